@@ -1,5 +1,7 @@
 #include <MeshFrame/core/Mesh/MeshCoreHeaders.h>
 #include <MeshFrame/core/viewer/MeshViewer.h>
+#include <MeshFrame/core/FileIO/ObjFramePrefetcher.h>
+#include <MeshFrame/core/FileIO/MeshSequenceFile.h>
 #include <AC/AC.h>
 #include <AC/Def.h>
 #include <AC/IO_AC.h>
@@ -12,6 +14,11 @@ MeshLib::CMeshViewer * pViewer;
 AC::VecStr filesObj;
 AC::VecStr filesBmp;
 M * pMesh = NULL;
+MeshLib::CObjFramePrefetcher * pPrefetcher = NULL;
+MeshLib::CMeshFrame frame;
+// set when playing a compressed .mfsq sequence instead of a folder of .obj files
+MeshLib::CMeshSequenceReader * pSequence = NULL;
+int numFrames = 0;
 clock_t waitTimeStart;
 MeshLib::CPoint centroid;
 
@@ -29,6 +36,8 @@ int frameRate = 25;
 int minFrameRate = 1;
 int maxFrameRate = 200;
 int totalWaitTimeThres = 1000 / frameRate;
+// number of frames parsed ahead in the background
+int numPrefetch = 8;
 
 void getMeshScale(M * pM, MeshLib::CPoint & c, float & s) {
 	MeshLib::CPoint center(0, 0, 0);
@@ -61,13 +70,33 @@ void normalizeMesh(M * pM, MeshLib::CPoint c, float s) {
 }
 
 
-void changeToNextFrame() {
-	int size = filesObj.size();
-	delete pMesh;
-	pMesh = new M;
-	pMesh->read_obj(filesObj[frameId].c_str(), false);
-	normalizeMesh(pMesh, centroid, scale);
-	pViewer->setMeshPointer(pMesh, true, false, true);
+/*
+* All the frames share the connectivity of the first one: only the positions are updated, from the frames
+* parsed in the background. Falls back to a full read_obj if a frame does not match the current mesh.
+*/
+void loadFrame(int direction) {
+	if (pSequence != NULL) {
+		pSequence->decodeFrame(frameId, pMesh);
+		normalizeMesh(pMesh, centroid, scale);
+		pViewer->updateMeshGeometry(true);
+		if (showFrameId)
+		{
+			printf("Frame: %d\n", frameId);
+		}
+		return;
+	}
+	pPrefetcher->getFrame(frameId, frame, direction);
+	if (pMesh->updatePositionsFromBuffer(&frame.verts)) {
+		normalizeMesh(pMesh, centroid, scale);
+		pViewer->updateMeshGeometry(true);
+	}
+	else {
+		delete pMesh;
+		pMesh = new M;
+		pMesh->read_obj(filesObj[frameId].c_str(), false);
+		normalizeMesh(pMesh, centroid, scale);
+		pViewer->setMeshPointer(pMesh, true, false, true);
+	}
 	if (hasTexture)
 	{
 		pViewer->setTexture(filesBmp[frameId].c_str());
@@ -76,6 +105,11 @@ void changeToNextFrame() {
 	{
 		printf("Frame: %d Name: %s\n", frameId, filesObj[frameId].c_str());
 	}
+}
+
+void changeToNextFrame() {
+	int size = numFrames;
+	loadFrame(1);
 	++frameId;
 	if (frameId >= size)
 	{
@@ -84,20 +118,8 @@ void changeToNextFrame() {
 }
 
 void changeToLastFrame() {
-	int size = filesObj.size();
-	delete pMesh;
-	pMesh = new M;
-	pMesh->read_obj(filesObj[frameId].c_str(), false);
-	normalizeMesh(pMesh, centroid, scale);
-	pViewer->setMeshPointer(pMesh, true, false, true);
-	if (hasTexture)
-	{
-		pViewer->setTexture(filesBmp[frameId].c_str());
-	}
-	if (showFrameId)
-	{
-		printf("Frame: %d Name: %s\n", frameId, filesObj[frameId].c_str());
-	}
+	int size = numFrames;
+	loadFrame(-1);
 	--frameId;
 	if (frameId < 0)
 	{
@@ -175,28 +197,40 @@ void switchFaceIdleFunc() {
 
 int main(int argc, char ** argv) {
 	if (argc < 2) {
-		printf("Need 1 input file: mesh.\n");
+		printf("Need 1 input: [path to meshes] or [.mfsq sequence].\n");
 		return -1;
 	}
 
-	AC::IO::getFilesWithExt(argv[1], "obj", filesObj);
-	if (filesObj.size() == 0)
-	{
-		AC::IO::getFilesWithExt(argv[1], "txt", filesObj);
+	pMesh = new M;
+	std::string input(argv[1]);
+	if (input.size() > 5 && input.substr(input.size() - 5) == ".mfsq") {
+		pSequence = new MeshLib::CMeshSequenceReader;
+		if (!pSequence->open(argv[1]) || !pSequence->buildMesh(pMesh)) {
+			return -1;
+		}
+		numFrames = pSequence->numFrames();
 	}
-	AC::IO::getFilesWithExt(argv[1], "bmp", filesBmp);
+	else {
+		AC::IO::getFilesWithExt(argv[1], "obj", filesObj);
+		if (filesObj.size() == 0)
+		{
+			AC::IO::getFilesWithExt(argv[1], "txt", filesObj);
+		}
+		AC::IO::getFilesWithExt(argv[1], "bmp", filesBmp);
 
-	M m;
-	m.read_obj(filesObj.front().c_str(), false);
+		pMesh->read_obj(filesObj.front().c_str(), false);
+		pPrefetcher = new MeshLib::CObjFramePrefetcher(filesObj, numPrefetch);
+		numFrames = filesObj.size();
+	}
 	waitTimeStart = clock();
-	getMeshScale(&m, centroid, scale);
-	normalizeMesh(&m, centroid, scale);
+	getMeshScale(pMesh, centroid, scale);
+	normalizeMesh(pMesh, centroid, scale);
 
 	MeshLib::CMeshViewer viewer;
 	pViewer = &viewer;
 	viewer.setting().vertexColorMode = MeshLib::GLSetting::defaultColor;
 	viewer.setting().vertexSize = 4;
-	viewer.setMeshPointer(&m, true, false, true);
+	viewer.setMeshPointer(pMesh, true, false, true);
 	if (hasTexture)
 	{
 		viewer.setTexture(filesBmp.front().c_str());
@@ -204,5 +238,7 @@ int main(int argc, char ** argv) {
 	viewer.setUserIdleFunc(switchFaceIdleFunc);
 	viewer.setUserKeyFunc(sequenceDisplayKeyFunction);
 	viewer.show();
+	delete pPrefetcher;
+	delete pSequence;
 	delete pMesh;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <MeshFrame/core/Mesh/MeshCoreHeaders.h>
 #include <MeshFrame/core/viewer/MeshViewer.h>
+#include <MeshFrame/core/FileIO/ObjFramePrefetcher.h>
 #include <AC/AC.h>
 #include <AC/Def.h>
 #include <AC/IO_AC.h>
@@ -12,6 +13,8 @@ MeshLib::CMeshViewer * pViewer;
 AC::VecStr filesObj;
 AC::VecStr filesTexture;
 M * pMesh = NULL;
+MeshLib::CObjFramePrefetcher * pPrefetcher = NULL;
+MeshLib::CMeshFrame frame;
 clock_t waitTimeStart;
 MeshLib::CPoint centroid;
 
@@ -29,6 +32,8 @@ int frameRate = 25;
 int minFrameRate = 1;
 int maxFrameRate = 200;
 int totalWaitTimeThres = 1000 / frameRate;
+// number of frames parsed ahead in the background
+int numPrefetch = 8;
 
 void getMeshScale(M * pM, MeshLib::CPoint & c, float & s) {
 	MeshLib::CPoint center(0, 0, 0);
@@ -61,13 +66,23 @@ void normalizeMesh(M * pM, MeshLib::CPoint c, float s) {
 }
 
 
-void changeToNextFrame() {
-	int size = filesObj.size();
-	delete pMesh;
-	pMesh = new M;
-	pMesh->read_obj(filesObj[frameId].c_str(), false);
-	normalizeMesh(pMesh, centroid, scale);
-	pViewer->setMeshPointer(pMesh, true, false, true);
+/*
+* All the frames share the connectivity of the first one: only the positions are updated, from the frames
+* parsed in the background. Falls back to a full read_obj if a frame does not match the current mesh.
+*/
+void loadFrame(int direction) {
+	pPrefetcher->getFrame(frameId, frame, direction);
+	if (pMesh->updatePositionsFromBuffer(&frame.verts)) {
+		normalizeMesh(pMesh, centroid, scale);
+		pViewer->updateMeshGeometry(true);
+	}
+	else {
+		delete pMesh;
+		pMesh = new M;
+		pMesh->read_obj(filesObj[frameId].c_str(), false);
+		normalizeMesh(pMesh, centroid, scale);
+		pViewer->setMeshPointer(pMesh, true, false, true);
+	}
 	if (hasTexture)
 	{
 		pViewer->setTexture(filesTexture[frameId].c_str());
@@ -76,6 +91,11 @@ void changeToNextFrame() {
 	{
 		printf("Frame: %d Name: %s\n", frameId, filesObj[frameId].c_str());
 	}
+}
+
+void changeToNextFrame() {
+	int size = filesObj.size();
+	loadFrame(1);
 	++frameId;
 	if (frameId >= size)
 	{
@@ -85,19 +105,7 @@ void changeToNextFrame() {
 
 void changeToLastFrame() {
 	int size = filesObj.size();
-	delete pMesh;
-	pMesh = new M;
-	pMesh->read_obj(filesObj[frameId].c_str(), false);
-	normalizeMesh(pMesh, centroid, scale);
-	pViewer->setMeshPointer(pMesh, true, false, true);
-	if (hasTexture)
-	{
-		pViewer->setTexture(filesTexture[frameId].c_str());
-	}
-	if (showFrameId)
-	{
-		printf("Frame: %d Name: %s\n", frameId, filesObj[frameId].c_str());
-	}
+	loadFrame(-1);
 	--frameId;
 	if (frameId < 0)
 	{
@@ -190,17 +198,18 @@ int main(int argc, char ** argv) {
 	hasTexture = false;
 	hasTexture = true;
 
-	M m;
-	m.read_obj(filesObj.front().c_str(), false);
+	pMesh = new M;
+	pMesh->read_obj(filesObj.front().c_str(), false);
 	waitTimeStart = clock();
-	getMeshScale(&m, centroid, scale);
-	normalizeMesh(&m, centroid, scale);
+	getMeshScale(pMesh, centroid, scale);
+	normalizeMesh(pMesh, centroid, scale);
+	pPrefetcher = new MeshLib::CObjFramePrefetcher(filesObj, numPrefetch);
 
 	MeshLib::CMeshViewer viewer;
 	pViewer = &viewer;
 	viewer.setting().vertexColorMode = MeshLib::GLSetting::userDefined;
 	viewer.setting().vertexSize = 5;
-	viewer.setMeshPointer(&m, true, false, true);
+	viewer.setMeshPointer(pMesh, true, false, true);
 	if (hasTexture)
 	{
 		viewer.setTexture(filesTexture.front().c_str());
@@ -208,5 +217,6 @@ int main(int argc, char ** argv) {
 	viewer.setUserIdleFunc(switchFaceIdleFunc);
 	viewer.setUserKeyFunc(sequenceDisplayKeyFunction);
 	viewer.show();
+	delete pPrefetcher;
 	delete pMesh;
 }
\ No newline at end of file
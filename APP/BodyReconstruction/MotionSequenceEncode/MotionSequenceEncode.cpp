@@ -0,0 +1,49 @@
+#include <MeshFrame/core/FileIO/ObjFramePrefetcher.h>
+#include <MeshFrame/core/FileIO/MeshSequenceFile.h>
+#include <AC/AC.h>
+#include <AC/Def.h>
+#include <AC/IO_AC.h>
+#include <algorithm>
+#include <ctime>
+
+/*
+* Pack a folder of .obj frames sharing one connectivity into a single .mfsq file,
+* which can be played by MotionSequenceDisplay.
+*/
+int main(int argc, char ** argv) {
+	if (argc < 3) {
+		printf("Usage: MotionSequenceEncode [path to meshes] [output .mfsq] [quantization bits, default 16] [key frame interval, default 32]\n");
+		return -1;
+	}
+	int quantBits = argc > 3 ? atoi(argv[3]) : 16;
+	int keyFrameInterval = argc > 4 ? atoi(argv[4]) : 32;
+
+	AC::VecStr filesObj;
+	AC::IO::getFilesWithExt(argv[1], "obj", filesObj);
+	if (filesObj.size() == 0)
+	{
+		printf("No .obj file found in: %s\n", argv[1]);
+		return -1;
+	}
+	std::sort(filesObj.begin(), filesObj.end());
+
+	clock_t start = clock();
+	MeshLib::CMeshFrame frame;
+	MeshLib::readObjFrame(filesObj.front().c_str(), frame, true);
+
+	MeshLib::CMeshSequenceWriter writer;
+	if (!writer.open(argv[2], (int)frame.verts.size(), frame.faces, quantBits, keyFrameInterval)) {
+		return -1;
+	}
+
+	MeshLib::CObjFramePrefetcher prefetcher(filesObj, 8);
+	for (int iFrame = 0; iFrame < (int)filesObj.size(); ++iFrame) {
+		prefetcher.getFrame(iFrame, frame);
+		if (!writer.addFrame(frame.verts)) {
+			printf("Frame %s does not match the connectivity of the first frame!\n", filesObj[iFrame].c_str());
+			return -1;
+		}
+	}
+	writer.close();
+	printf("Encoded %d frames in %f seconds.\n", (int)filesObj.size(), (double)(clock() - start) / CLOCKS_PER_SEC);
+}
\ No newline at end of file
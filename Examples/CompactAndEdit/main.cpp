@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <vector>
+#include <array>
+#include <MeshFrame/core/Mesh/MeshCoreHeaders.h>
+#include <MeshFrame/core/Mesh/DynamicMesh.h>
+#include <MeshFrame/core/Mesh/MeshSimplifier.h>
+
+/*
+* Creates elements after DynamicMesh::compact: the slots the compaction vacates at the end of the pools
+* are appended to again and have to come out as fresh as never used ones.
+*/
+
+using namespace MeshLib;
+
+typedef DynamicMesh<CVertex, CEdge, CFace, CHalfEdge> M;
+
+#define GRID_SIZE 30
+#define TARGET_FACES 400
+
+void makeGrid(M & mesh, int n)
+{
+	std::vector<std::array<double, 3>> verts;
+	std::vector<std::array<int, 3>> faces;
+	for (int j = 0; j <= n; ++j)
+	{
+		for (int i = 0; i <= n; ++i)
+		{
+			verts.push_back({ (double)i, (double)j, 0.0 });
+		}
+	}
+	for (int j = 0; j < n; ++j)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			int a = j * (n + 1) + i, b = a + 1, c = a + n + 2, d = a + n + 1;
+			faces.push_back({ a, b, c });
+			faces.push_back({ a, c, d });
+		}
+	}
+	mesh.readVFBuffer(CStridedArray<double>::fromVector(verts), CStridedArray<int>::fromVector(faces));
+}
+
+int countBroken(M & mesh)
+{
+	int broken = 0;
+	for (CHalfEdge * pH : mesh.getHEContainer())
+	{
+		if (pH->he_next()->he_next()->he_next() != pH) ++broken;
+		if (pH->he_sym() != NULL && pH->he_sym()->he_sym() != pH) ++broken;
+		if (pH->he_sym() == NULL && !pH->edge()->boundary()) ++broken;
+	}
+	for (CVertex * pV : mesh.getVContainer())
+	{
+		if (!mesh.isManifold(pV)) ++broken;
+	}
+	return broken;
+}
+
+int main(int argc, char ** argv)
+{
+	M mesh;
+	makeGrid(mesh, GRID_SIZE);
+
+	CMeshSimplifier<M> simplifier;
+	simplifier.simplifyParallel(&mesh, TARGET_FACES);
+	mesh.compact();
+
+	std::vector<CEdge *> boundaryEdges;
+	for (CEdge * pE : mesh.getEContainer())
+	{
+		if (pE->boundary()) boundaryEdges.push_back(pE);
+	}
+	for (CEdge * pE : boundaryEdges)
+	{
+		CPoint p = (pE->halfedge()->source()->point() + pE->halfedge()->target()->point()) / 2;
+		mesh.splitEdge(pE, p);
+	}
+
+	int broken = countBroken(mesh);
+	printf("%d faces after splitting %d boundary edges, %d broken elements\n", (int)mesh.numFaces(), (int)boundaryEdges.size(), broken);
+	return broken == 0 ? 0 : 1;
+}
@@ -0,0 +1,937 @@
+/*!
+*      \file EdgebreakerFile.h
+*      \brief Connectivity compressed static triangle mesh format (.meb)
+*
+*		Connectivity is coded by an Edgebreaker-like traversal: triangles are conquered one by one
+*		across the gate edge of an active boundary loop, each one producing one of the symbols
+*		C (new vertex), R, L, E (closing the right, the left or both edges), S (split the loop)
+*		or M (merge with another loop, needed for handles). Holes are closed by a dummy vertex
+*		beforehand, so every loop of the traversal is surrounded by triangles. S and M carry an
+*		offset along the loops, like in the original Edgebreaker decoder.
+*
+*		Positions are quantized and predicted by the parallelogram rule across the gate edge;
+*		uv(), normal() and color() are coded the same way when the vertex type has them.
+*		Everything is coded in a single adaptive range coded stream (see RangeCoder.h).
+*
+*		Vertices are renumbered in traversal order by the decoder.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include "../Geometry/Point.h"
+#include "../Geometry/Point2.h"
+#include "RangeCoder.h"
+
+namespace MeshLib {
+
+	namespace Edgebreaker {
+		const uint32_t VERSION = 1;
+
+		enum Symbol { C = 0, R = 1, L = 2, E = 3, S = 4, M = 5, V = 6, NumSymbols = 7 };
+		enum AttributeFlag { HasUV = 1, HasNormal = 2, HasColor = 4 };
+
+		/*! node of an active loop, stands for a vertex and the loop edge going out of it */
+		struct Node
+		{
+			int v;
+			/* vertex opposite to the out edge in the conquered triangle, used for prediction */
+			int opp;
+			int prev, next;
+			/* encoder only: loop id and halfedge of the out edge */
+			int loop;
+			int he;
+		};
+
+		struct Loop
+		{
+			int id;
+			int gate;
+			int anchor;
+			int size;
+		};
+
+		/*! active loops, shared by the encoder and the decoder so that they take exactly the same decisions */
+		class CLoops
+		{
+		public:
+			int newNode(int v, int opp) {
+				int n;
+				if (!mFreeNodes.empty()) {
+					n = mFreeNodes.back();
+					mFreeNodes.pop_back();
+				}
+				else {
+					n = (int)nodes.size();
+					nodes.push_back(Node());
+				}
+				Node & node = nodes[n];
+				node.v = v;
+				node.opp = opp;
+				node.prev = node.next = n;
+				node.loop = -1;
+				node.he = -1;
+				return n;
+			}
+			void deleteNode(int n) {
+				Loop & lp = current();
+				if (lp.anchor == n) lp.anchor = nodes[n].next;
+				mFreeNodes.push_back(n);
+			}
+			void link(int a, int b) {
+				nodes[a].next = b;
+				nodes[b].prev = a;
+			}
+
+			/* start a component by its first triangle, whose 3 edges form the first loop */
+			void startTriangle(int v0, int v1, int v2) {
+				int n0 = newNode(v0, v2), n1 = newNode(v1, v0), n2 = newNode(v2, v1);
+				link(n0, n1);
+				link(n1, n2);
+				link(n2, n0);
+				Loop lp = { mLoopId++, n0, n0, 3 };
+				stack.push_back(lp);
+			}
+
+			Loop & current() { return stack.back(); };
+
+			/* C: conquer the triangle (b, a, x) with a new vertex x, continue with the edge x->b */
+			int opC(int x) {
+				Loop & lp = current();
+				int ga = lp.gate, gb = nodes[ga].next;
+				int nx = newNode(x, nodes[ga].v);
+				nodes[ga].opp = nodes[gb].v;
+				link(ga, nx);
+				link(nx, gb);
+				lp.size++;
+				lp.gate = nx;
+				return nx;
+			}
+			/* R: x is the vertex after b, continue with the edge a->x */
+			void opR() {
+				Loop & lp = current();
+				int ga = lp.gate, gb = nodes[ga].next;
+				nodes[ga].opp = nodes[gb].v;
+				link(ga, nodes[gb].next);
+				deleteNode(gb);
+				lp.size--;
+			}
+			/* L: x is the vertex before a, continue with the edge x->b */
+			void opL() {
+				Loop & lp = current();
+				int ga = lp.gate, px = nodes[ga].prev;
+				nodes[px].opp = nodes[ga].v;
+				link(px, nodes[ga].next);
+				deleteNode(ga);
+				lp.size--;
+				lp.gate = px;
+			}
+			/* E: both edges already conquered. Closes the loop, or pinches it if x appears twice */
+			void opE() {
+				Loop & lp = current();
+				if (lp.size == 3) {
+					for (int n = lp.gate, i = 0; i < 3; ++i) {
+						int next = nodes[n].next;
+						mFreeNodes.push_back(n);
+						n = next;
+					}
+					stack.pop_back();
+					return;
+				}
+				int ga = lp.gate, gb = nodes[ga].next, px = nodes[ga].prev, nx = nodes[gb].next;
+				nodes[px].opp = nodes[nx].opp;
+				nodes[px].he = nodes[nx].he;
+				link(px, nodes[nx].next);
+				deleteNode(ga);
+				deleteNode(gb);
+				deleteNode(nx);
+				lp.size -= 3;
+				lp.gate = px;
+			}
+			/* S: x is the node at offset k after b in the current loop, split the loop in two */
+			int opS(int nx) {
+				int ga = current().gate, gb = nodes[ga].next, pnx = nodes[nx].prev;
+				int k = 0;
+				for (int n = gb; n != nx; n = nodes[n].next) ++k;
+				int xA = newNode(nodes[nx].v, nodes[ga].v);
+				Loop & lp = current();
+				nodes[ga].opp = nodes[gb].v;
+				link(ga, nx);
+				link(pnx, xA);
+				link(xA, gb);
+				Loop loopA = { mLoopId++, xA, xA, k + 1 };
+				lp.size = lp.size - k;
+				lp.anchor = ga;
+				stack.push_back(loopA);
+				return xA;
+			}
+			/* M: x is the node nx of the loop at stack index iLoop, merge it into the current loop */
+			int opM(int iLoop, int nx) {
+				int ga = current().gate, gb = nodes[ga].next, pnx = nodes[nx].prev;
+				int xB = newNode(nodes[nx].v, nodes[ga].v);
+				Loop & lp = current();
+				nodes[ga].opp = nodes[gb].v;
+				link(ga, nx);
+				link(pnx, xB);
+				link(xB, gb);
+				lp.size += stack[iLoop].size + 1;
+				lp.gate = xB;
+				lp.anchor = ga;
+				Loop merged = lp;
+				stack.erase(stack.begin() + iLoop);
+				stack.back() = merged;
+				return xB;
+			}
+
+			void clear() {
+				nodes.clear();
+				mFreeNodes.clear();
+				stack.clear();
+			}
+
+			std::vector<Node> nodes;
+			std::vector<Loop> stack;
+
+		private:
+			std::vector<int> mFreeNodes;
+			int mLoopId = 0;
+		};
+
+		/*! symbol model, binary decisions conditioned by the previous symbol */
+		class CSymbolModel
+		{
+		public:
+			CSymbolModel() {
+				for (int i = 0; i < NumSymbols; ++i)
+					for (int j = 0; j < NumSymbols - 1; ++j)
+						mProbs[i][j] = BIT_PROB_INIT;
+			}
+			void encode(CRangeEncoder & enc, int symbol) {
+				for (int j = 0; j < NumSymbols - 1; ++j) {
+					enc.encodeBit(mProbs[mLast][j], symbol == j ? 0 : 1);
+					if (symbol == j) break;
+				}
+				mLast = symbol;
+			}
+			int decode(CRangeDecoder & dec) {
+				int symbol = NumSymbols - 1;
+				for (int j = 0; j < NumSymbols - 1; ++j) {
+					if (dec.decodeBit(mProbs[mLast][j]) == 0) {
+						symbol = j;
+						break;
+					}
+				}
+				mLast = symbol;
+				return symbol;
+			}
+		private:
+			CBitProb mProbs[NumSymbols][NumSymbols - 1];
+			int mLast = C;
+		};
+
+		/*! integer attribute of D channels, quantized over its bounding box */
+		template<int D>
+		struct CQuantizedAttribute
+		{
+			static const int MAX_BITS = 30;
+
+			double min[D];
+			double step = 1.0;
+			std::vector<std::array<int32_t, D>> q;
+			CIntModel models[D];
+
+			/*! bits in [1, MAX_BITS]: the parallelogram predictions q[a] + q[b] - q[c] have to fit an int32_t */
+			void setRange(double vMin[D], double vMax[D], int bits) {
+				assert(bits >= 1 && bits <= MAX_BITS);
+				double extent = 0;
+				for (int j = 0; j < D; ++j) {
+					min[j] = vMin[j];
+					extent = vMax[j] - vMin[j] > extent ? vMax[j] - vMin[j] : extent;
+				}
+				if (extent == 0.0) extent = 1.0;
+				step = extent / (double)((1u << bits) - 1);
+			}
+			void write(FILE * pFile) {
+				fwrite(min, sizeof(double), D, pFile);
+				fwrite(&step, sizeof(double), 1, pFile);
+			}
+			/*! false on a truncated file, or a range no setRange could have written */
+			bool read(FILE * pFile) {
+				if (fread(min, sizeof(double), D, pFile) != D || fread(&step, sizeof(double), 1, pFile) != 1) return false;
+				for (int j = 0; j < D; ++j) {
+					if (!(fabs(min[j]) < HUGE_VAL)) return false;
+				}
+				return step > 0.0 && step < HUGE_VAL;
+			}
+			std::array<int32_t, D> quantize(const double * value) {
+				std::array<int32_t, D> r;
+				for (int j = 0; j < D; ++j) r[j] = (int32_t)floor((value[j] - min[j]) / step + 0.5);
+				return r;
+			}
+			double dequantize(int32_t value, int j) {
+				return min[j] + value * step;
+			}
+			/*
+			* Prediction of the attribute of x in the triangle (b, a, x), c being opposite to a->b in the conquered
+			* triangle. Parallelogram if a, b, c are real vertices, else falls back to the available neighbors.
+			*/
+			std::array<int32_t, D> predict(int a, int b, int c, const std::vector<bool> & dummy, int last) {
+				std::array<int32_t, D> p;
+				bool hasA = a >= 0 && !dummy[a], hasB = b >= 0 && !dummy[b], hasC = c >= 0 && !dummy[c];
+				for (int j = 0; j < D; ++j) {
+					if (hasA && hasB && hasC) p[j] = q[a][j] + q[b][j] - q[c][j];
+					else if (hasA && hasB) p[j] = (q[a][j] + q[b][j]) / 2;
+					else if (hasA) p[j] = q[a][j];
+					else if (hasB) p[j] = q[b][j];
+					else if (last >= 0) p[j] = q[last][j];
+					else p[j] = 0;
+				}
+				return p;
+			}
+			void encode(CRangeEncoder & enc, int v, const std::array<int32_t, D> & prediction) {
+				for (int j = 0; j < D; ++j) models[j].encode(enc, q[v][j] - prediction[j]);
+			}
+			void decode(CRangeDecoder & dec, int v, const std::array<int32_t, D> & prediction) {
+				if ((int)q.size() <= v) q.resize(v + 1);
+				for (int j = 0; j < D; ++j) q[v][j] = prediction[j] + models[j].decode(dec);
+			}
+		};
+
+		/*! all the per vertex streams */
+		struct CVertexStreams
+		{
+			CQuantizedAttribute<3> position;
+			CQuantizedAttribute<2> uv;
+			CQuantizedAttribute<3> normal;
+			CQuantizedAttribute<3> color;
+			uint32_t flags = 0;
+			/* last real vertex coded, fallback predictor */
+			int last = -1;
+
+			void encode(CRangeEncoder & enc, int v, int a, int b, int c, const std::vector<bool> & dummy) {
+				position.encode(enc, v, position.predict(a, b, c, dummy, last));
+				if (flags & HasUV) uv.encode(enc, v, uv.predict(a, b, c, dummy, last));
+				if (flags & HasNormal) normal.encode(enc, v, normal.predict(a, b, -1, dummy, last));
+				if (flags & HasColor) color.encode(enc, v, color.predict(a, b, -1, dummy, last));
+				last = v;
+			}
+			void decode(CRangeDecoder & dec, int v, int a, int b, int c, const std::vector<bool> & dummy) {
+				position.decode(dec, v, position.predict(a, b, c, dummy, last));
+				if (flags & HasUV) uv.decode(dec, v, uv.predict(a, b, c, dummy, last));
+				if (flags & HasNormal) normal.decode(dec, v, normal.predict(a, b, -1, dummy, last));
+				if (flags & HasColor) color.decode(dec, v, color.predict(a, b, -1, dummy, last));
+				last = v;
+			}
+			/* keep the quantized buffers in step with the vertex count, dummy vertices included */
+			void resize(int numVertices) {
+				position.q.resize(numVertices);
+				if (flags & HasUV) uv.q.resize(numVertices);
+				if (flags & HasNormal) normal.q.resize(numVertices);
+				if (flags & HasColor) color.q.resize(numVertices);
+			}
+		};
+	}
+
+	/*!
+	* \brief Encoder of the .meb format.
+	*
+	*  Needs a manifold triangle mesh (manifold vertices are not required), boundaries are allowed.
+	*/
+	template<typename MeshType>
+	class CEdgebreakerEncoder
+	{
+	public:
+		/*!
+		Encode a mesh.
+		\param pMesh the input mesh
+		\param fileName the output file name
+		\param quantBits position quantization, relatively to the bounding box, in [1, 30]
+		\param withAttributes whether to write the uv(), normal() and color() streams the vertex type has
+		\return false if quantBits is out of range, the file can not be written or the mesh has non-manifold edges
+		*/
+		bool encode(MeshType * pMesh, const char * fileName, int quantBits = 14, bool withAttributes = true)
+		{
+			using namespace Edgebreaker;
+			if (quantBits < 1 || quantBits > CQuantizedAttribute<3>::MAX_BITS) {
+				printf("Edgebreaker: quantBits must be in [1, %d]!\n", CQuantizedAttribute<3>::MAX_BITS);
+				return false;
+			}
+			if (!_buildTables(pMesh)) return false;
+
+			_setupStreams(pMesh, quantBits, withAttributes);
+
+			std::vector<uint8_t> buffer;
+			CRangeEncoder enc(buffer);
+			CSymbolModel symbols;
+			CIntModel offsetModel, loopModel, vertexRefModel, isolatedModel;
+			CBitProb newComponentProb = BIT_PROB_INIT, startVertexProb = BIT_PROB_INIT, dummyProb = BIT_PROB_INIT;
+
+			const int numTriangles = (int)mFV.size() / 3;
+			mVisited.assign(numTriangles, false);
+			mHENode.assign(mFV.size(), -1);
+			mDecodedId.assign(mNumVertices, -1);
+			mDecodedDummy.clear();
+			mStreams.resize(0);
+			mLoops.clear();
+			int numDecoded = 0;
+
+			/* new vertex in traversal order: code its dummy flag, then its attributes */
+			auto emitVertex = [&](int v, int a, int b, int c) {
+				mDecodedId[v] = numDecoded++;
+				bool isDummy = v >= mNumRealVertices;
+				mDecodedDummy.push_back(isDummy);
+				enc.encodeBit(dummyProb, isDummy ? 1 : 0);
+				mStreams.resize(numDecoded);
+				if (!isDummy) {
+					_copyAttributes(v, mDecodedId[v]);
+					mStreams.encode(enc, mDecodedId[v], a, b, c, mDecodedDummy);
+				}
+			};
+
+			for (int fStart = 0; fStart < mNumRealTriangles; ++fStart) {
+				if (mVisited[fStart]) continue;
+				enc.encodeBit(newComponentProb, 1);
+
+				/* first triangle of the component */
+				mVisited[fStart] = true;
+				int vs[3];
+				for (int k = 0; k < 3; ++k) {
+					vs[k] = mFV[3 * fStart + k];
+					if (mDecodedId[vs[k]] < 0) {
+						enc.encodeBit(startVertexProb, 0);
+						int a = k > 0 ? mDecodedId[vs[k - 1]] : -1;
+						emitVertex(vs[k], a, -1, -1);
+					}
+					else {
+						enc.encodeBit(startVertexProb, 1);
+						vertexRefModel.encode(enc, numDecoded - 1 - mDecodedId[vs[k]]);
+					}
+				}
+				mLoops.startTriangle(mDecodedId[vs[0]], mDecodedId[vs[1]], mDecodedId[vs[2]]);
+				{
+					Loop & lp = mLoops.current();
+					int n = lp.gate;
+					for (int k = 0; k < 3; ++k) {
+						_setNodeHE(n, 3 * fStart + k);
+						n = mLoops.nodes[n].next;
+					}
+					lp.id = _newLoopLabel(lp);
+				}
+
+				while (!mLoops.stack.empty()) {
+					Loop & lp = mLoops.current();
+					int ga = lp.gate;
+					int gb = mLoops.nodes[ga].next;
+					int heAB = mLoops.nodes[ga].he;
+					int heBA = mSym[heAB];
+					int t = heBA / 3;
+					int heAX = _next(heBA), heXB = _next(heAX);
+					int x = mFV[heXB];
+					mVisited[t] = true;
+
+					bool rightDone = mVisited[mSym[heXB] / 3];
+					bool leftDone = mVisited[mSym[heAX] / 3];
+					int a = mLoops.nodes[ga].v, b = mLoops.nodes[gb].v, c = mLoops.nodes[ga].opp;
+
+					if (rightDone && leftDone) {
+						symbols.encode(enc, E);
+						bool closesLoop = lp.size == 3;
+						int px = mLoops.nodes[ga].prev;
+						mLoops.opE();
+						if (!closesLoop) {
+							mHENode[mLoops.nodes[px].he] = px;
+						}
+					}
+					else if (rightDone) {
+						symbols.encode(enc, R);
+						mLoops.opR();
+						_setNodeHE(ga, heAX);
+					}
+					else if (leftDone) {
+						symbols.encode(enc, L);
+						mLoops.opL();
+						_setNodeHE(mLoops.current().gate, heXB);
+					}
+					else {
+						int nx = _findLoopNode(heXB);
+						if (nx < 0) {
+							if (mDecodedId[x] < 0) {
+								symbols.encode(enc, C);
+								emitVertex(x, a, b, c);
+							}
+							else {
+								/* x was conquered in another fan: non-manifold vertex */
+								symbols.encode(enc, V);
+								vertexRefModel.encode(enc, numDecoded - 1 - mDecodedId[x]);
+							}
+							int n = mLoops.opC(mDecodedId[x]);
+							mLoops.nodes[n].loop = mLoops.current().id;
+							_setNodeHE(ga, heAX);
+							_setNodeHE(n, heXB);
+						}
+						else if (mLoops.nodes[nx].loop == lp.id) {
+							symbols.encode(enc, S);
+							int k = 0;
+							for (int n = gb; n != nx; n = mLoops.nodes[n].next) ++k;
+							offsetModel.encode(enc, k - 2);
+							int xA = mLoops.opS(nx);
+							_setNodeHE(ga, heAX);
+							_setNodeHE(xA, heXB);
+							Loop & loopA = mLoops.current();
+							loopA.id = _newLoopLabel(loopA);
+						}
+						else {
+							symbols.encode(enc, M);
+							int iLoop = 0;
+							while (mLoops.stack[iLoop].id != mLoops.nodes[nx].loop) ++iLoop;
+							loopModel.encode(enc, (int)mLoops.stack.size() - 2 - iLoop);
+							int m = 0;
+							for (int n = mLoops.stack[iLoop].anchor; n != nx; n = mLoops.nodes[n].next) ++m;
+							offsetModel.encode(enc, m);
+							int xB = mLoops.opM(iLoop, nx);
+							_setNodeHE(ga, heAX);
+							_setNodeHE(xB, heXB);
+							Loop & merged = mLoops.current();
+							merged.id = _newLoopLabel(merged);
+						}
+					}
+				}
+			}
+			enc.encodeBit(newComponentProb, 0);
+
+			/* vertices without any face */
+			int numIsolated = 0;
+			for (int v = 0; v < mNumRealVertices; ++v) if (mDecodedId[v] < 0) ++numIsolated;
+			isolatedModel.encode(enc, numIsolated);
+			for (int v = 0; v < mNumRealVertices; ++v) {
+				if (mDecodedId[v] >= 0) continue;
+				mDecodedId[v] = numDecoded++;
+				mDecodedDummy.push_back(false);
+				mStreams.resize(numDecoded);
+				_copyAttributes(v, mDecodedId[v]);
+				mStreams.encode(enc, mDecodedId[v], -1, -1, -1, mDecodedDummy);
+			}
+			enc.flush();
+
+			return _write(fileName, numDecoded, buffer);
+		}
+
+	private:
+		int _next(int he) { return 3 * (he / 3) + (he + 1) % 3; };
+
+		void _setNodeHE(int n, int he) {
+			mLoops.nodes[n].he = he;
+			mHENode[he] = n;
+		}
+
+		/* relabel the nodes of a new loop, returns its label */
+		int _newLoopLabel(Edgebreaker::Loop & lp) {
+			int id = mLoopLabel++;
+			int n = lp.gate;
+			for (int i = 0; i < lp.size; ++i) {
+				mLoops.nodes[n].loop = id;
+				n = mLoops.nodes[n].next;
+			}
+			return id;
+		}
+
+		/*
+		* Rotate around x = source of heX (x->b, in the triangle being conquered) through triangles not conquered
+		* yet, until reaching a conquered one: its edge y->x is a loop edge, the node after it is the occurrence
+		* of x on the loops. -1 if the whole fan of x is free.
+		*/
+		int _findLoopNode(int heX) {
+			int he = heX;
+			do {
+				int sym = mSym[he];
+				if (mVisited[sym / 3]) {
+					int ny = mHENode[sym];
+					return ny < 0 ? -1 : mLoops.nodes[ny].next;
+				}
+				he = _next(sym);
+			} while (he != heX);
+			return -1;
+		}
+
+		/* triangle and opposite halfedge tables, holes closed by a dummy vertex */
+		bool _buildTables(MeshType * pMesh)
+		{
+			auto & vertices = pMesh->vertices();
+			auto & faces = pMesh->faces();
+			auto & halfedges = pMesh->halfedges();
+
+			mVIndex.assign(vertices.getCurrentIndex(), -1);
+			mVertices.clear();
+			for (int i = 0; i < (int)vertices.getCurrentIndex(); ++i) {
+				if (vertices.hasBeenDeleted(i)) continue;
+				mVIndex[i] = (int)mVertices.size();
+				mVertices.push_back(vertices.getPointer(i));
+			}
+			mNumRealVertices = (int)mVertices.size();
+
+			std::vector<int> heIndex(halfedges.getCurrentIndex(), -1);
+			mFV.clear();
+			for (int i = 0; i < (int)faces.getCurrentIndex(); ++i) {
+				if (faces.hasBeenDeleted(i)) continue;
+				auto * pHE = MeshType::faceHalfedge(faces.getPointer(i));
+				for (int k = 0; k < 3; ++k) {
+					heIndex[pHE->index()] = (int)mFV.size();
+					mFV.push_back(mVIndex[MeshType::halfedgeSource(pHE)->index()]);
+					pHE = MeshType::halfedgeNext(pHE);
+				}
+			}
+			mNumRealTriangles = (int)mFV.size() / 3;
+			mSym.assign(mFV.size(), -1);
+			for (int i = 0; i < (int)faces.getCurrentIndex(); ++i) {
+				if (faces.hasBeenDeleted(i)) continue;
+				auto * pHE = MeshType::faceHalfedge(faces.getPointer(i));
+				for (int k = 0; k < 3; ++k) {
+					auto * pSym = MeshType::halfedgeSym(pHE);
+					if (pSym != NULL) {
+						if (MeshType::halfedgeSym(pSym) != pHE || MeshType::halfedgeSource(pSym) != MeshType::halfedgeTarget(pHE)) {
+							printf("Edgebreaker: the mesh has non-manifold edges!\n");
+							return false;
+						}
+						mSym[heIndex[pHE->index()]] = heIndex[pSym->index()];
+					}
+					pHE = MeshType::halfedgeNext(pHE);
+				}
+			}
+
+			/* close each boundary loop by a fan of triangles (v, u, d) around a dummy vertex d */
+			const int numRealHE = (int)mFV.size();
+			int numVertices = mNumRealVertices;
+			for (int h0 = 0; h0 < numRealHE; ++h0) {
+				if (mSym[h0] >= 0) continue;
+				int d = numVertices++;
+				std::vector<int> chain;
+				int h = h0;
+				do {
+					chain.push_back(h);
+					/* next boundary halfedge, rotating around the target of h, holes already closed are still boundaries */
+					int he = _next(h);
+					while (mSym[he] >= 0 && mSym[he] < numRealHE) {
+						he = _next(mSym[he]);
+					}
+					h = he;
+				} while (h != h0 && (int)chain.size() <= numRealHE);
+				if (h != h0) {
+					printf("Edgebreaker: inconsistent boundary!\n");
+					return false;
+				}
+				int firstT = (int)mFV.size() / 3;
+				int n = (int)chain.size();
+				for (int i = 0; i < n; ++i) {
+					int hb = chain[i];
+					int u = mFV[hb], v = mFV[_next(hb)];
+					int t = firstT + i;
+					/* halfedges: v->u, u->d, d->v */
+					mFV.push_back(v);
+					mFV.push_back(u);
+					mFV.push_back(d);
+					mSym.push_back(hb);
+					mSym.push_back(-1);
+					mSym.push_back(-1);
+					mSym[hb] = 3 * t;
+				}
+				for (int i = 0; i < n; ++i) {
+					int t = firstT + i, tNext = firstT + (i + 1) % n;
+					/* d->v of this triangle is opposite to u'->d of the triangle of the next boundary halfedge v->u' */
+					mSym[3 * t + 2] = 3 * tNext + 1;
+					mSym[3 * tNext + 1] = 3 * t + 2;
+				}
+			}
+			mNumVertices = numVertices;
+			return true;
+		}
+
+		void _setupStreams(MeshType * pMesh, int quantBits, bool withAttributes)
+		{
+			using namespace Edgebreaker;
+			mStreams = CVertexStreams();
+			if (mVertices.empty()) return;
+			auto * pV0 = mVertices[0];
+			if (withAttributes) {
+				if (pV0->hasUV()) mStreams.flags |= HasUV;
+				if (pV0->hasNormal()) mStreams.flags |= HasNormal;
+				if (pV0->hasColor()) mStreams.flags |= HasColor;
+			}
+			double pMin[3], pMax[3], uvMin[2], uvMax[2], cMin[3], cMax[3];
+			for (int j = 0; j < 3; ++j) {
+				pMin[j] = pMax[j] = pV0->point()[j];
+				if (mStreams.flags & HasColor) cMin[j] = cMax[j] = pV0->color()[j];
+			}
+			for (int j = 0; j < 2; ++j) {
+				if (mStreams.flags & HasUV) uvMin[j] = uvMax[j] = pV0->uv()[j];
+			}
+			for (auto * pV : mVertices) {
+				for (int j = 0; j < 3; ++j) {
+					pMin[j] = std::min(pMin[j], pV->point()[j]);
+					pMax[j] = std::max(pMax[j], pV->point()[j]);
+					if (mStreams.flags & HasColor) {
+						cMin[j] = std::min(cMin[j], (double)pV->color()[j]);
+						cMax[j] = std::max(cMax[j], (double)pV->color()[j]);
+					}
+				}
+				if (mStreams.flags & HasUV) {
+					for (int j = 0; j < 2; ++j) {
+						uvMin[j] = std::min(uvMin[j], pV->uv()[j]);
+						uvMax[j] = std::max(uvMax[j], pV->uv()[j]);
+					}
+				}
+			}
+			double nMin[3] = { -1, -1, -1 }, nMax[3] = { 1, 1, 1 };
+			mStreams.position.setRange(pMin, pMax, quantBits);
+			if (mStreams.flags & HasUV) mStreams.uv.setRange(uvMin, uvMax, 16);
+			if (mStreams.flags & HasNormal) mStreams.normal.setRange(nMin, nMax, 10);
+			if (mStreams.flags & HasColor) mStreams.color.setRange(cMin, cMax, 8);
+		}
+
+		void _copyAttributes(int v, int id)
+		{
+			using namespace Edgebreaker;
+			auto * pV = mVertices[v];
+			double p[3] = { pV->point()[0], pV->point()[1], pV->point()[2] };
+			mStreams.position.q[id] = mStreams.position.quantize(p);
+			if (mStreams.flags & HasUV) {
+				double uv[2] = { pV->uv()[0], pV->uv()[1] };
+				mStreams.uv.q[id] = mStreams.uv.quantize(uv);
+			}
+			if (mStreams.flags & HasNormal) {
+				double n[3] = { pV->normal()[0], pV->normal()[1], pV->normal()[2] };
+				mStreams.normal.q[id] = mStreams.normal.quantize(n);
+			}
+			if (mStreams.flags & HasColor) {
+				double c[3] = { pV->color()[0], pV->color()[1], pV->color()[2] };
+				mStreams.color.q[id] = mStreams.color.quantize(c);
+			}
+		}
+
+		bool _write(const char * fileName, int numDecoded, std::vector<uint8_t> & buffer)
+		{
+			using namespace Edgebreaker;
+			FILE * pFile;
+			if ((pFile = fopen(fileName, "wb")) == NULL) {
+				printf("Error in opening file: %s!\n", fileName);
+				return false;
+			}
+			uint32_t header[7] = { 0, VERSION, mStreams.flags, (uint32_t)mNumRealVertices, (uint32_t)mNumRealTriangles,
+				(uint32_t)numDecoded, (uint32_t)buffer.size() };
+			memcpy(header, "MFEB", 4);
+			fwrite(header, sizeof(uint32_t), 7, pFile);
+			mStreams.position.write(pFile);
+			if (mStreams.flags & HasUV) mStreams.uv.write(pFile);
+			if (mStreams.flags & HasNormal) mStreams.normal.write(pFile);
+			if (mStreams.flags & HasColor) mStreams.color.write(pFile);
+			fwrite(buffer.data(), 1, buffer.size(), pFile);
+			fclose(pFile);
+			return true;
+		}
+
+		std::vector<typename MeshType::VPtr> mVertices;
+		std::vector<int>  mVIndex;
+		int mNumRealVertices = 0;
+		int mNumRealTriangles = 0;
+		int mNumVertices = 0;
+		/* vertex of each corner, halfedge 3t+k goes from corner k to corner k+1 of triangle t */
+		std::vector<int>  mFV;
+		std::vector<int>  mSym;
+		std::vector<bool> mVisited;
+		/* loop node owning each loop edge */
+		std::vector<int>  mHENode;
+		std::vector<int>  mDecodedId;
+		std::vector<bool> mDecodedDummy;
+		int mLoopLabel = 0;
+		Edgebreaker::CLoops mLoops;
+		Edgebreaker::CVertexStreams mStreams;
+	};
+
+	/*!
+	* \brief Decoder of the .meb format, builds the mesh by readVFList.
+	*/
+	template<typename MeshType>
+	class CEdgebreakerDecoder
+	{
+	public:
+		/*!
+		Decode a .meb file into an empty mesh.
+		\param fileName the input file name
+		\param pMesh the output mesh
+		*/
+		bool decode(const char * fileName, MeshType * pMesh)
+		{
+			using namespace Edgebreaker;
+			FILE * pFile;
+			if ((pFile = fopen(fileName, "rb")) == NULL) {
+				printf("Error in opening file: %s!\n", fileName);
+				return false;
+			}
+			uint32_t header[7];
+			CVertexStreams streams;
+			bool valid = fread(header, sizeof(uint32_t), 7, pFile) == 7 && memcmp(header, "MFEB", 4) == 0 && header[1] == VERSION;
+			if (valid) {
+				streams.flags = header[2];
+				valid = streams.position.read(pFile);
+				if (valid && (streams.flags & HasUV)) valid = streams.uv.read(pFile);
+				if (valid && (streams.flags & HasNormal)) valid = streams.normal.read(pFile);
+				if (valid && (streams.flags & HasColor)) valid = streams.color.read(pFile);
+			}
+			std::vector<uint8_t> buffer;
+			if (valid) {
+				buffer.resize(header[6]);
+				valid = fread(buffer.data(), 1, buffer.size(), pFile) == buffer.size();
+			}
+			fclose(pFile);
+			if (!valid) {
+				printf("Not a valid .meb file: %s!\n", fileName);
+				return false;
+			}
+			const int numRealVertices = (int)header[3], numRealTriangles = (int)header[4], numDecodedVertices = (int)header[5];
+
+			CRangeDecoder dec(buffer.data(), buffer.size());
+			CSymbolModel symbols;
+			CIntModel offsetModel, loopModel, vertexRefModel, isolatedModel;
+			CBitProb newComponentProb = BIT_PROB_INIT, startVertexProb = BIT_PROB_INIT, dummyProb = BIT_PROB_INIT;
+			CLoops loops;
+			std::vector<bool> dummy;
+			dummy.reserve(numDecodedVertices);
+			std::vector<std::array<int, 3>> triangles;
+			triangles.reserve(numRealTriangles);
+			int numDecoded = 0;
+
+			auto newVertex = [&](int a, int b, int c) {
+				int v = numDecoded++;
+				bool isDummy = dec.decodeBit(dummyProb) != 0;
+				dummy.push_back(isDummy);
+				streams.resize(numDecoded);
+				if (!isDummy) streams.decode(dec, v, a, b, c, dummy);
+				return v;
+			};
+			auto addTriangle = [&](int v0, int v1, int v2) {
+				if (!dummy[v0] && !dummy[v1] && !dummy[v2]) {
+					std::array<int, 3> t = { v0, v1, v2 };
+					triangles.push_back(t);
+				}
+			};
+
+			while (dec.decodeBit(newComponentProb)) {
+				int vs[3];
+				for (int k = 0; k < 3; ++k) {
+					if (dec.decodeBit(startVertexProb) == 0) {
+						vs[k] = newVertex(k > 0 ? vs[k - 1] : -1, -1, -1);
+					}
+					else {
+						vs[k] = numDecoded - 1 - vertexRefModel.decode(dec);
+					}
+				}
+				addTriangle(vs[0], vs[1], vs[2]);
+				loops.startTriangle(vs[0], vs[1], vs[2]);
+
+				while (!loops.stack.empty()) {
+					if (dec.overrun() || numDecoded > numDecodedVertices) {
+						printf("Corrupted .meb file: %s!\n", fileName);
+						return false;
+					}
+					Loop & lp = loops.current();
+					int ga = lp.gate, gb = loops.nodes[ga].next;
+					int a = loops.nodes[ga].v, b = loops.nodes[gb].v, c = loops.nodes[ga].opp;
+					int x;
+					switch (symbols.decode(dec)) {
+					case C:
+						x = newVertex(a, b, c);
+						loops.opC(x);
+						break;
+					case V:
+						x = numDecoded - 1 - vertexRefModel.decode(dec);
+						loops.opC(x);
+						break;
+					case R:
+						x = loops.nodes[loops.nodes[gb].next].v;
+						loops.opR();
+						break;
+					case L:
+						x = loops.nodes[loops.nodes[ga].prev].v;
+						loops.opL();
+						break;
+					case E:
+						x = loops.nodes[loops.nodes[ga].prev].v;
+						loops.opE();
+						break;
+					case S: {
+						int k = offsetModel.decode(dec) + 2;
+						int nx = gb;
+						for (int i = 0; i < k; ++i) nx = loops.nodes[nx].next;
+						x = loops.nodes[nx].v;
+						loops.opS(nx);
+						break;
+					}
+					default: {
+						int iLoop = (int)loops.stack.size() - 2 - loopModel.decode(dec);
+						if (iLoop < 0 || iLoop >= (int)loops.stack.size() - 1) {
+							printf("Corrupted .meb file: %s!\n", fileName);
+							return false;
+						}
+						int m = offsetModel.decode(dec);
+						int nx = loops.stack[iLoop].anchor;
+						for (int i = 0; i < m; ++i) nx = loops.nodes[nx].next;
+						x = loops.nodes[nx].v;
+						loops.opM(iLoop, nx);
+						break;
+					}
+					}
+					addTriangle(b, a, x);
+				}
+			}
+
+			int numIsolated = isolatedModel.decode(dec);
+			for (int i = 0; i < numIsolated; ++i) {
+				int v = numDecoded++;
+				dummy.push_back(false);
+				streams.resize(numDecoded);
+				streams.decode(dec, v, -1, -1, -1, dummy);
+			}
+
+			/* drop the dummy vertices and build the mesh */
+			std::vector<int> realId(numDecoded, -1);
+			std::vector<std::array<double, 3>> verts;
+			verts.reserve(numRealVertices);
+			for (int v = 0; v < numDecoded; ++v) {
+				if (dummy[v]) continue;
+				realId[v] = (int)verts.size();
+				std::array<double, 3> p;
+				for (int j = 0; j < 3; ++j) p[j] = streams.position.dequantize(streams.position.q[v][j], j);
+				verts.push_back(p);
+			}
+			for (std::array<int, 3> & t : triangles) {
+				for (int k = 0; k < 3; ++k) t[k] = realId[t[k]];
+			}
+			pMesh->readVFList(&verts, &triangles, nullptr, false);
+
+			for (int v = 0; v < numDecoded; ++v) {
+				if (dummy[v]) continue;
+				auto * pV = pMesh->vertices().getPointer(realId[v]);
+				if ((streams.flags & HasUV) && pV->hasUV()) {
+					for (int j = 0; j < 2; ++j) pV->uv()[j] = streams.uv.dequantize(streams.uv.q[v][j], j);
+				}
+				if ((streams.flags & HasNormal) && pV->hasNormal()) {
+					CPoint n;
+					for (int j = 0; j < 3; ++j) n[j] = streams.normal.dequantize(streams.normal.q[v][j], j);
+					double l = n.norm();
+					pV->normal() = l > 0 ? n / l : n;
+				}
+				if ((streams.flags & HasColor) && pV->hasColor()) {
+					for (int j = 0; j < 3; ++j) pV->color()[j] = (float)streams.color.dequantize(streams.color.q[v][j], j);
+				}
+			}
+			return true;
+		}
+	};
+}
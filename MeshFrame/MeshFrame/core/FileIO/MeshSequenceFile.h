@@ -0,0 +1,428 @@
+/*!
+*      \file MeshSequenceFile.h
+*      \brief Compressed container for mesh sequences sharing one connectivity (.mfsq)
+*
+*		The face list is stored once. Positions are quantized on a uniform grid, each frame is
+*		predicted from the previous ones (key frames from the previous vertex) and the residuals
+*		are range coded. A frame index at the end of the file gives random access; decoding a
+*		frame costs at most one key frame interval of entropy decoding, and playing forward
+*		only one frame.
+*
+*		Layout (little endian):
+*		\code
+*		"MFSQ" | version | numVertices | numFaces | numFrames | keyFrameInterval   (uint32)
+*		step (double) | origin (3 double) | indexOffset (uint64)
+*		faces: numFaces * 3 int32
+*		frames: { predictor (uint8) | payload size (uint32) | range coded residuals }
+*		index: numFrames uint64 frame offsets
+*		\endcode
+*		A position is origin + step * q, q being the quantized integer coordinates; version 1 files have no
+*		origin field, their origin is 0.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <array>
+
+#include "../Geometry/Point.h"
+#include "RangeCoder.h"
+
+namespace MeshLib {
+
+	namespace MeshSequenceFile {
+		const uint32_t VERSION = 2;
+		/*! quantization bits: the linear predictions 2 q1 - q2 have to fit an int32_t */
+		const int MAX_QUANT_BITS = 30;
+		/*! frame predictors */
+		enum Predictor { KeyFrame = 0, Delta = 1, Linear = 2 };
+	}
+
+	/*!
+	* \brief Writes a .mfsq sequence frame by frame.
+	*
+	*  \code
+	*  CMeshSequenceWriter writer;
+	*  writer.open("capture.mfsq", numVertices, faces);
+	*  for (...) writer.addFrame(verts);
+	*  writer.close();
+	*  \endcode
+	*/
+	class CMeshSequenceWriter
+	{
+	public:
+		~CMeshSequenceWriter() { close(); };
+
+		/*!
+		Create the file and write the connectivity.
+		\param fileName the output file name
+		\param numVertices number of vertices of every frame
+		\param faces 0-based triangle list, shared by all the frames
+		\param quantBits quantization resolution, relatively to the bounding box of the first frame, in [1, 30]
+		\param keyFrameInterval a frame coded without temporal prediction every keyFrameInterval frames,
+		bounds the cost of random access
+		*/
+		bool open(const char * fileName, int numVertices, const std::vector<std::array<int, 3>> & faces,
+			int quantBits = 16, int keyFrameInterval = 32)
+		{
+			close();
+			if (quantBits < 1 || quantBits > MeshSequenceFile::MAX_QUANT_BITS) {
+				printf("Error in writing file: %s, quantBits must be in [1, %d]!\n", fileName, MeshSequenceFile::MAX_QUANT_BITS);
+				return false;
+			}
+			if ((mFile = fopen(fileName, "wb")) == NULL) {
+				printf("Error in opening file: %s!\n", fileName);
+				return false;
+			}
+			mNumVertices = numVertices;
+			mQuantBits = quantBits;
+			mKeyFrameInterval = keyFrameInterval > 0 ? keyFrameInterval : 1;
+			mStep = 0;
+			mOrigin[0] = mOrigin[1] = mOrigin[2] = 0;
+			mOffsets.clear();
+			mQ.assign(3 * numVertices, 0);
+			mQPrev.assign(3 * numVertices, 0);
+			mQPrev2.assign(3 * numVertices, 0);
+
+			uint32_t header[6] = { 0, MeshSequenceFile::VERSION, (uint32_t)numVertices, (uint32_t)faces.size(), 0, (uint32_t)mKeyFrameInterval };
+			memcpy(header, "MFSQ", 4);
+			fwrite(header, sizeof(uint32_t), 6, mFile);
+			fwrite(&mStep, sizeof(double), 1, mFile);
+			fwrite(mOrigin, sizeof(double), 3, mFile);
+			uint64_t indexOffset = 0;
+			fwrite(&indexOffset, sizeof(uint64_t), 1, mFile);
+			for (const std::array<int, 3> & f : faces) {
+				int32_t fi[3] = { f[0], f[1], f[2] };
+				fwrite(fi, sizeof(int32_t), 3, mFile);
+			}
+			return true;
+		}
+
+		/*!
+		Append a frame.
+		\param verts vertex positions, ordered as the vertices referred by the face list
+		*/
+		bool addFrame(const std::vector<std::array<double, 3>> & verts)
+		{
+			if (mFile == NULL || (int)verts.size() != mNumVertices) return false;
+			const int frameId = (int)mOffsets.size();
+			if (frameId == 0) {
+				_computeGrid(verts);
+			}
+
+			std::swap(mQPrev2, mQPrev);
+			std::swap(mQPrev, mQ);
+#pragma omp parallel for
+			for (int i = 0; i < mNumVertices; ++i) {
+				for (int j = 0; j < 3; ++j) {
+					mQ[3 * i + j] = (int32_t)floor((verts[i][j] - mOrigin[j]) / mStep + 0.5);
+				}
+			}
+
+			/* key frames are predicted from the previous vertex, the others choose the cheapest temporal predictor */
+			int posInGroup = frameId % mKeyFrameInterval;
+			uint8_t predictor = MeshSequenceFile::KeyFrame;
+			if (posInGroup == 1) {
+				predictor = MeshSequenceFile::Delta;
+			}
+			else if (posInGroup > 1) {
+				double costDelta = 0, costLinear = 0;
+#pragma omp parallel for reduction(+:costDelta, costLinear)
+				for (int i = 0; i < 3 * mNumVertices; ++i) {
+					costDelta += fabs((double)mQ[i] - mQPrev[i]);
+					costLinear += fabs((double)mQ[i] - 2.0 * mQPrev[i] + mQPrev2[i]);
+				}
+				predictor = costLinear < costDelta ? MeshSequenceFile::Linear : MeshSequenceFile::Delta;
+			}
+
+			mBuffer.clear();
+			CRangeEncoder encoder(mBuffer);
+			CIntModel models[3];
+			for (int i = 0; i < mNumVertices; ++i) {
+				for (int j = 0; j < 3; ++j) {
+					const int k = 3 * i + j;
+					models[j].encode(encoder, mQ[k] - _predict(predictor, k));
+				}
+			}
+			encoder.flush();
+
+			mOffsets.push_back((uint64_t)_ftell64(mFile));
+			uint32_t size = (uint32_t)mBuffer.size();
+			fwrite(&predictor, sizeof(uint8_t), 1, mFile);
+			fwrite(&size, sizeof(uint32_t), 1, mFile);
+			fwrite(mBuffer.data(), 1, mBuffer.size(), mFile);
+			return true;
+		}
+
+		/*!
+		Append the positions of a mesh, vertex i being the vertex with index() i, as loaded by read_obj.
+		*/
+		template<typename MeshType>
+		bool addFrame(MeshType * pMesh)
+		{
+			const int numV = (int)pMesh->vertices().getCurrentIndex();
+			mVerts.resize(numV);
+#pragma omp parallel for
+			for (int i = 0; i < numV; ++i) {
+				const CPoint & p = pMesh->vertices().getPointer(i)->point();
+				mVerts[i] = { p[0], p[1], p[2] };
+			}
+			return addFrame(mVerts);
+		}
+
+		/*! write the frame index and close the file */
+		bool close()
+		{
+			if (mFile == NULL) return false;
+			uint64_t indexOffset = (uint64_t)_ftell64(mFile);
+			if (!mOffsets.empty()) {
+				fwrite(mOffsets.data(), sizeof(uint64_t), mOffsets.size(), mFile);
+			}
+			uint32_t numFrames = (uint32_t)mOffsets.size();
+			fseek(mFile, 4 * sizeof(uint32_t), SEEK_SET);
+			fwrite(&numFrames, sizeof(uint32_t), 1, mFile);
+			fseek(mFile, 6 * sizeof(uint32_t), SEEK_SET);
+			fwrite(&mStep, sizeof(double), 1, mFile);
+			fwrite(mOrigin, sizeof(double), 3, mFile);
+			fwrite(&indexOffset, sizeof(uint64_t), 1, mFile);
+			fclose(mFile);
+			mFile = NULL;
+			return true;
+		}
+
+	private:
+		/* the grid starts at the min corner of the first frame, its step is relative to the largest extent */
+		void _computeGrid(const std::vector<std::array<double, 3>> & verts) {
+			double extent = 0;
+			for (int j = 0; j < 3; ++j) {
+				double vMin = verts[0][j], vMax = verts[0][j];
+				for (const std::array<double, 3> & v : verts) {
+					vMin = v[j] < vMin ? v[j] : vMin;
+					vMax = v[j] > vMax ? v[j] : vMax;
+				}
+				mOrigin[j] = vMin;
+				extent = vMax - vMin > extent ? vMax - vMin : extent;
+			}
+			if (extent == 0.0) extent = 1.0;
+			mStep = extent / (double)((1u << mQuantBits) - 1);
+		}
+
+		int32_t _predict(uint8_t predictor, int k) {
+			switch (predictor) {
+			case MeshSequenceFile::Delta:
+				return mQPrev[k];
+			case MeshSequenceFile::Linear:
+				return 2 * mQPrev[k] - mQPrev2[k];
+			default:
+				return k >= 3 ? mQ[k - 3] : 0;
+			}
+		}
+
+		static int64_t _ftell64(FILE * pFile) {
+#ifdef _WIN32
+			return _ftelli64(pFile);
+#else
+			return (int64_t)ftello(pFile);
+#endif
+		}
+
+		FILE * mFile = NULL;
+		int    mNumVertices = 0;
+		int    mQuantBits = 16;
+		int    mKeyFrameInterval = 32;
+		double mStep = 0;
+		double mOrigin[3] = { 0, 0, 0 };
+		std::vector<uint64_t> mOffsets;
+		std::vector<int32_t>  mQ, mQPrev, mQPrev2;
+		std::vector<uint8_t>  mBuffer;
+		std::vector<std::array<double, 3>> mVerts;
+	};
+
+	/*!
+	* \brief Random access reader of .mfsq sequences.
+	*
+	*  \code
+	*  CMeshSequenceReader reader;
+	*  reader.open("capture.mfsq");
+	*  reader.buildMesh(&mesh);
+	*  reader.decodeFrame(frameId, &mesh);
+	*  \endcode
+	*/
+	class CMeshSequenceReader
+	{
+	public:
+		~CMeshSequenceReader() { close(); };
+
+		/*! read the header, the connectivity and the frame index */
+		bool open(const char * fileName)
+		{
+			close();
+			if ((mFile = fopen(fileName, "rb")) == NULL) {
+				printf("Error in opening file: %s!\n", fileName);
+				return false;
+			}
+			uint32_t header[6];
+			uint64_t indexOffset;
+			mOrigin[0] = mOrigin[1] = mOrigin[2] = 0;
+			if (fread(header, sizeof(uint32_t), 6, mFile) != 6 || memcmp(header, "MFSQ", 4) != 0
+				|| header[1] < 1 || header[1] > MeshSequenceFile::VERSION
+				|| fread(&mStep, sizeof(double), 1, mFile) != 1
+				|| (header[1] >= 2 && fread(mOrigin, sizeof(double), 3, mFile) != 3)
+				|| fread(&indexOffset, sizeof(uint64_t), 1, mFile) != 1) {
+				printf("Not a valid .mfsq file: %s!\n", fileName);
+				close();
+				return false;
+			}
+			mNumVertices = (int)header[2];
+			mFaces.resize(header[3]);
+			mKeyFrameInterval = (int)header[5];
+			for (std::array<int, 3> & f : mFaces) {
+				int32_t fi[3];
+				if (fread(fi, sizeof(int32_t), 3, mFile) != 3) break;
+				f = { fi[0], fi[1], fi[2] };
+			}
+			mOffsets.resize(header[4]);
+			_fseek64(mFile, (int64_t)indexOffset);
+			if (fread(mOffsets.data(), sizeof(uint64_t), mOffsets.size(), mFile) != mOffsets.size()) {
+				printf("Truncated .mfsq file: %s!\n", fileName);
+				close();
+				return false;
+			}
+			mQ.assign(3 * mNumVertices, 0);
+			mQPrev.assign(3 * mNumVertices, 0);
+			mQPrev2.assign(3 * mNumVertices, 0);
+			mDecodedFrame = -1;
+			return true;
+		}
+
+		void close()
+		{
+			if (mFile != NULL) fclose(mFile);
+			mFile = NULL;
+		}
+
+		int numFrames() { return (int)mOffsets.size(); };
+		int numVertices() { return mNumVertices; };
+		int numFaces() { return (int)mFaces.size(); };
+		const std::vector<std::array<int, 3>> & faces() { return mFaces; };
+
+		/*!
+		Decode a frame into a vertex buffer.
+		\param frameId index of the frame
+		\param verts output positions
+		*/
+		bool decodeFrame(int frameId, std::vector<std::array<double, 3>> & verts)
+		{
+			if (!_decode(frameId)) return false;
+			verts.resize(mNumVertices);
+#pragma omp parallel for
+			for (int i = 0; i < mNumVertices; ++i) {
+				verts[i] = { mOrigin[0] + mQ[3 * i] * mStep, mOrigin[1] + mQ[3 * i + 1] * mStep, mOrigin[2] + mQ[3 * i + 2] * mStep };
+			}
+			return true;
+		}
+
+		/*!
+		Decode a frame directly into the vertex positions of a mesh built by buildMesh (or read from any frame
+		of the sequence by read_obj): vertex i is the vertex with index() i.
+		*/
+		template<typename MeshType>
+		bool decodeFrame(int frameId, MeshType * pMesh)
+		{
+			if ((int)pMesh->vertices().getCurrentIndex() != mNumVertices || !_decode(frameId)) return false;
+#pragma omp parallel for
+			for (int i = 0; i < mNumVertices; ++i) {
+				CPoint & p = pMesh->vertices().getPointer(i)->point();
+				p[0] = mOrigin[0] + mQ[3 * i] * mStep;
+				p[1] = mOrigin[1] + mQ[3 * i + 1] * mStep;
+				p[2] = mOrigin[2] + mQ[3 * i + 2] * mStep;
+			}
+			return true;
+		}
+
+		/*! build the mesh from the stored connectivity and the first frame */
+		template<typename MeshType>
+		bool buildMesh(MeshType * pMesh)
+		{
+			std::vector<std::array<double, 3>> verts;
+			if (!decodeFrame(0, verts)) return false;
+			pMesh->readVFList(&verts, &mFaces, nullptr, false);
+			return true;
+		}
+
+	private:
+		/* decode frameId into mQ, continuing from the last decoded frame when possible */
+		bool _decode(int frameId)
+		{
+			if (mFile == NULL || frameId < 0 || frameId >= numFrames()) return false;
+			if (frameId == mDecodedFrame) return true;
+
+			int keyFrame = frameId - frameId % mKeyFrameInterval;
+			int start = (mDecodedFrame >= keyFrame && mDecodedFrame < frameId) ? mDecodedFrame + 1 : keyFrame;
+			for (int iFrame = start; iFrame <= frameId; ++iFrame) {
+				if (!_decodeNext(iFrame)) {
+					mDecodedFrame = -1;
+					return false;
+				}
+				mDecodedFrame = iFrame;
+			}
+			return true;
+		}
+
+		bool _decodeNext(int frameId)
+		{
+			uint8_t predictor;
+			uint32_t size;
+			_fseek64(mFile, (int64_t)mOffsets[frameId]);
+			if (fread(&predictor, sizeof(uint8_t), 1, mFile) != 1 || fread(&size, sizeof(uint32_t), 1, mFile) != 1) return false;
+			mBuffer.resize(size);
+			if (fread(mBuffer.data(), 1, size, mFile) != size) return false;
+
+			std::swap(mQPrev2, mQPrev);
+			std::swap(mQPrev, mQ);
+			CRangeDecoder decoder(mBuffer.data(), mBuffer.size());
+			CIntModel models[3];
+			for (int i = 0; i < mNumVertices; ++i) {
+				for (int j = 0; j < 3; ++j) {
+					const int k = 3 * i + j;
+					int32_t prediction;
+					switch (predictor) {
+					case MeshSequenceFile::Delta:
+						prediction = mQPrev[k];
+						break;
+					case MeshSequenceFile::Linear:
+						prediction = 2 * mQPrev[k] - mQPrev2[k];
+						break;
+					default:
+						prediction = k >= 3 ? mQ[k - 3] : 0;
+					}
+					mQ[k] = prediction + models[j].decode(decoder);
+				}
+			}
+			return !decoder.overrun();
+		}
+
+		static void _fseek64(FILE * pFile, int64_t offset) {
+#ifdef _WIN32
+			_fseeki64(pFile, offset, SEEK_SET);
+#else
+			fseeko(pFile, (off_t)offset, SEEK_SET);
+#endif
+		}
+
+		FILE * mFile = NULL;
+		int    mNumVertices = 0;
+		int    mKeyFrameInterval = 32;
+		double mStep = 0;
+		double mOrigin[3] = { 0, 0, 0 };
+		int    mDecodedFrame = -1;
+		std::vector<std::array<int, 3>> mFaces;
+		std::vector<uint64_t> mOffsets;
+		std::vector<int32_t>  mQ, mQPrev, mQPrev2;
+		std::vector<uint8_t>  mBuffer;
+	};
+}
@@ -0,0 +1,88 @@
+/*!
+*      \file ObjFrame.h
+*      \brief Light-weight .obj frame reader for mesh sequences
+*
+*		Parses only the vertex positions (and optionally the triangle list) of an .obj file
+*		into flat buffers, without building any halfedge structure. Meant to be used together
+*		with CBaseMesh::updatePositionsFromBuffer, for sequences sharing one connectivity.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <array>
+#include <string>
+
+#include "../Parser/strutil.h"
+#include "../Parser/IOFuncDef.h"
+
+namespace MeshLib {
+
+	/*!
+	* \brief One frame of a mesh sequence: vertex positions and (optionally) the 0-based triangle list.
+	*/
+	struct CMeshFrame
+	{
+		std::vector<std::array<double, 3>> verts;
+		std::vector<std::array<int, 3>>    faces;
+		/*! whether the frame was read successfully */
+		bool valid = false;
+
+		void clear() {
+			verts.clear();
+			faces.clear();
+			valid = false;
+		}
+	};
+
+	/*!
+	Read the vertex positions of an .obj file into a frame buffer.
+	\param fileName the input .obj file name
+	\param frame the output frame, its buffers are reused to avoid reallocation
+	\param readFaces whether to read the face list as well, only needed to check the topology
+	\return true if the file was opened and parsed
+	*/
+	inline bool readObjFrame(const char * fileName, CMeshFrame & frame, bool readFaces = false)
+	{
+		frame.verts.clear();
+		frame.faces.clear();
+		frame.valid = false;
+
+		FILE * pFile;
+		if ((pFile = fopen(fileName, "r")) == NULL) {
+			printf("Error in opening file: %s!\n", fileName);
+			return false;
+		}
+		char lineBuffer[MAX_LINE_SIZE];
+
+		while (fgets(lineBuffer, MAX_LINE_SIZE, pFile)) {
+			if (lineBuffer[0] == 'v' && (lineBuffer[1] == ' ' || lineBuffer[1] == '\t')) {
+				strutil::Tokenizer stokenizer(lineBuffer, " \t\r\n");
+				stokenizer.nextToken();
+				std::array<double, 3> p;
+				for (int i = 0; i < 3; i++) {
+					stokenizer.nextToken();
+					p[i] = strutil::parseStringToDouble(stokenizer.getToken());
+				}
+				frame.verts.push_back(p);
+			}
+			else if (readFaces && lineBuffer[0] == 'f' && (lineBuffer[1] == ' ' || lineBuffer[1] == '\t')) {
+				strutil::Tokenizer stokenizer(lineBuffer, " \t\r\n");
+				stokenizer.nextToken();
+				std::array<int, 3> f;
+				for (int i = 0; i < 3; i++) {
+					stokenizer.nextToken();
+					/* "v/vt/vn": strtol stops at the first '/' */
+					f[i] = strutil::parseStringToInt(stokenizer.getToken()) - 1;
+				}
+				frame.faces.push_back(f);
+			}
+		}
+		fclose(pFile);
+
+		frame.valid = true;
+		return true;
+	}
+}
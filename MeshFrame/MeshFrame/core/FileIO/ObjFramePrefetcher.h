@@ -0,0 +1,154 @@
+/*!
+*      \file ObjFramePrefetcher.h
+*      \brief Background reader for .obj mesh sequences
+*
+*		A worker thread parses the frames following the one being displayed into CMeshFrame
+*		buffers, so that playing a sequence only costs a CBaseMesh::updatePositionsFromBuffer
+*		per frame instead of a full read_obj.
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "ObjFrame.h"
+
+namespace MeshLib {
+
+	/*!
+	* \brief Prefetches the next frames of an .obj sequence in a background thread.
+	*
+	*  Usage:
+	*  \code
+	*  CObjFramePrefetcher prefetcher(files, 8);
+	*  CMeshFrame frame;
+	*  prefetcher.getFrame(frameId, frame);
+	*  mesh.updatePositionsFromBuffer(&frame.verts);
+	*  \endcode
+	*/
+	class CObjFramePrefetcher
+	{
+	public:
+		/*!
+		\param files the .obj files of the sequence, in playing order
+		\param numPrefetch number of frames parsed ahead of the current one
+		\param readFaces whether to parse the face lists too, only needed to check the topology
+		*/
+		CObjFramePrefetcher(const std::vector<std::string> & files, int numPrefetch = 8, bool readFaces = false)
+			: mFiles(files), mNumPrefetch(numPrefetch), mReadFaces(readFaces)
+		{
+			mWorker = std::thread(&CObjFramePrefetcher::_work, this);
+		}
+		~CObjFramePrefetcher()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mStop = true;
+			}
+			mCondition.notify_all();
+			mWorker.join();
+		}
+		CObjFramePrefetcher(const CObjFramePrefetcher &) = delete;
+		CObjFramePrefetcher & operator=(const CObjFramePrefetcher &) = delete;
+
+		/*!
+		Get a frame, blocking until it is parsed, and move the prefetching window to the frames following it.
+		\param frameId index of the frame in the file list
+		\param frame output frame, swapped with the cached buffers
+		\param direction playing direction, 1 for forward, -1 for backward
+		\return frame.valid
+		*/
+		bool getFrame(int frameId, CMeshFrame & frame, int direction = 1)
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCurrent = frameId;
+			mDirection = direction >= 0 ? 1 : -1;
+			_evict();
+			mCondition.notify_all();
+			mCondition.wait(lock, [&] { return mCache.count(frameId) != 0; });
+
+			std::swap(frame, *mCache[frameId]);
+			mCache.erase(frameId);
+			return frame.valid;
+		}
+
+		int numFrames() { return (int)mFiles.size(); };
+
+	private:
+		int _wrap(int i) {
+			int n = (int)mFiles.size();
+			return ((i % n) + n) % n;
+		}
+
+		/* the next frame to parse: the current one first, then the following ones in playing order */
+		int _nextWanted() {
+			int n = std::min<int>(mNumPrefetch + 1, (int)mFiles.size());
+			for (int k = 0; k < n; ++k) {
+				int id = _wrap(mCurrent + k * mDirection);
+				if (mCache.count(id) == 0 && mParsing.count(id) == 0) return id;
+			}
+			return -1;
+		}
+
+		bool _inWindow(int id) {
+			int n = std::min<int>(mNumPrefetch + 1, (int)mFiles.size());
+			for (int k = 0; k < n; ++k) {
+				if (_wrap(mCurrent + k * mDirection) == id) return true;
+			}
+			return false;
+		}
+
+		/* drop cached frames which are no longer ahead of the current one, e.g. after a jump backward */
+		void _evict() {
+			for (auto it = mCache.begin(); it != mCache.end();) {
+				if (_inWindow(it->first)) ++it;
+				else it = mCache.erase(it);
+			}
+		}
+
+		void _work() {
+			std::unique_lock<std::mutex> lock(mMutex);
+			while (!mStop) {
+				int id = mFiles.empty() ? -1 : _nextWanted();
+				if (id < 0) {
+					mCondition.wait(lock);
+					continue;
+				}
+				mParsing.insert(id);
+				lock.unlock();
+
+				std::unique_ptr<CMeshFrame> pFrame(new CMeshFrame);
+				readObjFrame(mFiles[id].c_str(), *pFrame, mReadFaces);
+
+				lock.lock();
+				mParsing.erase(id);
+				if (_inWindow(id)) {
+					mCache[id] = std::move(pFrame);
+				}
+				mCondition.notify_all();
+			}
+		}
+
+		std::vector<std::string> mFiles;
+		int  mNumPrefetch;
+		bool mReadFaces;
+
+		int  mCurrent = 0;
+		int  mDirection = 1;
+		bool mStop = false;
+
+		std::map<int, std::unique_ptr<CMeshFrame>> mCache;
+		std::set<int>            mParsing;
+		std::mutex               mMutex;
+		std::condition_variable  mCondition;
+		std::thread              mWorker;
+	};
+}
@@ -0,0 +1,183 @@
+/*!
+*      \file RangeCoder.h
+*      \brief Adaptive binary range coder, used by the compressed mesh file formats
+*
+*		Carry-less range coder with 11 bits adaptive probabilities (the LZMA scheme), plus a small
+*		adaptive model for signed integers (Elias-gamma like: unary coded bit length, then mantissa).
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace MeshLib {
+
+	/*! adaptive probability of a bit being 0, in 1/2048 */
+	typedef uint16_t CBitProb;
+	const CBitProb BIT_PROB_INIT = 1 << 10;
+
+	class CRangeEncoder
+	{
+	public:
+		CRangeEncoder(std::vector<uint8_t> & out) : mOut(out) {};
+
+		void encodeBit(CBitProb & prob, int bit) {
+			uint32_t bound = (mRange >> 11) * prob;
+			if (bit == 0) {
+				mRange = bound;
+				prob += (2048 - prob) >> 5;
+			}
+			else {
+				mLow += bound;
+				mRange -= bound;
+				prob -= prob >> 5;
+			}
+			_normalize();
+		}
+		/*! encode the numBits low bits of value with probability 1/2, most significant first */
+		void encodeDirect(uint32_t value, int numBits) {
+			for (int i = numBits - 1; i >= 0; --i) {
+				mRange >>= 1;
+				if ((value >> i) & 1) mLow += mRange;
+				_normalize();
+			}
+		}
+		/*! must be called once after the last symbol */
+		void flush() {
+			for (int i = 0; i < 5; ++i) _shiftLow();
+		}
+
+	private:
+		void _normalize() {
+			while (mRange < (1u << 24)) {
+				mRange <<= 8;
+				_shiftLow();
+			}
+		}
+		void _shiftLow() {
+			if ((uint32_t)mLow < 0xFF000000u || (mLow >> 32) != 0) {
+				uint8_t carry = (uint8_t)(mLow >> 32);
+				uint8_t temp = mCache;
+				do {
+					mOut.push_back((uint8_t)(temp + carry));
+					temp = 0xFF;
+				} while (--mCacheSize != 0);
+				mCache = (uint8_t)(mLow >> 24);
+			}
+			++mCacheSize;
+			mLow = (mLow & 0x00FFFFFF) << 8;
+		}
+
+		std::vector<uint8_t> & mOut;
+		uint64_t mLow = 0;
+		uint32_t mRange = 0xFFFFFFFFu;
+		uint8_t  mCache = 0;
+		uint64_t mCacheSize = 1;
+	};
+
+	class CRangeDecoder
+	{
+	public:
+		CRangeDecoder(const uint8_t * data, size_t size) : mData(data), mSize(size) {
+			for (int i = 0; i < 5; ++i) mCode = (mCode << 8) | _nextByte();
+		};
+
+		int decodeBit(CBitProb & prob) {
+			uint32_t bound = (mRange >> 11) * prob;
+			int bit;
+			if (mCode < bound) {
+				mRange = bound;
+				prob += (2048 - prob) >> 5;
+				bit = 0;
+			}
+			else {
+				mCode -= bound;
+				mRange -= bound;
+				prob -= prob >> 5;
+				bit = 1;
+			}
+			_normalize();
+			return bit;
+		}
+		uint32_t decodeDirect(int numBits) {
+			uint32_t value = 0;
+			for (int i = 0; i < numBits; ++i) {
+				mRange >>= 1;
+				uint32_t bit = 0;
+				if (mCode >= mRange) {
+					mCode -= mRange;
+					bit = 1;
+				}
+				value = (value << 1) | bit;
+				_normalize();
+			}
+			return value;
+		}
+		/*! whether the decoder read past the end of the stream, i.e. the data is corrupted */
+		bool overrun() { return mPos > mSize + 5; };
+
+	private:
+		uint8_t _nextByte() {
+			return mPos < mSize ? mData[mPos++] : (++mPos, 0);
+		}
+		void _normalize() {
+			while (mRange < (1u << 24)) {
+				mRange <<= 8;
+				mCode = (mCode << 8) | _nextByte();
+			}
+		}
+
+		const uint8_t * mData;
+		size_t   mSize;
+		size_t   mPos = 0;
+		uint32_t mCode = 0;
+		uint32_t mRange = 0xFFFFFFFFu;
+	};
+
+	/*!
+	* \brief Adaptive model for signed integers of small magnitude, e.g. prediction residuals.
+	*
+	*  v is zigzag mapped to u, u + 1 is coded as its bit length in unary with one adaptive
+	*  bit per length, followed by the bits below the leading one: the first one adaptive
+	*  (per length), the others direct.
+	*/
+	class CIntModel
+	{
+	public:
+		CIntModel() {
+			for (int i = 0; i < 34; ++i) {
+				mLength[i] = BIT_PROB_INIT;
+				mMantissa[i] = BIT_PROB_INIT;
+			}
+		}
+
+		void encode(CRangeEncoder & enc, int32_t v) {
+			uint64_t u = (uint64_t)(((uint32_t)v << 1) ^ (uint32_t)(v >> 31)) + 1;
+			int numBits = 0;
+			while ((u >> numBits) > 1) ++numBits;
+			for (int i = 0; i < numBits; ++i) enc.encodeBit(mLength[i], 1);
+			if (numBits < 32) enc.encodeBit(mLength[numBits], 0);
+			if (numBits == 0) return;
+			enc.encodeBit(mMantissa[numBits], (int)((u >> (numBits - 1)) & 1));
+			if (numBits > 1) enc.encodeDirect((uint32_t)u, numBits - 1);
+		}
+
+		int32_t decode(CRangeDecoder & dec) {
+			int numBits = 0;
+			while (numBits < 32 && dec.decodeBit(mLength[numBits])) ++numBits;
+			uint64_t u = 1;
+			if (numBits > 0) {
+				u = (u << 1) | (uint64_t)dec.decodeBit(mMantissa[numBits]);
+				if (numBits > 1) u = (u << (numBits - 1)) | dec.decodeDirect(numBits - 1);
+			}
+			uint32_t z = (uint32_t)(u - 1);
+			return (int32_t)((z >> 1) ^ (~(z & 1) + 1));
+		}
+
+	private:
+		CBitProb mLength[34];
+		CBitProb mMantissa[34];
+	};
+}
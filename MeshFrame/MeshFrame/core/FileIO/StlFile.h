@@ -0,0 +1,324 @@
+/*!
+*      \file StlFile.h
+*      \brief STL triangle soup reader and vertex welding, used by CBaseMesh::read_stl
+*
+*		STL stores every triangle with its own 3 corners. The corners are welded into shared
+*		vertices with a spatial hash (cells sorted by key, neighbor cells looked up when a corner
+*		is closer than epsilon to the cell border), in parallel.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include "../Parallel/ParallelAlgorithms.h"
+
+namespace MeshLib {
+
+	namespace Stl {
+
+		/*! size of an open file, with 64-bit offsets: long is 32-bit on MSVC and big binary files exceed 2 GB */
+		inline long long _fileSize(FILE * pFile)
+		{
+#ifdef _WIN32
+			_fseeki64(pFile, 0, SEEK_END);
+			long long fileSize = (long long)_ftelli64(pFile);
+			_fseeki64(pFile, 0, SEEK_SET);
+#else
+			fseeko(pFile, 0, SEEK_END);
+			long long fileSize = (long long)ftello(pFile);
+			fseeko(pFile, 0, SEEK_SET);
+#endif
+			return fileSize;
+		}
+
+		/*!
+		Read the triangles of a binary or ASCII .stl file.
+		\param fileName the input file name
+		\param corners output, 3 corners per triangle
+		\return false if the file can not be read
+		*/
+		inline bool readSoup(const char * fileName, std::vector<std::array<float, 3>> & corners)
+		{
+			FILE * pFile;
+			if ((pFile = fopen(fileName, "rb")) == NULL) {
+				printf("Error in opening file: %s!\n", fileName);
+				return false;
+			}
+			const long long fileSize = _fileSize(pFile);
+			if (fileSize < 0) {
+				printf("Error in reading file: %s!\n", fileName);
+				fclose(pFile);
+				return false;
+			}
+			std::vector<char> buffer((size_t)fileSize + 1);
+			size_t numRead = fread(buffer.data(), 1, (size_t)fileSize, pFile);
+			fclose(pFile);
+			if ((long long)numRead != fileSize) {
+				printf("Error in reading file: %s!\n", fileName);
+				return false;
+			}
+			buffer[(size_t)fileSize] = '\0';
+
+			/*
+			* Binary files are 84 + 50 n bytes, some followed by padding. ASCII files start with "solid", as well as some
+			* binary ones: an exact size is taken as binary, a larger one as binary only if the ASCII parsing fails.
+			*/
+			uint32_t numTriangles = 0;
+			if (fileSize >= 84) memcpy(&numTriangles, buffer.data() + 80, sizeof(uint32_t));
+			const bool fitsBinary = fileSize >= 84 && fileSize >= 84 + 50 * (long long)numTriangles;
+			const bool startsSolid = fileSize >= 5 && strncmp(buffer.data(), "solid", 5) == 0;
+			auto readBinary = [&]() {
+				corners.resize(3 * (size_t)numTriangles);
+				const char * pData = buffer.data() + 84;
+#pragma omp parallel for
+				for (long long t = 0; t < (long long)numTriangles; ++t) {
+					/* skip the normal, then 3 vertices */
+					memcpy(corners[3 * t].data(), pData + 50 * t + 12, 9 * sizeof(float));
+				}
+			};
+			if (fitsBinary && (fileSize == 84 + 50 * (long long)numTriangles || !startsSolid)) {
+				readBinary();
+				return true;
+			}
+
+			/* ASCII: parse "vertex x y z" lines, the chunks of lines are parsed in parallel */
+			int numChunks = Parallel::maxThreads();
+			std::vector<size_t> bounds(numChunks + 1, (size_t)fileSize);
+			bounds[0] = 0;
+			for (int c = 1; c < numChunks; ++c) {
+				size_t b = std::max(bounds[c - 1], (size_t)(fileSize * c / numChunks));
+				while (b < (size_t)fileSize && buffer[b] != '\n') ++b;
+				bounds[c] = b;
+			}
+			std::vector<std::vector<std::array<float, 3>>> chunkCorners(numChunks);
+#pragma omp parallel for schedule(static, 1)
+			for (int c = 0; c < numChunks; ++c) {
+				const char * p = buffer.data() + bounds[c];
+				const char * pEnd = buffer.data() + bounds[c + 1];
+				while (p < pEnd) {
+					while (p < pEnd && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+					if (pEnd - p > 6 && strncmp(p, "vertex", 6) == 0) {
+						char * pNext;
+						std::array<float, 3> v;
+						p += 6;
+						for (int j = 0; j < 3; ++j) {
+							v[j] = strtof(p, &pNext);
+							p = pNext;
+						}
+						chunkCorners[c].push_back(v);
+					}
+					while (p < pEnd && *p != '\n') ++p;
+				}
+			}
+			corners.clear();
+			for (auto & cc : chunkCorners) corners.insert(corners.end(), cc.begin(), cc.end());
+			if (corners.empty() || corners.size() % 3 != 0) {
+				if (fitsBinary) {
+					readBinary();
+					return true;
+				}
+				printf("Not a valid .stl file: %s!\n", fileName);
+				return false;
+			}
+			return true;
+		}
+
+		/*!
+		Weld the corners of a triangle soup into shared vertices.
+		Each corner is attached to the corner of smallest index within epsilon, found through a spatial hash, and
+		the chains of attachments are flattened.
+		\param corners 3 corners per triangle
+		\param epsilon welding distance, 0 to only weld identical corners
+		\param verts output welded vertices
+		\param faces output triangles, degenerated ones (two corners welded together) are dropped
+		*/
+		inline void weld(const std::vector<std::array<float, 3>> & corners, double epsilon,
+			std::vector<std::array<double, 3>> & verts, std::vector<std::array<int, 3>> & faces)
+		{
+			const long long n = (long long)corners.size();
+			verts.clear();
+			faces.clear();
+			if (n == 0) return;
+
+			double bMin[3], bMax[3];
+			for (int j = 0; j < 3; ++j) bMin[j] = bMax[j] = corners[0][j];
+			for (long long i = 0; i < n; ++i) {
+				for (int j = 0; j < 3; ++j) {
+					bMin[j] = std::min(bMin[j], (double)corners[i][j]);
+					bMax[j] = std::max(bMax[j], (double)corners[i][j]);
+				}
+			}
+			double extent = std::max(bMax[0] - bMin[0], std::max(bMax[1] - bMin[1], bMax[2] - bMin[2]));
+			if (extent == 0.0) extent = 1.0;
+			/* 21 bits per axis fit in a 64 bits key; a cell of several epsilon keeps most lookups in one cell */
+			const int64_t maxCell = (1 << 21) - 1;
+			double cellSize = std::max(4 * epsilon, extent / (double)maxCell);
+
+			std::vector<uint64_t> keys(n);
+			auto cellOf = [&](double x, int j) {
+				int64_t c = (int64_t)floor((x - bMin[j]) / cellSize);
+				return std::min(std::max(c, (int64_t)0), maxCell);
+			};
+#pragma omp parallel for
+			for (long long i = 0; i < n; ++i) {
+				keys[i] = ((uint64_t)cellOf(corners[i][0], 0) << 42) | ((uint64_t)cellOf(corners[i][1], 1) << 21) | (uint64_t)cellOf(corners[i][2], 2);
+			}
+			std::vector<uint32_t> order(n);
+#pragma omp parallel for
+			for (long long i = 0; i < n; ++i) order[i] = (uint32_t)i;
+			Parallel::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+				return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+			});
+
+			/* cells: sorted keys and their range in order */
+			std::vector<uint64_t> cellKeys;
+			std::vector<long long> cellStart;
+			for (long long i = 0; i < n; ++i) {
+				if (i == 0 || keys[order[i]] != keys[order[i - 1]]) {
+					cellKeys.push_back(keys[order[i]]);
+					cellStart.push_back(i);
+				}
+			}
+			cellStart.push_back(n);
+
+			std::vector<uint32_t> rep(n);
+			const double eps2 = epsilon * epsilon;
+#pragma omp parallel for schedule(dynamic, 4096)
+			for (long long i = 0; i < n; ++i) {
+				const std::array<float, 3> & p = corners[i];
+				int64_t c[3] = { (int64_t)(keys[i] >> 42), (int64_t)((keys[i] >> 21) & maxCell), (int64_t)(keys[i] & maxCell) };
+				/* neighbor cells only on the sides closer than epsilon */
+				int lo[3], hi[3];
+				for (int j = 0; j < 3; ++j) {
+					double x = p[j] - bMin[j] - c[j] * cellSize;
+					lo[j] = (epsilon > 0 && x < epsilon && c[j] > 0) ? -1 : 0;
+					hi[j] = (epsilon > 0 && cellSize - x <= epsilon && c[j] < maxCell) ? 1 : 0;
+				}
+				uint32_t best = (uint32_t)i;
+				for (int dx = lo[0]; dx <= hi[0]; ++dx)
+					for (int dy = lo[1]; dy <= hi[1]; ++dy)
+						for (int dz = lo[2]; dz <= hi[2]; ++dz) {
+							uint64_t key = ((uint64_t)(c[0] + dx) << 42) | ((uint64_t)(c[1] + dy) << 21) | (uint64_t)(c[2] + dz);
+							auto it = std::lower_bound(cellKeys.begin(), cellKeys.end(), key);
+							if (it == cellKeys.end() || *it != key) continue;
+							size_t iCell = it - cellKeys.begin();
+							/* corners of a cell are sorted by index, stop at the current best */
+							for (long long k = cellStart[iCell]; k < cellStart[iCell + 1] && order[k] < best; ++k) {
+								const std::array<float, 3> & q = corners[order[k]];
+								double d2 = 0;
+								for (int j = 0; j < 3; ++j) d2 += ((double)p[j] - q[j]) * ((double)p[j] - q[j]);
+								if (d2 <= eps2) {
+									best = order[k];
+									break;
+								}
+							}
+						}
+				rep[i] = best;
+			}
+
+			/* rep[i] <= i: flatten the chains by pointer jumping */
+			bool changed = true;
+			while (changed) {
+				changed = false;
+#pragma omp parallel for reduction(||:changed)
+				for (long long i = 0; i < n; ++i) {
+					uint32_t r = rep[rep[i]];
+					if (r != rep[i]) {
+						rep[i] = r;
+						changed = true;
+					}
+				}
+			}
+
+			std::vector<int> vertexId(n);
+#pragma omp parallel for
+			for (long long i = 0; i < n; ++i) vertexId[i] = rep[i] == (uint32_t)i ? 1 : 0;
+			int numVerts = Parallel::exclusiveScan(vertexId);
+			verts.resize(numVerts);
+#pragma omp parallel for
+			for (long long i = 0; i < n; ++i) {
+				if (rep[i] == (uint32_t)i) {
+					verts[vertexId[i]] = { corners[i][0], corners[i][1], corners[i][2] };
+				}
+			}
+
+			const long long numTriangles = n / 3;
+			faces.resize(numTriangles);
+			std::vector<int> keep(numTriangles);
+#pragma omp parallel for
+			for (long long t = 0; t < numTriangles; ++t) {
+				std::array<int, 3> & f = faces[t];
+				for (int k = 0; k < 3; ++k) f[k] = vertexId[rep[3 * t + k]];
+				keep[t] = (f[0] != f[1] && f[1] != f[2] && f[2] != f[0]) ? 1 : 0;
+			}
+			long long numKept = 0;
+			for (long long t = 0; t < numTriangles; ++t) {
+				if (keep[t]) faces[numKept++] = faces[t];
+			}
+			if (numKept != numTriangles) {
+				printf("Dropped %lld degenerated triangles.\n", numTriangles - numKept);
+			}
+			faces.resize(numKept);
+		}
+
+		/*!
+		Find the non-manifold edges of a triangle list: edges with more than 2 triangles, or 2 triangles with
+		inconsistent orientations. For each such edge, the first triangle and the next one of opposite orientation
+		are kept, the others are marked.
+		\param faces the triangle list
+		\param rejected output, 1 for the triangles to drop to get a manifold edge set
+		\param nonManifoldEdges output, the vertex pairs of the non-manifold edges
+		*/
+		inline void findNonManifoldEdges(const std::vector<std::array<int, 3>> & faces, std::vector<char> & rejected,
+			std::vector<std::array<int, 2>> & nonManifoldEdges)
+		{
+			const long long numTriangles = (long long)faces.size();
+			/* undirected edge key, then the triangle index (its direction is recovered from the triangle) */
+			std::vector<std::pair<uint64_t, uint32_t>> edges(3 * numTriangles);
+#pragma omp parallel for
+			for (long long t = 0; t < numTriangles; ++t) {
+				for (int k = 0; k < 3; ++k) {
+					uint32_t u = faces[t][k], v = faces[t][(k + 1) % 3];
+					uint64_t key = u < v ? ((uint64_t)u << 32) | v : ((uint64_t)v << 32) | u;
+					edges[3 * t + k] = std::make_pair(key, (uint32_t)t);
+				}
+			}
+			Parallel::sort(edges.begin(), edges.end());
+
+			rejected.assign(numTriangles, 0);
+			nonManifoldEdges.clear();
+			auto isForward = [&](uint64_t key, uint32_t t) {
+				uint32_t u = (uint32_t)(key >> 32);
+				for (int k = 0; k < 3; ++k) if ((uint32_t)faces[t][k] == u) return (uint32_t)faces[t][(k + 1) % 3] == (uint32_t)(key & 0xFFFFFFFF);
+				return false;
+			};
+			long long i = 0;
+			const long long numEdges = (long long)edges.size();
+			while (i < numEdges) {
+				long long j = i + 1;
+				while (j < numEdges && edges[j].first == edges[i].first) ++j;
+				if (j - i > 2 || (j - i == 2 && isForward(edges[i].first, edges[i].second) == isForward(edges[i + 1].first, edges[i + 1].second))) {
+					nonManifoldEdges.push_back({ (int)(edges[i].first >> 32), (int)(edges[i].first & 0xFFFFFFFF) });
+					bool firstForward = isForward(edges[i].first, edges[i].second);
+					bool pairFound = false;
+					for (long long k = i + 1; k < j; ++k) {
+						if (!pairFound && isForward(edges[k].first, edges[k].second) != firstForward) {
+							pairFound = true;
+							continue;
+						}
+						rejected[edges[k].second] = 1;
+					}
+				}
+				i = j;
+			}
+		}
+	}
+}
@@ -0,0 +1,79 @@
+/*!
+*      \file Quadric.h
+*      \brief Quadric error metric: the sum of squared distances to a set of planes
+*
+*		The symmetric 4x4 matrix of a quadric is stored as its 10 upper entries, so that quadrics can
+*		be summed and kept per vertex without an external matrix library.
+*/
+
+#pragma once
+
+#include <math.h>
+#include "Point.h"
+
+namespace MeshLib {
+
+	class CQuadric
+	{
+	public:
+		CQuadric() { for (int i = 0; i < 10; ++i) m[i] = 0; };
+
+		/*!
+		Quadric of the plane n . x + d = 0, n being a unit normal.
+		\param w weight of the plane, e.g. the area of the face it comes from
+		*/
+		static CQuadric plane(const CPoint & n, double d, double w = 1.0)
+		{
+			CQuadric q;
+			q.m[0] = w * n[0] * n[0]; q.m[1] = w * n[0] * n[1]; q.m[2] = w * n[0] * n[2]; q.m[3] = w * n[0] * d;
+			q.m[4] = w * n[1] * n[1]; q.m[5] = w * n[1] * n[2]; q.m[6] = w * n[1] * d;
+			q.m[7] = w * n[2] * n[2]; q.m[8] = w * n[2] * d;
+			q.m[9] = w * d * d;
+			return q;
+		};
+		/*! quadric of the plane through p with unit normal n */
+		static CQuadric plane(const CPoint & n, const CPoint & p, double w = 1.0) { return plane(n, -(n * p), w); };
+
+		CQuadric & operator+=(const CQuadric & q) { for (int i = 0; i < 10; ++i) m[i] += q.m[i]; return *this; };
+		CQuadric operator+(const CQuadric & q) const { CQuadric r(*this); r += q; return r; };
+		CQuadric & operator*=(double s) { for (int i = 0; i < 10; ++i) m[i] *= s; return *this; };
+		CQuadric operator*(double s) const { CQuadric r(*this); r *= s; return r; };
+
+		/*! the quadric error of p, v^T Q v with v = (p, 1) */
+		double error(const CPoint & p) const
+		{
+			const double x = p[0], y = p[1], z = p[2];
+			return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x
+				+ m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y
+				+ m[7] * z * z + 2 * m[8] * z
+				+ m[9];
+		};
+
+		/*!
+		The point of least error, found by solving the upper 3x3 system.
+		\param p receives the point
+		\return false if the system is close to singular, e.g. the planes are parallel, p is then unchanged
+		*/
+		bool minimizer(CPoint & p) const
+		{
+			const double a = m[0], b = m[1], c = m[2], e = m[4], f = m[5], i = m[7];
+			/* cofactors of the symmetric matrix [a b c; b e f; c f i] */
+			const double c00 = e * i - f * f, c01 = c * f - b * i, c02 = b * f - c * e;
+			const double c11 = a * i - c * c, c12 = b * c - a * f;
+			const double c22 = a * e - b * b;
+			const double det = a * c00 + b * c01 + c * c02;
+			/* relative to the scale of the entries, so that the test does not depend on the weights */
+			const double scale = fabs(a) + fabs(e) + fabs(i);
+			if (!(fabs(det) > 1e-10 * scale * scale * scale)) return false;
+			const double inv = 1.0 / det;
+			const double rx = -m[3], ry = -m[6], rz = -m[8];
+			p[0] = (c00 * rx + c01 * ry + c02 * rz) * inv;
+			p[1] = (c01 * rx + c11 * ry + c12 * rz) * inv;
+			p[2] = (c02 * rx + c12 * ry + c22 * rz) * inv;
+			return true;
+		};
+
+		/*! a2, ab, ac, ad, b2, bc, bd, c2, cd, d2 */
+		double m[10];
+	};
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <assert.h>
+#include <algorithm>
 // A container support random access, not thread safe,
 // with default pre allocated memory, in stack
 // "P" in CPArray means pre allocate
@@ -19,6 +20,26 @@ public:
 		}
 	}
 
+	// copies own their memory, the default copy would share the heap memory or point to the other pre allocated one
+	CPArray(const CPArray & other) :
+		pMem(pPreAllocated)
+	{
+		*this = other;
+	}
+
+	CPArray & operator=(const CPArray & other) {
+		if (this == &other) {
+			return *this;
+		}
+		mSize = 0;
+		if (other.mSize > mCapacity) {
+			reserve(other.mSize);
+		}
+		std::copy(other.pMem, other.pMem + other.mSize, pMem);
+		mSize = other.mSize;
+		return *this;
+	}
+
 	T& operator[](const int & i) {
 		assert(i < mSize);
 		return pMem[i];
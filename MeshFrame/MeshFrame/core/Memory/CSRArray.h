@@ -0,0 +1,63 @@
+/*!
+*      \file CSRArray.h
+*      \brief Compressed sparse rows of int, the storage of the adjacency snapshots of the meshes
+*/
+
+#pragma once
+
+#include <vector>
+#include "../Parallel/OpenMP.h"
+
+#include "../Parallel/ParallelAlgorithms.h"
+
+namespace MeshLib {
+
+	/*!
+	* \brief Rows of ints stored back to back: row i is indices[offsets[i]] ... indices[offsets[i + 1] - 1].
+	*/
+	struct CCSRArray
+	{
+		std::vector<int> offsets;
+		std::vector<int> indices;
+
+		int numRows() const { return offsets.empty() ? 0 : (int)offsets.size() - 1; };
+		int degree(int i) const { return offsets[i + 1] - offsets[i]; };
+		const int * begin(int i) const { return indices.data() + offsets[i]; };
+		const int * end(int i) const { return indices.data() + offsets[i + 1]; };
+		void clear() { offsets.clear(); indices.clear(); };
+
+		/*!
+		Fill the rows in parallel, in two passes: one to size the rows, one to write them.
+		\param gather gather(i, row) fills the std::vector<int> row with the entries of row i, it is called twice per row
+		*/
+		template<typename Gather>
+		void build(int numRows, Gather gather);
+	};
+
+	template<typename Gather>
+	inline void CCSRArray::build(int numRows, Gather gather)
+	{
+		offsets.assign(numRows + 1, 0);
+#pragma omp parallel
+		{
+			std::vector<int> row;
+#pragma omp for schedule(dynamic, 1024)
+			for (int i = 0; i < numRows; ++i) {
+				row.clear();
+				gather(i, row);
+				offsets[i] = (int)row.size();
+			}
+		}
+		indices.resize(Parallel::exclusiveScan(offsets));
+#pragma omp parallel
+		{
+			std::vector<int> row;
+#pragma omp for schedule(dynamic, 1024)
+			for (int i = 0; i < numRows; ++i) {
+				row.clear();
+				gather(i, row);
+				std::copy(row.begin(), row.end(), indices.begin() + offsets[i]);
+			}
+		}
+	}
+}
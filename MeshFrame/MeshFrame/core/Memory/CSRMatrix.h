@@ -0,0 +1,78 @@
+/*!
+*      \file CSRMatrix.h
+*      \brief Sparse matrix of doubles in compressed sparse rows, the output of the Laplacian assemblies
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "../Parallel/OpenMP.h"
+
+#include "CSRArray.h"
+
+namespace MeshLib {
+
+	/*!
+	* \brief Square sparse matrix: the sparsity pattern is a CCSRArray of column indices, sorted in each row,
+	*  and values[k] is the value of the entry pattern.indices[k].
+	*
+	*  The pattern is fixed once built, the assemblies only rewrite the values.
+	*/
+	struct CCSRMatrix
+	{
+		CCSRArray           pattern;
+		std::vector<double> values;
+		/*! position of (i, i) in values, -1 if not in the pattern */
+		std::vector<int>    diagonal;
+
+		int numRows() const { return pattern.numRows(); };
+		int numNonZeros() const { return (int)values.size(); };
+		void clear() { pattern.clear(); values.clear(); diagonal.clear(); };
+
+		/*!
+		Set the pattern, the values are zeroed.
+		*/
+		void setPattern(const CCSRArray & newPattern);
+		/*!
+		\return the position of (i, j) in values, -1 if not in the pattern
+		*/
+		int find(int i, int j) const;
+		/*!
+		y = A x, in parallel over the rows
+		*/
+		void multiply(const std::vector<double> & x, std::vector<double> & y) const;
+	};
+
+	inline void CCSRMatrix::setPattern(const CCSRArray & newPattern)
+	{
+		pattern = newPattern;
+		values.assign(pattern.indices.size(), 0.0);
+		diagonal.resize(numRows());
+#pragma omp parallel for
+		for (int i = 0; i < numRows(); ++i) {
+			diagonal[i] = find(i, i);
+		}
+	}
+
+	inline int CCSRMatrix::find(int i, int j) const
+	{
+		const int * pos = std::lower_bound(pattern.begin(i), pattern.end(i), j);
+		if (pos == pattern.end(i) || *pos != j) return -1;
+		return (int)(pos - pattern.indices.data());
+	}
+
+	inline void CCSRMatrix::multiply(const std::vector<double> & x, std::vector<double> & y) const
+	{
+		const int n = numRows();
+		y.resize(n);
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < n; ++i) {
+			double sum = 0;
+			for (int k = pattern.offsets[i]; k < pattern.offsets[i + 1]; ++k) {
+				sum += values[k] * x[pattern.indices[k]];
+			}
+			y[i] = sum;
+		}
+	}
+}
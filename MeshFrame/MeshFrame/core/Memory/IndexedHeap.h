@@ -0,0 +1,150 @@
+/*!
+*      \file IndexedHeap.h
+*      \brief d-ary min heap over int ids whose keys can be changed in place
+*
+*		Each id is at most once in the heap and its position is tracked, so updating the key of an element
+*		moves it instead of pushing a duplicate, and elements can be removed from the middle.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+namespace MeshLib {
+
+	template<int D = 4>
+	class CIndexedHeap
+	{
+	public:
+		/*! the ids must be less than numIds, the heap is emptied */
+		void reset(int numIds);
+		/*! make a heap of the given ids and keys in linear time, replacing the content */
+		void build(const std::vector<int> & ids, const std::vector<double> & keys);
+
+		bool empty() const { return mEntries.empty(); };
+		int size() const { return (int)mEntries.size(); };
+		bool contains(int id) const { return id < (int)mPositions.size() && mPositions[id] >= 0; };
+		double key(int id) const { return mEntries[mPositions[id]].key; };
+
+		/*! insert the id, or change its key if it is already in */
+		void push(int id, double key);
+		void remove(int id);
+
+		int top() const { return mEntries[0].id; };
+		double topKey() const { return mEntries[0].key; };
+		int pop();
+
+	private:
+		struct Entry
+		{
+			double key;
+			int id;
+		};
+
+		void _siftUp(int i);
+		void _siftDown(int i);
+		void _place(int i, const Entry & entry)
+		{
+			mEntries[i] = entry;
+			mPositions[entry.id] = i;
+		};
+
+		std::vector<Entry> mEntries;
+		/*! id -> position in mEntries, -1 if not in the heap */
+		std::vector<int>   mPositions;
+	};
+
+	template<int D>
+	inline void CIndexedHeap<D>::reset(int numIds)
+	{
+		mEntries.clear();
+		mPositions.assign(numIds, -1);
+	}
+
+	template<int D>
+	inline void CIndexedHeap<D>::build(const std::vector<int> & ids, const std::vector<double> & keys)
+	{
+		for (const Entry & entry : mEntries) mPositions[entry.id] = -1;
+		mEntries.resize(ids.size());
+		for (size_t i = 0; i < ids.size(); ++i) {
+			if (ids[i] >= (int)mPositions.size()) mPositions.resize(ids[i] + 1, -1);
+			_place((int)i, Entry{ keys[i], ids[i] });
+		}
+		for (int i = ((int)mEntries.size() - 2) / D; i >= 0; --i) _siftDown(i);
+	}
+
+	template<int D>
+	inline void CIndexedHeap<D>::push(int id, double key)
+	{
+		if (id >= (int)mPositions.size()) mPositions.resize(id + 1, -1);
+		int i = mPositions[id];
+		if (i < 0) {
+			mEntries.push_back(Entry{ key, id });
+			i = (int)mEntries.size() - 1;
+			mPositions[id] = i;
+			_siftUp(i);
+			return;
+		}
+		const double oldKey = mEntries[i].key;
+		mEntries[i].key = key;
+		if (key < oldKey) _siftUp(i);
+		else _siftDown(i);
+	}
+
+	template<int D>
+	inline void CIndexedHeap<D>::remove(int id)
+	{
+		if (!contains(id)) return;
+		const int i = mPositions[id];
+		mPositions[id] = -1;
+		const Entry last = mEntries.back();
+		mEntries.pop_back();
+		if (i == (int)mEntries.size()) return;
+		_place(i, last);
+		if (i > 0 && last.key < mEntries[(i - 1) / D].key) _siftUp(i);
+		else _siftDown(i);
+	}
+
+	template<int D>
+	inline int CIndexedHeap<D>::pop()
+	{
+		const int id = top();
+		remove(id);
+		return id;
+	}
+
+	template<int D>
+	inline void CIndexedHeap<D>::_siftUp(int i)
+	{
+		const Entry entry = mEntries[i];
+		while (i > 0) {
+			const int parent = (i - 1) / D;
+			if (!(entry.key < mEntries[parent].key)) break;
+			_place(i, mEntries[parent]);
+			i = parent;
+		}
+		_place(i, entry);
+	}
+
+	template<int D>
+	inline void CIndexedHeap<D>::_siftDown(int i)
+	{
+		const Entry entry = mEntries[i];
+		const int n = (int)mEntries.size();
+		for (;;) {
+			const int first = D * i + 1;
+			if (first >= n) break;
+			const int last = first + D < n ? first + D : n;
+			int best = first;
+			for (int c = first + 1; c < last; ++c) {
+				if (mEntries[c].key < mEntries[best].key) best = c;
+			}
+			if (!(mEntries[best].key < entry.key)) break;
+			_place(i, mEntries[best]);
+			i = best;
+		}
+		_place(i, entry);
+	}
+}
@@ -15,7 +15,7 @@ public:
 	typedef	typename std::vector<char*>::iterator		MemberIter;
 public:
 	/*Construct*/
-	MPIterator(MemberIter viter, size_t index, size_t blocksize, size_t size, std::vector<bool>& _deleteMask, size_t _memberTSize)
+	MPIterator(MemberIter viter, size_t index, size_t blocksize, size_t size, std::vector<char>& _deleteMask, size_t _memberTSize)
 		:mCurrentViter(viter), mIndex(index), mBlockSize(blocksize), mSize(size), deleteMask(_deleteMask), memberTSize(_memberTSize)
 	{
 		bool ifFindBegin = false;
@@ -129,7 +129,7 @@ public:
 	/*Current Block*/
 	char* mCurrentBlock;
 	/*Deleted mask of wether a member has been deleted*/
-	std::vector<bool> & deleteMask;
+	std::vector<char> & deleteMask;
 	/*Size of true member*/
 	const size_t memberTSize;
 };
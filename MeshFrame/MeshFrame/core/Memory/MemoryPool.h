@@ -4,12 +4,15 @@
 *      \brief A simple implation of memory pool, relying on std::vector and its index;
 *
 *      The access and the delete of members of memory pool rely the index, which is a size_t variation.
+*      Members can be deleted concurrently inside an OpenMP parallel region, as long as no two threads
+*      delete the same member and no member is created meanwhile.
 *
 */
 
 #include <vector>
-#include <list>
+#include <mutex>
 #include <assert.h>
+#include "../Parallel/OpenMP.h"
 #include "./MPIterator.h"
 
 #define DEFAULT_BLOCK_SIZE 2048
@@ -51,8 +54,20 @@ public:
 	}
 	/*Deleted the memberof corresponding id, return false if it has already been deleted*/
 	bool deleteMember(size_t index);
+	/*Compute the index of each member once the pool is compacted, -1 for the deleted members*/
+	void compactIndices(std::vector<int> & newIndices);
+	/*Move the members to the indices given by compactIndices, dropping the deleted ones; the members are
+	* copied by assignment and what they point to is not updated, the slots left behind are reset*/
+	void compact(const std::vector<int> & newIndices);
 	/*Judge if current pointer has been deleted*/
 	bool hasBeenDeleted(size_t index);
+	/*Whether newMember reuses the deleted members; when it does not, a deleted member keeps its content at its index
+	* and the new members are always appended*/
+	void setReuseDeleted(bool reuse) { reuseDeleted = reuse; };
+	/*Undo the last newMember, which has to have appended its member*/
+	void popMember();
+	/*Undo deleteMember(index): the member is live again with the content it has, return false if it is not deleted*/
+	bool restoreMember(size_t index);
 	/*Return the MemoryPool's maximal capacity*/
 	size_t capacity();
 	/*Return the MemoryPool's size*/
@@ -75,21 +90,23 @@ public:
 	}
 private:
 	std::vector<char*> memoryBlockPtrVec;
-	std::list<size_t> deletedMembersList;
+	/*the deleted members, reused last in first out*/
+	std::vector<size_t> deletedMembersList;
 	/*Block's size*/
 	const size_t blockSize = DEFAULT_BLOCK_SIZE;
 	/*Max current member's number*/
 	size_t currentIndex;
+	bool reuseDeleted = true;
 	void * getMemberPointer(size_t index);
 	/*masks on which member has been deleted*/
-	std::vector<bool> deleteMask;
+	std::vector<char> deleteMask;
 	/*size of true member type, in other word, you can cast MemoryPool<Son> to MemoryPool<Father>,
 	* and memberTSize is still sizeof(Son), and you can iterate MemoryPool<Son> pool as MemoryPool<Father>.
 	*/
 	const size_t memberTSize;
 
 	//std::mutex newMemberLock;
-	//std::mutex deleteMemberLock;
+	std::mutex deleteMemberLock;
 };
 
 template<typename T>
@@ -158,7 +175,7 @@ inline T * MemoryPool<T>::newMember(size_t & index)
 	//std::lock_guard<std::mutex> newMemberLockGuard(newMemberLock);
 	//std::lock_guard<std::mutex> deleteMemberLockGuard(deleteMemberLock);
 
-	if (deletedMembersList.empty()) {
+	if (deletedMembersList.empty() || !reuseDeleted) {
 		if (currentIndex >= memoryBlockPtrVec.size() * blockSize) {
 			T * pBlock = new T[blockSize];
 			if (pBlock == NULL) {
@@ -175,8 +192,8 @@ inline T * MemoryPool<T>::newMember(size_t & index)
 	}
 	else
 	{
-		index = deletedMembersList.front();
-		deletedMembersList.pop_front();
+		index = deletedMembersList.back();
+		deletedMembersList.pop_back();
 		T * pNewMember = (T *)getMemberPointer(index);
 		deleteMask[index] = false;
 		T * pT = (T *)pNewMember;
@@ -192,7 +209,7 @@ inline T * MemoryPool<T>::newMember(size_t & index, const T & initialVal)
 	//std::lock_guard<std::mutex> newMemberLockGuard(newMemberLock);
 	//std::lock_guard<std::mutex> deleteMemberLockGuard(deleteMemberLock);
 
-	if (deletedMembersList.empty()) {
+	if (deletedMembersList.empty() || !reuseDeleted) {
 		if (currentIndex >= memoryBlockPtrVec.size() * blockSize) {
 			T * pBlock = new T[blockSize];
 			if (pBlock == NULL) {
@@ -210,8 +227,8 @@ inline T * MemoryPool<T>::newMember(size_t & index, const T & initialVal)
 	}
 	else
 	{
-		index = deletedMembersList.front();
-		deletedMembersList.pop_front();
+		index = deletedMembersList.back();
+		deletedMembersList.pop_back();
 		T * pNewMember = (T *)getMemberPointer(index);
 		deleteMask[index] = false;
 		T * pT = (T *)pNewMember;
@@ -261,15 +278,75 @@ inline bool MemoryPool<T>::deleteMember(size_t index)
 	//std::lock_guard<std::mutex> newMemberLockGuard(newMemberLock);
 	//std::lock_guard<std::mutex> deleteMemberLockGuard(deleteMemberLock);
 
-	T * pMemberToDelete = (T *)getMemberPointer(index);
 	if (deleteMask[index]) {
 		return false;
 	}
+	deleteMask[index] = true;
+	if (MeshLib::Parallel::inParallel()) {
+		std::lock_guard<std::mutex> deleteMemberLockGuard(deleteMemberLock);
+		deletedMembersList.push_back(index);
+	}
 	else {
-		deleteMask[index] = true;
 		deletedMembersList.push_back(index);
-		return true;
 	}
+	return true;
+}
+
+template<typename T>
+inline void MemoryPool<T>::compactIndices(std::vector<int> & newIndices)
+{
+	newIndices.resize(currentIndex);
+	int numMembers = 0;
+	for (size_t i = 0; i < currentIndex; ++i) {
+		newIndices[i] = deleteMask[i] ? -1 : numMembers++;
+	}
+}
+
+template<typename T>
+inline void MemoryPool<T>::compact(const std::vector<int> & newIndices)
+{
+	size_t numMembers = 0;
+	// the members only move to lower indices, so going up never overwrites one still to be moved
+	for (size_t i = 0; i < currentIndex; ++i) {
+		if (newIndices[i] < 0) continue;
+		if ((size_t)newIndices[i] != i) {
+			*getPointer(newIndices[i]) = *getPointer(i);
+		}
+		++numMembers;
+	}
+	// the vacated tail still holds the moved members, and the appended members are expected to be fresh
+	for (size_t i = numMembers; i < currentIndex; ++i) {
+		*getPointer(i) = T();
+	}
+	currentIndex = numMembers;
+	deleteMask.assign(numMembers, false);
+	deletedMembersList.clear();
+}
+
+template<typename T>
+inline void MemoryPool<T>::popMember()
+{
+	assert(currentIndex > 0);
+	--currentIndex;
+	deleteMask.pop_back();
+	// the appended members are expected to be fresh
+	*getPointer(currentIndex) = T();
+}
+
+template<typename T>
+inline bool MemoryPool<T>::restoreMember(size_t index)
+{
+	if (!deleteMask[index]) {
+		return false;
+	}
+	// the members are usually restored in the reverse order of their deletion
+	for (size_t i = deletedMembersList.size(); i-- > 0;) {
+		if (deletedMembersList[i] != index) continue;
+		deletedMembersList.erase(deletedMembersList.begin() + i);
+		break;
+	}
+	deleteMask[index] = false;
+	return true;
 }
 
 template<typename T>
@@ -0,0 +1,43 @@
+/*!
+*      \file StridedArray.h
+*      \brief View of a n x 3 array in memory owned by someone else, e.g. a NumPy array
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <type_traits>
+
+namespace MeshLib {
+
+	/*!
+	* \brief n x 3 array view with arbitrary strides, it does not own the memory.
+	*
+	*  Strides are in bytes like NumPy's, so both C and Fortran ordered arrays, and interleaved
+	*  vertex buffers, can be read and written in place.
+	*  T can be const qualified for read only views.
+	*/
+	template<typename T>
+	struct CStridedArray
+	{
+		CStridedArray(T * pData, size_t numRows, ptrdiff_t rowStride = 3 * sizeof(T), ptrdiff_t colStride = sizeof(T))
+			: data(pData), rows(numRows), stride(rowStride), colStride(colStride) {};
+		/*! view on a std::vector<std::array<T, 3>> like buffer */
+		template<typename Vec>
+		static CStridedArray fromVector(Vec & vec) {
+			return CStridedArray(vec.empty() ? nullptr : &vec[0][0], vec.size());
+		}
+
+		T & operator()(size_t row, int col) const {
+			return *(T*)((typename std::conditional<std::is_const<T>::value, const char, char>::type *)data
+				+ (ptrdiff_t)row * stride + col * colStride);
+		}
+
+		T *       data;
+		size_t    rows;
+		/*! bytes between two rows */
+		ptrdiff_t stride;
+		/*! bytes between two columns of a row */
+		ptrdiff_t colStride;
+	};
+}
@@ -0,0 +1,156 @@
+/*!
+*      \file VertexPairIndex.h
+*      \brief Hash map from a pair of vertex indices to a mesh element
+*
+*		Open addressing with linear probing and backward shift deletion, keys are the two
+*		32 bits pool indices packed in a 64 bits integer. Used by the surface and tet meshes
+*		to find the halfedge or edge between two vertices without walking the vertex fan.
+*/
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace MeshLib {
+
+	/*!
+	* \brief Hash map (i0, i1) -> T, T being a pointer, NULL meaning not found. Not thread safe for writes.
+	*
+	*  The pairs are ordered, a user wanting unordered pairs sorts the indices before calling.
+	*/
+	template<typename T>
+	class CVertexPairIndex
+	{
+	public:
+		CVertexPairIndex() {};
+
+		/*! make room for n pairs without rehashing */
+		void reserve(size_t n);
+		void clear();
+		size_t size() const { return mSize; };
+
+		/*! insert or overwrite */
+		void insert(size_t i0, size_t i1, T value);
+		/*! \return the value, NULL if the pair is absent */
+		T find(size_t i0, size_t i1) const;
+		/*! remove the pair if it maps to value, or whatever it maps to if value is NULL */
+		bool erase(size_t i0, size_t i1, T value = NULL);
+
+	private:
+		struct Slot
+		{
+			uint64_t key;
+			T value;
+		};
+		static const uint64_t EMPTY_KEY = ~(uint64_t)0;
+
+		static uint64_t _key(size_t i0, size_t i1) { return ((uint64_t)i0 << 32) | (uint64_t)(uint32_t)i1; };
+		/*! Fibonacci hashing, the high bits of the product are the well mixed ones */
+		size_t _home(uint64_t key) const { return (size_t)((key * 0x9E3779B97F4A7C15ull) >> mShift); };
+		void _rehash(size_t capacity);
+
+		std::vector<Slot> mSlots;
+		size_t            mSize = 0;
+		int               mShift = 64;
+	};
+
+	template<typename T>
+	inline void CVertexPairIndex<T>::reserve(size_t n)
+	{
+		/* max load factor 1/2 */
+		size_t capacity = 16;
+		while (capacity < 2 * n) capacity *= 2;
+		if (capacity > mSlots.size()) _rehash(capacity);
+	}
+
+	template<typename T>
+	inline void CVertexPairIndex<T>::clear()
+	{
+		mSlots.clear();
+		mSize = 0;
+		mShift = 64;
+	}
+
+	template<typename T>
+	inline void CVertexPairIndex<T>::_rehash(size_t capacity)
+	{
+		std::vector<Slot> old;
+		old.swap(mSlots);
+		mSlots.assign(capacity, Slot{ EMPTY_KEY, NULL });
+		mShift = 64;
+		for (size_t c = capacity; c > 1; c >>= 1) --mShift;
+		const size_t mask = capacity - 1;
+		for (const Slot & s : old) {
+			if (s.key == EMPTY_KEY) continue;
+			size_t i = _home(s.key);
+			while (mSlots[i].key != EMPTY_KEY) i = (i + 1) & mask;
+			mSlots[i] = s;
+		}
+	}
+
+	template<typename T>
+	inline void CVertexPairIndex<T>::insert(size_t i0, size_t i1, T value)
+	{
+		if (2 * (mSize + 1) > mSlots.size()) {
+			_rehash(mSlots.empty() ? 16 : 2 * mSlots.size());
+		}
+		const uint64_t key = _key(i0, i1);
+		const size_t mask = mSlots.size() - 1;
+		size_t i = _home(key);
+		while (mSlots[i].key != EMPTY_KEY) {
+			if (mSlots[i].key == key) {
+				mSlots[i].value = value;
+				return;
+			}
+			i = (i + 1) & mask;
+		}
+		mSlots[i].key = key;
+		mSlots[i].value = value;
+		++mSize;
+	}
+
+	template<typename T>
+	inline T CVertexPairIndex<T>::find(size_t i0, size_t i1) const
+	{
+		if (mSize == 0) return NULL;
+		const uint64_t key = _key(i0, i1);
+		const size_t mask = mSlots.size() - 1;
+		for (size_t i = _home(key); mSlots[i].key != EMPTY_KEY; i = (i + 1) & mask) {
+			if (mSlots[i].key == key) return mSlots[i].value;
+		}
+		return NULL;
+	}
+
+	template<typename T>
+	inline bool CVertexPairIndex<T>::erase(size_t i0, size_t i1, T value)
+	{
+		if (mSize == 0) return false;
+		const uint64_t key = _key(i0, i1);
+		const size_t mask = mSlots.size() - 1;
+		size_t i = _home(key);
+		while (mSlots[i].key != key) {
+			if (mSlots[i].key == EMPTY_KEY) return false;
+			i = (i + 1) & mask;
+		}
+		if (value != NULL && mSlots[i].value != value) return false;
+
+		/* shift back the following slots of the cluster that may no longer be reached from their home */
+		size_t j = i;
+		for (;;) {
+			j = (j + 1) & mask;
+			if (mSlots[j].key == EMPTY_KEY) break;
+			size_t home = _home(mSlots[j].key);
+			/* j stays if its home lies cyclically in (i, j] */
+			bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+			if (stays) continue;
+			mSlots[i] = mSlots[j];
+			i = j;
+		}
+		mSlots[i].key = EMPTY_KEY;
+		mSlots[i].value = NULL;
+		--mSize;
+		return true;
+	}
+}
@@ -22,7 +22,7 @@
 #include <list>
 #include <vector>
 #include <map>
-#include <omp.h>
+#include "../Parallel/OpenMP.h"
 #include <ctime>
 
 #include "../Geometry/Point.h"
@@ -30,9 +30,17 @@
 #include "../Parser/strutil.h"
 #include "../Parser/IOFuncDef.h"
 #include "../Memory/MemoryPool.h"
+#include "../Memory/StridedArray.h"
+#include "../Memory/VertexPairIndex.h"
+#include "../Parallel/ParallelAlgorithms.h"
 #include "../FileIO/PlyFile.h"
+#include "../FileIO/ObjFrame.h"
+#include "../FileIO/EdgebreakerFile.h"
+#include "../FileIO/StlFile.h"
 #include "HalfEdge.h"
 #include "Props.h"
+#include "MeshCSR.h"
+#include "EditJournal.h"
 
 namespace MeshLib {
 
@@ -109,6 +117,52 @@ namespace MeshLib {
 		void			read_obj(const char * filename, bool removeIsolatedVertices = true);
 
 		void            readVFList(const std::vector<std::array<double, 3>>* verts, const std::vector<std::array<int, 3>>* faces, const std::vector<int>* vIds=nullptr, bool removeIsolatedVerts=true);
+		/*!
+		Build an empty mesh from vertex and triangle arrays in memory owned by the caller, e.g. NumPy arrays,
+		without intermediate copies. Row i of verts becomes the vertex with index() and id() i.
+		\param verts vertex positions, float or double
+		\param faces 0-based triangle list, int32 or int64
+		\param removeIsolatedVerts whether to remove the vertices not referenced by any face
+		\return false if a face references a vertex out of range, the mesh is left untouched then
+		*/
+		template<typename Real, typename Index>
+		bool			readVFBuffer(const CStridedArray<Real> & verts, const CStridedArray<Index> & faces, bool removeIsolatedVerts = true);
+		/*!
+		Build an empty mesh from a triangle list whose halfedge adjacency is already known, e.g. computed by a
+		subdivision scheme, without looking for the sym of each halfedge. Halfedge 3 * f + k of the list goes from
+		faces[3 * f + k] to faces[3 * f + (k + 1) % 3] and becomes the halfedge of index() 3 * f + k; vertex i
+		and face f get index() and id() i and f. The vertex positions are left to the caller.
+		\param numVerts number of vertices, all referenced by the faces
+		\param faces 3 vertex indices per triangle
+		\param twins for each halfedge of the list the opposite one, -1 on the boundary
+		*/
+		void			readHalfedgeList(int numVerts, const std::vector<int> & faces, const std::vector<int> & twins);
+		/*!
+		Write the vertex positions and the triangles into arrays allocated by the caller, in parallel.
+		Vertices are written in index() order skipping the deleted ones, the triangles refer to the rows of verts.
+		\param verts output positions with at least numVertices() rows, data may be NULL to skip the positions
+		\param faces output triangles with at least numFaces() rows, data may be NULL to skip the triangles
+		\return false if an array is too small
+		*/
+		template<typename Real, typename Index>
+		bool			writeVFBuffer(const CStridedArray<Real> & verts, const CStridedArray<Index> & faces);
+
+		/*!
+		Update the vertex positions from an .obj file sharing the connectivity of the current mesh, without
+		rebuilding the halfedge structure. The mesh must have been loaded by read_obj or readVFList (vertex i of
+		the file is the vertex with index() i).
+		\param fileName the input .obj file name
+		\param checkTopology whether to check that the face list of the file matches the mesh faces
+		\return false if the file can not be read or does not match the mesh, the positions are left untouched then
+		*/
+		bool			updatePositionsFromObj(const char * fileName, bool checkTopology = false);
+		/*!
+		Update the vertex positions from a vertex buffer, e.g. a CMeshFrame parsed by readObjFrame.
+		\param verts vertex positions, ordered by vertex index()
+		\param faces 0-based triangle list to check against the mesh faces, NULL to trust the connectivity
+		\return false if the buffers do not match the mesh, the positions are left untouched then
+		*/
+		bool			updatePositionsFromBuffer(const std::vector<std::array<double, 3>>* verts, const std::vector<std::array<int, 3>>* faces = nullptr);
 
 		/*!
 		Write an .obj file.
@@ -168,6 +222,31 @@ namespace MeshLib {
 		\param output the output .off file name
 		*/
 		void			write_off(const char * output);
+		/*!
+		Read an .meb file, the Edgebreaker compressed format of EdgebreakerFile.h. Vertices are renumbered.
+		\param input the input .meb file name
+		*/
+		void			read_eb(const char * input);
+		/*!
+		Read a binary or ASCII .stl file. Coincident corners are welded into shared vertices, faces which would
+		make an edge non-manifold are skipped.
+		\param input the input .stl file name
+		\param weldEpsilon corners closer than weldEpsilon are welded, 0 to only weld identical corners
+		\param nonManifoldEdges if not NULL, receives the vertex indices of the non-manifold edges found in the file
+		*/
+		void			read_stl(const char * input, double weldEpsilon = 0.0, std::vector<std::array<int, 2>> * nonManifoldEdges = NULL);
+		/*!
+		Write an .stl file.
+		\param output the output .stl file name
+		\param binary binary or ASCII
+		*/
+		void			write_stl(const char * output, bool binary = true);
+		/*!
+		Write an .meb file, with the uv, normal and color of the vertex type if it has them.
+		\param output the output .meb file name
+		\param quantBits position quantization bits, relatively to the bounding box
+		*/
+		void			write_eb(const char * output, int quantBits = 14);
 
 		//number of vertices, faces, edges
 		/*! number of vertices */
@@ -184,6 +263,14 @@ namespace MeshLib {
 		MemoryPool<EdgeType>	 & edges() { return mEContainer; };
 		MemoryPool<HalfEdgeType> & halfedges() { return mHEContainer;; };
 
+		/*!
+		Snapshot the vertex-vertex, vertex-face and face-face adjacency in compressed sparse rows, in parallel.
+		Kernels iterating many times over the neighbourhoods read these contiguous arrays instead of chasing
+		the halfedge pointers.
+		\param csr the output snapshot
+		*/
+		void			buildCSR(CMeshCSR<VertexType, FaceType> & csr);
+
 		//is boundary
 		/*! whether a vertex is on the boundary
 		\param v the pointer to the vertex
@@ -272,6 +359,25 @@ namespace MeshLib {
 		*/
 		static HEPtr	vertexHalfedge(VPtr pV0, VPtr pV1);
 
+		/*!
+		Make findHalfedge and findEdge use a hash index from vertex pairs to halfedges instead of walking the
+		vertex fans. The index is built at the first lookup, then kept up to date by createFace, deleteHalfEdge
+		and the DynamicMesh operators. The first lookup is not thread safe.
+		*/
+		void			useVertexPairIndex(bool use = true);
+		/*!
+		Drop the index after halfedges were relinked by hand, it is rebuilt at the next lookup.
+		*/
+		void			invalidateVertexPairIndex();
+		/*!
+		Same as vertexHalfedge(v0, v1), through the vertex pair index if it is used.
+		*/
+		HEPtr			findHalfedge(VPtr pV0, VPtr pV1);
+		/*!
+		Same as vertexEdge(v0, v1), through the vertex pair index if it is used.
+		*/
+		EPtr			findEdge(VPtr pV0, VPtr pV1);
+
 		//access corner(halfedge) by attaced face and vertex
 		/*!
 		Access a halfedge by its target vertex, and attaching face.
@@ -558,6 +664,22 @@ namespace MeshLib {
 		HEContainer &	getHEContainer() { return mHEContainer; };
 
 	protected:
+		/*!
+		Last step of the readers building the mesh face by face: label the boundary vertices, remove the isolated ones
+		and make the halfedge of a boundary vertex its most ccw in halfedge.
+		*/
+		void			finishLoading(bool removeIsolatedVerts);
+		/*! index all the halfedges linked in a face */
+		void			_buildVertexPairIndex();
+
+		/*! (source index, target index) -> halfedge, see useVertexPairIndex */
+		CVertexPairIndex<HEPtr>	mHEIndex;
+		bool				mUseVertexPairIndex = false;
+		/*! whether mHEIndex is built and maintained */
+		bool				mHEIndexValid = false;
+		/*! the creates and deletes of elements while a DynamicMesh savepoint is open */
+		CEditJournal<VertexType, EdgeType, FaceType, HalfEdgeType> mJournal;
+
 		//Maps
 		/*! Map of vertices */
 		VMap				mVMap;
@@ -1313,6 +1435,50 @@ namespace MeshLib {
 		return NULL;
 	};
 
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::useVertexPairIndex(bool use)
+	{
+		mUseVertexPairIndex = use;
+		if (!use) invalidateVertexPairIndex();
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::invalidateVertexPairIndex()
+	{
+		mHEIndex.clear();
+		mHEIndexValid = false;
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::_buildVertexPairIndex()
+	{
+		mHEIndex.clear();
+		mHEIndex.reserve(mHEContainer.size());
+		for (HalfEdgeType * pHE : mHEContainer)
+		{
+			if (pHE->he_prev() == NULL) continue;
+			mHEIndex.insert(pHE->source()->index(), pHE->target()->index(), pHE);
+		}
+		mHEIndexValid = true;
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline HalfEdgeType * CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::findHalfedge(VPtr pV0, VPtr pV1)
+	{
+		if (!mUseVertexPairIndex) return vertexHalfedge(pV0, pV1);
+		if (!mHEIndexValid) _buildVertexPairIndex();
+		return mHEIndex.find(pV0->index(), pV1->index());
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline EdgeType * CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::findEdge(VPtr pV0, VPtr pV1)
+	{
+		if (!mUseVertexPairIndex) return vertexEdge(pV0, pV1);
+		HEPtr pHE = findHalfedge(pV0, pV1);
+		if (pHE == NULL) pHE = findHalfedge(pV1, pV0);
+		return pHE != NULL ? (EPtr)pHE->edge() : NULL;
+	}
+
 	//access vertex->edges
 	/*!
 	Access the edge list of a vertex, {e} such that e->vertex1() == v
@@ -1351,6 +1517,7 @@ namespace MeshLib {
 			pProp->initializePropMember(index);
 		}
 		pV->index() = index;
+		if (mJournal.active()) mJournal.created(mJournal.Vertex, index);
 		return pV;
 	}
 	/*! New a edge in mesh */
@@ -1360,7 +1527,13 @@ namespace MeshLib {
 		size_t index;
 		EdgeType * pE = mEContainer.newMember(index);
 		assert(pE != NULL);
+
+		for (int i = 0; i < mEProps.size(); i++) {
+			BasicPropHandle * pProp = mEProps[i];
+			pProp->initializePropMember(index);
+		}
 		pE->index() = index;
+		if (mJournal.active()) mJournal.created(mJournal.Edge, index);
 		return pE;
 	}
 	/*! New a face in mesh */
@@ -1370,7 +1543,13 @@ namespace MeshLib {
 		size_t index;
 		FaceType * pF = mFContainer.newMember(index);
 		assert(pF != NULL);
+
+		for (int i = 0; i < mFProps.size(); i++) {
+			BasicPropHandle * pProp = mFProps[i];
+			pProp->initializePropMember(index);
+		}
 		pF->index() = index;
+		if (mJournal.active()) mJournal.created(mJournal.Face, index);
 		return pF;
 	}
 	/*! New a halfedge in mesh */
@@ -1380,7 +1559,13 @@ namespace MeshLib {
 		size_t index;
 		HalfEdgeType * pHE = mHEContainer.newMember(index);
 		assert(pHE != NULL);
+
+		for (int i = 0; i < mHEProps.size(); i++) {
+			BasicPropHandle * pProp = mHEProps[i];
+			pProp->initializePropMember(index);
+		}
 		pHE->index() = index;
+		if (mJournal.active()) mJournal.created(mJournal.HalfEdge, index);
 		return pHE;
 	}
 
@@ -1390,28 +1575,39 @@ namespace MeshLib {
 	inline bool CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::deleteVertex(VPtr pV)
 	{
 		//remove current vertex from pool
-		return mVContainer.deleteMember(pV->index());
+		if (!mVContainer.deleteMember(pV->index())) return false;
+		if (mJournal.active()) mJournal.deleted(mJournal.Vertex, pV->index());
+		return true;
 	}
 	/*! Delete a edge in mesh */
 	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
 	inline bool CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::deleteEdge(EPtr pE)
 	{
 		//remove current edge from pool
-		return mEContainer.deleteMember(pE->index());
+		if (!mEContainer.deleteMember(pE->index())) return false;
+		if (mJournal.active()) mJournal.deleted(mJournal.Edge, pE->index());
+		return true;
 	}
 	/*! Delete a face in mesh */
 	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
 	inline bool CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::deleteFace(FPtr pF)
 	{
 		//remove current face from pool
-		return mFContainer.deleteMember(pF->index());
+		if (!mFContainer.deleteMember(pF->index())) return false;
+		if (mJournal.active()) mJournal.deleted(mJournal.Face, pF->index());
+		return true;
 	}
 	/*! Delete a halfedge in mesh*/
 	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
 	inline bool CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::deleteHalfEdge(HEPtr pHE)
 	{
+		if (mHEIndexValid && pHE->he_prev() != NULL) {
+			mHEIndex.erase(pHE->source()->index(), pHE->target()->index(), pHE);
+		}
 		//remove current halfedge from pool
-		return mHEContainer.deleteMember(pHE->index());
+		if (!mHEContainer.deleteMember(pHE->index())) return false;
+		if (mJournal.active()) mJournal.deleted(mJournal.HalfEdge, pHE->index());
+		return true;
 	}
 
 	//create new gemetric simplexes
@@ -1479,6 +1675,7 @@ namespace MeshLib {
 		pTarget->halfedge() = pHE;
 		pHE->vertex() = pTarget;
 		pSource->outHEs().push_back(pHE);
+		if (mHEIndexValid) mHEIndex.insert(pSource->index(), pTarget->index(), pHE);
 
 		return pHE;
 	}
@@ -1504,7 +1701,10 @@ namespace MeshLib {
 			pHEs[i]->face() = pF;
 			//Search for the symmetrical halfedge
 			HalfEdgeType * pHESym = NULL;
-			for (int i = 0; i < pTarget->outHEs().size(); ++i)
+			if (mHEIndexValid) {
+				pHESym = mHEIndex.find(pTarget->index(), pSource->index());
+			}
+			else for (int i = 0; i < pTarget->outHEs().size(); ++i)
 			{
 				HalfEdgeType * pHE = (HalfEdgeType *)pTarget->outHEs()[i];
 				if ((VertexType *)pHE->vertex() == pSource) {
@@ -1558,7 +1758,10 @@ namespace MeshLib {
 			pHEs[i]->face() = pF;
 			//Search for the symmetrical halfedge
 			HalfEdgeType * pHESym = NULL;
-			for (int i = 0; i < pTarget->outHEs().size(); ++i)
+			if (mHEIndexValid) {
+				pHESym = mHEIndex.find(pTarget->index(), pSource->index());
+			}
+			else for (int i = 0; i < pTarget->outHEs().size(); ++i)
 			{
 				HalfEdgeType * pHE = (HalfEdgeType *)pTarget->outHEs()[i];
 				if ((VertexType *)pHE->vertex() == pSource) {
@@ -1595,6 +1798,60 @@ namespace MeshLib {
 	/*!
 	Label boundary edges, vertices
 	*/
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::buildCSR(CMeshCSR<VertexType, FaceType> & csr)
+	{
+		csr.vertices.clear();
+		csr.faces.clear();
+		csr.vertexIds.assign(mVContainer.getCurrentIndex(), -1);
+		csr.faceIds.assign(mFContainer.getCurrentIndex(), -1);
+		csr.vertices.reserve(mVContainer.size());
+		csr.faces.reserve(mFContainer.size());
+		for (VertexType * pV : mVContainer)
+		{
+			csr.vertexIds[pV->index()] = (int)csr.vertices.size();
+			csr.vertices.push_back(pV);
+		}
+		for (FaceType * pF : mFContainer)
+		{
+			csr.faceIds[pF->index()] = (int)csr.faces.size();
+			csr.faces.push_back(pF);
+		}
+		const std::vector<int> & vIds = csr.vertexIds;
+		const std::vector<int> & fIds = csr.faceIds;
+
+		auto sortUnique = [](std::vector<int> & row) {
+			std::sort(row.begin(), row.end());
+			row.erase(std::unique(row.begin(), row.end()), row.end());
+		};
+		/* the out halfedges give all the neighbours but the one across the boundary in halfedge */
+		csr.vv.build(csr.numVertices(), [&](int i, std::vector<int> & row) {
+			for (auto pOut : csr.vertices[i]->outHEs())
+			{
+				HalfEdgeType * pH = (HalfEdgeType *)pOut;
+				row.push_back(vIds[pH->target()->index()]);
+				if (pH->he_prev()->he_sym() == NULL) row.push_back(vIds[pH->he_prev()->source()->index()]);
+			}
+			sortUnique(row);
+		});
+		csr.vf.build(csr.numVertices(), [&](int i, std::vector<int> & row) {
+			for (auto pOut : csr.vertices[i]->outHEs())
+			{
+				HalfEdgeType * pH = (HalfEdgeType *)pOut;
+				row.push_back(fIds[pH->face()->index()]);
+			}
+			sortUnique(row);
+		});
+		csr.ff.build(csr.numFaces(), [&](int i, std::vector<int> & row) {
+			HalfEdgeType * pH0 = faceHalfedge(csr.faces[i]);
+			HalfEdgeType * pH = pH0;
+			do {
+				if (pH->he_sym() != NULL) row.push_back(fIds[pH->he_sym()->face()->index()]);
+				pH = halfedgeNext(pH);
+			} while (pH != pH0);
+		});
+	}
+
 	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
 	void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::labelBoundary(void)
 	{
@@ -2385,6 +2642,98 @@ namespace MeshLib {
 		fclose(fp);
 	}
 
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::read_stl(const char * input, double weldEpsilon, 
+		std::vector<std::array<int, 2>> * nonManifoldEdges)
+	{
+		std::vector<std::array<double, 3>> verts;
+		std::vector<std::array<int, 3>> faces;
+		{
+			std::vector<std::array<float, 3>> corners;
+			if (!Stl::readSoup(input, corners)) {
+				return;
+			}
+			Stl::weld(corners, weldEpsilon, verts, faces);
+		}
+
+		std::vector<char> rejected;
+		std::vector<std::array<int, 2>> badEdges;
+		Stl::findNonManifoldEdges(faces, rejected, badEdges);
+		if (!badEdges.empty()) {
+			printf("Found %d non-manifold edges in %s, the faces making them non-manifold are skipped.\n", (int)badEdges.size(), input);
+		}
+
+		if (nonManifoldEdges != NULL) {
+			nonManifoldEdges->swap(badEdges);
+		}
+		size_t numKept = 0;
+		for (size_t iF = 0; iF < faces.size(); ++iF) {
+			if (!rejected[iF]) faces[numKept++] = faces[iF];
+		}
+		faces.resize(numKept);
+
+		readVFBuffer(CStridedArray<double>::fromVector(verts), CStridedArray<int>::fromVector(faces));
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::write_stl(const char * output, bool binary)
+	{
+		FILE *fp = fopen(output, "wb");
+		if (!fp) {
+			printf("Fail to open output file: %s\n", output);
+			return;
+		}
+
+		std::vector<FaceType *> faces;
+		faces.reserve(mFContainer.size());
+		for (int i = 0; i < mFContainer.getCurrentIndex(); ++i)
+		{
+			if (!mFContainer.hasBeenDeleted(i)) faces.push_back(mFContainer.getPointer(i));
+		}
+
+		if (binary) {
+			/* 50 bytes per triangle: normal, 3 vertices, attribute byte count */
+			char header[80] = { 0 };
+			strncpy(header, "binary STL written by MeshFrame", 79);
+			fwrite(header, 1, 80, fp);
+			uint32_t numTriangles = (uint32_t)faces.size();
+			fwrite(&numTriangles, sizeof(uint32_t), 1, fp);
+			std::vector<char> buffer(50 * faces.size(), 0);
+#pragma omp parallel for
+			for (int iF = 0; iF < (int)faces.size(); ++iF) {
+				float data[12];
+				CPoint n = faceNormal(faces[iF]);
+				HalfEdgeType * pH = faceHalfedge(faces[iF]);
+				for (int j = 0; j < 3; ++j) {
+					data[j] = (float)n[j];
+				}
+				for (int k = 0; k < 3; ++k) {
+					const CPoint & p = halfedgeTarget(pH)->point();
+					for (int j = 0; j < 3; ++j) data[3 + 3 * k + j] = (float)p[j];
+					pH = halfedgeNext(pH);
+				}
+				memcpy(buffer.data() + 50 * (size_t)iF, data, sizeof(data));
+			}
+			fwrite(buffer.data(), 1, buffer.size(), fp);
+		}
+		else {
+			fprintf(fp, "solid MeshFrame\n");
+			for (FaceType * pF : faces) {
+				CPoint n = faceNormal(pF);
+				fprintf(fp, "facet normal %e %e %e\n  outer loop\n", n[0], n[1], n[2]);
+				HalfEdgeType * pH = faceHalfedge(pF);
+				for (int k = 0; k < 3; ++k) {
+					const CPoint & p = halfedgeTarget(pH)->point();
+					fprintf(fp, "    vertex %e %e %e\n", p[0], p[1], p[2]);
+					pH = halfedgeNext(pH);
+				}
+				fprintf(fp, "  endloop\nendfacet\n");
+			}
+			fprintf(fp, "endsolid MeshFrame\n");
+		}
+		fclose(fp);
+	}
+
 //template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
 //inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::read_obj(const char * fileName)
 //{
@@ -2544,6 +2893,9 @@ namespace MeshLib {
 		/*Read lines from file one by one, and analyze them*/
 		char lineBuffer[MAX_LINE_SIZE];
 		char lineTraitBuffer[MAX_TRAIT_STRING_SIZE];
+		/* the Edge lines go through the vertex pair index, built at the first one */
+		const bool usedVertexPairIndex = mUseVertexPairIndex;
+		mUseVertexPairIndex = true;
 		while (true)
 		{
 			/*If get nothing, free buffer, break!*/
@@ -2638,7 +2990,7 @@ namespace MeshLib {
 				int id1 = strutil::parseStringToInt(token);
 				VertexType* currentV0 = mVMap[id0];
 				VertexType* currentV1 = mVMap[id1];
-				EdgeType* currentEdge = vertexEdge(currentV0, currentV1);
+				EdgeType* currentEdge = findEdge(currentV0, currentV1);
 				/*Storing the string's info in currentEdge->string() from file*/
 				switch (stokenizer.findString('{', '}', lineTraitBuffer)) {
 				case strutil::Success:
@@ -2685,6 +3037,7 @@ namespace MeshLib {
 			}
 		}
 		fclose(pFile);
+		if (!usedVertexPairIndex) useVertexPairIndex(false);
 		/*Label boundary edges*/
 		for (int i = 0; i < mEContainer.getCurrentIndex(); ++i)
 		{
@@ -2796,10 +3149,15 @@ namespace MeshLib {
 	inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::readVFList(const std::vector<std::array<double, 3>>* verts, const std::vector<std::array<int, 3>>* faces, 
 		const std::vector<int>* vIds, bool removeIsolatedVerts)
 	{
+		if (vIds == nullptr) {
+			/* ids are the indices, no need for the id map */
+			readVFBuffer(CStridedArray<const double>::fromVector(*verts), CStridedArray<const int>::fromVector(*faces), removeIsolatedVerts);
+			return;
+		}
 
 		for (int iV = 0; iV < verts->size(); iV++)
 		{
-			int id = vIds != nullptr ? (*vIds)[iV] : iV;
+			int id = (*vIds)[iV];
 			VertexType* currentVertex = createVertexWithId(id);
 			currentVertex->point()[0] = (*verts)[iV][0];
 			currentVertex->point()[1] = (*verts)[iV][1];
@@ -2821,6 +3179,13 @@ namespace MeshLib {
 			mFIdMap.insert(FIdMapPair(iF, currentFace));
 		}
 
+		finishLoading(removeIsolatedVerts);
+		mVMap.clear();
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::finishLoading(bool removeIsolatedVerts)
+	{
 		/*Label boundary edges*/
 		for (int i = 0; i < mEContainer.getCurrentIndex(); ++i)
 		{
@@ -2874,9 +3239,254 @@ namespace MeshLib {
 				currentV->halfedge() = currentHE;
 			}
 		}
-		mVMap.clear();
 	}
 
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	template<typename Real, typename Index>
+	inline bool CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::readVFBuffer(const CStridedArray<Real> & verts, 
+		const CStridedArray<Index> & faces, bool removeIsolatedVerts)
+	{
+		const long long numVerts = (long long)verts.rows;
+		const int numFaces = (int)faces.rows;
+
+		int numBadFaces = 0;
+#pragma omp parallel for reduction(+:numBadFaces)
+		for (int iF = 0; iF < numFaces; ++iF) {
+			for (int j = 0; j < 3; ++j) {
+				long long vId = (long long)faces(iF, j);
+				if (vId < 0 || vId >= numVerts) {
+					++numBadFaces;
+					break;
+				}
+			}
+		}
+		if (numBadFaces) {
+			printf("Error in readVFBuffer: %d faces reference vertices out of range!\n", numBadFaces);
+			return false;
+		}
+
+		mVContainer.reserve(verts.rows);
+		mFContainer.reserve(faces.rows);
+		mHEContainer.reserve(3 * faces.rows);
+		mEContainer.reserve(3 * faces.rows / 2 + verts.rows);
+
+		std::vector<VertexType*> pVs(verts.rows);
+		for (size_t iV = 0; iV < verts.rows; ++iV) {
+			pVs[iV] = newVertex();
+			pVs[iV]->id() = (int)pVs[iV]->index();
+		}
+#pragma omp parallel for
+		for (long long iV = 0; iV < numVerts; ++iV) {
+			CPoint & p = pVs[iV]->point();
+			for (int j = 0; j < 3; ++j) {
+				p[j] = (double)verts(iV, j);
+			}
+		}
+
+		for (int iF = 0; iF < numFaces; ++iF)
+		{
+			VertexType* currentVs[3];
+			for (int j = 0; j < 3; j++)
+			{
+				currentVs[j] = pVs[(size_t)faces(iF, j)];
+			}
+			createFace(currentVs);
+		}
+
+		finishLoading(removeIsolatedVerts);
+		return true;
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::readHalfedgeList(int numVerts,
+		const std::vector<int> & faces, const std::vector<int> & twins)
+	{
+		const int numHEs = (int)faces.size();
+		const int numFaces = numHEs / 3;
+		/* an edge for each halfedge without a twin or with a twin of larger index */
+		std::vector<int> edgeIds(numHEs);
+#pragma omp parallel for
+		for (int h = 0; h < numHEs; ++h) {
+			edgeIds[h] = twins[h] < 0 || h < twins[h] ? 1 : 0;
+		}
+		const int numEdges = Parallel::exclusiveScan(edgeIds);
+
+		/* the pools hand out the indices in order, the members are linked in parallel afterwards */
+		mVContainer.reserve(numVerts);
+		mFContainer.reserve(numFaces);
+		mHEContainer.reserve(numHEs);
+		mEContainer.reserve(numEdges);
+		for (int i = 0; i < numVerts; ++i) newVertex();
+		for (int i = 0; i < numFaces; ++i) newFace();
+		for (int i = 0; i < numHEs; ++i) newHalfEdge();
+		for (int i = 0; i < numEdges; ++i) newEdge();
+
+#pragma omp parallel for
+		for (int i = 0; i < numVerts; ++i) {
+			mVContainer.getPointer(i)->id() = i;
+		}
+#pragma omp parallel for
+		for (int f = 0; f < numFaces; ++f) {
+			FaceType * pF = mFContainer.getPointer(f);
+			pF->id() = f;
+			/* like createFace, the face points to the halfedge ending at its first vertex */
+			pF->halfedge() = mHEContainer.getPointer(3 * f + 2);
+		}
+#pragma omp parallel for
+		for (int h = 0; h < numHEs; ++h) {
+			const int f = h / 3, k = h % 3;
+			HalfEdgeType * pHE = mHEContainer.getPointer(h);
+			pHE->vertex() = mVContainer.getPointer(faces[3 * f + (k + 1) % 3]);
+			pHE->face() = mFContainer.getPointer(f);
+			pHE->he_next() = mHEContainer.getPointer(3 * f + (k + 1) % 3);
+			pHE->he_prev() = mHEContainer.getPointer(3 * f + (k + 2) % 3);
+			pHE->he_sym() = twins[h] < 0 ? NULL : mHEContainer.getPointer(twins[h]);
+			const bool first = twins[h] < 0 || h < twins[h];
+			EdgeType * pE = mEContainer.getPointer(first ? edgeIds[h] : edgeIds[twins[h]]);
+			pHE->edge() = pE;
+			if (first) pE->halfedge() = pHE;
+		}
+
+		for (int h = 0; h < numHEs; ++h) {
+			HalfEdgeType * pHE = mHEContainer.getPointer(h);
+			pHE->source()->outHEs().push_back(pHE);
+			VertexType * pV = (VertexType *)pHE->vertex();
+			/* a boundary vertex points to its boundary halfedge */
+			if (pV->halfedge() == NULL || twins[h] < 0) pV->halfedge() = pHE;
+			if (twins[h] < 0) {
+				pV->boundary() = true;
+				pHE->source()->boundary() = true;
+			}
+		}
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	template<typename Real, typename Index>
+	inline bool CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::writeVFBuffer(const CStridedArray<Real> & verts, 
+		const CStridedArray<Index> & faces)
+	{
+		if ((verts.data != nullptr && verts.rows < mVContainer.size()) || (faces.data != nullptr && faces.rows < mFContainer.size())) {
+			printf("Error in writeVFBuffer: the output arrays are too small!\n");
+			return false;
+		}
+
+		/* row of each vertex and face in the outputs: prefix sum over the alive members of the pools */
+		const int numVSlots = (int)mVContainer.getCurrentIndex();
+		std::vector<int> vRows;
+		if (mVContainer.size() != numVSlots) {
+			vRows.resize(numVSlots);
+#pragma omp parallel for
+			for (int i = 0; i < numVSlots; ++i) {
+				vRows[i] = mVContainer.hasBeenDeleted(i) ? 0 : 1;
+			}
+			Parallel::exclusiveScan(vRows);
+		}
+
+		if (verts.data != nullptr) {
+#pragma omp parallel for
+			for (int i = 0; i < numVSlots; ++i) {
+				if (mVContainer.hasBeenDeleted(i)) continue;
+				const CPoint & p = mVContainer.getPointer(i)->point();
+				size_t row = vRows.empty() ? i : vRows[i];
+				for (int j = 0; j < 3; ++j) {
+					verts(row, j) = (Real)p[j];
+				}
+			}
+		}
+
+		if (faces.data != nullptr) {
+			const int numFSlots = (int)mFContainer.getCurrentIndex();
+			std::vector<int> fRows;
+			if (mFContainer.size() != numFSlots) {
+				fRows.resize(numFSlots);
+#pragma omp parallel for
+				for (int i = 0; i < numFSlots; ++i) {
+					fRows[i] = mFContainer.hasBeenDeleted(i) ? 0 : 1;
+				}
+				Parallel::exclusiveScan(fRows);
+			}
+#pragma omp parallel for
+			for (int i = 0; i < numFSlots; ++i) {
+				if (mFContainer.hasBeenDeleted(i)) continue;
+				HalfEdgeType * pH = faceHalfedge(mFContainer.getPointer(i));
+				size_t row = fRows.empty() ? i : fRows[i];
+				for (int j = 0; j < 3; ++j) {
+					int vIndex = (int)halfedgeTarget(pH)->index();
+					faces(row, j) = (Index)(vRows.empty() ? vIndex : vRows[vIndex]);
+					pH = halfedgeNext(pH);
+				}
+			}
+		}
+		return true;
+	}
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::read_eb(const char * input)
+	{
+		CEdgebreakerDecoder<CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>> decoder;
+		decoder.decode(input, this);
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::write_eb(const char * output, int quantBits)
+	{
+		CEdgebreakerEncoder<CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>> encoder;
+		encoder.encode(this, output, quantBits);
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline bool CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::updatePositionsFromObj(const char * fileName, bool checkTopology)
+	{
+		CMeshFrame frame;
+		if (!readObjFrame(fileName, frame, checkTopology)) {
+			return false;
+		}
+		return updatePositionsFromBuffer(&frame.verts, checkTopology ? &frame.faces : nullptr);
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline bool CBaseMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::updatePositionsFromBuffer(const std::vector<std::array<double, 3>>* verts, 
+		const std::vector<std::array<int, 3>>* faces)
+	{
+		const int numV = (int)mVContainer.getCurrentIndex();
+		if ((int)verts->size() != numV) {
+			printf("Vertex number mismatch: %d in buffer, %d in mesh!\n", (int)verts->size(), numV);
+			return false;
+		}
+
+		if (faces != nullptr) {
+			if ((int)faces->size() != numFaces()) {
+				printf("Face number mismatch: %d in buffer, %d in mesh!\n", (int)faces->size(), numFaces());
+				return false;
+			}
+			/* createFace makes pF->halfedge() point to the first vertex, followed by the next ones */
+			int iF = 0;
+			for (int i = 0; i < mFContainer.getCurrentIndex(); ++i)
+			{
+				if (mFContainer.hasBeenDeleted(i)) continue;
+				HalfEdgeType * pHE = faceHalfedge(mFContainer.getPointer(i));
+				for (int j = 0; j < 3; ++j) {
+					if ((int)halfedgeTarget(pHE)->index() != (*faces)[iF][j]) {
+						printf("Face %d does not match the mesh connectivity!\n", iF);
+						return false;
+					}
+					pHE = halfedgeNext(pHE);
+				}
+				++iF;
+			}
+		}
+
+#pragma omp parallel for
+		for (int i = 0; i < numV; ++i)
+		{
+			CPoint & p = mVContainer.getPointer(i)->point();
+			p[0] = (*verts)[i][0];
+			p[1] = (*verts)[i][1];
+			p[2] = (*verts)[i][2];
+		}
+		return true;
+	}
+
+
 }//name space MeshLib
 
 
@@ -224,7 +224,7 @@ protected:
 	*/
 	typename std::vector<TLoop*> m_loops;
 	/*!
-		Bubble sort the loops
+		Sort the loops by decreasing length
 		\param loops the vector of loops
 	*/
 	void _bubble_sort( std::vector<CLoop<CVertex, CEdge, CFace, CHalfEdge>*> & loops);
@@ -270,29 +270,15 @@ CLoop<CVertex, CEdge, CFace, CHalfEdge>::~CLoop()
 
 /*!
 	_bubble_sort
-	bubble sort  a vector of boundary loop objects, according to their lengths
+	sort a vector of boundary loop objects by decreasing length, the loops of equal length keeping their order
+	as with the former bubble sort, in O(n log n)
 	\param loops vector of loops
 */
 template<typename CVertex, typename CEdge, typename CFace, typename CHalfEdge>
 void CBoundary<CVertex, CEdge, CFace, CHalfEdge>::_bubble_sort( std::vector<CLoop<CVertex, CEdge, CFace, CHalfEdge>*> & loops)
 {
-      int i, j, flag = 1;    // set flag to 1 to start first pass
-      CLoop<CVertex,CEdge,CFace,CHalfEdge> * temp;             // holding variable
-      int numLength = (int)loops.size( );
-      for(i = 1; (i <= numLength) && flag; i++)
-     {
-          flag = 0;
-          for (j=0; j < (numLength -1); j++)
-         {
-               if (loops[j+1]->length() > loops[j]->length() )      // ascending order simply changes to <
-              {
-                    temp = loops[j];								// swap elements
-                    loops[j] = loops[j+1];
-                    loops[j+1] = temp;
-                    flag = 1;										// indicates that a swap occurred.
-               }
-          }
-     }
+	std::stable_sort( loops.begin(), loops.end(),
+		[]( CLoop<CVertex, CEdge, CFace, CHalfEdge> * a, CLoop<CVertex, CEdge, CFace, CHalfEdge> * b ) { return a->length() > b->length(); } );
 }
 
 /*!
@@ -1,7 +1,10 @@
 #ifndef _MESHLIB_DYNAMIC_MESH_H_
 #define _MESHLIB_DYNAMIC_MESH_H_ 
 
+#include <functional>
 #include "BaseMesh.h"
+#include "../Spatial/PointGrid.h"
+#include "../Spatial/KdTree.h"
 namespace MeshLib {
 
     template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
@@ -37,6 +40,119 @@ namespace MeshLib {
 
         /*! collapse an edge to vertex vs */
         void collapseEdgeVertexNM(EdgeType * pE);
+
+        /*! whether collapsing pH keeps the mesh a manifold: the link condition, plus no face or
+        tetrahedron left degenerate */
+        bool isCollapseOk(HalfEdgeType * pH);
+
+        /*! collapse the source of pH into its target, which is returned. The faces of pH and of its sym,
+        the edges of pH, pH->he_prev() and pH->he_sym()->he_next() and the source vertex are deleted;
+        check isCollapseOk first */
+        VertexType * collapseHalfedge(HalfEdgeType * pH);
+
+        /*! the inverse of collapseHalfedge: pull a new vertex at p out of pV, adding the faces (new, pV, pVl) and
+        (pV, new, pVr). The edges of pV from pVl up to pVr excluded, turning ccw, go to the new vertex, which is returned;
+        pVr is NULL when the new vertex is on the boundary, the edges from pVl to the boundary going to it then. The new
+        vertex takes the props of pV, the new faces and edges those of their neighbours across pV - pVl and pV - pVr */
+        VertexType * splitVertex(VertexType * pV, VertexType * pVl, VertexType * pVr, const CPoint & p);
+
+        /*! whether pE can be flipped: an interior edge whose opposite vertices are distinct and not adjacent */
+        bool isFlipOk(EdgeType * pE);
+
+        /*! replace pE by the edge between its opposite vertices, in place: no element is created or deleted.
+        check isFlipOk first */
+        void flipEdge(EdgeType * pE);
+
+        /*! insert a vertex at p on pE, splitting the faces of pE in two; pE is kept between the source of
+        pE->halfedge() and the new vertex, which is returned. The new faces and the other half of pE take
+        the props of the elements they are split from */
+        VertexType * splitEdge(EdgeType * pE, const CPoint & p);
+
+        /*! insert a vertex at p in pF, splitting it in three faces which take the props of pF; the new vertex is returned */
+        VertexType * splitFace(FaceType * pF, const CPoint & p);
+
+        /*! add triangles in one pass, e.g. the patches filling holes. Halfedge 3 f + k of the list goes from corners[3 f + k]
+        to corners[3 f + (k + 1) % 3], as in readHalfedgeList; twins gives for each halfedge the opposite one in the list,
+        or -1, and then borders gives the boundary halfedge of the mesh it is glued to, or NULL if it stays on the boundary.
+        The new elements get initialized props; the new faces are appended to pFaces */
+        void addFaces(const std::vector<VertexType *> & corners, const std::vector<int> & twins,
+            const std::vector<HalfEdgeType *> & borders, std::vector<FaceType *> * pFaces = NULL);
+
+        /*! called by splitEdge and splitFace on the new vertex, with the vertices of the split element and the
+        barycentric weights of the new point. The props of the vertex of largest weight are copied beforehand,
+        so the interpolator only has to fix what can be interpolated, e.g. the normal or the uv */
+        typedef std::function<void(VertexType * pV, VertexType * const * pVs, const double * weights, int n)> VertexInterpolator;
+        void setVertexInterpolator(const VertexInterpolator & interpolator) { mVertexInterpolator = interpolator; };
+
+        /*! whether the faces around pV form a single fan, closed or ending on the boundary, and pV->halfedge()
+        is its boundary halfedge when it is open */
+        bool isManifold(VertexType * pV);
+
+        /*! move the live vertices, edges, faces and halfedges to the front of their pools so that the indices are
+        0 ... n - 1 again, with their props; the attached spatial indices are rebuilt, the vertex pair index is
+        invalidated and the journal is committed. Every pointer to an element held outside the mesh is invalid afterwards, and so are pointers
+        to elements added by derived element types */
+        void compact();
+
+        /*! keep a spatial index of the vertices up to date with addVertex, removeVertex and moveVertex,
+        the ids being the vertex indices; NULL to detach */
+        void attachVertexGrid(CPointGrid * pGrid) { mpVertexGrid = pGrid; };
+        void attachVertexTree(CKdTree * pTree) { mpVertexTree = pTree; };
+
+        /*! create a vertex at p and insert it into the attached indices */
+        VertexType * addVertex(const CPoint & p);
+
+        /*! remove a vertex from the attached indices and the id map and delete it, its halfedges must be gone; inside a
+        parallel region the id map keeps its entry until compact */
+        void removeVertex(VertexType * pV);
+
+        /*! move a vertex and update the attached indices */
+        void moveVertex(VertexType * pV, const CPoint & p);
+
+        /*! start journaling the edits if needed, and return a mark of this point to roll back to. Marks nest: rolling back
+        to one keeps the earlier ones valid. While journaling, the pools do not reuse the deleted elements, which keep their
+        props, and the operators above log the elements they create, delete and modify, once per element and mark */
+        size_t savepoint();
+
+        /*! undo the edits made since mark, in reverse order, in time proportional to their number; the attached spatial
+        indices and the vertex pair index are updated. Rolling back to 0 ends the journal, as commit does. The props of the
+        elements are not journaled, only those of the deleted ones are kept */
+        void rollback(size_t mark = 0);
+
+        /*! keep the edits and end the journal */
+        void commit();
+
+        bool isJournaling() const { return mJournal.active(); };
+
+    protected:
+        /*! whether pV1 is adjacent to pV, in O(valence) */
+        bool isNeighbor(VertexType * pV, VertexType * pV1);
+        /*! remove pH from the outgoing halfedges of pV, the order of the others is not kept */
+        void eraseOutHalfedge(VertexType * pV, HalfEdgeType * pH);
+        /*! point the halfedge of pV to an incoming halfedge, the boundary one if there is one */
+        void resetVertexHalfedge(VertexType * pV);
+        /*! move the members of a pool and their props to the indices given by compactIndices */
+        template<typename Container>
+        void compactPool(Container & container, Props & props, const std::vector<int> & indices);
+        /*! copy the props of the element at index from to the element at index to */
+        void copyProps(Props & props, size_t from, size_t to);
+        /*! give a new vertex the props of the heaviest of pVs, then call the interpolator */
+        void interpolateVertex(VertexType * pV, VertexType * const * pVs, const double * weights, int n);
+        /*! keep the vertex pair index up to date with a halfedge about to change its ends, and after */
+        void unindexHalfedge(HalfEdgeType * pH);
+        void indexHalfedge(HalfEdgeType * pH);
+        /*! journal an element about to be modified, see savepoint */
+        void touch(VertexType * pV) { if (mJournal.active()) mJournal.modified(pV); };
+        void touch(EdgeType * pE) { if (mJournal.active()) mJournal.modified(pE); };
+        void touch(FaceType * pF) { if (mJournal.active()) mJournal.modified(pF); };
+        void touch(HalfEdgeType * pH) { if (mJournal.active()) mJournal.modified(pH); };
+        /*! undo a journal record on the pool of its kind */
+        template<typename Container, typename Element>
+        void undoRecord(Container & container, const std::vector<Element> & images, const typename CEditJournal<VertexType, EdgeType, FaceType, HalfEdgeType>::Record & r);
+
+        CPointGrid * mpVertexGrid = NULL;
+        CKdTree *    mpVertexTree = NULL;
+        VertexInterpolator mVertexInterpolator;
     };
 
     template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
@@ -80,15 +196,20 @@ namespace MeshLib {
     void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::enterHalfedge(HalfEdgeType * pHe, VertexType * pV1)
     {
         VertexType * pV2 = (VertexType *)pHe->target();
-        pHe->he_sym() = vertexHalfedge(pV2, pV1);
+        touch(pHe);
+        pHe->he_sym() = findHalfedge(pV2, pV1);
 
-        HalfEdgeType * pHe12 = vertexHalfedge(pV1, pV2);
+        HalfEdgeType * pHe12 = findHalfedge(pV1, pV2);
         HalfEdgeType * pHes = (HalfEdgeType *)pHe->he_sym();
+        touch(pV1);
         pV1->outHEs().push_back(pHe);
+        if (mHEIndexValid && pHe12 == NULL) mHEIndex.insert(pV1->index(), pV2->index(), pHe);
 
         if (pHes) {
+            touch(pHes);
             pHes->he_sym() = pHe;
             EdgeType * pE = (EdgeType *)pHes->edge();
+            touch(pE);
             pHe->edge() = pE;
             pE->halfedge() = pHe;
         }
@@ -117,16 +238,20 @@ namespace MeshLib {
         EdgeType * pE = (EdgeType *)pHe->edge();
         HalfEdgeType * pHes = (HalfEdgeType *)pHe->he_sym();
         if (pHes) {
+            touch(pHes);
+            touch(pE);
             pHes->he_sym() = NULL;
             if (pE->halfedge() == pHe) { pE->halfedge() = pHes; }
         }
-        else {
-            pE->isremoved() = true;//0708
-            //deleteEdge(pE);
+        else if (pE->halfedge() == pHe) {
+            /* the last halfedge of the edge */
+            deleteEdge(pE);
         }
-        for (size_t i = 0; i < pV1->outHEs().size(); ++i)
-        {
-            if (pV1->outHEs()[i] == pHe) { pV1->outHEs().erase(i); };
+        eraseOutHalfedge(pV1, pHe);
+        if (mHEIndexValid && mHEIndex.erase(pV1->index(), pV2->index(), pHe)) {
+            /* a non manifold edge may have another halfedge from pV1 to pV2 */
+            HalfEdgeType * pHe12 = vertexHalfedge(pV1, pV2);
+            if (pHe12 != NULL) mHEIndex.insert(pV1->index(), pV2->index(), pHe12);
         }
 
     }
@@ -156,6 +281,9 @@ namespace MeshLib {
         HalfEdgeType * pHe2 = (HalfEdgeType *)pE->halfedge()->he_sym();
         VertexType * pVs = (VertexType *)pHe1->source();
         VertexType * pVt = (VertexType *)pHe1->target();
+        /* the vertices opposite to pE lose a face and may point to its halfedges */
+        VertexType * pVl = (VertexType *)pHe1->he_next()->target();
+        VertexType * pVr = pHe2 ? (VertexType *)pHe2->he_next()->target() : NULL;
 
         if (pHe1) { destoryFace(halfedgeFace(pHe1)); }
         if (pHe2) { destoryFace(halfedgeFace(pHe2)); }
@@ -171,11 +299,15 @@ namespace MeshLib {
         {
             removeHalfedge(pHe, (VertexType *)pHe->he_prev()->vertex());
             removeHalfedge((HalfEdgeType *)pHe->he_next(), (VertexType *)pHe->vertex());
+            touch(pHe);
             pHe->vertex() = pVs;
             enterHalfedge(pHe, (VertexType *)pHe->he_prev()->vertex());
             enterHalfedge((HalfEdgeType *)pHe->he_next(), (VertexType *)pHe->vertex());
         }
-        //deleteVertex(pVt);
+        removeVertex(pVt);
+        resetVertexHalfedge(pVs);
+        resetVertexHalfedge(pVl);
+        if (pVr) resetVertexHalfedge(pVr);
     }
 
     template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
@@ -204,6 +336,7 @@ namespace MeshLib {
             for (auto pHe : around_he)
             {
                 HalfEdgeType * boguspHe = newHalfEdge();
+                touch(pHe);
                 pHe->he_sym() = boguspHe;
                 destoryFace((FaceType *)pHe->face());
                 deleteHalfEdge(boguspHe);
@@ -221,11 +354,12 @@ namespace MeshLib {
             {
                 removeHalfedge(pHe, (VertexType *)pHe->he_prev()->vertex());
                 removeHalfedge((HalfEdgeType *)pHe->he_next(), (VertexType *)pHe->vertex());
+                touch(pHe);
                 pHe->vertex() = pVs;
                 enterHalfedge(pHe, (VertexType *)pHe->he_prev()->vertex());
                 enterHalfedge((HalfEdgeType *)pHe->he_next(), (VertexType *)pHe->vertex());
             }
-            //deleteVertex(pVt);
+            removeVertex(pVt);
         }
         else
         {
@@ -234,5 +368,936 @@ namespace MeshLib {
 
     }
 
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    VertexType * DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::addVertex(const CPoint & p)
+    {
+        VertexType * pV = createVertexWithIndex();
+        pV->point() = p;
+        if (mpVertexGrid) mpVertexGrid->insert((int)pV->index(), p);
+        if (mpVertexTree) mpVertexTree->insert((int)pV->index(), p);
+        return pV;
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::removeVertex(VertexType * pV)
+    {
+        if (mpVertexGrid) mpVertexGrid->remove((int)pV->index());
+        if (mpVertexTree) mpVertexTree->remove((int)pV->index());
+        /* the parallel collapses leave their stale entries to compact, the map can not be shared between threads */
+        if (!Parallel::inParallel())
+        {
+            auto it = mVMap.find(pV->id());
+            if (it != mVMap.end() && it->second == pV) mVMap.erase(it);
+        }
+        deleteVertex(pV);
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::moveVertex(VertexType * pV, const CPoint & p)
+    {
+        touch(pV);
+        pV->point() = p;
+        if (mpVertexGrid) mpVertexGrid->move((int)pV->index(), p);
+        if (mpVertexTree) mpVertexTree->move((int)pV->index(), p);
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    bool DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::isNeighbor(VertexType * pV, VertexType * pV1)
+    {
+        for (auto pHe : pV->outHEs())
+        {
+            if (pHe->target() == pV1) return true;
+            /* on the boundary one neighbour is only the source of an incoming halfedge */
+            HalfEdgeType * pHeIn = (HalfEdgeType *)pHe->he_prev();
+            if (pHeIn->he_sym() == NULL && pHeIn->source() == pV1) return true;
+        }
+        return false;
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::eraseOutHalfedge(VertexType * pV, HalfEdgeType * pH)
+    {
+        touch(pV);
+        auto & outHEs = pV->outHEs();
+        for (size_t i = 0; i < outHEs.size(); ++i)
+        {
+            if (outHEs[i] != pH) continue;
+            outHEs[i] = outHEs.back();
+            outHEs.pop_back();
+            return;
+        }
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::resetVertexHalfedge(VertexType * pV)
+    {
+        touch(pV);
+        for (auto pHe : pV->outHEs())
+        {
+            HalfEdgeType * pHeIn = (HalfEdgeType *)pHe->he_prev();
+            pV->halfedge() = pHeIn;
+            if (pHeIn->he_sym() == NULL) return;
+        }
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    bool DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::isCollapseOk(HalfEdgeType * pH)
+    {
+        HalfEdgeType * pS = (HalfEdgeType *)pH->he_sym();
+        VertexType * pV0 = (VertexType *)pH->source();
+        VertexType * pV1 = (VertexType *)pH->target();
+        VertexType * pVl = (VertexType *)pH->he_next()->target();
+        VertexType * pVr = pS ? (VertexType *)pS->he_next()->target() : NULL;
+        if (pVl == pVr) return false;
+
+        /* a face whose other two edges are on the boundary would be left dangling */
+        if (pH->he_next()->he_sym() == NULL && pH->he_prev()->he_sym() == NULL) return false;
+        if (pS && pS->he_next()->he_sym() == NULL && pS->he_prev()->he_sym() == NULL) return false;
+        /* an interior edge between two boundary vertices would pinch the surface */
+        if (pS && pV0->boundary() && pV1->boundary()) return false;
+        /* a tetrahedron would collapse to a doubled triangle */
+        if (pS && !pV0->boundary() && !pV1->boundary() && pV0->outHEs().size() == 3 && pV1->outHEs().size() == 3) return false;
+
+        /* link condition: the common neighbours are exactly the opposite vertices */
+        for (auto pHe : pV0->outHEs())
+        {
+            VertexType * pV = (VertexType *)pHe->target();
+            if (pV != pV1 && pV != pVl && pV != pVr && isNeighbor(pV1, pV)) return false;
+            HalfEdgeType * pHeIn = (HalfEdgeType *)pHe->he_prev();
+            pV = (VertexType *)pHeIn->source();
+            if (pHeIn->he_sym() == NULL && pV != pV1 && pV != pVl && pV != pVr && isNeighbor(pV1, pV)) return false;
+        }
+        return true;
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    typename VertexType * DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::collapseHalfedge(HalfEdgeType * pH)
+    {
+        HalfEdgeType * pS = (HalfEdgeType *)pH->he_sym();
+        VertexType * pV0 = (VertexType *)pH->source();
+        VertexType * pV1 = (VertexType *)pH->target();
+
+        /* face L = (v0, v1, vl): hn is v1 -> vl, hp is vl -> v0 */
+        HalfEdgeType * pHn = (HalfEdgeType *)pH->he_next();
+        HalfEdgeType * pHp = (HalfEdgeType *)pH->he_prev();
+        VertexType * pVl = (VertexType *)pHn->target();
+        HalfEdgeType * pA = (HalfEdgeType *)pHn->he_sym();
+        HalfEdgeType * pB = (HalfEdgeType *)pHp->he_sym();
+        EdgeType * pEl = (EdgeType *)pHn->edge();
+        /* face R = (v1, v0, vr): on is v0 -> vr, op is vr -> v1 */
+        HalfEdgeType * pOn = pS ? (HalfEdgeType *)pS->he_next() : NULL;
+        HalfEdgeType * pOp = pS ? (HalfEdgeType *)pS->he_prev() : NULL;
+        VertexType * pVr = pS ? (VertexType *)pOn->target() : NULL;
+        HalfEdgeType * pC = pS ? (HalfEdgeType *)pOn->he_sym() : NULL;
+        HalfEdgeType * pD = pS ? (HalfEdgeType *)pOp->he_sym() : NULL;
+        EdgeType * pEr = pS ? (EdgeType *)pOp->edge() : NULL;
+        const bool boundary = pV0->boundary() || pV1->boundary();
+        touch(pV1);
+        if (pA) touch(pA);
+        if (pB) touch(pB);
+        touch(pEl);
+        if (pC) touch(pC);
+        if (pD) touch(pD);
+        if (pEr) touch(pEr);
+
+        /* the halfedges of v0 that are kept, they are moved to v1 */
+        std::vector<HalfEdgeType *> moved;
+        for (auto pHe : pV0->outHEs())
+        {
+            if (pHe == pH || pHe == pOn) continue;
+            moved.push_back((HalfEdgeType *)pHe);
+            if (mHEIndexValid)
+            {
+                mHEIndex.erase(pV0->index(), pHe->target()->index(), (HalfEdgeType *)pHe);
+                mHEIndex.erase(pHe->he_prev()->source()->index(), pV0->index(), (HalfEdgeType *)pHe->he_prev());
+            }
+        }
+
+        eraseOutHalfedge(pV1, pHn);
+        eraseOutHalfedge(pVl, pHp);
+        deleteEdge((EdgeType *)pH->edge());
+        deleteEdge((EdgeType *)pHp->edge());
+        deleteFace((FaceType *)pH->face());
+        deleteHalfEdge(pH);
+        deleteHalfEdge(pHn);
+        deleteHalfEdge(pHp);
+        if (pS)
+        {
+            eraseOutHalfedge(pV1, pS);
+            eraseOutHalfedge(pVr, pOp);
+            deleteEdge((EdgeType *)pOn->edge());
+            deleteFace((FaceType *)pS->face());
+            deleteHalfEdge(pS);
+            deleteHalfEdge(pOn);
+            deleteHalfEdge(pOp);
+        }
+
+        /* glue the outer halfedges of each deleted face, keeping the edge v1 - vl and v1 - vr */
+        if (pA) { pA->he_sym() = pB; pA->edge() = pEl; }
+        if (pB) { pB->he_sym() = pA; pB->edge() = pEl; }
+        pEl->halfedge() = pA ? pA : pB;
+        if (pS)
+        {
+            if (pC) { pC->he_sym() = pD; pC->edge() = pEr; }
+            if (pD) { pD->he_sym() = pC; pD->edge() = pEr; }
+            pEr->halfedge() = pD ? pD : pC;
+        }
+
+        for (HalfEdgeType * pHe : moved)
+        {
+            HalfEdgeType * pHeIn = (HalfEdgeType *)pHe->he_prev();
+            touch(pHeIn);
+            pHeIn->vertex() = pV1;
+            pV1->outHEs().push_back(pHe);
+            if (mHEIndexValid)
+            {
+                mHEIndex.insert(pV1->index(), pHe->target()->index(), pHe);
+                mHEIndex.insert(pHeIn->source()->index(), pV1->index(), pHeIn);
+            }
+        }
+        removeVertex(pV0);
+
+        pV1->boundary() = boundary;
+        resetVertexHalfedge(pV1);
+        resetVertexHalfedge(pVl);
+        if (pVr) resetVertexHalfedge(pVr);
+        assert(isManifold(pV1) && isManifold(pVl) && (pVr == NULL || isManifold(pVr)));
+        return pV1;
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    typename VertexType * DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::splitVertex(VertexType * pV1, VertexType * pVl, VertexType * pVr, const CPoint & p)
+    {
+        /* named after collapseHalfedge: the new vertex v0 gets the faces L = (v0, v1, vl) and R = (v1, v0, vr); A and B are
+        vl -> v1 and v1 -> vl, C and D are vr -> v1 and v1 -> vr, B and C going to v0 */
+        HalfEdgeType * pA = vertexHalfedge(pVl, pV1);
+        HalfEdgeType * pB = vertexHalfedge(pV1, pVl);
+        HalfEdgeType * pC = pVr ? vertexHalfedge(pVr, pV1) : NULL;
+        HalfEdgeType * pD = pVr ? vertexHalfedge(pV1, pVr) : NULL;
+        EdgeType * pEl = (EdgeType *)(pA ? pA : pB)->edge();
+        EdgeType * pEr = pVr ? (EdgeType *)(pD ? pD : pC)->edge() : NULL;
+        FaceType * pFlNext = (FaceType *)(pA ? pA : pB)->face();
+        FaceType * pFrNext = pVr ? (FaceType *)(pD ? pD : pC)->face() : NULL;
+
+        /* the halfedges of v1 going to v0: from B turning ccw up to D, or up to the next of C when there is no D; if the
+        boundary comes first, the rest from the next of C turning cw up to the boundary */
+        std::vector<HalfEdgeType *> moved;
+        const size_t valence = pV1->outHEs().size();
+        HalfEdgeType * pHe = pB;
+        while (pHe != NULL && pHe != pD && moved.size() < valence)
+        {
+            moved.push_back(pHe);
+            pHe = (HalfEdgeType *)pHe->he_prev()->he_sym();
+        }
+        if (pHe == NULL && pC != NULL && (moved.empty() || moved.back()->he_prev() != pC))
+        {
+            for (pHe = (HalfEdgeType *)pC->he_next(); moved.size() < valence; pHe = (HalfEdgeType *)pHe->he_sym()->he_next())
+            {
+                moved.push_back(pHe);
+                if (pHe->he_sym() == NULL) break;
+            }
+        }
+
+        touch(pV1);
+        touch(pVl);
+        if (pVr) touch(pVr);
+        for (HalfEdgeType * pHe : { pA, pB, pC, pD }) if (pHe) touch(pHe);
+        touch(pEl);
+        if (pEr) touch(pEr);
+        for (HalfEdgeType * pHe : moved)
+        {
+            touch(pHe);
+            touch((HalfEdgeType *)pHe->he_prev());
+            unindexHalfedge(pHe);
+            unindexHalfedge((HalfEdgeType *)pHe->he_prev());
+        }
+
+        VertexType * pV0 = addVertex(p);
+        copyProps(mVProps, pV1->index(), pV0->index());
+        for (HalfEdgeType * pHe : moved)
+        {
+            ((HalfEdgeType *)pHe->he_prev())->vertex() = pV0;
+            eraseOutHalfedge(pV1, pHe);
+            pV0->outHEs().push_back(pHe);
+        }
+
+        /* face L, the edge v0 - v1 and the edge v0 - vl, shared with B */
+        FaceType * pFl = newFace();
+        pFl->id() = (int)pFl->index();
+        copyProps(mFProps, pFlNext->index(), pFl->index());
+        HalfEdgeType * pH = newHalfEdge();
+        HalfEdgeType * pHn = newHalfEdge();
+        HalfEdgeType * pHp = newHalfEdge();
+        EdgeType * pE01 = newEdge();
+        copyProps(mEProps, pEl->index(), pE01->index());
+        EdgeType * pEl0 = newEdge();
+        copyProps(mEProps, pEl->index(), pEl0->index());
+        pH->vertex() = pV1; pHn->vertex() = pVl; pHp->vertex() = pV0;
+        pH->he_next() = pHn; pHn->he_next() = pHp; pHp->he_next() = pH;
+        pH->he_prev() = pHp; pHn->he_prev() = pH; pHp->he_prev() = pHn;
+        pH->face() = pFl; pHn->face() = pFl; pHp->face() = pFl;
+        pFl->halfedge() = pH;
+        pH->edge() = pE01;
+        pE01->halfedge() = pH;
+        pHn->he_sym() = pA;
+        if (pA) pA->he_sym() = pHn;
+        pHn->edge() = pEl;
+        pEl->halfedge() = pA ? pA : pHn;
+        pHp->he_sym() = pB;
+        if (pB) { pB->he_sym() = pHp; pB->edge() = pEl0; }
+        pHp->edge() = pEl0;
+        pEl0->halfedge() = pHp;
+        pV0->outHEs().push_back(pH);
+        pV1->outHEs().push_back(pHn);
+        pVl->outHEs().push_back(pHp);
+
+        HalfEdgeType * pS = NULL, * pOn = NULL, * pOp = NULL;
+        if (pVr)
+        {
+            /* face R and the edge v0 - vr, shared with C */
+            FaceType * pFr = newFace();
+            pFr->id() = (int)pFr->index();
+            copyProps(mFProps, pFrNext->index(), pFr->index());
+            pS = newHalfEdge();
+            pOn = newHalfEdge();
+            pOp = newHalfEdge();
+            EdgeType * pEr0 = newEdge();
+            copyProps(mEProps, pEr->index(), pEr0->index());
+            pS->vertex() = pV0; pOn->vertex() = pVr; pOp->vertex() = pV1;
+            pS->he_next() = pOn; pOn->he_next() = pOp; pOp->he_next() = pS;
+            pS->he_prev() = pOp; pOn->he_prev() = pS; pOp->he_prev() = pOn;
+            pS->face() = pFr; pOn->face() = pFr; pOp->face() = pFr;
+            pFr->halfedge() = pS;
+            pS->edge() = pE01;
+            pS->he_sym() = pH; pH->he_sym() = pS;
+            pOp->he_sym() = pD;
+            if (pD) pD->he_sym() = pOp;
+            pOp->edge() = pEr;
+            pEr->halfedge() = pD ? pD : pOp;
+            pOn->he_sym() = pC;
+            if (pC) { pC->he_sym() = pOn; pC->edge() = pEr0; }
+            pOn->edge() = pEr0;
+            pEr0->halfedge() = pOn;
+            pV1->outHEs().push_back(pS);
+            pV0->outHEs().push_back(pOn);
+            pVr->outHEs().push_back(pOp);
+        }
+
+        for (HalfEdgeType * pHe : moved)
+        {
+            indexHalfedge(pHe);
+            indexHalfedge((HalfEdgeType *)pHe->he_prev());
+        }
+        for (HalfEdgeType * pHe : { pH, pHn, pHp, pS, pOn, pOp }) if (pHe) indexHalfedge(pHe);
+
+        resetVertexHalfedge(pV0);
+        resetVertexHalfedge(pV1);
+        resetVertexHalfedge(pVl);
+        if (pVr) resetVertexHalfedge(pVr);
+        pV0->boundary() = pV0->halfedge()->he_sym() == NULL;
+        pV1->boundary() = pV1->halfedge()->he_sym() == NULL;
+        assert(isManifold(pV0) && isManifold(pV1) && isManifold(pVl) && (pVr == NULL || isManifold(pVr)));
+        return pV0;
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    bool DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::isFlipOk(EdgeType * pE)
+    {
+        HalfEdgeType * pH = (HalfEdgeType *)pE->halfedge();
+        HalfEdgeType * pS = (HalfEdgeType *)pH->he_sym();
+        if (pS == NULL) return false;
+        VertexType * pVc = (VertexType *)pH->he_next()->target();
+        VertexType * pVd = (VertexType *)pS->he_next()->target();
+        /* a vertex of valence 3 has its opposite vertices adjacent, so it is rejected here too */
+        return pVc != pVd && !isNeighbor(pVc, pVd);
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::flipEdge(EdgeType * pE)
+    {
+        /* faces (a, b, c) and (b, a, d) become (c, a, d) and (d, b, c), h turning from a -> b into d -> c */
+        HalfEdgeType * pH = (HalfEdgeType *)pE->halfedge();
+        HalfEdgeType * pHn = (HalfEdgeType *)pH->he_next();
+        HalfEdgeType * pHp = (HalfEdgeType *)pH->he_prev();
+        HalfEdgeType * pS = (HalfEdgeType *)pH->he_sym();
+        HalfEdgeType * pSn = (HalfEdgeType *)pS->he_next();
+        HalfEdgeType * pSp = (HalfEdgeType *)pS->he_prev();
+        VertexType * pVa = (VertexType *)pS->target();
+        VertexType * pVb = (VertexType *)pH->target();
+        VertexType * pVc = (VertexType *)pHn->target();
+        VertexType * pVd = (VertexType *)pSn->target();
+        FaceType * pF0 = (FaceType *)pH->face();
+        FaceType * pF1 = (FaceType *)pS->face();
+        for (HalfEdgeType * pHe : { pH, pHn, pHp, pS, pSn, pSp }) touch(pHe);
+        for (VertexType * pV : { pVa, pVb, pVc, pVd }) touch(pV);
+        touch(pF0);
+        touch(pF1);
+
+        unindexHalfedge(pH);
+        unindexHalfedge(pS);
+        eraseOutHalfedge(pVa, pH);
+        eraseOutHalfedge(pVb, pS);
+        pVd->outHEs().push_back(pH);
+        pVc->outHEs().push_back(pS);
+        pH->vertex() = pVc;
+        pS->vertex() = pVd;
+
+        pHp->he_next() = pSn; pSn->he_next() = pH; pH->he_next() = pHp;
+        pHp->he_prev() = pH; pSn->he_prev() = pHp; pH->he_prev() = pSn;
+        pSp->he_next() = pHn; pHn->he_next() = pS; pS->he_next() = pSp;
+        pSp->he_prev() = pS; pHn->he_prev() = pSp; pS->he_prev() = pHn;
+        pSn->face() = pF0;
+        pHn->face() = pF1;
+        pF0->halfedge() = pH;
+        pF1->halfedge() = pS;
+        indexHalfedge(pH);
+        indexHalfedge(pS);
+
+        /* the boundary halfedge of a or b, if any, is not one of the flipped edge */
+        if (pVa->halfedge() == pS) pVa->halfedge() = pHp;
+        if (pVb->halfedge() == pH) pVb->halfedge() = pSp;
+        assert(isManifold(pVa) && isManifold(pVb) && isManifold(pVc) && isManifold(pVd));
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    typename VertexType * DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::splitEdge(EdgeType * pE, const CPoint & p)
+    {
+        /* face (a, b, c) becomes (a, m, c) and (m, b, c), face (b, a, d) becomes (m, a, d) and (b, m, d);
+        h turns from a -> b into a -> m and its sym from b -> a into m -> a */
+        HalfEdgeType * pH = (HalfEdgeType *)pE->halfedge();
+        HalfEdgeType * pHn = (HalfEdgeType *)pH->he_next();
+        HalfEdgeType * pHp = (HalfEdgeType *)pH->he_prev();
+        HalfEdgeType * pS = (HalfEdgeType *)pH->he_sym();
+        VertexType * pVa = (VertexType *)pH->source();
+        VertexType * pVb = (VertexType *)pH->target();
+        VertexType * pVc = (VertexType *)pHn->target();
+        FaceType * pF0 = (FaceType *)pH->face();
+        for (HalfEdgeType * pHe : { pH, pHn, pHp }) touch(pHe);
+        touch(pVb);
+        touch(pVc);
+        touch(pF0);
+
+        VertexType * pVm = addVertex(p);
+        pVm->boundary() = pS == NULL;
+        VertexType * pVs[2] = { pVa, pVb };
+        const CPoint ab = pVb->point() - pVa->point();
+        const double len2 = ab * ab;
+        double t = len2 > 0 ? ((p - pVa->point()) * ab) / len2 : 0.5;
+        t = t < 0 ? 0 : (t > 1 ? 1 : t);
+        const double weights[2] = { 1 - t, t };
+        interpolateVertex(pVm, pVs, weights, 2);
+
+        unindexHalfedge(pH);
+        if (pS) unindexHalfedge(pS);
+
+        /* the half m - b of pE */
+        EdgeType * pEmb = newEdge();
+        copyProps(mEProps, pE->index(), pEmb->index());
+        HalfEdgeType * pT = newHalfEdge();
+        copyProps(mHEProps, pH->index(), pT->index());
+        pEmb->halfedge() = pT;
+        pT->edge() = pEmb;
+
+        /* face (m, b, c) and the edge m - c */
+        FaceType * pF2 = newFace();
+        pF2->id() = (int)pF2->index();
+        copyProps(mFProps, pF0->index(), pF2->index());
+        EdgeType * pEmc = newEdge();
+        HalfEdgeType * pMc = newHalfEdge();
+        HalfEdgeType * pCm = newHalfEdge();
+        pEmc->halfedge() = pMc;
+        pMc->edge() = pEmc; pCm->edge() = pEmc;
+        pMc->he_sym() = pCm; pCm->he_sym() = pMc;
+
+        pH->vertex() = pVm;
+        pMc->vertex() = pVc;
+        pCm->vertex() = pVm;
+        pT->vertex() = pVb;
+        pH->he_next() = pMc; pMc->he_next() = pHp; pHp->he_next() = pH;
+        pH->he_prev() = pHp; pMc->he_prev() = pH; pHp->he_prev() = pMc;
+        pT->he_next() = pHn; pHn->he_next() = pCm; pCm->he_next() = pT;
+        pT->he_prev() = pCm; pHn->he_prev() = pT; pCm->he_prev() = pHn;
+        pMc->face() = pF0;
+        pT->face() = pF2; pHn->face() = pF2; pCm->face() = pF2;
+        pF0->halfedge() = pH;
+        pF2->halfedge() = pT;
+        pVm->outHEs().push_back(pT);
+        pVm->outHEs().push_back(pMc);
+        pVc->outHEs().push_back(pCm);
+        pVm->halfedge() = pH;
+        if (pVb->halfedge() == pH) pVb->halfedge() = pT;
+
+        if (pS)
+        {
+            HalfEdgeType * pSn = (HalfEdgeType *)pS->he_next();
+            HalfEdgeType * pSp = (HalfEdgeType *)pS->he_prev();
+            VertexType * pVd = (VertexType *)pSn->target();
+            FaceType * pF1 = (FaceType *)pS->face();
+            for (HalfEdgeType * pHe : { pS, pSn, pSp }) touch(pHe);
+            touch(pVd);
+            touch(pF1);
+
+            HalfEdgeType * pU = newHalfEdge();
+            copyProps(mHEProps, pS->index(), pU->index());
+            pU->edge() = pEmb;
+            pU->he_sym() = pT; pT->he_sym() = pU;
+
+            /* face (b, m, d) and the edge m - d */
+            FaceType * pF3 = newFace();
+            pF3->id() = (int)pF3->index();
+            copyProps(mFProps, pF1->index(), pF3->index());
+            EdgeType * pEmd = newEdge();
+            HalfEdgeType * pMd = newHalfEdge();
+            HalfEdgeType * pDm = newHalfEdge();
+            pEmd->halfedge() = pMd;
+            pMd->edge() = pEmd; pDm->edge() = pEmd;
+            pMd->he_sym() = pDm; pDm->he_sym() = pMd;
+
+            pU->vertex() = pVm;
+            pMd->vertex() = pVd;
+            pDm->vertex() = pVm;
+            pS->he_next() = pSn; pSn->he_next() = pDm; pDm->he_next() = pS;
+            pS->he_prev() = pDm; pSn->he_prev() = pS; pDm->he_prev() = pSn;
+            pU->he_next() = pMd; pMd->he_next() = pSp; pSp->he_next() = pU;
+            pU->he_prev() = pSp; pMd->he_prev() = pU; pSp->he_prev() = pMd;
+            pDm->face() = pF1;
+            pU->face() = pF3; pMd->face() = pF3; pSp->face() = pF3;
+            pF1->halfedge() = pS;
+            pF3->halfedge() = pU;
+            eraseOutHalfedge(pVb, pS);
+            pVb->outHEs().push_back(pU);
+            pVm->outHEs().push_back(pS);
+            pVm->outHEs().push_back(pMd);
+            pVd->outHEs().push_back(pDm);
+
+            indexHalfedge(pS);
+            indexHalfedge(pU);
+            indexHalfedge(pMd);
+            indexHalfedge(pDm);
+            assert(isManifold(pVd));
+        }
+        indexHalfedge(pH);
+        indexHalfedge(pT);
+        indexHalfedge(pMc);
+        indexHalfedge(pCm);
+        assert(isManifold(pVa) && isManifold(pVb) && isManifold(pVc) && isManifold(pVm));
+        return pVm;
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    typename VertexType * DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::splitFace(FaceType * pF, const CPoint & p)
+    {
+        HalfEdgeType * pHs[3];
+        VertexType * pVs[3];
+        pHs[0] = (HalfEdgeType *)pF->halfedge();
+        pHs[1] = (HalfEdgeType *)pHs[0]->he_next();
+        pHs[2] = (HalfEdgeType *)pHs[1]->he_next();
+        for (int i = 0; i < 3; ++i) pVs[i] = (VertexType *)pHs[i]->source();
+        for (int i = 0; i < 3; ++i)
+        {
+            touch(pHs[i]);
+            touch(pVs[i]);
+        }
+        touch(pF);
+
+        /* barycentric weights from the areas of the sub triangles */
+        double weights[3], sum = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            weights[i] = ((pVs[(i + 1) % 3]->point() - p) ^ (pVs[(i + 2) % 3]->point() - p)).norm();
+            sum += weights[i];
+        }
+        for (int i = 0; i < 3; ++i) weights[i] = sum > 0 ? weights[i] / sum : 1.0 / 3;
+        VertexType * pVm = addVertex(p);
+        pVm->boundary() = false;
+        interpolateVertex(pVm, pVs, weights, 3);
+
+        /* face i is (v_i, v_i+1, m): hs[i], in[i] from v_i+1 to m and out[i] from m to v_i */
+        FaceType * pFs[3] = { pF, newFace(), newFace() };
+        HalfEdgeType * pIns[3], * pOuts[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            if (i > 0)
+            {
+                pFs[i]->id() = (int)pFs[i]->index();
+                copyProps(mFProps, pF->index(), pFs[i]->index());
+            }
+            pIns[i] = newHalfEdge();
+            pOuts[i] = newHalfEdge();
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            /* the edge v_i - m is shared by out[i] and in[i - 1] */
+            EdgeType * pEi = newEdge();
+            HalfEdgeType * pIn = pIns[(i + 2) % 3];
+            pEi->halfedge() = pOuts[i];
+            pOuts[i]->edge() = pEi; pIn->edge() = pEi;
+            pOuts[i]->he_sym() = pIn; pIn->he_sym() = pOuts[i];
+
+            pIns[i]->vertex() = pVm;
+            pOuts[i]->vertex() = pVs[i];
+            pHs[i]->he_next() = pIns[i]; pIns[i]->he_next() = pOuts[i]; pOuts[i]->he_next() = pHs[i];
+            pHs[i]->he_prev() = pOuts[i]; pIns[i]->he_prev() = pHs[i]; pOuts[i]->he_prev() = pIns[i];
+            pHs[i]->face() = pFs[i]; pIns[i]->face() = pFs[i]; pOuts[i]->face() = pFs[i];
+            pFs[i]->halfedge() = pHs[i];
+            pVs[(i + 1) % 3]->outHEs().push_back(pIns[i]);
+            pVm->outHEs().push_back(pOuts[i]);
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            indexHalfedge(pIns[i]);
+            indexHalfedge(pOuts[i]);
+        }
+        pVm->halfedge() = pIns[0];
+        assert(isManifold(pVs[0]) && isManifold(pVs[1]) && isManifold(pVs[2]) && isManifold(pVm));
+        return pVm;
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::addFaces(const std::vector<VertexType *> & corners,
+        const std::vector<int> & twins, const std::vector<HalfEdgeType *> & borders, std::vector<FaceType *> * pFaces)
+    {
+        const int numHEs = (int)corners.size();
+        const int numFaces = numHEs / 3;
+        /* a new edge for each halfedge left on the boundary or paired with a later one of the list */
+        std::vector<int> edgeIds(numHEs);
+#pragma omp parallel for
+        for (int h = 0; h < numHEs; ++h)
+        {
+            edgeIds[h] = twins[h] < 0 ? (borders[h] == NULL ? 1 : 0) : (h < twins[h] ? 1 : 0);
+        }
+        const int numEdges = Parallel::exclusiveScan(edgeIds);
+
+        /* the pools may hand out deleted slots, so the members are kept by their position in the list and every
+        field is set, then they are linked in parallel */
+        std::vector<FaceType *> faces(numFaces);
+        std::vector<HalfEdgeType *> halfedges(numHEs);
+        std::vector<EdgeType *> edges(numEdges);
+        for (int f = 0; f < numFaces; ++f) faces[f] = newFace();
+        for (int h = 0; h < numHEs; ++h) halfedges[h] = newHalfEdge();
+        for (int e = 0; e < numEdges; ++e) edges[e] = newEdge();
+
+#pragma omp parallel for
+        for (int f = 0; f < numFaces; ++f)
+        {
+            faces[f]->id() = (int)faces[f]->index();
+            /* like createFace, the face points to the halfedge ending at its first vertex */
+            faces[f]->halfedge() = halfedges[3 * f + 2];
+        }
+#pragma omp parallel for
+        for (int h = 0; h < numHEs; ++h)
+        {
+            const int f = h / 3, k = h % 3;
+            HalfEdgeType * pH = halfedges[h];
+            pH->vertex() = corners[3 * f + (k + 1) % 3];
+            pH->face() = faces[f];
+            pH->he_next() = halfedges[3 * f + (k + 1) % 3];
+            pH->he_prev() = halfedges[3 * f + (k + 2) % 3];
+            if (twins[h] >= 0)
+            {
+                const bool first = h < twins[h];
+                pH->he_sym() = halfedges[twins[h]];
+                pH->edge() = edges[edgeIds[first ? h : twins[h]]];
+                if (first) pH->edge()->halfedge() = pH;
+            }
+            else if (borders[h] != NULL)
+            {
+                HalfEdgeType * pB = borders[h];
+                touch(pB);
+                pB->he_sym() = pH;
+                pH->he_sym() = pB;
+                pH->edge() = pB->edge();
+            }
+            else
+            {
+                pH->he_sym() = NULL;
+                pH->edge() = edges[edgeIds[h]];
+                pH->edge()->halfedge() = pH;
+            }
+        }
+
+        /* the fans are shared between the faces, they are updated one halfedge at a time */
+        for (int h = 0; h < numHEs; ++h)
+        {
+            HalfEdgeType * pH = halfedges[h];
+            VertexType * pV = (VertexType *)pH->source();
+            touch(pV);
+            pV->outHEs().push_back(pH);
+            indexHalfedge(pH);
+        }
+        for (int h = 0; h < numHEs; ++h)
+        {
+            VertexType * pV = corners[h];
+            resetVertexHalfedge(pV);
+            pV->boundary() = pV->halfedge()->he_sym() == NULL;
+        }
+        if (pFaces) pFaces->insert(pFaces->end(), faces.begin(), faces.end());
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    bool DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::isManifold(VertexType * pV)
+    {
+        const size_t valence = pV->outHEs().size();
+        HalfEdgeType * pHeIn = (HalfEdgeType *)pV->halfedge();
+        if (valence == 0) return pHeIn == NULL;
+        if (pHeIn == NULL || pHeIn->target() != pV) return false;
+        /* turn around pV from its halfedge: an open fan has to be walked from its boundary end */
+        size_t numFaces = 0;
+        HalfEdgeType * pHe = pHeIn;
+        do {
+            ++numFaces;
+            pHe = (HalfEdgeType *)pHe->he_next()->he_sym();
+        } while (pHe != NULL && pHe != pHeIn && numFaces <= valence);
+        if (pHe == NULL && pHeIn->he_sym() != NULL) return false;
+        return numFaces == valence;
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::copyProps(Props & props, size_t from, size_t to)
+    {
+        for (BasicPropHandle * pProp : props) pProp->movePropMember(from, to);
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::interpolateVertex(VertexType * pV, VertexType * const * pVs, const double * weights, int n)
+    {
+        int heaviest = 0;
+        for (int i = 1; i < n; ++i) if (weights[i] > weights[heaviest]) heaviest = i;
+        copyProps(mVProps, pVs[heaviest]->index(), pV->index());
+        if (mVertexInterpolator) mVertexInterpolator(pV, pVs, weights, n);
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::unindexHalfedge(HalfEdgeType * pH)
+    {
+        if (mHEIndexValid) mHEIndex.erase(pH->source()->index(), pH->target()->index(), pH);
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::indexHalfedge(HalfEdgeType * pH)
+    {
+        if (mHEIndexValid) mHEIndex.insert(pH->source()->index(), pH->target()->index(), pH);
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    template<typename Container>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::compactPool(Container & container, Props & props, const std::vector<int> & indices)
+    {
+        for (BasicPropHandle * pProp : props)
+        {
+            for (size_t i = 0; i < indices.size(); ++i)
+            {
+                if (indices[i] >= 0 && indices[i] != (int)i) pProp->movePropMember(i, indices[i]);
+            }
+        }
+        container.compact(indices);
+        const int n = (int)container.getCurrentIndex();
+#pragma omp parallel for
+        for (int i = 0; i < n; ++i) container.getPointer(i)->index() = i;
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::compact()
+    {
+        /* the journal is by index */
+        commit();
+        std::vector<int> vIndices, eIndices, fIndices, heIndices;
+        mVContainer.compactIndices(vIndices);
+        mEContainer.compactIndices(eIndices);
+        mFContainer.compactIndices(fIndices);
+        mHEContainer.compactIndices(heIndices);
+        auto newV = [&](VertexType * pV) { return (VertexType *)mVContainer.getPointer(vIndices[pV->index()]); };
+        auto newE = [&](EdgeType * pE) { return (EdgeType *)mEContainer.getPointer(eIndices[pE->index()]); };
+        auto newF = [&](FaceType * pF) { return (FaceType *)mFContainer.getPointer(fIndices[pF->index()]); };
+        auto newHE = [&](HalfEdgeType * pHe) { return pHe ? (HalfEdgeType *)mHEContainer.getPointer(heIndices[pHe->index()]) : NULL; };
+
+        /* point to the new places while everything is still at the old ones */
+        const int numV = (int)vIndices.size(), numE = (int)eIndices.size(), numF = (int)fIndices.size(), numHE = (int)heIndices.size();
+#pragma omp parallel for
+        for (int i = 0; i < numHE; ++i)
+        {
+            if (heIndices[i] < 0) continue;
+            HalfEdgeType * pHe = mHEContainer.getPointer(i);
+            pHe->vertex() = newV((VertexType *)pHe->vertex());
+            pHe->edge() = newE((EdgeType *)pHe->edge());
+            pHe->face() = newF((FaceType *)pHe->face());
+            pHe->he_next() = newHE((HalfEdgeType *)pHe->he_next());
+            pHe->he_prev() = newHE((HalfEdgeType *)pHe->he_prev());
+            pHe->he_sym() = newHE((HalfEdgeType *)pHe->he_sym());
+        }
+#pragma omp parallel for
+        for (int i = 0; i < numV; ++i)
+        {
+            if (vIndices[i] < 0) continue;
+            VertexType * pV = mVContainer.getPointer(i);
+            pV->halfedge() = newHE((HalfEdgeType *)pV->halfedge());
+            for (auto & pHe : pV->outHEs()) pHe = newHE((HalfEdgeType *)pHe);
+        }
+#pragma omp parallel for
+        for (int i = 0; i < numE; ++i)
+        {
+            if (eIndices[i] >= 0) mEContainer.getPointer(i)->halfedge() = newHE((HalfEdgeType *)mEContainer.getPointer(i)->halfedge());
+        }
+#pragma omp parallel for
+        for (int i = 0; i < numF; ++i)
+        {
+            if (fIndices[i] >= 0) mFContainer.getPointer(i)->halfedge() = newHE((HalfEdgeType *)mFContainer.getPointer(i)->halfedge());
+        }
+        for (auto it = mVMap.begin(); it != mVMap.end();)
+        {
+            if (mVContainer.hasBeenDeleted(it->second->index())) it = mVMap.erase(it);
+            else { it->second = newV(it->second); ++it; }
+        }
+        for (auto it = mFIdMap.begin(); it != mFIdMap.end();)
+        {
+            if (mFContainer.hasBeenDeleted(it->second->index())) it = mFIdMap.erase(it);
+            else { it->second = newF(it->second); ++it; }
+        }
+
+        /* then move the elements, and their props */
+        compactPool(mVContainer, mVProps, vIndices);
+        compactPool(mEContainer, mEProps, eIndices);
+        compactPool(mFContainer, mFProps, fIndices);
+        compactPool(mHEContainer, mHEProps, heIndices);
+
+        invalidateVertexPairIndex();
+        if (mpVertexGrid) mpVertexGrid->buildVertices(mVContainer, [](VertexType * pV) { return pV->point(); }, mpVertexGrid->cellSize());
+        if (mpVertexTree) mpVertexTree->buildVertices(mVContainer, [](VertexType * pV) { return pV->point(); });
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    size_t DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::savepoint()
+    {
+        if (!mJournal.active())
+        {
+            mJournal.open();
+            mVContainer.setReuseDeleted(false);
+            mEContainer.setReuseDeleted(false);
+            mFContainer.setReuseDeleted(false);
+            mHEContainer.setReuseDeleted(false);
+        }
+        mJournal.mark(mVContainer.getCurrentIndex(), mEContainer.getCurrentIndex(), mFContainer.getCurrentIndex(), mHEContainer.getCurrentIndex());
+        return mJournal.records.size();
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    template<typename Container, typename Element>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::undoRecord(Container & container, const std::vector<Element> & images, const typename CEditJournal<VertexType, EdgeType, FaceType, HalfEdgeType>::Record & r)
+    {
+        typedef CEditJournal<VertexType, EdgeType, FaceType, HalfEdgeType> Journal;
+        if (r.op == Journal::Create)
+        {
+            assert(r.index + 1 == container.getCurrentIndex());
+            container.popMember();
+        }
+        else if (r.op == Journal::Delete) container.restoreMember(r.index);
+        else *container.getPointer(r.index) = images[r.image];
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::rollback(size_t mark)
+    {
+        typedef CEditJournal<VertexType, EdgeType, FaceType, HalfEdgeType> Journal;
+        if (!mJournal.active()) return;
+        std::vector<typename Journal::Record> & records = mJournal.records;
+        assert(mark <= records.size());
+
+        /* the ends of a halfedge change with itself or with its prev, of which it is the next: the journaled halfedges
+        and their nexts leave the vertex pair index before the undo, and come back after */
+        if (mHEIndexValid)
+        {
+            for (size_t i = mark; i < records.size(); ++i)
+            {
+                const typename Journal::Record & r = records[i];
+                if (r.kind != Journal::HalfEdge || mHEContainer.hasBeenDeleted(r.index)) continue;
+                HalfEdgeType * pH = mHEContainer.getPointer(r.index);
+                if (pH->he_prev() == NULL) continue;
+                unindexHalfedge(pH);
+                unindexHalfedge((HalfEdgeType *)pH->he_next());
+            }
+        }
+
+        size_t numImages[4] = { mJournal.vertexImages.size(), mJournal.edgeImages.size(), mJournal.faceImages.size(), mJournal.halfedgeImages.size() };
+        for (size_t i = records.size(); i-- > mark;)
+        {
+            const typename Journal::Record & r = records[i];
+            if (r.op == Journal::Modify) numImages[r.kind] = r.image;
+            switch (r.kind)
+            {
+            case Journal::Vertex:
+                if (r.op == Journal::Create)
+                {
+                    VertexType * pV = mVContainer.getPointer(r.index);
+                    auto it = mVMap.find(pV->id());
+                    if (it != mVMap.end() && it->second == pV) mVMap.erase(it);
+                }
+                else if (r.op == Journal::Delete)
+                {
+                    /* removeVertex took it out of the id map */
+                    VertexType * pV = mVContainer.getPointer(r.index);
+                    mVMap.insert(std::make_pair(pV->id(), pV));
+                }
+                undoRecord(mVContainer, mJournal.vertexImages, r);
+                break;
+            case Journal::Edge:
+                undoRecord(mEContainer, mJournal.edgeImages, r);
+                break;
+            case Journal::Face:
+                undoRecord(mFContainer, mJournal.faceImages, r);
+                break;
+            case Journal::HalfEdge:
+                undoRecord(mHEContainer, mJournal.halfedgeImages, r);
+                break;
+            }
+        }
+
+        for (size_t i = mark; i < records.size(); ++i)
+        {
+            const typename Journal::Record & r = records[i];
+            if (r.kind == Journal::HalfEdge && mHEIndexValid)
+            {
+                if (r.index >= mHEContainer.getCurrentIndex() || mHEContainer.hasBeenDeleted(r.index)) continue;
+                HalfEdgeType * pH = mHEContainer.getPointer(r.index);
+                if (pH->he_prev() == NULL) continue;
+                indexHalfedge(pH);
+                indexHalfedge((HalfEdgeType *)pH->he_next());
+            }
+            else if (r.kind == Journal::Vertex && (mpVertexGrid || mpVertexTree))
+            {
+                const int id = (int)r.index;
+                if (r.index < mVContainer.getCurrentIndex() && !mVContainer.hasBeenDeleted(r.index))
+                {
+                    const CPoint & p = mVContainer.getPointer(r.index)->point();
+                    if (mpVertexGrid) mpVertexGrid->move(id, p);
+                    if (mpVertexTree) mpVertexTree->move(id, p);
+                }
+                else
+                {
+                    if (mpVertexGrid && mpVertexGrid->contains(id)) mpVertexGrid->remove(id);
+                    if (mpVertexTree && mpVertexTree->contains(id)) mpVertexTree->remove(id);
+                }
+            }
+        }
+
+        records.resize(mark);
+        mJournal.vertexImages.resize(numImages[Journal::Vertex]);
+        mJournal.edgeImages.resize(numImages[Journal::Edge]);
+        mJournal.faceImages.resize(numImages[Journal::Face]);
+        mJournal.halfedgeImages.resize(numImages[Journal::HalfEdge]);
+        if (mark == 0) commit();
+        else mJournal.mark(mVContainer.getCurrentIndex(), mEContainer.getCurrentIndex(), mFContainer.getCurrentIndex(), mHEContainer.getCurrentIndex());
+    }
+
+    template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+    void DynamicMesh<VertexType, EdgeType, FaceType, HalfEdgeType>::commit()
+    {
+        if (!mJournal.active()) return;
+        mJournal.close();
+        mVContainer.setReuseDeleted(true);
+        mEContainer.setReuseDeleted(true);
+        mFContainer.setReuseDeleted(true);
+        mHEContainer.setReuseDeleted(true);
+    }
+
 }//MeshLib
 #endif
\ No newline at end of file
@@ -0,0 +1,117 @@
+/*!
+*      \file EditJournal.h
+*      \brief Undo log of the edits of a mesh, see DynamicMesh::savepoint
+*
+*		The elements created and deleted are logged by their index, the elements modified by an image of what they were
+*		before, taken the first time they are touched after a savepoint. The pools do not reuse their deleted members while
+*		a journal is open, so that a deleted element keeps its content and its props at its index, and a created one is
+*		always the last of its pool: undoing an edit never has to look at the rest of the mesh.
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_set>
+#include <mutex>
+#include "../Parallel/OpenMP.h"
+
+namespace MeshLib {
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	class CEditJournal
+	{
+	public:
+		enum Op { Create, Delete, Modify };
+		enum Kind { Vertex, Edge, Face, HalfEdge };
+		struct Record
+		{
+			unsigned char op;
+			unsigned char kind;
+			/*! position of the image in its list, for a Modify */
+			unsigned int image;
+			size_t index;
+		};
+
+		bool active() const { return mActive; };
+		void open() { close(); mActive = true; };
+		/*! stop logging and forget everything */
+		void close();
+		/*! the images taken from now on are the states at this point; the elements at or above the given pool sizes are
+		created afterwards, any rollback drops them so they need no image */
+		void mark(size_t numV, size_t numE, size_t numF, size_t numHE);
+
+		void created(Kind kind, size_t index) { _push(Record{ (unsigned char)Create, (unsigned char)kind, 0, index }); };
+		void deleted(Kind kind, size_t index) { _push(Record{ (unsigned char)Delete, (unsigned char)kind, 0, index }); };
+		void modified(const VertexType * pV) { _modified(Vertex, pV, vertexImages); };
+		void modified(const EdgeType * pE) { _modified(Edge, pE, edgeImages); };
+		void modified(const FaceType * pF) { _modified(Face, pF, faceImages); };
+		void modified(const HalfEdgeType * pHE) { _modified(HalfEdge, pHE, halfedgeImages); };
+
+		std::vector<Record>       records;
+		std::vector<VertexType>   vertexImages;
+		std::vector<EdgeType>     edgeImages;
+		std::vector<FaceType>     faceImages;
+		std::vector<HalfEdgeType> halfedgeImages;
+
+	private:
+		void _push(const Record & r);
+		template<typename T>
+		void _modified(Kind kind, const T * pT, std::vector<T> & images);
+
+		bool mActive = false;
+		size_t mBase[4] = { 0, 0, 0, 0 };
+		/*! (index, kind) of the elements with an image since the last mark */
+		std::unordered_set<size_t> mTouched;
+		/*! the decimation collapses in parallel */
+		std::mutex mLock;
+	};
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CEditJournal<VertexType, EdgeType, FaceType, HalfEdgeType>::mark(size_t numV, size_t numE, size_t numF, size_t numHE)
+	{
+		mTouched.clear();
+		mBase[Vertex] = numV;
+		mBase[Edge] = numE;
+		mBase[Face] = numF;
+		mBase[HalfEdge] = numHE;
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CEditJournal<VertexType, EdgeType, FaceType, HalfEdgeType>::close()
+	{
+		mActive = false;
+		records.clear();
+		vertexImages.clear();
+		edgeImages.clear();
+		faceImages.clear();
+		halfedgeImages.clear();
+		mTouched.clear();
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	inline void CEditJournal<VertexType, EdgeType, FaceType, HalfEdgeType>::_push(const Record & r)
+	{
+		if (Parallel::inParallel())
+		{
+			std::lock_guard<std::mutex> guard(mLock);
+			records.push_back(r);
+		}
+		else
+		{
+			records.push_back(r);
+		}
+	}
+
+	template<typename VertexType, typename EdgeType, typename FaceType, typename HalfEdgeType>
+	template<typename T>
+	inline void CEditJournal<VertexType, EdgeType, FaceType, HalfEdgeType>::_modified(Kind kind, const T * pT, std::vector<T> & images)
+	{
+		const size_t index = pT->index();
+		if (index >= mBase[kind]) return;
+		std::unique_lock<std::mutex> guard(mLock, std::defer_lock);
+		if (Parallel::inParallel()) guard.lock();
+		if (!mTouched.insert(4 * index + kind).second) return;
+		records.push_back(Record{ (unsigned char)Modify, (unsigned char)kind, (unsigned int)images.size(), index });
+		images.push_back(*pT);
+	}
+}
@@ -0,0 +1,43 @@
+/*!
+*      \file MeshCSR.h
+*      \brief Read only adjacency snapshot of a surface mesh in compressed sparse rows
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "../Memory/CSRArray.h"
+
+namespace MeshLib {
+
+	/*!
+	* \brief Vertex-vertex, vertex-face and face-face adjacency of a CBaseMesh over dense 32 bits ids,
+	*  made by CBaseMesh::buildCSR.
+	*
+	*  The dense ids number the live elements in pool order. The snapshot is not updated by the mesh,
+	*  rebuild it after a topological change.
+	*/
+	template<typename VertexType, typename FaceType>
+	struct CMeshCSR
+	{
+		/*! dense id -> element */
+		std::vector<VertexType *> vertices;
+		std::vector<FaceType *>   faces;
+		/*! pool index -> dense id, -1 for the deleted slots */
+		std::vector<int>          vertexIds;
+		std::vector<int>          faceIds;
+
+		/*! the vertices sharing an edge with a vertex, sorted */
+		CCSRArray vv;
+		/*! the faces around a vertex, sorted */
+		CCSRArray vf;
+		/*! the faces sharing an edge with a face, in the order of the halfedges of the face */
+		CCSRArray ff;
+
+		int numVertices() const { return (int)vertices.size(); };
+		int numFaces() const { return (int)faces.size(); };
+		int vertexId(VertexType * pV) const { return vertexIds[pV->index()]; };
+		int faceId(FaceType * pF) const { return faceIds[pF->index()]; };
+	};
+}
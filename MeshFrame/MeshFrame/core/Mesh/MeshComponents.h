@@ -0,0 +1,278 @@
+/*!
+*      \file MeshComponents.h
+*      \brief Connected components of a surface mesh, splitting and removal of the small islands
+*
+*		The components are computed by a parallel union-find over the CSR adjacency snapshot.
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Parallel/UnionFind.h"
+#include "../Memory/StridedArray.h"
+#include "MeshCSR.h"
+#include "Props.h"
+
+namespace MeshLib {
+
+	template<typename MeshType>
+	class CMeshComponents
+	{
+	public:
+		typedef typename MeshType::VPtr VPtr;
+		typedef typename MeshType::EPtr EPtr;
+		typedef typename MeshType::FPtr FPtr;
+		typedef typename MeshType::HEPtr HEPtr;
+
+		/*!
+		Label the faces, two faces being connected if they share an edge.
+		\param label receives the component of each face, from 0 to numComponents() - 1 by smallest face index;
+		added to the mesh if it was not yet
+		\return the number of components
+		*/
+		int labelFaces(MeshType * pMesh, FPropHandle<int> & label);
+		/*!
+		Label the vertices, two vertices being connected if they share an edge.
+		*/
+		int labelVertices(MeshType * pMesh, VPropHandle<int> & label);
+
+		/*! of the last labelling */
+		int numComponents() const { return (int)mBoxMin.size(); };
+		/*! number of faces, or vertices, in each component */
+		int size(int c) const { return mMembers.degree(c); };
+		const CPoint & boxMin(int c) const { return mBoxMin[c]; };
+		const CPoint & boxMax(int c) const { return mBoxMax[c]; };
+
+		/*!
+		Copy each face component of the last labelFaces with at least minFaces faces to a new mesh, in parallel.
+		Only the positions are copied. The caller deletes the parts.
+		*/
+		void extractComponents(std::vector<MeshType *> & parts, int minFaces = 0) const;
+		/*!
+		Delete the face components of the last labelFaces with less than minFaces faces, with their edges and
+		the vertices left isolated. The labelling is cleared.
+		\return the number of faces deleted
+		*/
+		int removeSmallComponents(int minFaces);
+
+	private:
+		/*! group the elements by component and compute the boxes of the components */
+		void _group(int numComponents);
+
+		MeshType *                      mpMesh = NULL;
+		bool                            mOnFaces = true;
+		CMeshCSR<typename MeshType::VType, typename MeshType::FType> mCSR;
+		/*! dense element id -> component */
+		std::vector<int>                mLabels;
+		/*! component -> dense element ids */
+		CCSRArray                       mMembers;
+		std::vector<CPoint>             mBoxMin;
+		std::vector<CPoint>             mBoxMax;
+	};
+
+	template<typename MeshType>
+	inline int CMeshComponents<MeshType>::labelFaces(MeshType * pMesh, FPropHandle<int> & label)
+	{
+		mpMesh = pMesh;
+		mOnFaces = true;
+		pMesh->buildCSR(mCSR);
+		const int numFaces = mCSR.numFaces();
+
+		CUnionFind sets(numFaces);
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < numFaces; ++i) {
+			for (const int * j = mCSR.ff.begin(i); j != mCSR.ff.end(i); ++j) {
+				if (*j > i) sets.unite(i, *j);
+			}
+		}
+		_group(sets.labels(mLabels));
+
+		if (label.pPropPool == NULL) pMesh->addFProp(label);
+#pragma omp parallel for
+		for (int i = 0; i < numFaces; ++i) {
+			pMesh->gFP(label, mCSR.faces[i]) = mLabels[i];
+		}
+		return numComponents();
+	}
+
+	template<typename MeshType>
+	inline int CMeshComponents<MeshType>::labelVertices(MeshType * pMesh, VPropHandle<int> & label)
+	{
+		mpMesh = pMesh;
+		mOnFaces = false;
+		pMesh->buildCSR(mCSR);
+		const int numVerts = mCSR.numVertices();
+
+		CUnionFind sets(numVerts);
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < numVerts; ++i) {
+			for (const int * j = mCSR.vv.begin(i); j != mCSR.vv.end(i); ++j) {
+				if (*j > i) sets.unite(i, *j);
+			}
+		}
+		_group(sets.labels(mLabels));
+
+		if (label.pPropPool == NULL) pMesh->addVProp(label);
+#pragma omp parallel for
+		for (int i = 0; i < numVerts; ++i) {
+			pMesh->gVP(label, mCSR.vertices[i]) = mLabels[i];
+		}
+		return numComponents();
+	}
+
+	template<typename MeshType>
+	inline void CMeshComponents<MeshType>::_group(int numComponents)
+	{
+		/* counting sort, stable so the members stay in dense id order */
+		const int n = (int)mLabels.size();
+		mMembers.offsets.assign(numComponents + 1, 0);
+		for (int i = 0; i < n; ++i) ++mMembers.offsets[mLabels[i]];
+		mMembers.indices.resize(Parallel::exclusiveScan(mMembers.offsets));
+		std::vector<int> fill(mMembers.offsets.begin(), mMembers.offsets.end() - 1);
+		for (int i = 0; i < n; ++i) mMembers.indices[fill[mLabels[i]]++] = i;
+
+		mBoxMin.resize(numComponents);
+		mBoxMax.resize(numComponents);
+#pragma omp parallel for schedule(dynamic, 64)
+		for (int c = 0; c < numComponents; ++c) {
+			CPoint lo(1e300, 1e300, 1e300), hi(-1e300, -1e300, -1e300);
+			auto grow = [&](const CPoint & p) {
+				for (int k = 0; k < 3; ++k) {
+					lo[k] = std::min(lo[k], p[k]);
+					hi[k] = std::max(hi[k], p[k]);
+				}
+			};
+			for (const int * i = mMembers.begin(c); i != mMembers.end(c); ++i) {
+				if (mOnFaces) {
+					HEPtr pH = MeshType::faceHalfedge(mCSR.faces[*i]);
+					for (int k = 0; k < 3; ++k) {
+						grow(pH->target()->point());
+						pH = MeshType::halfedgeNext(pH);
+					}
+				}
+				else {
+					grow(mCSR.vertices[*i]->point());
+				}
+			}
+			mBoxMin[c] = lo;
+			mBoxMax[c] = hi;
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshComponents<MeshType>::extractComponents(std::vector<MeshType *> & parts, int minFaces) const
+	{
+		parts.clear();
+		if (!mOnFaces) {
+			printf("Error in extractComponents: the last labelling is not on the faces!\n");
+			return;
+		}
+		std::vector<int> kept;
+		for (int c = 0; c < numComponents(); ++c) {
+			if (size(c) >= minFaces) kept.push_back(c);
+		}
+		parts.resize(kept.size());
+
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int k = 0; k < (int)kept.size(); ++k) {
+			const int c = kept[k];
+			const int numFaces = size(c);
+			std::vector<int> vIds;
+			vIds.reserve(3 * numFaces);
+			for (const int * i = mMembers.begin(c); i != mMembers.end(c); ++i) {
+				HEPtr pH = MeshType::faceHalfedge(mCSR.faces[*i]);
+				for (int j = 0; j < 3; ++j) {
+					vIds.push_back(mCSR.vertexId((VPtr)pH->target()));
+					pH = MeshType::halfedgeNext(pH);
+				}
+			}
+			std::vector<std::array<int, 3>> faces(numFaces);
+			for (int f = 0; f < numFaces; ++f) {
+				for (int j = 0; j < 3; ++j) faces[f][j] = vIds[3 * f + j];
+			}
+			std::sort(vIds.begin(), vIds.end());
+			vIds.erase(std::unique(vIds.begin(), vIds.end()), vIds.end());
+
+			std::vector<std::array<double, 3>> verts(vIds.size());
+			for (size_t v = 0; v < vIds.size(); ++v) {
+				const CPoint & p = mCSR.vertices[vIds[v]]->point();
+				verts[v] = { p[0], p[1], p[2] };
+			}
+			for (std::array<int, 3> & face : faces) {
+				for (int j = 0; j < 3; ++j) {
+					face[j] = (int)(std::lower_bound(vIds.begin(), vIds.end(), face[j]) - vIds.begin());
+				}
+			}
+			parts[k] = new MeshType;
+			parts[k]->readVFBuffer(CStridedArray<const double>::fromVector(verts), CStridedArray<const int>::fromVector(faces));
+		}
+	}
+
+	template<typename MeshType>
+	inline int CMeshComponents<MeshType>::removeSmallComponents(int minFaces)
+	{
+		if (!mOnFaces) {
+			printf("Error in removeSmallComponents: the last labelling is not on the faces!\n");
+			return 0;
+		}
+		MeshType * pMesh = mpMesh;
+		std::vector<VPtr> touched;
+		int numRemoved = 0;
+		for (int c = 0; c < numComponents(); ++c) {
+			if (size(c) >= minFaces) continue;
+			for (const int * i = mMembers.begin(c); i != mMembers.end(c); ++i) {
+				FPtr pF = mCSR.faces[*i];
+				HEPtr pHs[3];
+				pHs[0] = MeshType::faceHalfedge(pF);
+				pHs[1] = MeshType::halfedgeNext(pHs[0]);
+				pHs[2] = MeshType::halfedgeNext(pHs[1]);
+				for (HEPtr pH : pHs) {
+					VPtr pV = (VPtr)pH->source();
+					for (size_t j = 0; j < pV->outHEs().size(); ++j) {
+						if (pV->outHEs()[j] == pH) {
+							pV->outHEs().erase(j);
+							break;
+						}
+					}
+					touched.push_back(pV);
+				}
+				/* the edges of a face component only have halfedges in the component */
+				for (HEPtr pH : pHs) {
+					EPtr pE = (EPtr)pH->edge();
+					if (!pMesh->edges().hasBeenDeleted(pE->index())) pMesh->deleteEdge(pE);
+				}
+				for (HEPtr pH : pHs) {
+					pMesh->deleteHalfEdge(pH);
+				}
+				pMesh->deleteFace(pF);
+				++numRemoved;
+			}
+		}
+
+		/* a vertex shared with a kept component only loses some of its halfedges */
+		for (VPtr pV : touched) {
+			if (pMesh->vertices().hasBeenDeleted(pV->index())) continue;
+			if (pV->outHEs().size() == 0) {
+				pMesh->deleteVertex(pV);
+				continue;
+			}
+			if (!pMesh->halfedges().hasBeenDeleted(pV->halfedge()->index())) continue;
+			HEPtr pH = (HEPtr)pV->outHEs()[0]->he_prev();
+			for (size_t k = 0; k < pV->outHEs().size() && pH->he_sym() != NULL; ++k) {
+				pH = MeshType::vertexNextCcwInHalfEdge(pH);
+			}
+			pV->halfedge() = pH;
+		}
+
+		mLabels.clear();
+		mMembers.clear();
+		mBoxMin.clear();
+		mBoxMax.clear();
+		return numRemoved;
+	}
+}
@@ -0,0 +1,640 @@
+/*!
+*      \file MeshHoleFiller.h
+*      \brief Filling the holes of a DynamicMesh, e.g. the many small ones of a scan
+*
+*		The boundary loops are gathered in one parallel sweep of the halfedges: each boundary halfedge finds the
+*		next one around its target, and the loops are the sets of a parallel union-find over these links.
+*		Each hole is then filled on its own, in parallel, on flat arrays: the loop is triangulated by dynamic
+*		programming over its vertices, minimizing the area, or the largest dihedral angle first, or by ear
+*		clipping when it is long; the patch is optionally refined towards the edge lengths around the hole, with
+*		Delaunay flips, and faired by solving a Laplace or bi-Laplace equation for its new vertices. All the
+*		patches are then inserted by a single DynamicMesh::addFaces.
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <utility>
+#include <math.h>
+#include <float.h>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Memory/CSRMatrix.h"
+#include "../Memory/IndexedHeap.h"
+#include "../Parallel/ParallelAlgorithms.h"
+#include "../Parallel/UnionFind.h"
+#include "../Solver/PCGSolver.h"
+#include "DynamicMesh.h"
+
+namespace MeshLib {
+
+	template<typename MeshType>
+	class CMeshHoleFiller
+	{
+	public:
+		typedef typename MeshType::VPtr VPtr;
+		typedef typename MeshType::FPtr FPtr;
+		typedef typename MeshType::HEPtr HEPtr;
+
+		enum Weight
+		{
+			/*! the triangulation of least area */
+			MinArea,
+			/*! the least largest dihedral angle between adjacent triangles, the faces around the hole included,
+			then the least area */
+			MinDihedral
+		};
+
+		enum Fairing
+		{
+			NoFairing,
+			/*! each new vertex at the average of its neighbours: a minimal surface spanning the hole */
+			Membrane,
+			/*! the bi-Laplacian vanishes at the new vertices, so that the patch follows the bending of the mesh
+			around the hole */
+			ThinPlate
+		};
+
+		Weight weight = MinDihedral;
+		/*! the loops with more edges are left open, 0 for no limit; the border of a scan is usually the longest loop */
+		int maxHoleEdges = 0;
+		/*! the loops up to this many edges are triangulated by dynamic programming, in O(n^3), the longer ones by ear clipping */
+		int maxDPEdges = 100;
+		/*! insert vertices so that the patch has about the edge lengths of the mesh around the hole */
+		bool refine = false;
+		/*! a triangle is split at its centroid while the centroid is further than the local edge length over
+		density from its corners */
+		double density = sqrt(2.0);
+		Fairing fairing = NoFairing;
+
+		/*!
+		Fill the holes of pMesh in place. The new elements get initialized props.
+		\return the number of holes filled; the loops through a vertex twice, or whose triangulation would need
+		an edge already in the mesh, are left open
+		*/
+		int fill(MeshType * pMesh);
+		/*!
+		The boundary loops of pMesh, each as its boundary halfedges in order, halfedge i ending at the source of
+		halfedge i + 1; the loops are ordered by their first halfedge.
+		*/
+		static void boundaryLoops(MeshType * pMesh, std::vector<std::vector<HEPtr>> & loops);
+
+		/*! the faces and the vertices added by the last fill */
+		const std::vector<FPtr> & newFaces() const { return mFaces; };
+		const std::vector<VPtr> & newVertices() const { return mVertices; };
+
+	private:
+		/*! the splits and Delaunay relaxations of the refinement stop after this many passes */
+		static const int MAX_REFINE_PASSES = 32;
+		static const int MAX_RELAX_SWEEPS = 16;
+
+		/*! a hole filled on flat arrays: vertex i < n is the source of the loop halfedge i, the others are new */
+		struct Patch
+		{
+			std::vector<CPoint> points;
+			/*! the local edge length at each vertex, for the refinement */
+			std::vector<double> scales;
+			/*! 3 vertices per triangle, halfedge 3 t + k going from vertex k of triangle t to vertex k + 1; a
+			triangle across the loop halfedge i has the halfedge from i + 1 to i */
+			std::vector<int> triangles;
+			/*! for each halfedge of the triangles the opposite one, or -1 - i across the loop halfedge i */
+			std::vector<int> twins;
+			/*! the pairs of loop vertices joined by an edge of the mesh other than a loop edge, which the patch
+			must not join again */
+			std::unordered_set<long long> meshEdges;
+			bool filled = false;
+		};
+
+		bool _fillPatch(const std::vector<HEPtr> & loop, Patch & patch) const;
+		bool _triangulateDP(const std::vector<HEPtr> & loop, Patch & patch) const;
+		bool _triangulateEars(Patch & patch) const;
+		void _refine(Patch & patch, int n) const;
+		/*! flip the edges of the patch which are not locally Delaunay, \return the number of flips */
+		int _relax(Patch & patch, int n) const;
+		void _fair(const std::vector<HEPtr> & loop, Patch & patch) const;
+		/*! \return false if a halfedge of the patch has no opposite one, the patch would not close the hole */
+		static bool _linkTwins(Patch & patch, int n);
+
+		static long long _edgeKey(int a, int b) { return a < b ? ((long long)a << 32) | b : ((long long)b << 32) | a; };
+		static long long _halfedgeKey(int a, int b) { return ((long long)a << 32) | b; };
+		static CPoint _normal(const CPoint & a, const CPoint & b, const CPoint & c)
+		{
+			CPoint n = (b - a) ^ (c - a);
+			const double norm = n.norm();
+			return norm > 0 ? n / norm : CPoint(0, 0, 0);
+		};
+		/*! the angle between unit normals, pi if one is degenerate */
+		static double _dihedral(const CPoint & n0, const CPoint & n1)
+		{
+			if (n0 * n0 == 0 || n1 * n1 == 0) return 3.14159265358979323846;
+			return acos(std::max(-1.0, std::min(1.0, n0 * n1)));
+		};
+		static double _angle(const CPoint & u, const CPoint & v)
+		{
+			const double norms = u.norm() * v.norm();
+			return norms > 0 ? acos(std::max(-1.0, std::min(1.0, (u * v) / norms))) : 0;
+		};
+
+		std::vector<FPtr> mFaces;
+		std::vector<VPtr> mVertices;
+	};
+
+	template<typename MeshType>
+	inline int CMeshHoleFiller<MeshType>::fill(MeshType * pMesh)
+	{
+		mFaces.clear();
+		mVertices.clear();
+		std::vector<std::vector<HEPtr>> loops;
+		boundaryLoops(pMesh, loops);
+		if (maxHoleEdges > 0) {
+			loops.erase(std::remove_if(loops.begin(), loops.end(),
+				[this](const std::vector<HEPtr> & loop) { return (int)loop.size() > maxHoleEdges; }), loops.end());
+		}
+
+		const int numLoops = (int)loops.size();
+		std::vector<Patch> patches(numLoops);
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int l = 0; l < numLoops; ++l) {
+			patches[l].filled = _fillPatch(loops[l], patches[l]);
+		}
+
+		/* the new vertices and halfedges of each patch, then the vertices are created one at a time and the
+		faces of all the patches listed in parallel */
+		std::vector<int> vertexOffsets(numLoops), halfedgeOffsets(numLoops);
+		int numFilled = 0;
+		for (int l = 0; l < numLoops; ++l) {
+			const Patch & patch = patches[l];
+			vertexOffsets[l] = patch.filled ? (int)(patch.points.size() - loops[l].size()) : 0;
+			halfedgeOffsets[l] = patch.filled ? (int)patch.triangles.size() : 0;
+			if (patch.filled) ++numFilled;
+		}
+		const int numVertices = Parallel::exclusiveScan(vertexOffsets);
+		const int numHalfedges = Parallel::exclusiveScan(halfedgeOffsets);
+		mVertices.resize(numVertices);
+		for (int l = 0; l < numLoops; ++l) {
+			const Patch & patch = patches[l];
+			if (!patch.filled) continue;
+			const int n = (int)loops[l].size();
+			for (int i = n; i < (int)patch.points.size(); ++i) {
+				mVertices[vertexOffsets[l] + i - n] = pMesh->addVertex(patch.points[i]);
+			}
+		}
+
+		std::vector<VPtr> corners(numHalfedges);
+		std::vector<int> twins(numHalfedges);
+		std::vector<HEPtr> borders(numHalfedges);
+#pragma omp parallel for schedule(dynamic, 16)
+		for (int l = 0; l < numLoops; ++l) {
+			const Patch & patch = patches[l];
+			if (!patch.filled) continue;
+			const int n = (int)loops[l].size();
+			const int base = halfedgeOffsets[l];
+			for (int h = 0; h < (int)patch.triangles.size(); ++h) {
+				const int v = patch.triangles[h];
+				corners[base + h] = v < n ? (VPtr)loops[l][v]->source() : mVertices[vertexOffsets[l] + v - n];
+				const int twin = patch.twins[h];
+				twins[base + h] = twin >= 0 ? base + twin : -1;
+				borders[base + h] = twin >= 0 ? NULL : loops[l][-1 - twin];
+			}
+		}
+		pMesh->addFaces(corners, twins, borders, &mFaces);
+		return numFilled;
+	}
+
+	template<typename MeshType>
+	inline void CMeshHoleFiller<MeshType>::boundaryLoops(MeshType * pMesh, std::vector<std::vector<HEPtr>> & loops)
+	{
+		auto & halfedges = pMesh->getHEContainer();
+		const int numH = (int)halfedges.getCurrentIndex();
+		std::vector<int> positions(numH);
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < numH; ++i) {
+			positions[i] = !halfedges.hasBeenDeleted(i) && halfedges.getPointer(i)->he_sym() == NULL;
+		}
+		std::vector<int> boundary(Parallel::exclusiveScan(positions));
+		const int numB = (int)boundary.size();
+#pragma omp parallel for
+		for (int i = 0; i < numH; ++i) {
+			if (i + 1 < numH ? positions[i + 1] != positions[i] : positions[i] < numB) boundary[positions[i]] = i;
+		}
+
+		/* the next boundary halfedge is the one leaving the target, found by turning around it through the faces */
+		std::vector<int> next(numB);
+		CUnionFind sets(numB);
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int j = 0; j < numB; ++j) {
+			HEPtr pH = (HEPtr)halfedges.getPointer(boundary[j])->he_next();
+			while (pH->he_sym() != NULL) pH = (HEPtr)pH->he_sym()->he_next();
+			next[j] = positions[pH->index()];
+			sets.unite(j, next[j]);
+		}
+		std::vector<int> labels;
+		const int numLoops = sets.labels(labels);
+		/* the root of a set is its smallest element, the loops start there */
+		std::vector<int> starts(numLoops);
+#pragma omp parallel for
+		for (int j = 0; j < numB; ++j) {
+			if (sets.find(j) == j) starts[labels[j]] = j;
+		}
+		loops.assign(numLoops, std::vector<HEPtr>());
+#pragma omp parallel for schedule(dynamic, 16)
+		for (int l = 0; l < numLoops; ++l) {
+			int j = starts[l];
+			do {
+				loops[l].push_back(halfedges.getPointer(boundary[j]));
+				j = next[j];
+			} while (j != starts[l] && (int)loops[l].size() <= numB);
+		}
+	}
+
+	template<typename MeshType>
+	inline bool CMeshHoleFiller<MeshType>::_fillPatch(const std::vector<HEPtr> & loop, Patch & patch) const
+	{
+		const int n = (int)loop.size();
+		if (n < 3) return false;
+		std::unordered_map<VPtr, int> locals;
+		patch.points.resize(n);
+		for (int i = 0; i < n; ++i) {
+			VPtr pV = (VPtr)loop[i]->source();
+			if (!locals.emplace(pV, i).second) return false;
+			patch.points[i] = pV->point();
+		}
+		patch.scales.resize(n);
+		for (int i = 0; i < n; ++i) {
+			VPtr pV = (VPtr)loop[i]->source();
+			/* the outgoing halfedges give all the edges but the loop edge coming in */
+			double length = (patch.points[i] - patch.points[(i + n - 1) % n]).norm();
+			for (auto pOut : pV->outHEs()) {
+				VPtr pW = (VPtr)pOut->target();
+				length += (pW->point() - patch.points[i]).norm();
+				auto found = locals.find(pW);
+				if (found == locals.end()) continue;
+				const int j = found->second;
+				if (j != (i + 1) % n && j != (i + n - 1) % n) patch.meshEdges.insert(_edgeKey(i, j));
+			}
+			patch.scales[i] = length / (pV->outHEs().size() + 1);
+		}
+
+		if (!(n <= maxDPEdges ? _triangulateDP(loop, patch) : _triangulateEars(patch))) return false;
+		if (refine) _refine(patch, n);
+		if (!_linkTwins(patch, n)) return false;
+		if (fairing != NoFairing && (int)patch.points.size() > n) _fair(loop, patch);
+		return true;
+	}
+
+	template<typename MeshType>
+	inline bool CMeshHoleFiller<MeshType>::_triangulateDP(const std::vector<HEPtr> & loop, Patch & patch) const
+	{
+		/* the polygon i ... k closed by the diagonal from i to k is split by the triangle (i, k, m), whose
+		halfedges from m to i and from k to m are across the polygons i ... m and m ... k */
+		const int n = (int)loop.size();
+		const std::vector<CPoint> & p = patch.points;
+		/* the normals of the faces across the loop edges */
+		std::vector<CPoint> around(n);
+		for (int i = 0; i < n; ++i) {
+			HEPtr pH = loop[i];
+			around[i] = _normal(pH->source()->point(), pH->target()->point(), pH->he_next()->target()->point());
+		}
+		std::vector<double> angles(n * n, DBL_MAX), areas(n * n, DBL_MAX);
+		std::vector<int> apexes(n * n, -1);
+		for (int i = 0; i + 1 < n; ++i) {
+			angles[i * n + i + 1] = 0;
+			areas[i * n + i + 1] = 0;
+		}
+		/* the normal of the triangle splitting the polygon i ... k, or of the face across the loop edge i */
+		auto sideNormal = [&](int i, int k) {
+			return k == i + 1 ? around[i] : _normal(p[i], p[k], p[apexes[i * n + k]]);
+		};
+		for (int length = 2; length < n; ++length) {
+			for (int i = 0; i + length < n; ++i) {
+				const int k = i + length;
+				const bool closing = i == 0 && k == n - 1;
+				if (!closing && patch.meshEdges.count(_edgeKey(i, k))) continue;
+				double bestAngle = DBL_MAX, bestArea = DBL_MAX;
+				int best = -1;
+				for (int m = i + 1; m < k; ++m) {
+					if (angles[i * n + m] == DBL_MAX || angles[m * n + k] == DBL_MAX) continue;
+					const CPoint normal = (p[k] - p[i]) ^ (p[m] - p[i]);
+					const double area = normal.norm() / 2 + areas[i * n + m] + areas[m * n + k];
+					double angle = 0;
+					if (weight == MinDihedral) {
+						const CPoint unit = _normal(p[i], p[k], p[m]);
+						angle = std::max(angles[i * n + m], angles[m * n + k]);
+						angle = std::max(angle, _dihedral(unit, sideNormal(i, m)));
+						angle = std::max(angle, _dihedral(unit, sideNormal(m, k)));
+						if (closing) angle = std::max(angle, _dihedral(unit, around[n - 1]));
+					}
+					if (angle < bestAngle || (angle == bestAngle && area < bestArea)) {
+						bestAngle = angle;
+						bestArea = area;
+						best = m;
+					}
+				}
+				angles[i * n + k] = bestAngle;
+				areas[i * n + k] = bestArea;
+				apexes[i * n + k] = best;
+			}
+		}
+		if (apexes[n - 1] < 0) return false;
+
+		std::vector<std::pair<int, int>> stack(1, std::make_pair(0, n - 1));
+		while (!stack.empty()) {
+			const int i = stack.back().first, k = stack.back().second;
+			stack.pop_back();
+			if (k - i < 2) continue;
+			const int m = apexes[i * n + k];
+			patch.triangles.push_back(i);
+			patch.triangles.push_back(k);
+			patch.triangles.push_back(m);
+			stack.push_back(std::make_pair(i, m));
+			stack.push_back(std::make_pair(m, k));
+		}
+		return true;
+	}
+
+	template<typename MeshType>
+	inline bool CMeshHoleFiller<MeshType>::_triangulateEars(Patch & patch) const
+	{
+		/* clip the sharpest ear first, in the plane of the Newell normal of the loop, where the loop turns
+		counterclockwise; clipping the ear at j between a and b adds the triangle (a, b, j) */
+		const double pi = 3.14159265358979323846;
+		const int n = (int)patch.points.size();
+		const std::vector<CPoint> & p = patch.points;
+		CPoint normal(0, 0, 0);
+		for (int i = 0; i < n; ++i) normal += p[i] ^ p[(i + 1) % n];
+		if (normal.norm() == 0) return false;
+		normal /= normal.norm();
+		CPoint u = fabs(normal[0]) < 0.9 ? CPoint(1, 0, 0) : CPoint(0, 1, 0);
+		u = u - normal * (u * normal);
+		u /= u.norm();
+		const CPoint v = normal ^ u;
+		std::vector<double> xs(n), ys(n);
+		for (int i = 0; i < n; ++i) {
+			xs[i] = p[i] * u;
+			ys[i] = p[i] * v;
+		}
+
+		std::vector<int> prev(n), next(n);
+		for (int i = 0; i < n; ++i) {
+			prev[i] = (i + n - 1) % n;
+			next[i] = (i + 1) % n;
+		}
+		auto cross = [&](int a, int j, int b) {
+			return (xs[j] - xs[a]) * (ys[b] - ys[j]) - (ys[j] - ys[a]) * (xs[b] - xs[j]);
+		};
+		auto interiorAngle = [&](int j) {
+			const int a = prev[j], b = next[j];
+			const double dot = (xs[j] - xs[a]) * (xs[b] - xs[j]) + (ys[j] - ys[a]) * (ys[b] - ys[j]);
+			return pi - atan2(cross(a, j, b), dot);
+		};
+		auto isEar = [&](int j) {
+			const int a = prev[j], b = next[j];
+			if (cross(a, j, b) <= 0 || patch.meshEdges.count(_edgeKey(a, b))) return false;
+			/* no other corner inside the ear */
+			for (int c = next[b]; c != a; c = next[c]) {
+				if (cross(a, j, c) >= 0 && cross(j, b, c) >= 0 && cross(b, a, c) >= 0) return false;
+			}
+			return true;
+		};
+
+		CIndexedHeap<4> heap;
+		heap.reset(n);
+		auto update = [&](int j) {
+			if (cross(prev[j], j, next[j]) > 0) heap.push(j, interiorAngle(j));
+			else if (heap.contains(j)) heap.remove(j);
+		};
+		for (int j = 0; j < n; ++j) update(j);
+
+		int numLeft = n, j = 0;
+		bool rebuilt = false;
+		while (numLeft > 3) {
+			int ear = -1;
+			while (ear < 0 && !heap.empty()) {
+				const int c = heap.pop();
+				if (isEar(c)) ear = c;
+			}
+			if (ear < 0 && !rebuilt) {
+				/* an ear may have been freed by a clip away from it */
+				for (int c = next[j], i = 0; i < numLeft; c = next[c], ++i) update(c);
+				rebuilt = true;
+				continue;
+			}
+			if (ear < 0) {
+				/* the projection of the loop folds over: clip the sharpest corner in space */
+				double sharpest = DBL_MAX;
+				for (int c = next[j], i = 0; i < numLeft; c = next[c], ++i) {
+					if (patch.meshEdges.count(_edgeKey(prev[c], next[c]))) continue;
+					const double angle = _angle(p[prev[c]] - p[c], p[next[c]] - p[c]);
+					if (angle < sharpest) {
+						sharpest = angle;
+						ear = c;
+					}
+				}
+				if (ear < 0) return false;
+				if (heap.contains(ear)) heap.remove(ear);
+			}
+			rebuilt = false;
+			const int a = prev[ear], b = next[ear];
+			patch.triangles.push_back(a);
+			patch.triangles.push_back(b);
+			patch.triangles.push_back(ear);
+			next[a] = b;
+			prev[b] = a;
+			--numLeft;
+			j = a;
+			update(a);
+			update(b);
+		}
+		patch.triangles.push_back(prev[j]);
+		patch.triangles.push_back(next[j]);
+		patch.triangles.push_back(j);
+		return true;
+	}
+
+	template<typename MeshType>
+	inline void CMeshHoleFiller<MeshType>::_refine(Patch & patch, int n) const
+	{
+		std::vector<CPoint> & p = patch.points;
+		std::vector<int> & t = patch.triangles;
+		for (int pass = 0; pass < MAX_REFINE_PASSES; ++pass) {
+			bool split = false;
+			const int numT = (int)t.size() / 3;
+			for (int f = 0; f < numT; ++f) {
+				const int v0 = t[3 * f], v1 = t[3 * f + 1], v2 = t[3 * f + 2];
+				const CPoint c = (p[v0] + p[v1] + p[v2]) / 3;
+				const double scale = (patch.scales[v0] + patch.scales[v1] + patch.scales[v2]) / 3;
+				bool dense = true;
+				for (int v : { v0, v1, v2 }) {
+					const double d = density * (c - p[v]).norm();
+					if (d <= scale || d <= patch.scales[v]) dense = false;
+				}
+				if (!dense) continue;
+				const int m = (int)p.size();
+				p.push_back(c);
+				patch.scales.push_back(scale);
+				t[3 * f + 2] = m;
+				t.push_back(v1); t.push_back(v2); t.push_back(m);
+				t.push_back(v2); t.push_back(v0); t.push_back(m);
+				split = true;
+			}
+			if (!split) break;
+			_relax(patch, n);
+		}
+		_relax(patch, n);
+	}
+
+	template<typename MeshType>
+	inline int CMeshHoleFiller<MeshType>::_relax(Patch & patch, int n) const
+	{
+		const double pi = 3.14159265358979323846;
+		const std::vector<CPoint> & p = patch.points;
+		std::vector<int> & t = patch.triangles;
+		const int numH = (int)t.size();
+		std::unordered_map<long long, int> halfedges;
+		halfedges.reserve(numH);
+		for (int h = 0; h < numH; ++h) halfedges[_halfedgeKey(t[h], t[h / 3 * 3 + (h + 1) % 3])] = h;
+
+		int numFlips = 0;
+		for (int sweep = 0; sweep < MAX_RELAX_SWEEPS; ++sweep) {
+			int numSweepFlips = 0;
+			for (int h = 0; h < numH; ++h) {
+				const int f = h / 3, k = h % 3;
+				const int a = t[3 * f + k], b = t[3 * f + (k + 1) % 3], c = t[3 * f + (k + 2) % 3];
+				if (a > b) continue;
+				auto found = halfedges.find(_halfedgeKey(b, a));
+				if (found == halfedges.end()) continue;
+				const int g = found->second, e = g / 3;
+				const int d = t[3 * e + (g % 3 + 2) % 3];
+				if (c == d) continue;
+				if (_angle(p[a] - p[c], p[b] - p[c]) + _angle(p[a] - p[d], p[b] - p[d]) <= pi + 1e-10) continue;
+				if (halfedges.count(_halfedgeKey(c, d)) || halfedges.count(_halfedgeKey(d, c))) continue;
+				if (c < n && d < n && patch.meshEdges.count(_edgeKey(c, d))) continue;
+				/* (a, b, c) and (b, a, d) become (a, d, c) and (d, b, c) */
+				for (int i = 0; i < 3; ++i) {
+					halfedges.erase(_halfedgeKey(t[3 * f + i], t[3 * f + (i + 1) % 3]));
+					halfedges.erase(_halfedgeKey(t[3 * e + i], t[3 * e + (i + 1) % 3]));
+				}
+				t[3 * f] = a; t[3 * f + 1] = d; t[3 * f + 2] = c;
+				t[3 * e] = d; t[3 * e + 1] = b; t[3 * e + 2] = c;
+				for (int i = 0; i < 3; ++i) {
+					halfedges[_halfedgeKey(t[3 * f + i], t[3 * f + (i + 1) % 3])] = 3 * f + i;
+					halfedges[_halfedgeKey(t[3 * e + i], t[3 * e + (i + 1) % 3])] = 3 * e + i;
+				}
+				++numSweepFlips;
+			}
+			numFlips += numSweepFlips;
+			if (numSweepFlips == 0) break;
+		}
+		return numFlips;
+	}
+
+	template<typename MeshType>
+	inline bool CMeshHoleFiller<MeshType>::_linkTwins(Patch & patch, int n)
+	{
+		const std::vector<int> & t = patch.triangles;
+		const int numH = (int)t.size();
+		std::unordered_map<long long, int> halfedges;
+		halfedges.reserve(numH);
+		for (int h = 0; h < numH; ++h) {
+			if (!halfedges.emplace(_halfedgeKey(t[h], t[h / 3 * 3 + (h + 1) % 3]), h).second) return false;
+		}
+		patch.twins.resize(numH);
+		for (int h = 0; h < numH; ++h) {
+			const int a = t[h], b = t[h / 3 * 3 + (h + 1) % 3];
+			auto found = halfedges.find(_halfedgeKey(b, a));
+			if (found != halfedges.end()) patch.twins[h] = found->second;
+			else if (a < n && b < n && b == (a + n - 1) % n) patch.twins[h] = -1 - b;
+			else return false;
+		}
+		return true;
+	}
+
+	template<typename MeshType>
+	inline void CMeshHoleFiller<MeshType>::_fair(const std::vector<HEPtr> & loop, Patch & patch) const
+	{
+		/* uniform Laplacian L, (L x)_a = deg(a) x_a - sum of the neighbours; the rows of the new vertices of
+		L x = 0 or of L L x = 0 are solved for, the loop vertices and the mesh around them being fixed */
+		const int n = (int)loop.size();
+		const int m = (int)patch.points.size();
+		std::vector<CPoint> points = patch.points;
+		std::vector<std::vector<int>> neighbours(m);
+		const std::vector<int> & t = patch.triangles;
+		for (int h = 0; h < (int)t.size(); ++h) {
+			const int a = t[h], b = t[h / 3 * 3 + (h + 1) % 3];
+			neighbours[a].push_back(b);
+			neighbours[b].push_back(a);
+		}
+		if (fairing == ThinPlate) {
+			/* the bi-Laplacian at a new vertex next to the loop sees the neighbours of the loop vertex in the mesh */
+			std::unordered_map<VPtr, int> locals;
+			for (int i = 0; i < n; ++i) locals.emplace((VPtr)loop[i]->source(), i);
+			for (int i = 0; i < n; ++i) {
+				VPtr pV = (VPtr)loop[i]->source();
+				neighbours[i].push_back((i + n - 1) % n);
+				for (auto pOut : pV->outHEs()) {
+					VPtr pW = (VPtr)pOut->target();
+					auto found = locals.find(pW);
+					if (found != locals.end()) {
+						neighbours[i].push_back(found->second);
+					}
+					else {
+						locals.emplace(pW, (int)points.size());
+						neighbours[i].push_back((int)points.size());
+						points.push_back(pW->point());
+					}
+				}
+			}
+		}
+		for (int a = 0; a < m; ++a) {
+			std::sort(neighbours[a].begin(), neighbours[a].end());
+			neighbours[a].erase(std::unique(neighbours[a].begin(), neighbours[a].end()), neighbours[a].end());
+		}
+
+		const int numUnknowns = m - n;
+		std::vector<std::vector<std::pair<int, double>>> rows(numUnknowns);
+		std::vector<CPoint> b(numUnknowns, CPoint(0, 0, 0)), x(numUnknowns);
+		std::vector<std::pair<int, double>> terms;
+		auto laplacian = [&](int a, double scale) {
+			terms.push_back(std::make_pair(a, scale * neighbours[a].size()));
+			for (int c : neighbours[a]) terms.push_back(std::make_pair(c, -scale));
+		};
+		for (int r = 0; r < numUnknowns; ++r) {
+			const int a = n + r;
+			terms.clear();
+			if (fairing == Membrane) {
+				laplacian(a, 1.0);
+			}
+			else {
+				laplacian(a, (double)neighbours[a].size());
+				for (int c : neighbours[a]) laplacian(c, -1.0);
+			}
+			std::sort(terms.begin(), terms.end());
+			for (size_t i = 0; i < terms.size(); ) {
+				const int c = terms[i].first;
+				double value = 0;
+				for (; i < terms.size() && terms[i].first == c; ++i) value += terms[i].second;
+				if (c >= n && c < m) rows[r].push_back(std::make_pair(c - n, value));
+				else b[r] -= points[c] * value;
+			}
+			x[r] = points[a];
+		}
+
+		CCSRArray pattern;
+		pattern.build(numUnknowns, [&](int r, std::vector<int> & row) {
+			for (const auto & entry : rows[r]) row.push_back(entry.first);
+		});
+		CCSRMatrix A;
+		A.setPattern(pattern);
+		for (int r = 0; r < numUnknowns; ++r) {
+			for (const auto & entry : rows[r]) A.values[A.find(r, entry.first)] = entry.second;
+		}
+		CPCGSolver solver;
+		solver.setMatrix(A, CPCGSolver::IC0);
+		solver.solve(b, x);
+		for (int r = 0; r < numUnknowns; ++r) patch.points[n + r] = x[r];
+	}
+}
@@ -0,0 +1,236 @@
+/*!
+*      \file MeshLaplacian.h
+*      \brief Assembly of the Laplacian and mass matrices of a triangle mesh
+*
+*		The sparsity pattern and, for every face corner, the positions of its entries in the matrix values
+*		are computed once by build. An assembly is then a parallel pass over the faces computing their
+*		local weights, and a parallel pass over the rows gathering the weights of the faces around each
+*		vertex, so each row is written by one thread only.
+*/
+
+#pragma once
+
+#include <vector>
+#include <math.h>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Memory/CSRMatrix.h"
+#include "MeshCSR.h"
+
+namespace MeshLib {
+
+	template<typename MeshType>
+	class CMeshLaplacian
+	{
+	public:
+		typedef typename MeshType::VPtr VPtr;
+		typedef typename MeshType::HEPtr HEPtr;
+
+		enum Weights
+		{
+			/*! 1 per edge, the graph Laplacian */
+			Uniform,
+			/*! (cot alpha + cot beta) / 2, alpha and beta the angles opposite to the edge */
+			Cotangent,
+			/*! (tan(theta1 / 2) + tan(theta2 / 2)) / |xi - xj|, theta1 and theta2 the angles at xi beside the edge,
+			the matrix is not symmetric */
+			MeanValue
+		};
+
+		/*!
+		Build the sparsity pattern over the vertices and assemble the matrices.
+		\param consistentMass also assemble the consistent mass matrix, the lumped masses are always assembled
+		*/
+		void build(MeshType * pMesh, Weights weights = Cotangent, bool consistentMass = false);
+		/*!
+		Assemble the values again after the vertices moved, the connectivity must not have changed.
+		*/
+		void update();
+
+		/*!
+		L_ij = -w_ij, L_ii = sum of the w_ij: positive semi-definite for the uniform and cotangent weights,
+		the rows sum to 0. The rows and columns are the dense vertex ids.
+		*/
+		const CCSRMatrix & laplacian() const { return mL; };
+		/*! consistent mass matrix, M_ii = sum of A / 6 and M_ij = sum of A / 12 over the faces around; empty if not asked */
+		const CCSRMatrix & mass() const { return mM; };
+		/*! a third of the area of the faces around each vertex */
+		const std::vector<double> & lumpedMass() const { return mLumpedMass; };
+
+		int numVertices() const { return mCSR.numVertices(); };
+		VPtr vertex(int i) const { return mCSR.vertices[i]; };
+		int vertexId(VPtr pV) const { return mCSR.vertexId(pV); };
+
+	private:
+		void _computeFaces();
+		void _assembleRow(int i);
+
+		MeshType *          mpMesh = NULL;
+		Weights             mWeights = Cotangent;
+		bool                mConsistentMass = false;
+		CMeshCSR<typename MeshType::VType, typename MeshType::FType> mCSR;
+
+		/*! dense vertex id of corner 3 * f + k */
+		std::vector<int>    mCornerVertices;
+		/*! vertex -> its corners */
+		CCSRArray           mVCorners;
+		/*! positions in the values of the entries (i, j) and (i, l) of corner c of vertex i, j and l being the
+		next vertices in the face */
+		std::vector<int>    mCornerSlots;
+
+		/*! per corner: the cotangent of its angle, or the tangent of its half angle for the mean value weights */
+		std::vector<double> mCornerWeights;
+		/*! per corner: the length of the opposite edge */
+		std::vector<double> mEdgeLengths;
+		std::vector<double> mFaceAreas;
+
+		CCSRMatrix          mL;
+		CCSRMatrix          mM;
+		std::vector<double> mLumpedMass;
+	};
+
+	template<typename MeshType>
+	inline void CMeshLaplacian<MeshType>::build(MeshType * pMesh, Weights weights, bool consistentMass)
+	{
+		mpMesh = pMesh;
+		mWeights = weights;
+		mConsistentMass = consistentMass;
+		pMesh->buildCSR(mCSR);
+		const int numV = mCSR.numVertices(), numF = mCSR.numFaces();
+
+		mCornerVertices.resize(3 * numF);
+#pragma omp parallel for
+		for (int f = 0; f < numF; ++f) {
+			HEPtr pH = MeshType::faceHalfedge(mCSR.faces[f]);
+			for (int k = 0; k < 3; ++k) {
+				mCornerVertices[3 * f + k] = mCSR.vertexId((VPtr)pH->target());
+				pH = MeshType::halfedgeNext(pH);
+			}
+		}
+		mVCorners.build(numV, [&](int i, std::vector<int> & row) {
+			for (const int * f = mCSR.vf.begin(i); f != mCSR.vf.end(i); ++f) {
+				for (int k = 0; k < 3; ++k) {
+					if (mCornerVertices[3 * *f + k] == i) row.push_back(3 * *f + k);
+				}
+			}
+		});
+
+		/* the pattern is the vertex-vertex adjacency plus the diagonal */
+		CCSRArray pattern;
+		pattern.build(numV, [&](int i, std::vector<int> & row) {
+			const int * j = mCSR.vv.begin(i);
+			for (; j != mCSR.vv.end(i) && *j < i; ++j) row.push_back(*j);
+			row.push_back(i);
+			for (; j != mCSR.vv.end(i); ++j) row.push_back(*j);
+		});
+		mL.setPattern(pattern);
+		if (consistentMass) {
+			mM.setPattern(pattern);
+		}
+		else {
+			mM.clear();
+		}
+
+		mCornerSlots.resize(6 * numF);
+#pragma omp parallel for
+		for (int f = 0; f < numF; ++f) {
+			for (int k = 0; k < 3; ++k) {
+				const int i = mCornerVertices[3 * f + k];
+				mCornerSlots[6 * f + 2 * k] = mL.find(i, mCornerVertices[3 * f + (k + 1) % 3]);
+				mCornerSlots[6 * f + 2 * k + 1] = mL.find(i, mCornerVertices[3 * f + (k + 2) % 3]);
+			}
+		}
+		mCornerWeights.resize(3 * numF);
+		mEdgeLengths.resize(3 * numF);
+		mFaceAreas.resize(numF);
+		mLumpedMass.resize(numV);
+		update();
+	}
+
+	template<typename MeshType>
+	inline void CMeshLaplacian<MeshType>::update()
+	{
+		_computeFaces();
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < mCSR.numVertices(); ++i) {
+			_assembleRow(i);
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshLaplacian<MeshType>::_computeFaces()
+	{
+		const int numF = mCSR.numFaces();
+#pragma omp parallel for
+		for (int f = 0; f < numF; ++f) {
+			const CPoint & p0 = mCSR.vertices[mCornerVertices[3 * f]]->point();
+			const CPoint & p1 = mCSR.vertices[mCornerVertices[3 * f + 1]]->point();
+			const CPoint & p2 = mCSR.vertices[mCornerVertices[3 * f + 2]]->point();
+			/* e[k] is the edge opposite to corner k */
+			const CPoint e[3] = { p2 - p1, p0 - p2, p1 - p0 };
+			const double doubleArea = (e[1] ^ e[2]).norm();
+			mFaceAreas[f] = 0.5 * doubleArea;
+			for (int k = 0; k < 3; ++k) {
+				const CPoint & a = e[(k + 2) % 3];
+				const CPoint & b = e[(k + 1) % 3];
+				/* the angle at corner k is between a and -b */
+				const double dot = -(a * b);
+				mEdgeLengths[3 * f + k] = e[k].norm();
+				if (mWeights == MeanValue) {
+					const double denom = a.norm() * b.norm() + dot;
+					mCornerWeights[3 * f + k] = denom > 0 ? doubleArea / denom : 0.0;
+				}
+				else {
+					mCornerWeights[3 * f + k] = doubleArea > 0 ? dot / doubleArea : 0.0;
+				}
+			}
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshLaplacian<MeshType>::_assembleRow(int i)
+	{
+		double * L = mL.values.data();
+		const int rowBegin = mL.pattern.offsets[i], rowEnd = mL.pattern.offsets[i + 1];
+		double mass = 0;
+		if (mWeights == Uniform) {
+			for (int k = rowBegin; k < rowEnd; ++k) L[k] = -1.0;
+			L[mL.diagonal[i]] = rowEnd - rowBegin - 1;
+		}
+		else {
+			for (int k = rowBegin; k < rowEnd; ++k) L[k] = 0.0;
+		}
+		if (mConsistentMass) {
+			for (int k = rowBegin; k < rowEnd; ++k) mM.values[k] = 0.0;
+		}
+
+		for (const int * c = mVCorners.begin(i); c != mVCorners.end(i); ++c) {
+			const int f = *c / 3, k = *c % 3;
+			const int cj = 3 * f + (k + 1) % 3, cl = 3 * f + (k + 2) % 3;
+			const int slotJ = mCornerSlots[2 * *c], slotL = mCornerSlots[2 * *c + 1];
+			double wJ = 0, wL = 0;
+			if (mWeights == Cotangent) {
+				/* edge (i, j) is opposite to corner l, and edge (i, l) to corner j */
+				wJ = 0.5 * mCornerWeights[cl];
+				wL = 0.5 * mCornerWeights[cj];
+			}
+			else if (mWeights == MeanValue) {
+				wJ = mEdgeLengths[cl] > 0 ? mCornerWeights[*c] / mEdgeLengths[cl] : 0.0;
+				wL = mEdgeLengths[cj] > 0 ? mCornerWeights[*c] / mEdgeLengths[cj] : 0.0;
+			}
+			L[slotJ] -= wJ;
+			L[slotL] -= wL;
+			L[mL.diagonal[i]] += wJ + wL;
+
+			const double area = mFaceAreas[f];
+			mass += area / 3.0;
+			if (mConsistentMass) {
+				mM.values[slotJ] += area / 12.0;
+				mM.values[slotL] += area / 12.0;
+				mM.values[mM.diagonal[i]] += area / 6.0;
+			}
+		}
+		mLumpedMass[i] = mass;
+	}
+}
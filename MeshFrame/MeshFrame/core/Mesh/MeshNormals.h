@@ -0,0 +1,242 @@
+/*!
+*      \file MeshNormals.h
+*      \brief Face normals, face areas and vertex normals of a whole triangle mesh at once
+*
+*		A face pass over flat arrays computes every face normal once, then each vertex gathers the
+*		normals of its faces through a vertex-corner table. Both passes are parallel and race free.
+*/
+
+#pragma once
+
+#include <vector>
+#include <math.h>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Memory/CSRArray.h"
+#include "MeshCSR.h"
+
+namespace MeshLib {
+
+	template<typename MeshType>
+	class CMeshNormals
+	{
+	public:
+		typedef typename MeshType::VPtr VPtr;
+		typedef typename MeshType::FPtr FPtr;
+		typedef typename MeshType::HEPtr HEPtr;
+
+		/*! weights of the face normals in a vertex normal */
+		enum Weighting
+		{
+			Uniform,
+			/*! face area */
+			Area,
+			/*! angle of the face at the vertex */
+			Angle
+		};
+
+		/*!
+		Snapshot the connectivity and compute all the normals.
+		*/
+		void build(MeshType * pMesh, Weighting weighting = Area);
+		/*!
+		Recompute all the normals after the vertices moved, the connectivity must not have changed.
+		*/
+		void update();
+		/*!
+		Recompute the faces around the moved vertices, and the vertex normals of these faces.
+		*/
+		void update(const std::vector<VPtr> & moved);
+
+		int numVertices() const { return (int)mVertices.size(); };
+		int numFaces() const { return (int)mFaces.size(); };
+		/*! dense id -> element, the ids number the live elements in pool order */
+		VPtr vertex(int i) const { return mVertices[i]; };
+		FPtr face(int i) const { return mFaces[i]; };
+
+		/*! unit normals, 0 for a degenerate face or vertex */
+		CPoint faceNormal(int i) const { return CPoint(mFNx[i], mFNy[i], mFNz[i]); };
+		CPoint faceNormal(FPtr pF) const { return faceNormal(mFaceIds[pF->index()]); };
+		double faceArea(int i) const { return mFArea[i]; };
+		double faceArea(FPtr pF) const { return faceArea(mFaceIds[pF->index()]); };
+		const CPoint & vertexNormal(int i) const { return mVNormals[i]; };
+		const CPoint & vertexNormal(VPtr pV) const { return mVNormals[mVertexIds[pV->index()]]; };
+
+	private:
+		void _computeFace(int f);
+		void _computeVertex(int v);
+
+		MeshType *          mpMesh = NULL;
+		Weighting           mWeighting = Area;
+
+		std::vector<VPtr>   mVertices;
+		std::vector<FPtr>   mFaces;
+		std::vector<int>    mVertexIds;
+		std::vector<int>    mFaceIds;
+		/*! vertex -> corners 3 * f + k, k being the place of the vertex in face f */
+		CCSRArray           mVCorners;
+
+		/*! structure of arrays for the face pass: vertex ids of the corners, positions, normals */
+		std::vector<int>    mFV[3];
+		std::vector<double> mPx, mPy, mPz;
+		std::vector<double> mFNx, mFNy, mFNz, mFArea;
+		/*! angles at the corners, only for the angle weighting */
+		std::vector<double> mFAngle[3];
+		std::vector<CPoint> mVNormals;
+
+		/*! marks of the incremental update */
+		std::vector<int>    mFaceStamps, mVertexStamps;
+		int                 mStamp = 0;
+	};
+
+	template<typename MeshType>
+	inline void CMeshNormals<MeshType>::build(MeshType * pMesh, Weighting weighting)
+	{
+		mpMesh = pMesh;
+		mWeighting = weighting;
+		CMeshCSR<typename MeshType::VType, typename MeshType::FType> csr;
+		pMesh->buildCSR(csr);
+		mVertices.swap(csr.vertices);
+		mFaces.swap(csr.faces);
+		mVertexIds.swap(csr.vertexIds);
+		mFaceIds.swap(csr.faceIds);
+
+		const int numV = numVertices(), numF = numFaces();
+		for (int k = 0; k < 3; ++k) {
+			mFV[k].resize(numF);
+			mFAngle[k].assign(weighting == Angle ? numF : 0, 0.0);
+		}
+#pragma omp parallel for
+		for (int f = 0; f < numF; ++f) {
+			HEPtr pH = MeshType::faceHalfedge(mFaces[f]);
+			for (int k = 0; k < 3; ++k) {
+				mFV[k][f] = mVertexIds[pH->target()->index()];
+				pH = MeshType::halfedgeNext(pH);
+			}
+		}
+		mVCorners.build(numV, [&](int v, std::vector<int> & row) {
+			for (const int * f = csr.vf.begin(v); f != csr.vf.end(v); ++f) {
+				for (int k = 0; k < 3; ++k) {
+					if (mFV[k][*f] == v) row.push_back(3 * *f + k);
+				}
+			}
+		});
+
+		mPx.resize(numV);
+		mPy.resize(numV);
+		mPz.resize(numV);
+		mFNx.resize(numF);
+		mFNy.resize(numF);
+		mFNz.resize(numF);
+		mFArea.resize(numF);
+		mVNormals.resize(numV);
+		mFaceStamps.assign(numF, 0);
+		mVertexStamps.assign(numV, 0);
+		mStamp = 0;
+		update();
+	}
+
+	template<typename MeshType>
+	inline void CMeshNormals<MeshType>::update()
+	{
+		const int numV = numVertices(), numF = numFaces();
+#pragma omp parallel for
+		for (int v = 0; v < numV; ++v) {
+			const CPoint & p = mVertices[v]->point();
+			mPx[v] = p[0];
+			mPy[v] = p[1];
+			mPz[v] = p[2];
+		}
+#pragma omp parallel for schedule(static)
+		for (int f = 0; f < numF; ++f) {
+			_computeFace(f);
+		}
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < numV; ++v) {
+			_computeVertex(v);
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshNormals<MeshType>::update(const std::vector<VPtr> & moved)
+	{
+		++mStamp;
+		std::vector<int> faces, verts;
+		for (VPtr pV : moved) {
+			const int v = mVertexIds[pV->index()];
+			const CPoint & p = pV->point();
+			mPx[v] = p[0];
+			mPy[v] = p[1];
+			mPz[v] = p[2];
+			for (const int * c = mVCorners.begin(v); c != mVCorners.end(v); ++c) {
+				const int f = *c / 3;
+				if (mFaceStamps[f] == mStamp) continue;
+				mFaceStamps[f] = mStamp;
+				faces.push_back(f);
+			}
+		}
+		for (int f : faces) {
+			for (int k = 0; k < 3; ++k) {
+				const int v = mFV[k][f];
+				if (mVertexStamps[v] == mStamp) continue;
+				mVertexStamps[v] = mStamp;
+				verts.push_back(v);
+			}
+		}
+#pragma omp parallel for
+		for (int i = 0; i < (int)faces.size(); ++i) {
+			_computeFace(faces[i]);
+		}
+#pragma omp parallel for
+		for (int i = 0; i < (int)verts.size(); ++i) {
+			_computeVertex(verts[i]);
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshNormals<MeshType>::_computeFace(int f)
+	{
+		const int i0 = mFV[0][f], i1 = mFV[1][f], i2 = mFV[2][f];
+		const double ax = mPx[i1] - mPx[i0], ay = mPy[i1] - mPy[i0], az = mPz[i1] - mPz[i0];
+		const double bx = mPx[i2] - mPx[i0], by = mPy[i2] - mPy[i0], bz = mPz[i2] - mPz[i0];
+		const double nx = ay * bz - az * by;
+		const double ny = az * bx - ax * bz;
+		const double nz = ax * by - ay * bx;
+		const double len = sqrt(nx * nx + ny * ny + nz * nz);
+		const double inv = len > 0 ? 1.0 / len : 0.0;
+		mFNx[f] = nx * inv;
+		mFNy[f] = ny * inv;
+		mFNz[f] = nz * inv;
+		mFArea[f] = 0.5 * len;
+
+		if (mWeighting == Angle) {
+			/* |e1 x e2| is twice the area at every corner, only the dot products differ */
+			const double cx = mPx[i2] - mPx[i1], cy = mPy[i2] - mPy[i1], cz = mPz[i2] - mPz[i1];
+			mFAngle[0][f] = atan2(len, ax * bx + ay * by + az * bz);
+			mFAngle[1][f] = atan2(len, -(ax * cx + ay * cy + az * cz));
+			mFAngle[2][f] = atan2(len, bx * cx + by * cy + bz * cz);
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshNormals<MeshType>::_computeVertex(int v)
+	{
+		double nx = 0, ny = 0, nz = 0;
+		for (const int * c = mVCorners.begin(v); c != mVCorners.end(v); ++c) {
+			const int f = *c / 3;
+			double w;
+			switch (mWeighting) {
+			case Uniform: w = 1.0; break;
+			case Area: w = mFArea[f]; break;
+			default: w = mFAngle[*c % 3][f]; break;
+			}
+			nx += w * mFNx[f];
+			ny += w * mFNy[f];
+			nz += w * mFNz[f];
+		}
+		const double len = sqrt(nx * nx + ny * ny + nz * nz);
+		const double inv = len > 0 ? 1.0 / len : 0.0;
+		mVNormals[v] = CPoint(nx * inv, ny * inv, nz * inv);
+	}
+}
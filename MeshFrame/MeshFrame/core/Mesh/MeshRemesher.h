@@ -0,0 +1,365 @@
+/*!
+*      \file MeshRemesher.h
+*      \brief Isotropic remeshing of a DynamicMesh towards a target edge length
+*
+*		Each iteration splits the edges longer than 4/3 of the target, collapses those shorter than 4/5 of it,
+*		flips edges to bring the valences towards 6 (4 on the boundary), then relaxes the vertices in their
+*		tangent plane and projects them back onto the input surface, kept in a face BVH.
+*		The boundary and the sharp edges are features: they are split and collapsed along themselves only,
+*		never flipped, and their vertices do not move. The vertices where a feature turns sharply, or where
+*		other than two features meet, are corners and are kept.
+*		The topological phases gather their edges in one parallel sweep of the pool, then edit them one by
+*		one; the smoothing and the projection are parallel.
+*/
+
+#pragma once
+
+#include <vector>
+#include <math.h>
+#include "../Parallel/OpenMP.h"
+
+#include "../Parallel/ParallelAlgorithms.h"
+#include "../Spatial/FaceBVH.h"
+#include "MeshNormals.h"
+#include "DynamicMesh.h"
+
+namespace MeshLib {
+
+	template<typename MeshType>
+	class CMeshRemesher
+	{
+	public:
+		typedef typename MeshType::VPtr VPtr;
+		typedef typename MeshType::EPtr EPtr;
+		typedef typename MeshType::FPtr FPtr;
+		typedef typename MeshType::HEPtr HEPtr;
+
+		/*! edges for which this prop is true are kept as creases, NULL for none; it is kept up to date */
+		EPropHandle<bool> * pSharpHdl = NULL;
+		/*! relaxation steps after the topological phases of each iteration */
+		int smoothingSteps = 1;
+		/*! a vertex where its two feature edges turn by more than this angle, in degrees, is a corner */
+		double cornerAngle = 30.0;
+
+		/*!
+		Remesh pMesh in place towards edges of length targetLength.
+		\return the number of vertices at the end
+		*/
+		int remesh(MeshType * pMesh, double targetLength, int iterations = 10);
+
+	private:
+		/*! the passes of a phase repeat at most this many times per iteration, and stop when they change less
+		than one edge in MIN_CHANGES */
+		static const int MAX_PASSES = 8;
+		static const int MIN_CHANGES = 1000;
+
+		int _splitLong();
+		int _collapseShort();
+		int _equalizeValences();
+		void _smooth();
+
+		/*! indices of the live edges for which pred(pE) holds, in one parallel sweep */
+		template<typename Pred>
+		void _gatherEdges(Pred pred, std::vector<int> & indices);
+		/*! whether merging the ends of pH at p, pRemoved going, keeps the features, the edge lengths and the face orientations */
+		bool _canCollapse(HEPtr pH, VPtr pRemoved, const CPoint & p);
+		/*! whether moving pV to p leaves an edge of pV longer than the upper bound, pOther being ignored */
+		bool _makesLongEdge(VPtr pV, VPtr pOther, const CPoint & p);
+		/*! whether moving pV to p turns a face of pV not containing pOther upside down */
+		bool _flipsFace(VPtr pV, VPtr pOther, const CPoint & p);
+		/*! the number of neighbours of pV */
+		static int _valence(VPtr pV) { return (int)pV->outHEs().size() + (pV->boundary() ? 1 : 0); };
+		/*! calls visit(neighbour, edge) for the vertices adjacent to pV */
+		template<typename Visit>
+		static void _forEachNeighbor(VPtr pV, Visit visit);
+
+		enum Kind
+		{
+			Free,
+			/*! on a sharp edge or on the boundary, it slides along it */
+			Crease,
+			Corner
+		};
+		bool _feature(EPtr pE) { return mpMesh->gEP(mFeatureHdl, pE) != 0; };
+		int & _kind(VPtr pV) { return mpMesh->gVP(mKindHdl, pV); };
+		/*! classify the vertices from the feature edges around them */
+		void _initKinds();
+		double _length2(EPtr pE)
+		{
+			HEPtr pH = (HEPtr)pE->halfedge();
+			const CPoint d = pH->target()->point() - pH->source()->point();
+			return d * d;
+		};
+
+		MeshType *          mpMesh = NULL;
+		/*! the input surface */
+		const CFaceBVH<MeshType> * mpReference = NULL;
+		EPropHandle<char>   mFeatureHdl;
+		VPropHandle<int>    mKindHdl;
+		double              mLow2 = 0;
+		double              mHigh2 = 0;
+	};
+
+	template<typename MeshType>
+	inline int CMeshRemesher<MeshType>::remesh(MeshType * pMesh, double targetLength, int iterations)
+	{
+		mpMesh = pMesh;
+		mLow2 = (0.8 * targetLength) * (0.8 * targetLength);
+		mHigh2 = (4.0 / 3.0 * targetLength) * (4.0 / 3.0 * targetLength);
+		/* the triangles are copied into the tree, which is only queried for points: the faces it refers to can go */
+		CFaceBVH<MeshType> reference;
+		reference.build(pMesh);
+		mpReference = &reference;
+
+		pMesh->addEProp(mFeatureHdl, (char)0);
+		pMesh->addVProp(mKindHdl, (int)Free);
+		for (EPtr pE : pMesh->getEContainer()) {
+			pMesh->gEP(mFeatureHdl, pE) = pE->boundary() || (pSharpHdl && pMesh->gEP(*pSharpHdl, pE));
+		}
+		_initKinds();
+
+		/* a phase is repeated while it changes a noticeable share of the edges: each pass sweeps the whole pool */
+		auto converged = [&](int numChanges) { return (double)numChanges * MIN_CHANGES <= (double)pMesh->numEdges(); };
+		for (int i = 0; i < iterations; ++i) {
+			for (int pass = 0; pass < MAX_PASSES && !converged(_splitLong()); ++pass);
+			for (int pass = 0; pass < MAX_PASSES && !converged(_collapseShort()); ++pass);
+			for (int pass = 0; pass < MAX_PASSES && !converged(_equalizeValences()); ++pass);
+			for (int k = 0; k < smoothingSteps; ++k) _smooth();
+		}
+
+		if (pSharpHdl) {
+			for (EPtr pE : pMesh->getEContainer()) pMesh->gEP(*pSharpHdl, pE) = _feature(pE) && !pE->boundary();
+		}
+		pMesh->removeEProp(mFeatureHdl);
+		pMesh->removeVProp(mKindHdl);
+		mpReference = NULL;
+		return (int)pMesh->numVertices();
+	}
+
+	template<typename MeshType>
+	inline int CMeshRemesher<MeshType>::_splitLong()
+	{
+		std::vector<int> indices;
+		_gatherEdges([&](EPtr pE) { return _length2(pE) > mHigh2; }, indices);
+		auto & edges = mpMesh->getEContainer();
+		/* a split only shortens edges, so each gathered edge is still there and still long */
+		for (int i : indices) {
+			EPtr pE = edges.getPointer(i);
+			HEPtr pH = (HEPtr)pE->halfedge();
+			const CPoint p = (pH->source()->point() + pH->target()->point()) / 2;
+			VPtr pV = mpMesh->splitEdge(pE, p);
+			/* the two halves of a feature are features, the new edges across the faces are not */
+			_kind(pV) = _feature(pE) ? Crease : Free;
+		}
+		return (int)indices.size();
+	}
+
+	template<typename MeshType>
+	inline int CMeshRemesher<MeshType>::_collapseShort()
+	{
+		std::vector<int> indices;
+		_gatherEdges([&](EPtr pE) { return _length2(pE) < mLow2; }, indices);
+		auto & edges = mpMesh->getEContainer();
+		int numCollapses = 0;
+		for (int i : indices) {
+			/* collapses only delete edges, so a live index is still the gathered edge */
+			if (edges.hasBeenDeleted(i)) continue;
+			EPtr pE = edges.getPointer(i);
+			if (_length2(pE) >= mLow2) continue;
+			HEPtr pH = (HEPtr)pE->halfedge();
+			HEPtr pS = (HEPtr)pH->he_sym();
+			VPtr pVs = (VPtr)pH->source();
+			VPtr pVt = (VPtr)pH->target();
+			for (VPtr pRemoved : { pVs, pVt }) {
+				VPtr pKept = pRemoved == pVs ? pVt : pVs;
+				/* a boundary edge has no halfedge from its target: pH is collapsed, and the kept vertex takes
+				the place and the kind of the source */
+				HEPtr pC = pRemoved == pVs ? pH : (pS ? pS : pH);
+				/* a free edge collapses to its midpoint, otherwise the kept vertex stays where it is */
+				const CPoint p = _kind(pRemoved) == Free && _kind(pKept) == Free ? (pVs->point() + pVt->point()) / 2 : pKept->point();
+				if (!_canCollapse(pC, pRemoved, p)) continue;
+				const int kind = _kind(pKept);
+
+				/* the edges deleted with the faces of pC merge into the kept ones, and so do their feature flags */
+				HEPtr pN = (HEPtr)pC->he_next();
+				HEPtr pP = (HEPtr)pC->he_prev();
+				mpMesh->gEP(mFeatureHdl, (EPtr)pN->edge()) |= mpMesh->gEP(mFeatureHdl, (EPtr)pP->edge());
+				HEPtr pCs = (HEPtr)pC->he_sym();
+				if (pCs) {
+					EPtr pKept = (EPtr)pCs->he_prev()->edge();
+					mpMesh->gEP(mFeatureHdl, pKept) |= mpMesh->gEP(mFeatureHdl, (EPtr)pCs->he_next()->edge());
+				}
+				VPtr pV = mpMesh->collapseHalfedge(pC);
+				mpMesh->moveVertex(pV, p);
+				_kind(pV) = kind;
+				++numCollapses;
+				break;
+			}
+		}
+		return numCollapses;
+	}
+
+	template<typename MeshType>
+	inline int CMeshRemesher<MeshType>::_equalizeValences()
+	{
+		auto deviation = [](VPtr pV, int valence) {
+			const int d = valence - (pV->boundary() ? 4 : 6);
+			return d < 0 ? -d : d;
+		};
+		/* the deviation of the four vertices from their target valence, before minus after the flip */
+		auto gain = [&](EPtr pE) {
+			HEPtr pH = (HEPtr)pE->halfedge();
+			HEPtr pS = (HEPtr)pH->he_sym();
+			VPtr pVa = (VPtr)pH->source(), pVb = (VPtr)pH->target();
+			VPtr pVc = (VPtr)pH->he_next()->target(), pVd = (VPtr)pS->he_next()->target();
+			const int va = _valence(pVa), vb = _valence(pVb), vc = _valence(pVc), vd = _valence(pVd);
+			return deviation(pVa, va) + deviation(pVb, vb) + deviation(pVc, vc) + deviation(pVd, vd)
+				- deviation(pVa, va - 1) - deviation(pVb, vb - 1) - deviation(pVc, vc + 1) - deviation(pVd, vd + 1);
+		};
+		std::vector<int> indices;
+		_gatherEdges([&](EPtr pE) { return !_feature(pE) && gain(pE) > 0; }, indices);
+		auto & edges = mpMesh->getEContainer();
+		int numFlips = 0;
+		for (int i : indices) {
+			EPtr pE = edges.getPointer(i);
+			/* the valences changed with the previous flips */
+			if (gain(pE) <= 0 || !mpMesh->isFlipOk(pE)) continue;
+			/* the new faces must keep the orientation of the pair */
+			HEPtr pH = (HEPtr)pE->halfedge();
+			const CPoint & a = pH->source()->point();
+			const CPoint & b = pH->target()->point();
+			const CPoint & c = pH->he_next()->target()->point();
+			const CPoint & d = pH->he_sym()->he_next()->target()->point();
+			const CPoint n = ((b - a) ^ (c - a)) + ((a - b) ^ (d - b));
+			if (((a - c) ^ (d - c)) * n <= 0 || ((b - d) ^ (c - d)) * n <= 0) continue;
+			mpMesh->flipEdge(pE);
+			++numFlips;
+		}
+		return numFlips;
+	}
+
+	template<typename MeshType>
+	inline void CMeshRemesher<MeshType>::_smooth()
+	{
+		CMeshNormals<MeshType> normals;
+		normals.build(mpMesh);
+		const int numV = normals.numVertices();
+		std::vector<CPoint> points(numV);
+		/* uniform Laplacian, without its normal component so that the surface does not shrink */
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < numV; ++i) {
+			VPtr pV = normals.vertex(i);
+			points[i] = pV->point();
+			if (_kind(pV) != Free) continue;
+			CPoint centroid(0, 0, 0);
+			int n = 0;
+			_forEachNeighbor(pV, [&](VPtr pW, EPtr) { centroid += pW->point(); ++n; });
+			if (n == 0) continue;
+			const CPoint & normal = normals.vertexNormal(i);
+			CPoint d = centroid / n - pV->point();
+			d -= normal * (normal * d);
+			points[i] += d;
+		}
+
+		std::vector<typename CFaceBVH<MeshType>::Hit> hits;
+		std::vector<CPoint> closest;
+		mpReference->closestPoints(points, hits, &closest);
+		/* moveVertex keeps the attached spatial indices up to date, which is not thread safe */
+		for (int i = 0; i < numV; ++i) {
+			VPtr pV = normals.vertex(i);
+			if (_kind(pV) == Free && hits[i].pF != NULL) mpMesh->moveVertex(pV, closest[i]);
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshRemesher<MeshType>::_initKinds()
+	{
+		const double cosCorner = cos(cornerAngle * 3.14159265358979323846 / 180.0);
+		for (VPtr pV : mpMesh->getVContainer()) {
+			VPtr pEnds[2];
+			int numFeatures = 0;
+			_forEachNeighbor(pV, [&](VPtr pW, EPtr pE) {
+				if (!_feature(pE)) return;
+				if (numFeatures < 2) pEnds[numFeatures] = pW;
+				++numFeatures;
+			});
+			if (numFeatures == 0) continue;
+			_kind(pV) = Corner;
+			if (numFeatures != 2) continue;
+			/* the directions in and out of pV along the features */
+			CPoint in = pV->point() - pEnds[0]->point();
+			CPoint out = pEnds[1]->point() - pV->point();
+			const double norms = in.norm() * out.norm();
+			if (norms > 0 && in * out >= cosCorner * norms) _kind(pV) = Crease;
+		}
+	}
+
+	template<typename MeshType>
+	template<typename Pred>
+	inline void CMeshRemesher<MeshType>::_gatherEdges(Pred pred, std::vector<int> & indices)
+	{
+		auto & edges = mpMesh->getEContainer();
+		const int numE = (int)edges.getCurrentIndex();
+		std::vector<int> flags(numE);
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < numE; ++i) flags[i] = !edges.hasBeenDeleted(i) && pred(edges.getPointer(i));
+		indices.resize(Parallel::exclusiveScan(flags));
+#pragma omp parallel for
+		for (int i = 0; i < numE; ++i) {
+			if (i + 1 < numE ? flags[i + 1] != flags[i] : flags[i] < (int)indices.size()) indices[flags[i]] = i;
+		}
+	}
+
+	template<typename MeshType>
+	inline bool CMeshRemesher<MeshType>::_canCollapse(HEPtr pH, VPtr pRemoved, const CPoint & p)
+	{
+		VPtr pV0 = (VPtr)pH->source();
+		VPtr pV1 = (VPtr)pH->target();
+		/* a free vertex goes anywhere, a crease vertex only along its feature, a corner stays */
+		const int kind = _kind(pRemoved);
+		if (kind == Corner || (kind == Crease && !_feature((EPtr)pH->edge()))) return false;
+		if (!mpMesh->isCollapseOk(pH)) return false;
+		if (_makesLongEdge(pV0, pV1, p) || _makesLongEdge(pV1, pV0, p)) return false;
+		return !_flipsFace(pV0, pV1, p) && !_flipsFace(pV1, pV0, p);
+	}
+
+	template<typename MeshType>
+	inline bool CMeshRemesher<MeshType>::_makesLongEdge(VPtr pV, VPtr pOther, const CPoint & p)
+	{
+		bool longEdge = false;
+		_forEachNeighbor(pV, [&](VPtr pW, EPtr) {
+			if (pW == pOther) return;
+			const CPoint d = pW->point() - p;
+			if (d * d > mHigh2) longEdge = true;
+		});
+		return longEdge;
+	}
+
+	template<typename MeshType>
+	inline bool CMeshRemesher<MeshType>::_flipsFace(VPtr pV, VPtr pOther, const CPoint & p)
+	{
+		for (auto pH : pV->outHEs()) {
+			VPtr pVb = (VPtr)pH->target();
+			VPtr pVc = (VPtr)pH->he_next()->target();
+			if (pVb == pOther || pVc == pOther) continue;
+			const CPoint & b = pVb->point();
+			const CPoint & c = pVc->point();
+			const CPoint before = (b - pV->point()) ^ (c - pV->point());
+			const CPoint after = (b - p) ^ (c - p);
+			if (before * after <= 0) return true;
+		}
+		return false;
+	}
+
+	template<typename MeshType>
+	template<typename Visit>
+	inline void CMeshRemesher<MeshType>::_forEachNeighbor(VPtr pV, Visit visit)
+	{
+		for (auto pH : pV->outHEs()) {
+			visit((VPtr)pH->target(), (EPtr)pH->edge());
+			/* on the boundary one neighbour is only the source of an incoming halfedge */
+			HEPtr pHIn = (HEPtr)pH->he_prev();
+			if (pHIn->he_sym() == NULL) visit((VPtr)pHIn->source(), (EPtr)pHIn->edge());
+		}
+	}
+}
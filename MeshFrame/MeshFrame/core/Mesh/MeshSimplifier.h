@@ -0,0 +1,421 @@
+/*!
+*      \file MeshSimplifier.h
+*      \brief Quadric error metric simplification of a DynamicMesh by halfedge collapses
+*
+*		The quadrics of the vertices are kept in a vertex prop and the optimal position of each edge in an
+*		edge prop, both removed when done. The edges are ordered in an indexed heap: after a collapse
+*		the costs of the edges around the kept vertex are updated in place, so the heap holds no stale
+*		entries. The initial quadrics and costs are computed in parallel.
+*
+*		simplifyParallel works in rounds instead: among the cheapest edges it picks those that are the
+*		cheapest within two rings of their end vertices, so that their collapses touch disjoint parts of
+*		the mesh, and collapses them and updates the costs around them concurrently.
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <float.h>
+#include <limits.h>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Quadric.h"
+#include "../Memory/IndexedHeap.h"
+#include "../Parallel/ParallelAlgorithms.h"
+#include "DynamicMesh.h"
+
+namespace MeshLib {
+
+	template<typename MeshType>
+	class CMeshSimplifier
+	{
+	public:
+		typedef typename MeshType::VPtr VPtr;
+		typedef typename MeshType::EPtr EPtr;
+		typedef typename MeshType::FPtr FPtr;
+		typedef typename MeshType::HEPtr HEPtr;
+
+		/*! weight of the planes keeping the boundary in place, relative to the area weighted face planes */
+		double boundaryWeight = 100.0;
+		/*! reject collapses turning the normal of a face around by more than 90 degrees */
+		bool preventFlips = true;
+		/*! simplifyParallel: the share of the edges, cheapest first, competing in a round */
+		double roundFraction = 0.03;
+		/*! simplifyParallel: the passes electing independent collapses in a round */
+		static const int MAX_PASSES = 8;
+
+		/*!
+		Collapse the edges of least error until the mesh has at most targetFaces faces, or the least
+		error is above maxError.
+		\return the number of collapses done
+		*/
+		int simplify(MeshType * pMesh, int targetFaces, double maxError = DBL_MAX);
+		/*!
+		Same as simplify, the collapses being done by rounds of independent ones in parallel; the pools of the
+		mesh are compacted at the end. The spatial indices attached to the mesh must be detached.
+		\return the number of collapses done
+		*/
+		int simplifyParallel(MeshType * pMesh, int targetFaces, double maxError = DBL_MAX);
+
+		/*! called by simplify before each collapse, with the halfedge whose source is about to be merged into its
+		target and the position the target is moved to, e.g. to record the vertex splits of a progressive mesh */
+		typedef std::function<void(HEPtr pH, const CPoint & p)> CollapseObserver;
+		void setCollapseObserver(const CollapseObserver & observer) { mCollapseObserver = observer; };
+
+	private:
+		void _initQuadrics();
+		/*! the quadric of the plane through the boundary halfedge pH, perpendicular to its face */
+		CQuadric _boundaryQuadric(HEPtr pH);
+		/*! compute the optimal position of pE and return its error */
+		double _computeCost(EPtr pE);
+		/*! whether moving the vertices of pH to p flips a face that is kept */
+		bool _flips(HEPtr pH, const CPoint & p);
+		bool _flipsAround(VPtr pV, HEPtr pH, const CPoint & p);
+		/*! the least of values[v] over the vertices v within two rings of the end vertices of pE */
+		static int _minWithin2Rings(EPtr pE, const std::vector<int> & values);
+		/*! a well mixed hash of an index and a seed */
+		static unsigned int _hash(int i, int seed)
+		{
+			unsigned int h = (unsigned int)i * 0x9E3779B1u ^ (unsigned int)seed * 0x85EBCA77u;
+			h ^= h >> 16; h *= 0x7FEB352Du; h ^= h >> 15; h *= 0x846CA68Bu; h ^= h >> 16;
+			return h;
+		};
+		/*! calls visit(neighbour, edge) for the vertices adjacent to pV */
+		template<typename Visit>
+		static void _forEachNeighbor(VPtr pV, Visit visit);
+
+		MeshType *             mpMesh = NULL;
+		VPropHandle<CQuadric>  mQuadricHdl;
+		EPropHandle<CPoint>    mPositionHdl;
+		CIndexedHeap<4>        mHeap;
+		CollapseObserver       mCollapseObserver;
+	};
+
+	template<typename MeshType>
+	inline int CMeshSimplifier<MeshType>::simplify(MeshType * pMesh, int targetFaces, double maxError)
+	{
+		mpMesh = pMesh;
+		pMesh->addVProp(mQuadricHdl);
+		pMesh->addEProp(mPositionHdl);
+		_initQuadrics();
+
+		std::vector<EPtr> edges;
+		edges.reserve(pMesh->getEContainer().size());
+		for (EPtr pE : pMesh->getEContainer()) edges.push_back(pE);
+		const int numE = (int)edges.size();
+		std::vector<int> ids(numE);
+		std::vector<double> costs(numE);
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < numE; ++i) {
+			ids[i] = (int)edges[i]->index();
+			costs[i] = _computeCost(edges[i]);
+		}
+		mHeap.reset((int)pMesh->getEContainer().getCurrentIndex());
+		mHeap.build(ids, costs);
+
+		int numFaces = pMesh->numFaces();
+		int numCollapses = 0;
+		while (numFaces > targetFaces && !mHeap.empty() && mHeap.topKey() <= maxError) {
+			EPtr pE = pMesh->getEContainer().getPointer(mHeap.pop());
+			HEPtr pH = (HEPtr)pE->halfedge();
+			const CPoint p = pMesh->gEP(mPositionHdl, pE);
+			/* an illegal edge is dropped, it comes back when its neighbourhood changes */
+			if (!pMesh->isCollapseOk(pH) || (preventFlips && _flips(pH, p))) continue;
+
+			HEPtr pS = (HEPtr)pH->he_sym();
+			mHeap.remove((int)pH->he_prev()->edge()->index());
+			if (pS) mHeap.remove((int)pS->he_next()->edge()->index());
+			const CQuadric q = pMesh->gVP(mQuadricHdl, (VPtr)pH->source()) + pMesh->gVP(mQuadricHdl, (VPtr)pH->target());
+			if (mCollapseObserver) mCollapseObserver(pH, p);
+
+			VPtr pV = pMesh->collapseHalfedge(pH);
+			pMesh->moveVertex(pV, p);
+			pMesh->gVP(mQuadricHdl, pV) = q;
+			numFaces -= pS ? 2 : 1;
+			++numCollapses;
+
+			_forEachNeighbor(pV, [&](VPtr, EPtr pEAround) { mHeap.push((int)pEAround->index(), _computeCost(pEAround)); });
+		}
+
+		mHeap.reset(0);
+		pMesh->removeVProp(mQuadricHdl);
+		pMesh->removeEProp(mPositionHdl);
+		return numCollapses;
+	}
+
+	template<typename MeshType>
+	inline int CMeshSimplifier<MeshType>::simplifyParallel(MeshType * pMesh, int targetFaces, double maxError)
+	{
+		mpMesh = pMesh;
+		/* the vertex pair index is not updated concurrently */
+		pMesh->invalidateVertexPairIndex();
+		pMesh->addVProp(mQuadricHdl);
+		pMesh->addEProp(mPositionHdl);
+		_initQuadrics();
+
+		auto & vertices = pMesh->getVContainer();
+		auto & edges = pMesh->getEContainer();
+		int numVIndices = 0, numEIndices = 0;
+		/* DBL_MAX for the deleted edges and those whose collapse was rejected */
+		std::vector<double> costs;
+		std::vector<int> flags, candidates, winners, endpoints;
+		/* edge -> rank among the competing candidates, vertex -> least rank of its edges */
+		std::vector<int> ranks, bestRanks;
+		int numFaces = pMesh->numFaces();
+		int numCollapses = 0;
+		int round = 0;
+		while (numFaces > targetFaces) {
+			/* a round costs as much as the pools are long: compact them once half of the edges are gone */
+			if (2 * (int)edges.size() < numEIndices) pMesh->compact();
+			if ((int)edges.getCurrentIndex() != numEIndices) {
+				numVIndices = (int)vertices.getCurrentIndex();
+				numEIndices = (int)edges.getCurrentIndex();
+				costs.assign(numEIndices, DBL_MAX);
+#pragma omp parallel for schedule(dynamic, 1024)
+				for (int i = 0; i < numEIndices; ++i) {
+					if (!edges.hasBeenDeleted(i)) costs[i] = _computeCost(edges.getPointer(i));
+				}
+				flags.resize(numEIndices);
+				ranks.assign(numEIndices, INT_MAX);
+				bestRanks.assign(numVIndices, INT_MAX);
+			}
+
+			/* the candidates are the cheapest edges */
+#pragma omp parallel for
+			for (int i = 0; i < numEIndices; ++i) flags[i] = costs[i] < DBL_MAX && costs[i] <= maxError;
+			candidates.resize(Parallel::exclusiveScan(flags));
+			if (candidates.empty()) break;
+#pragma omp parallel for
+			for (int i = 0; i < numEIndices; ++i) {
+				if (i + 1 < numEIndices ? flags[i + 1] != flags[i] : flags[i] < (int)candidates.size()) candidates[flags[i]] = i;
+			}
+			auto cheaper = [&](int a, int b) { return costs[a] < costs[b] || (costs[a] == costs[b] && a < b); };
+			const int numCandidates = std::max(1, (int)(roundFraction * candidates.size()));
+			std::nth_element(candidates.begin(), candidates.begin() + numCandidates - 1, candidates.end(), cheaper);
+			candidates.resize(numCandidates);
+			/* within the cheap share the ranks are shuffled rather than ordered by cost: ordered ranks form long
+			chains of neighbours each losing to the next, and few candidates win a round. The hash changes with
+			the round so that an edge losing once does not lose again for the same reason */
+			auto shuffled = [&](int a, int b) { return _hash(a, round) < _hash(b, round) || (_hash(a, round) == _hash(b, round) && a < b); };
+			Parallel::sort(candidates.begin(), candidates.end(), shuffled);
+			++round;
+
+			/* a candidate wins if it has the least rank among the candidates with an end vertex within two rings
+			of its own end vertices, so the vertices read or written by two winners are disjoint. The candidates
+			too close to a winner drop out and the others compete again, until none is left */
+			winners.clear();
+			const int maxWinners = (numFaces - targetFaces + 1) / 2;
+			for (int pass = 0; pass < MAX_PASSES && !candidates.empty() && (int)winners.size() < maxWinners; ++pass) {
+				const int numActive = (int)candidates.size();
+#pragma omp parallel for
+				for (int j = 0; j < numActive; ++j) ranks[candidates[j]] = j;
+				endpoints.resize(2 * numActive);
+#pragma omp parallel for
+				for (int j = 0; j < numActive; ++j) {
+					HEPtr pH = (HEPtr)edges.getPointer(candidates[j])->halfedge();
+					endpoints[2 * j] = (int)pH->source()->index();
+					endpoints[2 * j + 1] = (int)pH->target()->index();
+				}
+				Parallel::sort(endpoints.begin(), endpoints.end());
+				endpoints.erase(std::unique(endpoints.begin(), endpoints.end()), endpoints.end());
+				const int numEndpoints = (int)endpoints.size();
+#pragma omp parallel for schedule(dynamic, 1024)
+				for (int k = 0; k < numEndpoints; ++k) {
+					int best = INT_MAX;
+					_forEachNeighbor(vertices.getPointer(endpoints[k]), [&](VPtr, EPtr pE) { best = std::min(best, ranks[pE->index()]); });
+					bestRanks[endpoints[k]] = best;
+				}
+#pragma omp parallel for schedule(dynamic, 256)
+				for (int j = 0; j < numActive; ++j) {
+					flags[j] = _minWithin2Rings(edges.getPointer(candidates[j]), bestRanks) == j;
+				}
+#pragma omp parallel for
+				for (int k = 0; k < numEndpoints; ++k) bestRanks[endpoints[k]] = INT_MAX;
+#pragma omp parallel for
+				for (int j = 0; j < numActive; ++j) ranks[candidates[j]] = INT_MAX;
+
+				/* the winners mark their end vertices, the candidates near a mark drop out */
+				int numNew = 0;
+				for (int j = 0; j < numActive && (int)winners.size() < maxWinners; ++j) {
+					if (!flags[j]) continue;
+					HEPtr pH = (HEPtr)edges.getPointer(candidates[j])->halfedge();
+					bestRanks[pH->source()->index()] = bestRanks[pH->target()->index()] = -1;
+					winners.push_back(candidates[j]);
+					++numNew;
+				}
+				if (numNew == 0) break;
+#pragma omp parallel for schedule(dynamic, 256)
+				for (int j = 0; j < numActive; ++j) {
+					flags[j] = _minWithin2Rings(edges.getPointer(candidates[j]), bestRanks) == INT_MAX;
+				}
+				int numLeft = 0;
+				for (int j = 0; j < numActive; ++j) {
+					if (flags[j]) candidates[numLeft++] = candidates[j];
+				}
+				candidates.resize(numLeft);
+			}
+			for (int w : winners) {
+				HEPtr pH = (HEPtr)edges.getPointer(w)->halfedge();
+				bestRanks[pH->source()->index()] = bestRanks[pH->target()->index()] = INT_MAX;
+			}
+
+			const int numWinners = (int)winners.size();
+			int numRemoved = 0, numDone = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:numRemoved, numDone)
+			for (int w = 0; w < numWinners; ++w) {
+				EPtr pE = edges.getPointer(winners[w]);
+				HEPtr pH = (HEPtr)pE->halfedge();
+				const CPoint p = pMesh->gEP(mPositionHdl, pE);
+				if (!pMesh->isCollapseOk(pH) || (preventFlips && _flips(pH, p))) {
+					costs[winners[w]] = DBL_MAX;
+					continue;
+				}
+				const CQuadric q = pMesh->gVP(mQuadricHdl, (VPtr)pH->source()) + pMesh->gVP(mQuadricHdl, (VPtr)pH->target());
+				numRemoved += pH->he_sym() ? 2 : 1;
+				++numDone;
+
+				VPtr pV = pMesh->collapseHalfedge(pH);
+				pV->point() = p;
+				pMesh->gVP(mQuadricHdl, pV) = q;
+				_forEachNeighbor(pV, [&](VPtr, EPtr pEAround) { costs[pEAround->index()] = _computeCost(pEAround); });
+			}
+#pragma omp parallel for
+			for (int i = 0; i < numEIndices; ++i) {
+				if (costs[i] < DBL_MAX && edges.hasBeenDeleted(i)) costs[i] = DBL_MAX;
+			}
+			numFaces -= numRemoved;
+			numCollapses += numDone;
+		}
+
+		pMesh->removeVProp(mQuadricHdl);
+		pMesh->removeEProp(mPositionHdl);
+		pMesh->compact();
+		return numCollapses;
+	}
+
+	template<typename MeshType>
+	inline int CMeshSimplifier<MeshType>::_minWithin2Rings(EPtr pE, const std::vector<int> & values)
+	{
+		HEPtr pH = (HEPtr)pE->halfedge();
+		int best = INT_MAX;
+		for (VPtr pV : { (VPtr)pH->source(), (VPtr)pH->target() }) {
+			best = std::min(best, values[pV->index()]);
+			_forEachNeighbor(pV, [&](VPtr pW, EPtr) {
+				best = std::min(best, values[pW->index()]);
+				_forEachNeighbor(pW, [&](VPtr pU, EPtr) { best = std::min(best, values[pU->index()]); });
+			});
+		}
+		return best;
+	}
+
+	template<typename MeshType>
+	template<typename Visit>
+	inline void CMeshSimplifier<MeshType>::_forEachNeighbor(VPtr pV, Visit visit)
+	{
+		for (auto pH : pV->outHEs()) {
+			visit((VPtr)pH->target(), (EPtr)pH->edge());
+			/* on the boundary one neighbour is only the source of an incoming halfedge */
+			HEPtr pHIn = (HEPtr)pH->he_prev();
+			if (pHIn->he_sym() == NULL) visit((VPtr)pHIn->source(), (EPtr)pHIn->edge());
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshSimplifier<MeshType>::_initQuadrics()
+	{
+		std::vector<FPtr> faces;
+		faces.reserve(mpMesh->getFContainer().size());
+		for (FPtr pF : mpMesh->getFContainer()) faces.push_back(pF);
+		std::vector<VPtr> vertices;
+		vertices.reserve(mpMesh->getVContainer().size());
+		for (VPtr pV : mpMesh->getVContainer()) vertices.push_back(pV);
+
+		/* area weighted plane of each face, indexed by the face index */
+		std::vector<CQuadric> faceQuadrics(mpMesh->getFContainer().getCurrentIndex());
+		const int numF = (int)faces.size();
+#pragma omp parallel for
+		for (int f = 0; f < numF; ++f) {
+			HEPtr pH = MeshType::faceHalfedge(faces[f]);
+			const CPoint & p0 = pH->source()->point();
+			const CPoint n = (pH->target()->point() - p0) ^ (pH->he_next()->target()->point() - p0);
+			const double norm = n.norm();
+			if (norm == 0) continue;
+			faceQuadrics[faces[f]->index()] = CQuadric::plane(n / norm, p0, 0.5 * norm);
+		}
+
+		/* each vertex gathers the planes of its faces and of its boundary edges */
+		const int numV = (int)vertices.size();
+#pragma omp parallel for
+		for (int v = 0; v < numV; ++v) {
+			CQuadric q;
+			for (auto pH : vertices[v]->outHEs()) {
+				q += faceQuadrics[pH->face()->index()];
+				if (pH->he_sym() == NULL) q += _boundaryQuadric((HEPtr)pH);
+				HEPtr pHIn = (HEPtr)pH->he_prev();
+				if (pHIn->he_sym() == NULL) q += _boundaryQuadric(pHIn);
+			}
+			mpMesh->gVP(mQuadricHdl, vertices[v]) = q;
+		}
+	}
+
+	template<typename MeshType>
+	inline CQuadric CMeshSimplifier<MeshType>::_boundaryQuadric(HEPtr pH)
+	{
+		const CPoint & p0 = pH->source()->point();
+		const CPoint e = pH->target()->point() - p0;
+		const CPoint n = e ^ (pH->he_next()->target()->point() - p0);
+		CPoint m = e ^ n;
+		const double norm = m.norm();
+		if (norm == 0) return CQuadric();
+		m /= norm;
+		return CQuadric::plane(m, p0, boundaryWeight * e.normSquare());
+	}
+
+	template<typename MeshType>
+	inline double CMeshSimplifier<MeshType>::_computeCost(EPtr pE)
+	{
+		HEPtr pH = (HEPtr)pE->halfedge();
+		VPtr pV0 = (VPtr)pH->source();
+		VPtr pV1 = (VPtr)pH->target();
+		const CQuadric q = mpMesh->gVP(mQuadricHdl, pV0) + mpMesh->gVP(mQuadricHdl, pV1);
+		CPoint & p = mpMesh->gEP(mPositionHdl, pE);
+		if (!q.minimizer(p)) {
+			/* no unique optimum: the best of the end points and the midpoint */
+			const CPoint candidates[3] = { pV0->point(), pV1->point(), (pV0->point() + pV1->point()) / 2 };
+			double best = DBL_MAX;
+			for (const CPoint & c : candidates) {
+				const double error = q.error(c);
+				if (error < best) {
+					best = error;
+					p = c;
+				}
+			}
+		}
+		const double error = q.error(p);
+		return error > 0 ? error : 0;
+	}
+
+	template<typename MeshType>
+	inline bool CMeshSimplifier<MeshType>::_flips(HEPtr pH, const CPoint & p)
+	{
+		return _flipsAround((VPtr)pH->source(), pH, p) || _flipsAround((VPtr)pH->target(), pH, p);
+	}
+
+	template<typename MeshType>
+	inline bool CMeshSimplifier<MeshType>::_flipsAround(VPtr pV, HEPtr pH, const CPoint & p)
+	{
+		HEPtr pS = (HEPtr)pH->he_sym();
+		for (auto pHOut : pV->outHEs()) {
+			/* the faces of the collapsed edge are deleted */
+			if (pHOut->face() == pH->face() || (pS && pHOut->face() == pS->face())) continue;
+			const CPoint & p1 = pHOut->target()->point();
+			const CPoint & p2 = pHOut->he_next()->target()->point();
+			const CPoint nOld = (p1 - pV->point()) ^ (p2 - pV->point());
+			const CPoint nNew = (p1 - p) ^ (p2 - p);
+			if (nOld * nNew <= 0 && nOld.normSquare() > 0) return true;
+		}
+		return false;
+	}
+}
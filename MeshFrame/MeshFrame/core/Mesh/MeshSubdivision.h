@@ -0,0 +1,453 @@
+/*!
+*      \file MeshSubdivision.h
+*      \brief Loop and sqrt(3) subdivision of triangle meshes
+*
+*		The levels are computed on flat arrays: the triangles and the twin of each halfedge of a level follow
+*		from those of the previous one by index arithmetic, so no halfedge is ever looked up, and only the
+*		last level is turned into a mesh, by readHalfedgeList. The positions of each level are a sparse
+*		matrix, the stencils, times those of the previous level. The stencils are kept, so that the output
+*		can follow the deformations of the control mesh by updatePositions alone.
+*/
+
+#pragma once
+
+#include <vector>
+#include <math.h>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Memory/CSRArray.h"
+#include "../Parallel/ParallelAlgorithms.h"
+
+namespace MeshLib {
+
+	template<typename MeshType>
+	class CMeshSubdivision
+	{
+	public:
+		typedef typename MeshType::VPtr VPtr;
+		typedef typename MeshType::FPtr FPtr;
+		typedef typename MeshType::HEPtr HEPtr;
+
+		enum Scheme
+		{
+			/*! 1 to 4 split, C2 except at the extraordinary vertices, boundaries are cubic B-splines */
+			Loop,
+			/*! 1 to 3 split and edge flips, closed meshes only */
+			Sqrt3
+		};
+
+		/*!
+		Subdivide pIn levels times into pOut.
+		\param pOut an empty mesh, vertex i of the result has index() i
+		\param limit whether to put the vertices at their limit positions instead of their positions at the last level
+		\return false if pIn has a boundary and the scheme is Sqrt3
+		*/
+		bool subdivide(MeshType * pIn, MeshType * pOut, int levels, Scheme scheme = Loop, bool limit = false);
+		/*!
+		Recompute the positions of pOut after the vertices of pIn moved, with the stencils of the last subdivide;
+		the connectivity of neither mesh may have changed.
+		*/
+		void updatePositions();
+
+	private:
+		/*! the triangles of a level and the twin of each halfedge, halfedge 3 f + k going from vertex k of face f
+		to vertex k + 1 */
+		struct Level
+		{
+			int numVerts = 0;
+			std::vector<int> faces;
+			std::vector<int> twins;
+
+			int numFaces() const { return (int)faces.size() / 3; };
+			static int next(int h) { return h % 3 == 2 ? h - 2 : h + 1; };
+			static int prev(int h) { return h % 3 == 0 ? h + 2 : h - 1; };
+		};
+		/*! the new positions as weighted sums of the previous ones, a row per new vertex */
+		struct Stencil
+		{
+			CCSRArray           pattern;
+			std::vector<double> weights;
+
+			void apply(const std::vector<CPoint> & in, std::vector<CPoint> & out) const;
+		};
+
+		/*! the out halfedges of v in turning order, starting from the boundary one if v is on the boundary */
+		static void _ring(const Level & level, int h, std::vector<int> & ring, bool & boundary);
+		/*! start[v]: an out halfedge of each vertex, returns the largest number of out halfedges of a vertex */
+		static int _starts(const Level & level, std::vector<int> & start);
+		/*! fill a stencil row by row in parallel; row(i, cols, weights) appends the entries of row i */
+		template<typename Row>
+		static void _buildStencil(int numRows, Row row, Stencil & stencil);
+
+		void _loop(const Level & level, Level & child, Stencil & stencil);
+		void _sqrt3(const Level & level, Level & child, Stencil & stencil);
+		void _limit(const Level & level, Scheme scheme, Stencil & stencil);
+
+		/*! the weights of the vertex rules, by valence, computed once */
+		double _loopBeta(int n);
+		double _sqrt3Alpha(int n);
+
+		MeshType *           mpIn = NULL;
+		MeshType *           mpOut = NULL;
+		/*! the vertices of pIn in the order of the first level */
+		std::vector<VPtr>    mInVertices;
+		std::vector<Stencil> mStencils;
+		std::vector<double>  mLoopBetas;
+		std::vector<double>  mSqrt3Alphas;
+	};
+
+	template<typename MeshType>
+	inline bool CMeshSubdivision<MeshType>::subdivide(MeshType * pIn, MeshType * pOut, int levels, Scheme scheme, bool limit)
+	{
+		mpIn = pIn;
+		mpOut = pOut;
+
+		/* the first level from the halfedge structure */
+		Level level;
+		std::vector<int> vIds(pIn->getVContainer().getCurrentIndex(), -1);
+		mInVertices.clear();
+		for (VPtr pV : pIn->getVContainer()) {
+			vIds[pV->index()] = (int)mInVertices.size();
+			mInVertices.push_back(pV);
+		}
+		std::vector<FPtr> faces;
+		faces.reserve(pIn->numFaces());
+		for (FPtr pF : pIn->getFContainer()) faces.push_back(pF);
+		const int numF = (int)faces.size();
+		level.numVerts = (int)mInVertices.size();
+		level.faces.resize(3 * numF);
+		level.twins.resize(3 * numF);
+		/* halfedge index -> halfedge of the level */
+		std::vector<int> heIds(pIn->getHEContainer().getCurrentIndex(), -1);
+#pragma omp parallel for
+		for (int f = 0; f < numF; ++f) {
+			HEPtr pH = MeshType::faceHalfedge(faces[f]);
+			for (int k = 0; k < 3; ++k) {
+				/* halfedge 3 f + k goes from vertex k to vertex k + 1 */
+				level.faces[3 * f + k] = vIds[MeshType::halfedgeSource(pH)->index()];
+				heIds[pH->index()] = 3 * f + k;
+				pH = MeshType::halfedgeNext(pH);
+			}
+		}
+		bool closed = true;
+#pragma omp parallel for reduction(&&:closed)
+		for (int f = 0; f < numF; ++f) {
+			HEPtr pH = MeshType::faceHalfedge(faces[f]);
+			for (int k = 0; k < 3; ++k) {
+				HEPtr pS = MeshType::halfedgeSym(pH);
+				level.twins[3 * f + k] = pS ? heIds[pS->index()] : -1;
+				closed = closed && pS != NULL;
+				pH = MeshType::halfedgeNext(pH);
+			}
+		}
+		if (scheme == Sqrt3 && !closed) return false;
+
+		mStencils.assign(levels + (limit ? 1 : 0), Stencil());
+		for (int i = 0; i < levels; ++i) {
+			Level child;
+			if (scheme == Loop) _loop(level, child, mStencils[i]);
+			else _sqrt3(level, child, mStencils[i]);
+			std::swap(level, child);
+		}
+		if (limit) _limit(level, scheme, mStencils[levels]);
+
+		pOut->readHalfedgeList(level.numVerts, level.faces, level.twins);
+		updatePositions();
+		return true;
+	}
+
+	template<typename MeshType>
+	inline void CMeshSubdivision<MeshType>::updatePositions()
+	{
+		const int numV = (int)mInVertices.size();
+		std::vector<CPoint> points(numV), next;
+#pragma omp parallel for
+		for (int i = 0; i < numV; ++i) points[i] = mInVertices[i]->point();
+		for (const Stencil & stencil : mStencils) {
+			stencil.apply(points, next);
+			points.swap(next);
+		}
+		auto & vertices = mpOut->getVContainer();
+		const int numOut = (int)points.size();
+#pragma omp parallel for
+		for (int i = 0; i < numOut; ++i) vertices.getPointer(i)->point() = points[i];
+	}
+
+	template<typename MeshType>
+	inline void CMeshSubdivision<MeshType>::Stencil::apply(const std::vector<CPoint> & in, std::vector<CPoint> & out) const
+	{
+		const int n = pattern.numRows();
+		out.resize(n);
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < n; ++i) {
+			CPoint sum(0, 0, 0);
+			for (int k = pattern.offsets[i]; k < pattern.offsets[i + 1]; ++k) {
+				sum += in[pattern.indices[k]] * weights[k];
+			}
+			out[i] = sum;
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshSubdivision<MeshType>::_ring(const Level & level, int h, std::vector<int> & ring, bool & boundary)
+	{
+		ring.clear();
+		/* back to the boundary halfedge if there is one: the out halfedge before h is next(twin(h)) */
+		const int start = h;
+		boundary = false;
+		for (;;) {
+			const int t = level.twins[h];
+			if (t < 0) { boundary = true; break; }
+			h = Level::next(t);
+			if (h == start) break;
+		}
+		const int first = h;
+		do {
+			ring.push_back(h);
+			const int t = level.twins[Level::prev(h)];
+			if (t < 0) break;
+			h = t;
+		} while (h != first);
+	}
+
+	template<typename MeshType>
+	inline int CMeshSubdivision<MeshType>::_starts(const Level & level, std::vector<int> & start)
+	{
+		start.assign(level.numVerts, -1);
+		std::vector<int> counts(level.numVerts, 0);
+		int maxCount = 0;
+		const int numHEs = (int)level.faces.size();
+		for (int h = 0; h < numHEs; ++h) {
+			const int v = level.faces[h];
+			start[v] = h;
+			if (++counts[v] > maxCount) maxCount = counts[v];
+		}
+		return maxCount;
+	}
+
+	template<typename MeshType>
+	template<typename Row>
+	inline void CMeshSubdivision<MeshType>::_buildStencil(int numRows, Row row, Stencil & stencil)
+	{
+		std::vector<int> & offsets = stencil.pattern.offsets;
+		offsets.assign(numRows + 1, 0);
+#pragma omp parallel
+		{
+			std::vector<int> cols;
+			std::vector<double> weights;
+#pragma omp for schedule(dynamic, 1024)
+			for (int i = 0; i < numRows; ++i) {
+				cols.clear();
+				weights.clear();
+				row(i, cols, weights);
+				offsets[i] = (int)cols.size();
+			}
+		}
+		const int numEntries = Parallel::exclusiveScan(offsets);
+		stencil.pattern.indices.resize(numEntries);
+		stencil.weights.resize(numEntries);
+#pragma omp parallel
+		{
+			std::vector<int> cols;
+			std::vector<double> weights;
+#pragma omp for schedule(dynamic, 1024)
+			for (int i = 0; i < numRows; ++i) {
+				cols.clear();
+				weights.clear();
+				row(i, cols, weights);
+				std::copy(cols.begin(), cols.end(), stencil.pattern.indices.begin() + offsets[i]);
+				std::copy(weights.begin(), weights.end(), stencil.weights.begin() + offsets[i]);
+			}
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshSubdivision<MeshType>::_loop(const Level & level, Level & child, Stencil & stencil)
+	{
+		const int numV = level.numVerts;
+		const int numF = level.numFaces();
+		const int numHEs = 3 * numF;
+		/* an edge vertex per halfedge without a twin or with a twin of larger index */
+		std::vector<int> edgeIds(numHEs), edgeHEs;
+#pragma omp parallel for
+		for (int h = 0; h < numHEs; ++h) edgeIds[h] = level.twins[h] < 0 || h < level.twins[h] ? 1 : 0;
+		const int numE = Parallel::exclusiveScan(edgeIds);
+		edgeHEs.resize(numE);
+#pragma omp parallel for
+		for (int h = 0; h < numHEs; ++h) {
+			const int t = level.twins[h];
+			if (t < 0 || h < t) edgeHEs[edgeIds[h]] = h;
+			else edgeIds[h] = edgeIds[t];
+		}
+		std::vector<int> start;
+		/* the rows only read the weight tables */
+		_loopBeta(_starts(level, start));
+
+		_buildStencil(numV + numE, [&](int i, std::vector<int> & cols, std::vector<double> & weights) {
+			if (i >= numV) {
+				const int h = edgeHEs[i - numV];
+				const int t = level.twins[h];
+				const int a = level.faces[h], b = level.faces[Level::next(h)];
+				if (t < 0) {
+					cols.insert(cols.end(), { a, b });
+					weights.insert(weights.end(), { 0.5, 0.5 });
+				}
+				else {
+					const int c = level.faces[Level::prev(h)], d = level.faces[Level::prev(t)];
+					cols.insert(cols.end(), { a, b, c, d });
+					weights.insert(weights.end(), { 0.375, 0.375, 0.125, 0.125 });
+				}
+				return;
+			}
+			std::vector<int> ring;
+			bool boundary;
+			_ring(level, start[i], ring, boundary);
+			cols.push_back(i);
+			if (boundary) {
+				/* the two boundary neighbours: the target of the first out halfedge, the source of the last in halfedge */
+				cols.insert(cols.end(), { level.faces[Level::next(ring.front())], level.faces[Level::prev(ring.back())] });
+				weights.insert(weights.end(), { 0.75, 0.125, 0.125 });
+				return;
+			}
+			const int n = (int)ring.size();
+			const double beta = mLoopBetas[n];
+			weights.push_back(1 - n * beta);
+			for (int h : ring) {
+				cols.push_back(level.faces[Level::next(h)]);
+				weights.push_back(beta);
+			}
+		}, stencil);
+
+		/* face 4 f + k is (v_k, m_k, m_k-1) and face 4 f + 3 is (m_0, m_1, m_2), m_k being the vertex of halfedge 3 f + k */
+		child.numVerts = numV + numE;
+		child.faces.resize(12 * numF);
+		child.twins.resize(12 * numF);
+#pragma omp parallel for
+		for (int f = 0; f < numF; ++f) {
+			int m[3];
+			for (int k = 0; k < 3; ++k) m[k] = numV + edgeIds[3 * f + k];
+			for (int k = 0; k < 3; ++k) {
+				const int h = 3 * f + k;
+				const int c = 4 * f + k;
+				const int km = (k + 2) % 3;
+				child.faces[3 * c] = level.faces[h];
+				child.faces[3 * c + 1] = m[k];
+				child.faces[3 * c + 2] = m[km];
+				child.faces[3 * (4 * f + 3) + k] = m[k];
+
+				/* halfedge h splits into v_k -> m_k, in face c, and m_k -> v_k+1, in face 4 f + k + 1 */
+				const int t = level.twins[h];
+				const int g = t / 3, j = t % 3;
+				child.twins[3 * c] = t < 0 ? -1 : 3 * (4 * g + (j + 1) % 3) + 2;
+				child.twins[3 * (4 * f + (k + 1) % 3) + 2] = t < 0 ? -1 : 3 * (4 * g + j);
+				/* m_k -> m_k-1 against m_k-1 -> m_k of the middle face */
+				child.twins[3 * c + 1] = 3 * (4 * f + 3) + km;
+				child.twins[3 * (4 * f + 3) + km] = 3 * c + 1;
+			}
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshSubdivision<MeshType>::_sqrt3(const Level & level, Level & child, Stencil & stencil)
+	{
+		const int numV = level.numVerts;
+		const int numF = level.numFaces();
+		const int numHEs = 3 * numF;
+		std::vector<int> start;
+		_sqrt3Alpha(_starts(level, start));
+
+		_buildStencil(numV + numF, [&](int i, std::vector<int> & cols, std::vector<double> & weights) {
+			if (i >= numV) {
+				const int f = i - numV;
+				cols.insert(cols.end(), { level.faces[3 * f], level.faces[3 * f + 1], level.faces[3 * f + 2] });
+				weights.insert(weights.end(), { 1.0 / 3, 1.0 / 3, 1.0 / 3 });
+				return;
+			}
+			std::vector<int> ring;
+			bool boundary;
+			_ring(level, start[i], ring, boundary);
+			const int n = (int)ring.size();
+			const double alpha = mSqrt3Alphas[n];
+			cols.push_back(i);
+			weights.push_back(1 - alpha);
+			for (int h : ring) {
+				cols.push_back(level.faces[Level::next(h)]);
+				weights.push_back(alpha / n);
+			}
+		}, stencil);
+
+		/* each halfedge h of face f, twin t in face g, becomes the face (v_k, c_g, c_f): the edge is flipped
+		between the centers c of the faces */
+		child.numVerts = numV + numF;
+		child.faces.resize(3 * numHEs);
+		child.twins.resize(3 * numHEs);
+#pragma omp parallel for
+		for (int h = 0; h < numHEs; ++h) {
+			const int t = level.twins[h];
+			child.faces[3 * h] = level.faces[h];
+			child.faces[3 * h + 1] = numV + t / 3;
+			child.faces[3 * h + 2] = numV + h / 3;
+			/* v_k -> c_g against c_g -> v_k of the face of next(t), c_g -> c_f against c_f -> c_g of the face of t,
+			c_f -> v_k against v_k -> c_f of the face of twin(prev(h)) */
+			child.twins[3 * h] = 3 * Level::next(t) + 2;
+			child.twins[3 * h + 1] = 3 * t + 1;
+			child.twins[3 * h + 2] = 3 * level.twins[Level::prev(h)];
+		}
+	}
+
+	template<typename MeshType>
+	inline void CMeshSubdivision<MeshType>::_limit(const Level & level, Scheme scheme, Stencil & stencil)
+	{
+		std::vector<int> start;
+		const int maxValence = _starts(level, start);
+		if (scheme == Loop) _loopBeta(maxValence);
+		else _sqrt3Alpha(maxValence);
+		_buildStencil(level.numVerts, [&](int i, std::vector<int> & cols, std::vector<double> & weights) {
+			std::vector<int> ring;
+			bool boundary;
+			_ring(level, start[i], ring, boundary);
+			cols.push_back(i);
+			if (boundary) {
+				/* the limit of the cubic B-spline */
+				cols.insert(cols.end(), { level.faces[Level::next(ring.front())], level.faces[Level::prev(ring.back())] });
+				weights.insert(weights.end(), { 2.0 / 3, 1.0 / 6, 1.0 / 6 });
+				return;
+			}
+			/* the dominant left eigenvector of the subdivision matrix: a weight for the vertex, the rest shared by the ring */
+			const int n = (int)ring.size();
+			double w;
+			if (scheme == Loop) w = 1.0 / (3.0 / (8.0 * mLoopBetas[n]) + n);
+			else w = 3 * mSqrt3Alphas[n] / (1 + 3 * mSqrt3Alphas[n]) / n;
+			weights.push_back(1 - n * w);
+			for (int h : ring) {
+				cols.push_back(level.faces[Level::next(h)]);
+				weights.push_back(w);
+			}
+		}, stencil);
+	}
+
+	template<typename MeshType>
+	inline double CMeshSubdivision<MeshType>::_loopBeta(int n)
+	{
+		const double pi = 3.14159265358979323846;
+		/* filled up to n on first use */
+		while ((int)mLoopBetas.size() <= n) {
+			const int m = (int)mLoopBetas.size();
+			const double c = 0.375 + 0.25 * cos(2 * pi / m);
+			mLoopBetas.push_back(m == 0 ? 0 : (0.625 - c * c) / m);
+		}
+		return mLoopBetas[n];
+	}
+
+	template<typename MeshType>
+	inline double CMeshSubdivision<MeshType>::_sqrt3Alpha(int n)
+	{
+		const double pi = 3.14159265358979323846;
+		while ((int)mSqrt3Alphas.size() <= n) {
+			const int m = (int)mSqrt3Alphas.size();
+			mSqrt3Alphas.push_back(m == 0 ? 0 : (4 - 2 * cos(2 * pi / m)) / 9);
+		}
+		return mSqrt3Alphas[n];
+	}
+}
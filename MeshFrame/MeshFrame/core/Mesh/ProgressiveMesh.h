@@ -0,0 +1,297 @@
+/*!
+*      \file ProgressiveMesh.h
+*      \brief Progressive mesh: a base mesh and the vertex splits inverting the collapses that made it (.mpm)
+*
+*		build records the collapses of CMeshSimplifier::simplify; each one is inverted by a vertex split, given by the
+*		vertex it splits, its two neighbours where the new faces go (vl and vr, -1 on the boundary) and the positions
+*		of both vertices afterwards. The vertices are numbered as in the base mesh, the vertex of split i being
+*		numBaseVertices + i, so that a split refers to vertices of the coarser meshes only.
+*
+*		refineTo and coarsenTo apply the splits and the collapses in place, with DynamicMesh::splitVertex and
+*		collapseHalfedge, each in time proportional to the valences it touches.
+*
+*		Layout (little endian):
+*		\code
+*		"MFPM" | version | numVertices | numFaces | numSplits   (uint32)
+*		base vertices: numVertices * 3 double
+*		base faces: numFaces * 3 int32
+*		splits: { vs | vl | vr (int32) | vt position | vs position (3 double each) }
+*		\endcode
+*		The splits come last and in order, so that a file cut anywhere, e.g. while it is downloaded, still reads as a
+*		coarser progressive mesh.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include <vector>
+#include <array>
+
+#include "MeshSimplifier.h"
+
+namespace MeshLib {
+
+	namespace ProgressiveMeshFile {
+		const uint32_t VERSION = 1;
+	}
+
+	template<typename MeshType>
+	class CProgressiveMesh
+	{
+	public:
+		typedef typename MeshType::VPtr VPtr;
+		typedef typename MeshType::FPtr FPtr;
+		typedef typename MeshType::HEPtr HEPtr;
+
+		struct VSplit
+		{
+			/* the vertex split and its neighbours getting the new faces, vr is -1 when the new vertex is on the boundary */
+			int vs, vl, vr;
+			/* positions of the new vertex and of vs after the split */
+			CPoint pt, ps;
+		};
+
+		/*!
+		Simplify pMesh down to baseFaces faces, see CMeshSimplifier::simplify, recording the vertex splits. pMesh is the
+		base mesh afterwards and is refined and coarsened in place by refineTo and coarsenTo.
+		\return the number of vertex splits
+		*/
+		int build(MeshType * pMesh, int baseFaces, double maxError = DBL_MAX, CMeshSimplifier<MeshType> * pSimplifier = NULL);
+
+		/*!
+		Read a progressive mesh into an empty mesh, which becomes its base mesh; a file cut within the splits keeps
+		the complete ones.
+		*/
+		bool read(const char * fileName, MeshType * pMesh);
+		/*! write the base mesh and the splits, whatever the current level of detail */
+		bool write(const char * fileName) const;
+
+		/*! apply splits until the mesh has at least numFaces faces or all of them are applied, return the number of faces */
+		int refineTo(int numFaces);
+		/*! undo splits until the mesh has at most numFaces faces or is the base mesh, return the number of faces */
+		int coarsenTo(int numFaces);
+		/*! apply or undo splits until exactly numSplits of them are applied */
+		void setLevel(int numSplits);
+
+		int numSplits() const { return (int)mSplits.size(); };
+		/*! the number of splits applied to the base mesh */
+		int level() const { return mLevel; };
+		const std::vector<VSplit> & splits() const { return mSplits; };
+		/*! the vertex numbered i, NULL if it is not in the mesh at the current level */
+		VPtr vertex(int i) const { return i < (int)mVertices.size() ? mVertices[i] : NULL; };
+
+	private:
+		void _split();
+		void _collapse();
+
+		MeshType *                         mpMesh = NULL;
+		std::vector<std::array<double, 3>> mBaseVertices;
+		std::vector<std::array<int, 3>>    mBaseFaces;
+		std::vector<VSplit>                mSplits;
+		/* the position of vs before split i, to put it back when the split is undone */
+		std::vector<CPoint>                mCollapsed;
+		/* vertex number -> vertex, for the base vertices and the splits applied */
+		std::vector<VPtr>                  mVertices;
+		int                                mLevel = 0;
+	};
+
+	template<typename MeshType>
+	inline int CProgressiveMesh<MeshType>::build(MeshType * pMesh, int baseFaces, double maxError, CMeshSimplifier<MeshType> * pSimplifier)
+	{
+		struct Collapse
+		{
+			int v0, v1, vl, vr;
+			CPoint p0, p1, p;
+		};
+		std::vector<Collapse> collapses;
+		CMeshSimplifier<MeshType> simplifier;
+		if (pSimplifier == NULL) pSimplifier = &simplifier;
+		pSimplifier->setCollapseObserver([&](HEPtr pH, const CPoint & p) {
+			HEPtr pS = (HEPtr)pH->he_sym();
+			Collapse c;
+			c.v0 = (int)pH->source()->index();
+			c.v1 = (int)pH->target()->index();
+			c.vl = (int)pH->he_next()->target()->index();
+			c.vr = pS ? (int)pS->he_next()->target()->index() : -1;
+			c.p0 = pH->source()->point();
+			c.p1 = pH->target()->point();
+			c.p = p;
+			collapses.push_back(c);
+		});
+		pSimplifier->simplify(pMesh, baseFaces, maxError);
+		pSimplifier->setCollapseObserver(NULL);
+
+		/* base vertices first, in index order, then the removed ones from the last collapse back */
+		auto & vertices = pMesh->getVContainer();
+		std::vector<int> numbers(vertices.getCurrentIndex(), -1);
+		mpMesh = pMesh;
+		mVertices.clear();
+		mBaseVertices.clear();
+		for (VPtr pV : vertices) {
+			numbers[pV->index()] = (int)mVertices.size();
+			mVertices.push_back(pV);
+			const CPoint & p = pV->point();
+			mBaseVertices.push_back({ p[0], p[1], p[2] });
+		}
+		const int numCollapses = (int)collapses.size();
+		for (int i = 0; i < numCollapses; ++i) {
+			numbers[collapses[numCollapses - 1 - i].v0] = (int)mVertices.size() + i;
+		}
+		mBaseFaces.clear();
+		for (FPtr pF : pMesh->getFContainer()) {
+			HEPtr pH = MeshType::faceHalfedge(pF);
+			mBaseFaces.push_back({ numbers[pH->source()->index()], numbers[pH->target()->index()], numbers[pH->he_next()->target()->index()] });
+		}
+
+		mSplits.resize(numCollapses);
+		mCollapsed.resize(numCollapses);
+		for (int i = 0; i < numCollapses; ++i) {
+			const Collapse & c = collapses[numCollapses - 1 - i];
+			VSplit & s = mSplits[i];
+			s.vs = numbers[c.v1];
+			s.vl = numbers[c.vl];
+			s.vr = c.vr >= 0 ? numbers[c.vr] : -1;
+			s.pt = c.p0;
+			s.ps = c.p1;
+			mCollapsed[i] = c.p;
+		}
+		mLevel = 0;
+		return numCollapses;
+	}
+
+	template<typename MeshType>
+	inline bool CProgressiveMesh<MeshType>::read(const char * fileName, MeshType * pMesh)
+	{
+		FILE * fp = fopen(fileName, "rb");
+		if (fp == NULL) {
+			printf("Error in opening file: %s!\n", fileName);
+			return false;
+		}
+		uint32_t header[5];
+		if (fread(header, sizeof(uint32_t), 5, fp) != 5 || memcmp(header, "MFPM", 4) != 0 || header[1] > ProgressiveMeshFile::VERSION) {
+			printf("Error in reading file: %s is not a progressive mesh!\n", fileName);
+			fclose(fp);
+			return false;
+		}
+		const int numVertices = (int)header[2], numFaces = (int)header[3], numSplits = (int)header[4];
+		std::vector<double> verts(3 * (size_t)numVertices);
+		std::vector<int32_t> faces(3 * (size_t)numFaces);
+		if (fread(verts.data(), sizeof(double), verts.size(), fp) != verts.size() || fread(faces.data(), sizeof(int32_t), faces.size(), fp) != faces.size()) {
+			printf("Error in reading file: %s is truncated within the base mesh!\n", fileName);
+			fclose(fp);
+			return false;
+		}
+
+		mSplits.clear();
+		mSplits.reserve(numSplits);
+		for (int i = 0; i < numSplits; ++i) {
+			int32_t ids[3];
+			double p[6];
+			if (fread(ids, sizeof(int32_t), 3, fp) != 3 || fread(p, sizeof(double), 6, fp) != 6) break;
+			VSplit s;
+			s.vs = ids[0];
+			s.vl = ids[1];
+			s.vr = ids[2];
+			s.pt = CPoint(p[0], p[1], p[2]);
+			s.ps = CPoint(p[3], p[4], p[5]);
+			/* a split refers to the vertices before it */
+			const int numBefore = numVertices + i;
+			if (s.vs < 0 || s.vs >= numBefore || s.vl < 0 || s.vl >= numBefore || s.vr >= numBefore) break;
+			mSplits.push_back(s);
+		}
+		fclose(fp);
+		if ((int)mSplits.size() < numSplits) {
+			printf("Warning in reading file: %s has %d of its %d vertex splits.\n", fileName, (int)mSplits.size(), numSplits);
+		}
+
+		if (!pMesh->readVFBuffer(CStridedArray<double>(verts.data(), numVertices), CStridedArray<int32_t>(faces.data(), numFaces), false)) return false;
+		mpMesh = pMesh;
+		mBaseVertices.resize(numVertices);
+		for (int i = 0; i < numVertices; ++i) mBaseVertices[i] = { verts[3 * i], verts[3 * i + 1], verts[3 * i + 2] };
+		mBaseFaces.resize(numFaces);
+		for (int i = 0; i < numFaces; ++i) mBaseFaces[i] = { faces[3 * i], faces[3 * i + 1], faces[3 * i + 2] };
+		mVertices.assign(numVertices, NULL);
+		for (VPtr pV : pMesh->getVContainer()) mVertices[pV->index()] = pV;
+		mCollapsed.assign(mSplits.size(), CPoint());
+		mLevel = 0;
+		return true;
+	}
+
+	template<typename MeshType>
+	inline bool CProgressiveMesh<MeshType>::write(const char * fileName) const
+	{
+		FILE * fp = fopen(fileName, "wb");
+		if (fp == NULL) {
+			printf("Error in opening file: %s!\n", fileName);
+			return false;
+		}
+		uint32_t header[5] = { 0, ProgressiveMeshFile::VERSION, (uint32_t)mBaseVertices.size(), (uint32_t)mBaseFaces.size(), (uint32_t)mSplits.size() };
+		memcpy(header, "MFPM", 4);
+		fwrite(header, sizeof(uint32_t), 5, fp);
+		for (const std::array<double, 3> & p : mBaseVertices) fwrite(p.data(), sizeof(double), 3, fp);
+		for (const std::array<int, 3> & f : mBaseFaces) {
+			int32_t fi[3] = { f[0], f[1], f[2] };
+			fwrite(fi, sizeof(int32_t), 3, fp);
+		}
+		for (const VSplit & s : mSplits) {
+			int32_t ids[3] = { s.vs, s.vl, s.vr };
+			double p[6] = { s.pt[0], s.pt[1], s.pt[2], s.ps[0], s.ps[1], s.ps[2] };
+			fwrite(ids, sizeof(int32_t), 3, fp);
+			fwrite(p, sizeof(double), 6, fp);
+		}
+		fclose(fp);
+		return true;
+	}
+
+	template<typename MeshType>
+	inline int CProgressiveMesh<MeshType>::refineTo(int numFaces)
+	{
+		while (mLevel < (int)mSplits.size() && mpMesh->numFaces() < numFaces) _split();
+		return mpMesh->numFaces();
+	}
+
+	template<typename MeshType>
+	inline int CProgressiveMesh<MeshType>::coarsenTo(int numFaces)
+	{
+		while (mLevel > 0 && mpMesh->numFaces() > numFaces) _collapse();
+		return mpMesh->numFaces();
+	}
+
+	template<typename MeshType>
+	inline void CProgressiveMesh<MeshType>::setLevel(int numSplits)
+	{
+		if (numSplits > (int)mSplits.size()) numSplits = (int)mSplits.size();
+		if (numSplits < 0) numSplits = 0;
+		while (mLevel < numSplits) _split();
+		while (mLevel > numSplits) _collapse();
+	}
+
+	template<typename MeshType>
+	inline void CProgressiveMesh<MeshType>::_split()
+	{
+		const VSplit & s = mSplits[mLevel];
+		VPtr pVs = mVertices[s.vs];
+		mCollapsed[mLevel] = pVs->point();
+		VPtr pVt = mpMesh->splitVertex(pVs, mVertices[s.vl], s.vr >= 0 ? mVertices[s.vr] : NULL, s.pt);
+		mpMesh->moveVertex(pVs, s.ps);
+		mVertices.push_back(pVt);
+		++mLevel;
+	}
+
+	template<typename MeshType>
+	inline void CProgressiveMesh<MeshType>::_collapse()
+	{
+		--mLevel;
+		const VSplit & s = mSplits[mLevel];
+		VPtr pVs = mVertices[s.vs];
+		VPtr pVt = mVertices.back();
+		mVertices.pop_back();
+		HEPtr pH = MeshType::vertexHalfedge(pVt, pVs);
+		assert(pH != NULL && mpMesh->isCollapseOk(pH));
+		mpMesh->collapseHalfedge(pH);
+		mpMesh->moveVertex(pVs, mCollapsed[mLevel]);
+	}
+}
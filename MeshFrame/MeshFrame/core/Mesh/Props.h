@@ -23,6 +23,10 @@ public:\
 		PropPool<T> * pTPropPool = (PropPool<T> *)pPropPool;\
 		delete pTPropPool;\
 	}\
+	void movePropMember(size_t from, size_t to) {\
+		PropPool<T> & pool = *((PropPool<T> *)pPropPool);\
+		pool[to] = pool[from];\
+	}; \
 	private:\
 	T typeInitialVal; \
 };
@@ -160,6 +164,8 @@ namespace MeshLib {
 		virtual void initializePropMember(void * pP) {};
 		virtual void initializePropMember(size_t index) {};
 		virtual void destructProp() {};
+		/*! copy the value of the element at index from to the element at index to, used when the pool is compacted */
+		virtual void movePropMember(size_t from, size_t to) {};
 	private:
 		// Handle is not copyable
 		//BasicPropHandle(const BasicPropHandle &);
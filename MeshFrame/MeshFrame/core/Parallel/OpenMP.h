@@ -0,0 +1,39 @@
+/*!
+*      \file OpenMP.h
+*      \brief The OpenMP runtime calls of MeshFrame, with serial fallbacks when it is compiled without OpenMP
+*
+*		The parallel loops are plain pragmas, ignored by a compiler without OpenMP; only the runtime calls need
+*		the library, so they go through here and a program not built with OpenMP does not have to link it.
+*/
+
+#pragma once
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace MeshLib {
+
+	namespace Parallel {
+
+		/*! number of threads a parallel region would use, 1 without OpenMP */
+		inline int maxThreads()
+		{
+#ifdef _OPENMP
+			return omp_get_max_threads();
+#else
+			return 1;
+#endif
+		}
+
+		/*! whether the caller runs inside an active parallel region */
+		inline bool inParallel()
+		{
+#ifdef _OPENMP
+			return omp_in_parallel() != 0;
+#else
+			return false;
+#endif
+		}
+	}
+}
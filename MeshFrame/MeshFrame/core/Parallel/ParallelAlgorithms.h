@@ -0,0 +1,92 @@
+/*!
+*      \file ParallelAlgorithms.h
+*      \brief OpenMP building blocks shared by the bulk mesh algorithms: sort and prefix sum
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include "OpenMP.h"
+
+namespace MeshLib {
+
+	namespace Parallel {
+
+		/*!
+		Sort [begin, end) with all the OpenMP threads: each thread sorts one chunk, then the chunks are merged pairwise.
+		*/
+		template<typename RandomIt, typename Compare>
+		void sort(RandomIt begin, RandomIt end, Compare comp)
+		{
+			const long long n = end - begin;
+			int numChunks = Parallel::maxThreads();
+			if (n < 100000 || numChunks < 2) {
+				std::sort(begin, end, comp);
+				return;
+			}
+			std::vector<long long> bounds(numChunks + 1);
+			for (int i = 0; i <= numChunks; ++i) bounds[i] = n * i / numChunks;
+
+#pragma omp parallel for schedule(static, 1)
+			for (int i = 0; i < numChunks; ++i) {
+				std::sort(begin + bounds[i], begin + bounds[i + 1], comp);
+			}
+			for (int width = 1; width < numChunks; width *= 2) {
+				int numMerges = (numChunks + 2 * width - 1) / (2 * width);
+#pragma omp parallel for schedule(static, 1)
+				for (int m = 0; m < numMerges; ++m) {
+					int lo = 2 * m * width, mid = std::min(lo + width, numChunks), hi = std::min(lo + 2 * width, numChunks);
+					if (mid < hi) {
+						std::inplace_merge(begin + bounds[lo], begin + bounds[mid], begin + bounds[hi], comp);
+					}
+				}
+			}
+		}
+
+		template<typename RandomIt>
+		void sort(RandomIt begin, RandomIt end)
+		{
+			Parallel::sort(begin, end, std::less<typename std::iterator_traits<RandomIt>::value_type>());
+		}
+
+		/*!
+		In place exclusive prefix sum, returns the total.
+		*/
+		template<typename T>
+		T exclusiveScan(std::vector<T> & values)
+		{
+			const long long n = (long long)values.size();
+			int numChunks = Parallel::maxThreads();
+			if (n < 100000 || numChunks < 2) {
+				T sum = 0;
+				for (long long i = 0; i < n; ++i) {
+					T v = values[i];
+					values[i] = sum;
+					sum += v;
+				}
+				return sum;
+			}
+			std::vector<T> chunkSums(numChunks + 1, 0);
+#pragma omp parallel for schedule(static, 1)
+			for (int c = 0; c < numChunks; ++c) {
+				T sum = 0;
+				for (long long i = n * c / numChunks; i < n * (c + 1) / numChunks; ++i) sum += values[i];
+				chunkSums[c + 1] = sum;
+			}
+			for (int c = 0; c < numChunks; ++c) chunkSums[c + 1] += chunkSums[c];
+#pragma omp parallel for schedule(static, 1)
+			for (int c = 0; c < numChunks; ++c) {
+				T sum = chunkSums[c];
+				for (long long i = n * c / numChunks; i < n * (c + 1) / numChunks; ++i) {
+					T v = values[i];
+					values[i] = sum;
+					sum += v;
+				}
+			}
+			return chunkSums[numChunks];
+		}
+	}
+}
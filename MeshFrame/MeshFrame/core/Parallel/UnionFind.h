@@ -0,0 +1,100 @@
+/*!
+*      \file UnionFind.h
+*      \brief Lock free union-find for the parallel connected components
+*/
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include "OpenMP.h"
+
+#include "ParallelAlgorithms.h"
+
+namespace MeshLib {
+
+	/*!
+	* \brief Disjoint sets over 0 ... n - 1, unite and find may be called concurrently.
+	*
+	*  A root is always linked under the smaller root with a compare and swap, so the root of a set is its
+	*  smallest element, whatever the order of the unions. find halves the paths on the way up.
+	*/
+	class CUnionFind
+	{
+	public:
+		CUnionFind(int n = 0) { reset(n); };
+
+		/*! n singletons */
+		void reset(int n);
+		int size() const { return mSize; };
+
+		/*! the smallest element of the set of i */
+		int find(int i);
+		/*! \return false if a and b were already in the same set */
+		bool unite(int a, int b);
+
+		/*!
+		Dense set ids, ordered by smallest element. Not to be called concurrently with unite.
+		\param labels receives the set id of each element
+		\return number of sets
+		*/
+		int labels(std::vector<int> & labels);
+
+	private:
+		std::unique_ptr<std::atomic<int>[]> mParents;
+		int mSize = 0;
+	};
+
+	inline void CUnionFind::reset(int n)
+	{
+		mSize = n;
+		mParents.reset(new std::atomic<int>[n]);
+#pragma omp parallel for
+		for (int i = 0; i < n; ++i) {
+			mParents[i].store(i, std::memory_order_relaxed);
+		}
+	}
+
+	inline int CUnionFind::find(int i)
+	{
+		for (;;) {
+			int p = mParents[i].load(std::memory_order_relaxed);
+			if (p == i) return i;
+			int gp = mParents[p].load(std::memory_order_relaxed);
+			/* gp is an ancestor of i, skipping p keeps the tree valid even if the CAS loses a race */
+			if (gp != p) mParents[i].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+			i = gp;
+		}
+	}
+
+	inline bool CUnionFind::unite(int a, int b)
+	{
+		for (;;) {
+			a = find(a);
+			b = find(b);
+			if (a == b) return false;
+			if (a > b) std::swap(a, b);
+			int expected = b;
+			/* fails if b got linked meanwhile, then retry from the new roots */
+			if (mParents[b].compare_exchange_strong(expected, a)) return true;
+		}
+	}
+
+	inline int CUnionFind::labels(std::vector<int> & labels)
+	{
+		labels.resize(mSize);
+		std::vector<int> rootIds(mSize);
+#pragma omp parallel for
+		for (int i = 0; i < mSize; ++i) {
+			labels[i] = find(i);
+			rootIds[i] = labels[i] == i ? 1 : 0;
+		}
+		int numSets = Parallel::exclusiveScan(rootIds);
+#pragma omp parallel for
+		for (int i = 0; i < mSize; ++i) {
+			labels[i] = rootIds[labels[i]];
+		}
+		return numSets;
+	}
+}
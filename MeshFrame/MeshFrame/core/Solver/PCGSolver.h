@@ -0,0 +1,347 @@
+/*!
+*      \file PCGSolver.h
+*      \brief Preconditioned conjugate gradient for the symmetric positive definite CSR systems of the meshes
+*
+*		The matrix products, dot products and updates run in parallel; the incomplete Cholesky
+*		factorization and its triangular solves are sequential.
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Memory/CSRMatrix.h"
+
+namespace MeshLib {
+
+	/*!
+	* \brief Solves A x = b for a symmetric positive definite CCSRMatrix, e.g. L + M from CMeshLaplacian.
+	*
+	*  The preconditioner is computed by setMatrix and reused by all the solves until the next setMatrix. The
+	*  analysis of the sparsity pattern is kept as long as setMatrix is called with the same pattern, so a
+	*  matrix whose values change every frame only pays for the numeric factorization.
+	*  The solves start from the x passed in when it has the right size: pass the previous solution to warm start.
+	*/
+	class CPCGSolver
+	{
+	public:
+		enum Preconditioner
+		{
+			None,
+			/*! inverse of the diagonal */
+			Jacobi,
+			/*! incomplete Cholesky without fill in, the strongest but sequential to apply */
+			IC0
+		};
+
+		/*! relative residual |b - A x| / |b| to reach */
+		double tolerance = 1e-8;
+		int maxIterations = 1000;
+
+		/*!
+		Set the matrix and compute the preconditioner, the diagonal must be in the pattern. The matrix is
+		referenced, not copied: it must stay alive and unchanged until the next setMatrix.
+		*/
+		void setMatrix(const CCSRMatrix & A, Preconditioner preconditioner = Jacobi);
+
+		/*!
+		\param x initial guess if it has the size of b, zero otherwise; receives the solution
+		\return true if the tolerance was reached
+		*/
+		bool solve(const std::vector<double> & b, std::vector<double> & x);
+		/*!
+		Solve for the 3 coordinates at once, sharing the passes over the matrix. Each coordinate stops
+		on its own once it reached the tolerance.
+		*/
+		bool solve(const std::vector<CPoint> & b, std::vector<CPoint> & x);
+
+		/*! of the last solve */
+		int iterations() const { return mIterations; };
+		/*! of the last solve, the largest over the coordinates */
+		double relativeResidual() const { return mResidual; };
+
+	private:
+		bool _samePattern(const CCSRArray & pattern) const;
+		void _analyse();
+		void _factorize();
+
+		/*! the solves on K right hand sides interleaved: entry i of rhs c is at K * i + c */
+		template<int K>
+		bool _solve(const double * b, double * x);
+		template<int K>
+		void _multiply(const double * x, double * y) const;
+		template<int K>
+		void _precondition(const double * r, double * z);
+		template<int K>
+		void _dot(const double * u, const double * v, double * out) const;
+
+		const CCSRMatrix *  mpA = NULL;
+		Preconditioner      mPreconditioner = Jacobi;
+
+		/*! copy of the pattern of the last analysis */
+		std::vector<int>    mOffsets;
+		std::vector<int>    mIndices;
+		/*! the lower triangle of the pattern, with the diagonal last in each row, and the positions of its entries in A */
+		CCSRArray           mLower;
+		std::vector<int>    mLowerSource;
+
+		std::vector<double> mInvDiagonal;
+		/*! values of the incomplete factor over mLower */
+		std::vector<double> mLowerValues;
+
+		std::vector<double> mR, mZ, mP, mQ;
+		int                 mIterations = 0;
+		double              mResidual = 0;
+	};
+
+	inline void CPCGSolver::setMatrix(const CCSRMatrix & A, Preconditioner preconditioner)
+	{
+		mpA = &A;
+		mPreconditioner = preconditioner;
+		if (!_samePattern(A.pattern)) {
+			mOffsets = A.pattern.offsets;
+			mIndices = A.pattern.indices;
+			_analyse();
+		}
+		_factorize();
+	}
+
+	inline bool CPCGSolver::_samePattern(const CCSRArray & pattern) const
+	{
+		return mOffsets == pattern.offsets && mIndices == pattern.indices;
+	}
+
+	inline void CPCGSolver::_analyse()
+	{
+		const CCSRArray & pattern = mpA->pattern;
+		const int n = pattern.numRows();
+		mLower.offsets.assign(n + 1, 0);
+		for (int i = 0; i < n; ++i) {
+			for (const int * j = pattern.begin(i); j != pattern.end(i) && *j <= i; ++j) ++mLower.offsets[i];
+		}
+		mLower.indices.resize(Parallel::exclusiveScan(mLower.offsets));
+		mLowerSource.resize(mLower.indices.size());
+#pragma omp parallel for
+		for (int i = 0; i < n; ++i) {
+			int k = mLower.offsets[i];
+			for (const int * j = pattern.begin(i); j != pattern.end(i) && *j <= i; ++j, ++k) {
+				mLower.indices[k] = *j;
+				mLowerSource[k] = (int)(j - pattern.indices.data());
+			}
+		}
+	}
+
+	inline void CPCGSolver::_factorize()
+	{
+		const CCSRMatrix & A = *mpA;
+		const int n = A.numRows();
+		mInvDiagonal.resize(n);
+#pragma omp parallel for
+		for (int i = 0; i < n; ++i) {
+			const double d = A.diagonal[i] >= 0 ? A.values[A.diagonal[i]] : 0.0;
+			mInvDiagonal[i] = d != 0 ? 1.0 / d : 1.0;
+		}
+		if (mPreconditioner != IC0) return;
+
+		/* row by row: L_ij = (a_ij - sum_m<j L_im L_jm) / L_jj, the sums being sparse dot products of sorted rows;
+		on a breakdown the diagonal is shifted and the factorization restarted */
+		mLowerValues.resize(mLower.indices.size());
+		for (double shift = 0;; shift = shift == 0 ? 1e-3 : 2 * shift) {
+			if (shift > 1e3) {
+				printf("Warning in CPCGSolver: the incomplete Cholesky factorization failed, using Jacobi instead.\n");
+				mPreconditioner = Jacobi;
+				return;
+			}
+			bool breakdown = false;
+			for (int i = 0; i < n && !breakdown; ++i) {
+				const int rowBegin = mLower.offsets[i], rowEnd = mLower.offsets[i + 1];
+				for (int k = rowBegin; k < rowEnd; ++k) {
+					const int j = mLower.indices[k];
+					double s = A.values[mLowerSource[k]];
+					int ki = rowBegin, kj = mLower.offsets[j];
+					while (ki < k && kj < mLower.offsets[j + 1] - 1) {
+						if (mLower.indices[ki] < mLower.indices[kj]) ++ki;
+						else if (mLower.indices[ki] > mLower.indices[kj]) ++kj;
+						else s -= mLowerValues[ki++] * mLowerValues[kj++];
+					}
+					if (j < i) {
+						mLowerValues[k] = s / mLowerValues[mLower.offsets[j + 1] - 1];
+						continue;
+					}
+					s += shift * A.values[mLowerSource[k]];
+					if (s <= 0) {
+						breakdown = true;
+						break;
+					}
+					mLowerValues[k] = sqrt(s);
+				}
+			}
+			if (!breakdown) break;
+		}
+	}
+
+	inline bool CPCGSolver::solve(const std::vector<double> & b, std::vector<double> & x)
+	{
+		if (x.size() != b.size()) x.assign(b.size(), 0.0);
+		return _solve<1>(b.data(), x.data());
+	}
+
+	inline bool CPCGSolver::solve(const std::vector<CPoint> & b, std::vector<CPoint> & x)
+	{
+		const int n = (int)b.size();
+		std::vector<double> bb(3 * n), xx(3 * n, 0.0);
+		const bool warm = x.size() == b.size();
+#pragma omp parallel for
+		for (int i = 0; i < n; ++i) {
+			for (int c = 0; c < 3; ++c) {
+				bb[3 * i + c] = b[i][c];
+				if (warm) xx[3 * i + c] = x[i][c];
+			}
+		}
+		const bool converged = _solve<3>(bb.data(), xx.data());
+		x.resize(n);
+#pragma omp parallel for
+		for (int i = 0; i < n; ++i) {
+			x[i] = CPoint(xx[3 * i], xx[3 * i + 1], xx[3 * i + 2]);
+		}
+		return converged;
+	}
+
+	template<int K>
+	inline bool CPCGSolver::_solve(const double * b, double * x)
+	{
+		const int n = mpA->numRows(), size = K * n;
+		mR.resize(size);
+		mZ.resize(size);
+		mP.resize(size);
+		mQ.resize(size);
+		double * r = mR.data(), * z = mZ.data(), * p = mP.data(), * q = mQ.data();
+
+		double bNorm[K], rz[K], rr[K], pq[K], alpha[K], beta[K];
+		bool done[K];
+		_dot<K>(b, b, bNorm);
+		for (int c = 0; c < K; ++c) bNorm[c] = sqrt(bNorm[c]);
+
+		_multiply<K>(x, q);
+#pragma omp parallel for
+		for (int i = 0; i < size; ++i) r[i] = b[i] - q[i];
+		_precondition<K>(r, z);
+#pragma omp parallel for
+		for (int i = 0; i < size; ++i) p[i] = z[i];
+		_dot<K>(r, z, rz);
+		_dot<K>(r, r, rr);
+
+		mIterations = 0;
+		for (;;) {
+			bool allDone = true;
+			mResidual = 0;
+			for (int c = 0; c < K; ++c) {
+				const double residual = bNorm[c] > 0 ? sqrt(rr[c]) / bNorm[c] : sqrt(rr[c]);
+				done[c] = residual <= tolerance;
+				allDone = allDone && done[c];
+				mResidual = std::max(mResidual, residual);
+			}
+			if (allDone || mIterations == maxIterations) return allDone;
+			++mIterations;
+
+			_multiply<K>(p, q);
+			_dot<K>(p, q, pq);
+			for (int c = 0; c < K; ++c) alpha[c] = done[c] || pq[c] == 0 ? 0.0 : rz[c] / pq[c];
+#pragma omp parallel for
+			for (int i = 0; i < n; ++i) {
+				for (int c = 0; c < K; ++c) {
+					x[K * i + c] += alpha[c] * p[K * i + c];
+					r[K * i + c] -= alpha[c] * q[K * i + c];
+				}
+			}
+			_precondition<K>(r, z);
+			double rzNew[K];
+			_dot<K>(r, z, rzNew);
+			_dot<K>(r, r, rr);
+			for (int c = 0; c < K; ++c) {
+				beta[c] = rz[c] != 0 ? rzNew[c] / rz[c] : 0.0;
+				rz[c] = rzNew[c];
+			}
+#pragma omp parallel for
+			for (int i = 0; i < n; ++i) {
+				for (int c = 0; c < K; ++c) {
+					p[K * i + c] = z[K * i + c] + beta[c] * p[K * i + c];
+				}
+			}
+		}
+	}
+
+	template<int K>
+	inline void CPCGSolver::_multiply(const double * x, double * y) const
+	{
+		const CCSRMatrix & A = *mpA;
+		const int n = A.numRows();
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < n; ++i) {
+			double sum[K] = {};
+			for (int k = A.pattern.offsets[i]; k < A.pattern.offsets[i + 1]; ++k) {
+				const double a = A.values[k];
+				const double * xj = x + K * A.pattern.indices[k];
+				for (int c = 0; c < K; ++c) sum[c] += a * xj[c];
+			}
+			for (int c = 0; c < K; ++c) y[K * i + c] = sum[c];
+		}
+	}
+
+	template<int K>
+	inline void CPCGSolver::_precondition(const double * r, double * z)
+	{
+		const int n = mpA->numRows();
+		if (mPreconditioner == None) {
+#pragma omp parallel for
+			for (int i = 0; i < K * n; ++i) z[i] = r[i];
+			return;
+		}
+		if (mPreconditioner == Jacobi) {
+#pragma omp parallel for
+			for (int i = 0; i < n; ++i) {
+				for (int c = 0; c < K; ++c) z[K * i + c] = mInvDiagonal[i] * r[K * i + c];
+			}
+			return;
+		}
+		/* L y = r, then L^T z = y, in place in z */
+		for (int i = 0; i < n; ++i) {
+			const int diag = mLower.offsets[i + 1] - 1;
+			for (int c = 0; c < K; ++c) {
+				double s = r[K * i + c];
+				for (int k = mLower.offsets[i]; k < diag; ++k) s -= mLowerValues[k] * z[K * mLower.indices[k] + c];
+				z[K * i + c] = s / mLowerValues[diag];
+			}
+		}
+		for (int i = n - 1; i >= 0; --i) {
+			const int diag = mLower.offsets[i + 1] - 1;
+			for (int c = 0; c < K; ++c) {
+				const double zi = z[K * i + c] / mLowerValues[diag];
+				z[K * i + c] = zi;
+				for (int k = mLower.offsets[i]; k < diag; ++k) z[K * mLower.indices[k] + c] -= mLowerValues[k] * zi;
+			}
+		}
+	}
+
+	template<int K>
+	inline void CPCGSolver::_dot(const double * u, const double * v, double * out) const
+	{
+		const int n = mpA->numRows();
+		for (int c = 0; c < K; ++c) out[c] = 0;
+#pragma omp parallel
+		{
+			double sum[K] = {};
+#pragma omp for
+			for (int i = 0; i < n; ++i) {
+				for (int c = 0; c < K; ++c) sum[c] += u[K * i + c] * v[K * i + c];
+			}
+#pragma omp critical
+			for (int c = 0; c < K; ++c) out[c] += sum[c];
+		}
+	}
+}
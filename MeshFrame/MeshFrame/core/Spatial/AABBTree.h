@@ -0,0 +1,297 @@
+/*!
+*      \file AABBTree.h
+*      \brief Axis aligned bounding box tree over abstract primitives, the core of the mesh hierarchies
+*
+*		Binned SAH build, nodes are stored in a flat array with the two children of a node next to
+*		each other. The users keep their primitives in the leaf order given by order().
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include "../Parallel/OpenMP.h"
+
+namespace MeshLib {
+
+	class CAABBTree
+	{
+	public:
+		/*! interior node: count == 0 and its children are first and first + 1; leaf: slots [first, first + count) */
+		struct Node
+		{
+			double bmin[3];
+			double bmax[3];
+			int first;
+			int count;
+		};
+		/*! per primitive: min corner, max corner, centroid */
+		typedef std::array<double, 9> PrimBounds;
+
+		/*! below this depth the splits are median splits, which bounds the depth by MAX_SAH_DEPTH + 32 */
+		static const int MAX_SAH_DEPTH = 64;
+		/*! enough for any depth first traversal */
+		static const int MAX_STACK = MAX_SAH_DEPTH + 40;
+
+		CAABBTree() : mNumNodes(0) {};
+
+		/*!
+		Build the tree using all the OpenMP threads.
+		\param primBounds bounds and centroid of each primitive
+		\param maxLeafSize maximum number of primitives in a leaf
+		*/
+		void build(const std::vector<PrimBounds> & primBounds, int maxLeafSize = 4);
+		/*!
+		Recompute the boxes bottom up, after the primitives moved.
+		\param slotBounds slotBounds(slot, bmin, bmax) grows bmin, bmax to contain the primitive at the slot
+		*/
+		template<typename SlotBounds>
+		void refit(SlotBounds slotBounds);
+
+		const std::vector<Node> & nodes() const { return mNodes; };
+		/*! order()[slot] is the primitive stored at the slot, the leaves reference slots */
+		const std::vector<int> & order() const { return mOrder; };
+		bool empty() const { return mNodes.empty(); };
+
+		/*! slab test, a NaN from 0 * inf keeps the previous bound */
+		static bool intersectBox(const Node & node, const double org[3], const double invDir[3], double tMin, double tMax, double & tEnter);
+		static double boxDistance2(const Node & node, const double p[3]);
+		static bool containsPoint(const Node & node, const double p[3]);
+
+	private:
+		struct Subtree
+		{
+			int node, begin, end, depth;
+		};
+		int  _split(const Subtree & st, std::vector<Subtree> & children);
+		void _buildSerial(const Subtree & root);
+
+		std::vector<Node> mNodes;
+		std::vector<int>  mOrder;
+		std::atomic<int>  mNumNodes;
+		int               mMaxLeafSize = 4;
+		/*! build only */
+		const std::vector<PrimBounds> * mpPrimBounds = NULL;
+
+		static const int NUM_BINS = 16;
+	};
+
+	inline void CAABBTree::build(const std::vector<PrimBounds> & primBounds, int maxLeafSize)
+	{
+		mMaxLeafSize = std::max(1, maxLeafSize);
+		const int numPrims = (int)primBounds.size();
+		mNodes.clear();
+		mOrder.resize(numPrims);
+		if (numPrims == 0) return;
+		for (int i = 0; i < numPrims; ++i) {
+			mOrder[i] = i;
+		}
+		mpPrimBounds = &primBounds;
+
+		/* a binary tree with leaves of at least one primitive has at most 2n - 1 nodes */
+		mNodes.resize(2 * numPrims - 1);
+		mNumNodes = 1;
+
+		/* split breadth first until there is enough independent subtrees to keep all the threads busy */
+		std::vector<Subtree> pending(1, Subtree{ 0, 0, numPrims, 0 }), next;
+		const int minSubtrees = 4 * Parallel::maxThreads();
+		while (!pending.empty() && (int)pending.size() < minSubtrees) {
+			next.clear();
+			for (const Subtree & st : pending) {
+				_split(st, next);
+			}
+			pending.swap(next);
+		}
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int i = 0; i < (int)pending.size(); ++i) {
+			_buildSerial(pending[i]);
+		}
+		mNodes.resize(mNumNodes);
+		mpPrimBounds = NULL;
+	}
+
+	template<typename SlotBounds>
+	inline void CAABBTree::refit(SlotBounds slotBounds)
+	{
+		/* children are always allocated after their parent */
+		for (int i = (int)mNodes.size() - 1; i >= 0; --i) {
+			Node & node = mNodes[i];
+			if (node.count > 0) {
+				for (int k = 0; k < 3; ++k) {
+					node.bmin[k] = std::numeric_limits<double>::infinity();
+					node.bmax[k] = -std::numeric_limits<double>::infinity();
+				}
+				for (int slot = node.first; slot < node.first + node.count; ++slot) {
+					slotBounds(slot, node.bmin, node.bmax);
+				}
+			}
+			else {
+				const Node & l = mNodes[node.first];
+				const Node & r = mNodes[node.first + 1];
+				for (int k = 0; k < 3; ++k) {
+					node.bmin[k] = std::min(l.bmin[k], r.bmin[k]);
+					node.bmax[k] = std::max(l.bmax[k], r.bmax[k]);
+				}
+			}
+		}
+	}
+
+	/*!
+	* Split one node by the binned surface area heuristic, or turn it into a leaf.
+	* Returns the number of children pushed to children (0 or 2).
+	*/
+	inline int CAABBTree::_split(const Subtree & st, std::vector<Subtree> & children)
+	{
+		const std::vector<PrimBounds> & primBounds = *mpPrimBounds;
+		Node & node = mNodes[st.node];
+		const int count = st.end - st.begin;
+		double cmin[3], cmax[3];
+		for (int k = 0; k < 3; ++k) {
+			node.bmin[k] = cmin[k] = std::numeric_limits<double>::infinity();
+			node.bmax[k] = cmax[k] = -std::numeric_limits<double>::infinity();
+		}
+		for (int i = st.begin; i < st.end; ++i) {
+			const PrimBounds & b = primBounds[mOrder[i]];
+			for (int k = 0; k < 3; ++k) {
+				node.bmin[k] = std::min(node.bmin[k], b[k]);
+				node.bmax[k] = std::max(node.bmax[k], b[3 + k]);
+				cmin[k] = std::min(cmin[k], b[6 + k]);
+				cmax[k] = std::max(cmax[k], b[6 + k]);
+			}
+		}
+		node.first = st.begin;
+		node.count = count;
+		if (count <= mMaxLeafSize) return 0;
+
+		auto halfArea = [](const double lo[3], const double hi[3]) {
+			double d[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+			return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+		};
+
+		int bestAxis = -1, bestBin = 0;
+		double bestCost = std::numeric_limits<double>::infinity();
+		for (int axis = 0; axis < 3; ++axis) {
+			double extent = cmax[axis] - cmin[axis];
+			if (extent <= 0) continue;
+			int binCount[NUM_BINS] = { 0 };
+			double binMin[NUM_BINS][3], binMax[NUM_BINS][3];
+			for (int b = 0; b < NUM_BINS; ++b) for (int k = 0; k < 3; ++k) {
+				binMin[b][k] = std::numeric_limits<double>::infinity();
+				binMax[b][k] = -std::numeric_limits<double>::infinity();
+			}
+			const double scale = NUM_BINS / extent;
+			for (int i = st.begin; i < st.end; ++i) {
+				const PrimBounds & pb = primBounds[mOrder[i]];
+				int b = std::min(NUM_BINS - 1, (int)((pb[6 + axis] - cmin[axis]) * scale));
+				++binCount[b];
+				for (int k = 0; k < 3; ++k) {
+					binMin[b][k] = std::min(binMin[b][k], pb[k]);
+					binMax[b][k] = std::max(binMax[b][k], pb[3 + k]);
+				}
+			}
+			/* sweep from the right to get the area of the right sides, then from the left */
+			double rightArea[NUM_BINS];
+			int rightCount[NUM_BINS];
+			double lo[3], hi[3];
+			int n = 0;
+			for (int k = 0; k < 3; ++k) {
+				lo[k] = std::numeric_limits<double>::infinity();
+				hi[k] = -std::numeric_limits<double>::infinity();
+			}
+			for (int b = NUM_BINS - 1; b > 0; --b) {
+				n += binCount[b];
+				for (int k = 0; k < 3; ++k) {
+					lo[k] = std::min(lo[k], binMin[b][k]);
+					hi[k] = std::max(hi[k], binMax[b][k]);
+				}
+				rightCount[b] = n;
+				rightArea[b] = n ? halfArea(lo, hi) : 0;
+			}
+			n = 0;
+			for (int k = 0; k < 3; ++k) {
+				lo[k] = std::numeric_limits<double>::infinity();
+				hi[k] = -std::numeric_limits<double>::infinity();
+			}
+			for (int b = 0; b < NUM_BINS - 1; ++b) {
+				n += binCount[b];
+				for (int k = 0; k < 3; ++k) {
+					lo[k] = std::min(lo[k], binMin[b][k]);
+					hi[k] = std::max(hi[k], binMax[b][k]);
+				}
+				if (n == 0 || rightCount[b + 1] == 0) continue;
+				double cost = n * halfArea(lo, hi) + rightCount[b + 1] * rightArea[b + 1];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		int mid;
+		if (bestAxis < 0 || st.depth >= MAX_SAH_DEPTH) {
+			/* all the centroids coincide, or the tree got too deep for the traversal stack: split in the middle */
+			mid = st.begin + count / 2;
+		}
+		else {
+			/* the nodes over maxLeafSize are always split, even where the SAH would rather keep a leaf */
+			const double scale = NUM_BINS / (cmax[bestAxis] - cmin[bestAxis]);
+			const double c0 = cmin[bestAxis];
+			const int axis = bestAxis, bin = bestBin;
+			mid = (int)(std::partition(mOrder.begin() + st.begin, mOrder.begin() + st.end, [&](int id) {
+				return std::min(NUM_BINS - 1, (int)((primBounds[id][6 + axis] - c0) * scale)) <= bin;
+			}) - mOrder.begin());
+		}
+
+		int child = mNumNodes.fetch_add(2);
+		node.first = child;
+		node.count = 0;
+		children.push_back(Subtree{ child, st.begin, mid, st.depth + 1 });
+		children.push_back(Subtree{ child + 1, mid, st.end, st.depth + 1 });
+		return 2;
+	}
+
+	inline void CAABBTree::_buildSerial(const Subtree & root)
+	{
+		std::vector<Subtree> stack(1, root);
+		while (!stack.empty()) {
+			Subtree st = stack.back();
+			stack.pop_back();
+			_split(st, stack);
+		}
+	}
+
+	inline bool CAABBTree::intersectBox(const Node & node, const double org[3], const double invDir[3],
+		double tMin, double tMax, double & tEnter)
+	{
+		for (int k = 0; k < 3; ++k) {
+			double t0 = (node.bmin[k] - org[k]) * invDir[k];
+			double t1 = (node.bmax[k] - org[k]) * invDir[k];
+			if (t0 > t1) std::swap(t0, t1);
+			tMin = t0 > tMin ? t0 : tMin;
+			tMax = t1 < tMax ? t1 : tMax;
+		}
+		tEnter = tMin;
+		return tMin <= tMax;
+	}
+
+	inline double CAABBTree::boxDistance2(const Node & node, const double p[3])
+	{
+		double d2 = 0;
+		for (int k = 0; k < 3; ++k) {
+			double d = std::max(0.0, std::max(node.bmin[k] - p[k], p[k] - node.bmax[k]));
+			d2 += d * d;
+		}
+		return d2;
+	}
+
+	inline bool CAABBTree::containsPoint(const Node & node, const double p[3])
+	{
+		return node.bmin[0] <= p[0] && p[0] <= node.bmax[0]
+			&& node.bmin[1] <= p[1] && p[1] <= node.bmax[1]
+			&& node.bmin[2] <= p[2] && p[2] <= node.bmax[2];
+	}
+}
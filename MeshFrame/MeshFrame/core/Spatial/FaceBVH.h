@@ -0,0 +1,499 @@
+/*!
+*      \file FaceBVH.h
+*      \brief Bounding volume hierarchy over the faces of a triangle mesh, for ray and closest point queries
+*
+*		The tree is a CAABBTree, the triangles are copied in its leaf order.
+*		Works headless, the viewer uses it for picking.
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "AABBTree.h"
+
+namespace MeshLib {
+
+	template<typename MeshType>
+	class CFaceBVH
+	{
+	public:
+		typedef typename MeshType::FPtr FPtr;
+		typedef typename MeshType::HEPtr HEPtr;
+
+		/*!
+		* Result of a query. The hit point is (1 - u - v) * p0 + u * p1 + v * p2, where p0, p1, p2 are the
+		* targets of faceHalfedge(pF) and of the two next halfedges.
+		* t is the ray parameter for ray queries, the distance for closest point queries.
+		*/
+		struct Hit
+		{
+			FPtr   pF = NULL;
+			double t = std::numeric_limits<double>::infinity();
+			double u = 0;
+			double v = 0;
+		};
+
+		/*!
+		Build the hierarchy over all the faces of the mesh, using all the OpenMP threads.
+		\param pMesh the mesh, must be a triangle mesh
+		\param maxLeafSize maximum number of triangles in a leaf
+		*/
+		void build(MeshType * pMesh, int maxLeafSize = 4);
+		/*!
+		Update the bounding boxes after the vertices moved, the connectivity of the mesh must not have changed.
+		The tree is not rebuilt, so the queries get slower if the motion is large.
+		*/
+		void refit();
+
+		/*!
+		Closest intersection of the ray org + t * dir, tMin <= t <= tMax.
+		\return whether the ray hits a face, hit is filled then
+		*/
+		bool intersect(const CPoint & org, const CPoint & dir, Hit & hit,
+			double tMin = 0, double tMax = std::numeric_limits<double>::infinity()) const;
+		/*!
+		Whether the ray hits any face for tMin <= t <= tMax, stops at the first hit found.
+		*/
+		bool occluded(const CPoint & org, const CPoint & dir,
+			double tMin = 0, double tMax = std::numeric_limits<double>::infinity()) const;
+		/*!
+		Closest intersections of a packet of N rays (typically 4 or 8) traversed together: a node is visited once
+		for all the rays hitting its box. Meant for coherent rays, e.g. through neighbouring pixels, incoherent rays
+		are better traced one by one. hits[i].pF is NULL for the rays missing the mesh.
+		*/
+		template<int N>
+		void intersect(const CPoint org[N], const CPoint dir[N], Hit hits[N], double tMin = 0) const;
+
+		/*!
+		Closest point of the mesh to p.
+		\param closest the closest point
+		\param maxDist only look for points closer than maxDist
+		\return false if no face is closer than maxDist
+		*/
+		bool closestPoint(const CPoint & p, Hit & hit, CPoint & closest, double maxDist = std::numeric_limits<double>::infinity()) const;
+		/*!
+		Closest points of a batch of query points, in parallel.
+		\param closest if not NULL, receives the closest points
+		*/
+		void closestPoints(const std::vector<CPoint> & points, std::vector<Hit> & hits, std::vector<CPoint> * closest = NULL,
+			double maxDist = std::numeric_limits<double>::infinity()) const;
+		/*!
+		Closest point to p on the triangle a, a + ab, a + ac, Ericson's Real-Time Collision Detection 5.1.5. The barycentric
+		coordinates of the vertex and edge regions are exact zeros, which tells on which feature the closest point lies.
+		\return the squared distance
+		*/
+		static double closestPointOnTriangle(const CPoint & p, const CPoint & a, const CPoint & ab, const CPoint & ac,
+			double & u, double & v);
+
+		bool empty() const { return mTree.empty(); };
+		size_t numNodes() const { return mTree.nodes().size(); };
+
+	private:
+		typedef CAABBTree::Node Node;
+		struct Triangle
+		{
+			CPoint p0, e1, e2;
+		};
+
+		void _setTriangle(int i);
+		bool _intersectTriangle(int i, const CPoint & org, const CPoint & dir, double tMin, double & t, double & u, double & v) const;
+
+		MeshType *            mpMesh = NULL;
+		CAABBTree             mTree;
+		/*! faces and triangles in leaf order */
+		std::vector<FPtr>     mFaces;
+		std::vector<Triangle> mTris;
+
+		static const int MAX_STACK = CAABBTree::MAX_STACK;
+	};
+
+	template<typename MeshType>
+	inline void CFaceBVH<MeshType>::build(MeshType * pMesh, int maxLeafSize)
+	{
+		mpMesh = pMesh;
+		mFaces.clear();
+		mFaces.reserve(pMesh->numFaces());
+		for (FPtr pF : pMesh->faces()) {
+			mFaces.push_back(pF);
+		}
+		const int numPrims = (int)mFaces.size();
+		mTris.resize(numPrims);
+
+		std::vector<CAABBTree::PrimBounds> primBounds(numPrims);
+#pragma omp parallel for
+		for (int i = 0; i < numPrims; ++i) {
+			_setTriangle(i);
+			const Triangle & tri = mTris[i];
+			CPoint p1 = tri.p0 + tri.e1, p2 = tri.p0 + tri.e2;
+			CAABBTree::PrimBounds & b = primBounds[i];
+			for (int k = 0; k < 3; ++k) {
+				b[k] = std::min(tri.p0(k), std::min(p1(k), p2(k)));
+				b[3 + k] = std::max(tri.p0(k), std::max(p1(k), p2(k)));
+				b[6 + k] = (tri.p0(k) + p1(k) + p2(k)) / 3.0;
+			}
+		}
+		mTree.build(primBounds, maxLeafSize);
+
+		/* store the triangles and faces in leaf order */
+		const std::vector<int> & order = mTree.order();
+		std::vector<Triangle> tris(numPrims);
+		std::vector<FPtr> faces(numPrims);
+#pragma omp parallel for
+		for (int i = 0; i < numPrims; ++i) {
+			tris[i] = mTris[order[i]];
+			faces[i] = mFaces[order[i]];
+		}
+		mTris.swap(tris);
+		mFaces.swap(faces);
+	}
+
+	template<typename MeshType>
+	inline void CFaceBVH<MeshType>::refit()
+	{
+		if (mTree.empty()) return;
+#pragma omp parallel for
+		for (int i = 0; i < (int)mTris.size(); ++i) {
+			_setTriangle(i);
+		}
+		mTree.refit([this](int i, double bmin[3], double bmax[3]) {
+			const Triangle & tri = mTris[i];
+			for (int k = 0; k < 3; ++k) {
+				double a = tri.p0(k), b = a + tri.e1(k), c = a + tri.e2(k);
+				bmin[k] = std::min(bmin[k], std::min(a, std::min(b, c)));
+				bmax[k] = std::max(bmax[k], std::max(a, std::max(b, c)));
+			}
+		});
+	}
+
+	template<typename MeshType>
+	inline void CFaceBVH<MeshType>::_setTriangle(int i)
+	{
+		HEPtr pH = MeshType::faceHalfedge(mFaces[i]);
+		const CPoint & p0 = MeshType::halfedgeTarget(pH)->point();
+		pH = MeshType::halfedgeNext(pH);
+		const CPoint & p1 = MeshType::halfedgeTarget(pH)->point();
+		pH = MeshType::halfedgeNext(pH);
+		const CPoint & p2 = MeshType::halfedgeTarget(pH)->point();
+		mTris[i].p0 = p0;
+		mTris[i].e1 = p1 - p0;
+		mTris[i].e2 = p2 - p0;
+	}
+
+	/*! Moller-Trumbore, two sided */
+	template<typename MeshType>
+	inline bool CFaceBVH<MeshType>::_intersectTriangle(int i, const CPoint & org, const CPoint & dir, double tMin,
+		double & t, double & u, double & v) const
+	{
+		const Triangle & tri = mTris[i];
+		CPoint P = dir ^ tri.e2;
+		double det = tri.e1 * P;
+		if (det == 0) return false;
+		double invDet = 1.0 / det;
+		CPoint T = org - tri.p0;
+		double uu = (T * P) * invDet;
+		if (uu < 0 || uu > 1) return false;
+		CPoint Q = T ^ tri.e1;
+		double vv = (dir * Q) * invDet;
+		if (vv < 0 || uu + vv > 1) return false;
+		double tt = (tri.e2 * Q) * invDet;
+		if (tt < tMin || tt > t) return false;
+		t = tt;
+		u = uu;
+		v = vv;
+		return true;
+	}
+
+	template<typename MeshType>
+	inline bool CFaceBVH<MeshType>::intersect(const CPoint & org, const CPoint & dir, Hit & hit, double tMin, double tMax) const
+	{
+		hit = Hit();
+		if (mTree.empty()) return false;
+		const std::vector<Node> & nodes = mTree.nodes();
+		const double o[3] = { org(0), org(1), org(2) };
+		const double invDir[3] = { 1.0 / dir(0), 1.0 / dir(1), 1.0 / dir(2) };
+		double t = tMax, u = 0, v = 0, tEnter;
+		int hitTri = -1;
+
+		int stack[MAX_STACK];
+		int top = 0;
+		if (!CAABBTree::intersectBox(nodes[0], o, invDir, tMin, t, tEnter)) return false;
+		stack[top++] = 0;
+		while (top > 0) {
+			const Node & node = nodes[stack[--top]];
+			if (node.count > 0) {
+				for (int i = node.first; i < node.first + node.count; ++i) {
+					if (_intersectTriangle(i, org, dir, tMin, t, u, v)) hitTri = i;
+				}
+				continue;
+			}
+			double tl, tr;
+			bool hl = CAABBTree::intersectBox(nodes[node.first], o, invDir, tMin, t, tl);
+			bool hr = CAABBTree::intersectBox(nodes[node.first + 1], o, invDir, tMin, t, tr);
+			/* push the far child first, so that the near one is visited first and shrinks t */
+			if (hl && hr) {
+				if (tl <= tr) {
+					stack[top++] = node.first + 1;
+					stack[top++] = node.first;
+				}
+				else {
+					stack[top++] = node.first;
+					stack[top++] = node.first + 1;
+				}
+			}
+			else if (hl) stack[top++] = node.first;
+			else if (hr) stack[top++] = node.first + 1;
+		}
+		if (hitTri < 0) return false;
+		hit.pF = mFaces[hitTri];
+		hit.t = t;
+		hit.u = u;
+		hit.v = v;
+		return true;
+	}
+
+	template<typename MeshType>
+	inline bool CFaceBVH<MeshType>::occluded(const CPoint & org, const CPoint & dir, double tMin, double tMax) const
+	{
+		if (mTree.empty()) return false;
+		const std::vector<Node> & nodes = mTree.nodes();
+		const double o[3] = { org(0), org(1), org(2) };
+		const double invDir[3] = { 1.0 / dir(0), 1.0 / dir(1), 1.0 / dir(2) };
+		double t = tMax, u, v, tEnter;
+
+		int stack[MAX_STACK];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const Node & node = nodes[stack[--top]];
+			if (!CAABBTree::intersectBox(node, o, invDir, tMin, tMax, tEnter)) continue;
+			if (node.count > 0) {
+				for (int i = node.first; i < node.first + node.count; ++i) {
+					if (_intersectTriangle(i, org, dir, tMin, t, u, v)) return true;
+				}
+				continue;
+			}
+			stack[top++] = node.first + 1;
+			stack[top++] = node.first;
+		}
+		return false;
+	}
+
+	template<typename MeshType>
+	template<int N>
+	inline void CFaceBVH<MeshType>::intersect(const CPoint org[N], const CPoint dir[N], Hit hits[N], double tMin) const
+	{
+		/* lanes stored as structure of arrays, the per lane loops below are meant to be vectorized */
+		double o[3][N], d[3][N], invDir[3][N], t[N], hu[N], hv[N];
+		int hitTri[N];
+		for (int k = 0; k < 3; ++k) {
+			for (int r = 0; r < N; ++r) {
+				o[k][r] = org[r](k);
+				d[k][r] = dir[r](k);
+				invDir[k][r] = 1.0 / dir[r](k);
+			}
+		}
+		for (int r = 0; r < N; ++r) {
+			hits[r] = Hit();
+			t[r] = std::numeric_limits<double>::infinity();
+			hu[r] = hv[r] = 0;
+			hitTri[r] = -1;
+		}
+		if (mTree.empty()) return;
+		const std::vector<Node> & nodes = mTree.nodes();
+
+		int stack[MAX_STACK];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const Node & node = nodes[stack[--top]];
+			bool active[N];
+			bool any = false;
+			for (int r = 0; r < N; ++r) {
+				double t0 = tMin, t1 = t[r];
+				for (int k = 0; k < 3; ++k) {
+					double a = (node.bmin[k] - o[k][r]) * invDir[k][r];
+					double b = (node.bmax[k] - o[k][r]) * invDir[k][r];
+					double lo = a > b ? b : a, hi = a > b ? a : b;
+					t0 = lo > t0 ? lo : t0;
+					t1 = hi < t1 ? hi : t1;
+				}
+				active[r] = t0 <= t1;
+				any |= active[r];
+			}
+			if (!any) continue;
+			if (node.count > 0) {
+				for (int i = node.first; i < node.first + node.count; ++i) {
+					/* Moller-Trumbore on all the lanes, branch free */
+					const Triangle & tri = mTris[i];
+					const double p0[3] = { tri.p0(0), tri.p0(1), tri.p0(2) };
+					const double e1[3] = { tri.e1(0), tri.e1(1), tri.e1(2) };
+					const double e2[3] = { tri.e2(0), tri.e2(1), tri.e2(2) };
+					for (int r = 0; r < N; ++r) {
+						double P[3] = { d[1][r] * e2[2] - d[2][r] * e2[1], d[2][r] * e2[0] - d[0][r] * e2[2], d[0][r] * e2[1] - d[1][r] * e2[0] };
+						double det = e1[0] * P[0] + e1[1] * P[1] + e1[2] * P[2];
+						double invDet = 1.0 / det;
+						double T[3] = { o[0][r] - p0[0], o[1][r] - p0[1], o[2][r] - p0[2] };
+						double u = (T[0] * P[0] + T[1] * P[1] + T[2] * P[2]) * invDet;
+						double Q[3] = { T[1] * e1[2] - T[2] * e1[1], T[2] * e1[0] - T[0] * e1[2], T[0] * e1[1] - T[1] * e1[0] };
+						double v = (d[0][r] * Q[0] + d[1][r] * Q[1] + d[2][r] * Q[2]) * invDet;
+						double tt = (e2[0] * Q[0] + e2[1] * Q[1] + e2[2] * Q[2]) * invDet;
+						bool hit = active[r] & (det != 0) & (u >= 0) & (u <= 1) & (v >= 0) & (u + v <= 1) & (tt >= tMin) & (tt <= t[r]);
+						t[r] = hit ? tt : t[r];
+						hu[r] = hit ? u : hu[r];
+						hv[r] = hit ? v : hv[r];
+						hitTri[r] = hit ? i : hitTri[r];
+					}
+				}
+				continue;
+			}
+			/* near child first along the direction of the first ray of the packet */
+			int axis = 0;
+			const Node & l = nodes[node.first];
+			const Node & rn = nodes[node.first + 1];
+			double dc[3];
+			for (int k = 0; k < 3; ++k) dc[k] = (rn.bmin[k] + rn.bmax[k]) - (l.bmin[k] + l.bmax[k]);
+			if (fabs(dc[1]) > fabs(dc[axis])) axis = 1;
+			if (fabs(dc[2]) > fabs(dc[axis])) axis = 2;
+			if ((dc[axis] >= 0) == (invDir[axis][0] >= 0)) {
+				stack[top++] = node.first + 1;
+				stack[top++] = node.first;
+			}
+			else {
+				stack[top++] = node.first;
+				stack[top++] = node.first + 1;
+			}
+		}
+		for (int r = 0; r < N; ++r) {
+			if (hitTri[r] < 0) continue;
+			hits[r].pF = mFaces[hitTri[r]];
+			hits[r].t = t[r];
+			hits[r].u = hu[r];
+			hits[r].v = hv[r];
+		}
+	}
+
+	template<typename MeshType>
+	inline double CFaceBVH<MeshType>::closestPointOnTriangle(const CPoint & p, const CPoint & a, const CPoint & ab, const CPoint & ac,
+		double & u, double & v)
+	{
+		CPoint ap = p - a;
+		double d1 = ab * ap, d2 = ac * ap;
+		if (d1 <= 0 && d2 <= 0) {
+			u = 0; v = 0;
+			return ap * ap;
+		}
+		CPoint bp = ap - ab;
+		double d3 = ab * bp, d4 = ac * bp;
+		if (d3 >= 0 && d4 <= d3) {
+			u = 1; v = 0;
+			return bp * bp;
+		}
+		double vc = d1 * d4 - d3 * d2;
+		if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+			u = d1 / (d1 - d3); v = 0;
+			CPoint d = ap - ab * u;
+			return d * d;
+		}
+		CPoint cp = ap - ac;
+		double d5 = ab * cp, d6 = ac * cp;
+		if (d6 >= 0 && d5 <= d6) {
+			u = 0; v = 1;
+			return cp * cp;
+		}
+		double vb = d5 * d2 - d1 * d6;
+		if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+			u = 0; v = d2 / (d2 - d6);
+			CPoint d = ap - ac * v;
+			return d * d;
+		}
+		double va = d3 * d6 - d5 * d4;
+		if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+			v = (d4 - d3) / ((d4 - d3) + (d5 - d6)); u = 1 - v;
+			CPoint d = ap - ab * u - ac * v;
+			return d * d;
+		}
+		double denom = 1.0 / (va + vb + vc);
+		u = vb * denom;
+		v = vc * denom;
+		CPoint d = ap - ab * u - ac * v;
+		return d * d;
+	}
+
+	template<typename MeshType>
+	inline bool CFaceBVH<MeshType>::closestPoint(const CPoint & p, Hit & hit, CPoint & closest, double maxDist) const
+	{
+		hit = Hit();
+		if (mTree.empty()) return false;
+		const std::vector<Node> & nodes = mTree.nodes();
+		const double q[3] = { p(0), p(1), p(2) };
+		double best = maxDist * maxDist, u, v;
+		int bestTri = -1;
+
+		/* boxes are culled when pushed and again when popped, as the best distance may have shrunk meanwhile */
+		int stack[MAX_STACK];
+		double stackDist[MAX_STACK];
+		int top = 0;
+		stack[top] = 0;
+		stackDist[top++] = CAABBTree::boxDistance2(nodes[0], q);
+		while (top > 0) {
+			--top;
+			if (stackDist[top] >= best) continue;
+			const Node & node = nodes[stack[top]];
+			if (node.count > 0) {
+				for (int i = node.first; i < node.first + node.count; ++i) {
+					const Triangle & tri = mTris[i];
+					double d2 = closestPointOnTriangle(p, tri.p0, tri.e1, tri.e2, u, v);
+					if (d2 < best) {
+						best = d2;
+						bestTri = i;
+						hit.u = u;
+						hit.v = v;
+					}
+				}
+				continue;
+			}
+			/* near child pushed last, to be visited first */
+			double dl = CAABBTree::boxDistance2(nodes[node.first], q);
+			double dr = CAABBTree::boxDistance2(nodes[node.first + 1], q);
+			int nearChild = node.first, farChild = node.first + 1;
+			if (dr < dl) {
+				std::swap(nearChild, farChild);
+				std::swap(dl, dr);
+			}
+			if (dr < best) {
+				stack[top] = farChild;
+				stackDist[top++] = dr;
+			}
+			if (dl < best) {
+				stack[top] = nearChild;
+				stackDist[top++] = dl;
+			}
+		}
+		if (bestTri < 0) return false;
+		const Triangle & tri = mTris[bestTri];
+		closest = tri.p0 + tri.e1 * hit.u + tri.e2 * hit.v;
+		hit.pF = mFaces[bestTri];
+		hit.t = sqrt(best);
+		return true;
+	}
+
+	template<typename MeshType>
+	inline void CFaceBVH<MeshType>::closestPoints(const std::vector<CPoint> & points, std::vector<Hit> & hits,
+		std::vector<CPoint> * closest, double maxDist) const
+	{
+		hits.resize(points.size());
+		if (closest != NULL) closest->resize(points.size());
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < (int)points.size(); ++i) {
+			CPoint c;
+			closestPoint(points[i], hits[i], c, maxDist);
+			if (closest != NULL) (*closest)[i] = c;
+		}
+	}
+}
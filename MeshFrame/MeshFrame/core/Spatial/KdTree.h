@@ -0,0 +1,287 @@
+/*!
+*      \file KdTree.h
+*      \brief Balanced kd-tree over points for nearest and k nearest neighbour queries
+*
+*		The tree is implicit: node i covers a range of the permuted ids, split at the middle, and its
+*		children are 2 i + 1 and 2 i + 2. It is built level by level, the nodes of a level in parallel.
+*		Removed points are only marked and inserted points are kept in a pending list scanned by the
+*		queries; the tree is rebuilt once they amount to a quarter of it.
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+
+namespace MeshLib {
+
+	class CKdTree
+	{
+	public:
+		static const int LEAF_SIZE = 8;
+
+		/*!
+		Index points with the ids 0 ... n - 1.
+		*/
+		void build(const std::vector<CPoint> & points);
+		/*!
+		Index the live members of a vertex pool of a CBaseMesh or a CTMesh, the ids being the vertex indices.
+		\param getPoint getPoint(pV) returns the position of a vertex
+		*/
+		template<typename VertexPool, typename GetPoint>
+		void buildVertices(VertexPool & vertices, GetPoint getPoint);
+
+		/*! add a point, or move it if the id is already in the tree */
+		void insert(int id, const CPoint & p);
+		void remove(int id);
+		void move(int id, const CPoint & p) { insert(id, p); };
+		bool contains(int id) const { return id < (int)mStates.size() && mStates[id] != Absent; };
+		const CPoint & point(int id) const { return mPoints[id]; };
+		int size() const { return mSize; };
+
+		/*!
+		The k nearest ids of p by increasing distance, fewer if the tree has less than k points.
+		\param dist2 if not NULL, receives their squared distances
+		*/
+		void knn(const CPoint & p, int k, std::vector<int> & ids, std::vector<double> * dist2 = NULL) const;
+		/*! the nearest id, -1 if the tree is empty */
+		int nearest(const CPoint & p) const;
+		/*! k nearest of a batch of points in parallel: ids[k * i + j] is the j-th neighbour of queries[i], -1 if none */
+		void knn(const std::vector<CPoint> & queries, int k, std::vector<int> & ids) const;
+
+	private:
+		enum State { Absent, InTree, Pending };
+
+		/*! build the tree over the ids in mOrder */
+		void _build();
+		void _rebuildIfNeeded();
+		/*! bounded max heap of the best candidates */
+		void _push(std::vector<std::pair<double, int>> & heap, int k, double d2, int id) const;
+
+		std::vector<CPoint>        mPoints;
+		std::vector<unsigned char> mStates;
+		/*! ids in tree order, and their positions for locality */
+		std::vector<int>           mOrder;
+		std::vector<CPoint>        mOrderPoints;
+		/*! split axis and coordinate of each interior node, the axis of the leaves is -1 */
+		std::vector<signed char>   mSplitAxes;
+		std::vector<double>        mSplitValues;
+		std::vector<int>           mPending;
+		int                        mNumRemoved = 0;
+		int                        mSize = 0;
+	};
+
+	inline void CKdTree::build(const std::vector<CPoint> & points)
+	{
+		const int n = (int)points.size();
+		mPoints = points;
+		mStates.assign(n, InTree);
+		mOrder.resize(n);
+		for (int i = 0; i < n; ++i) mOrder[i] = i;
+		_build();
+	}
+
+	template<typename VertexPool, typename GetPoint>
+	inline void CKdTree::buildVertices(VertexPool & vertices, GetPoint getPoint)
+	{
+		mPoints.assign(vertices.getCurrentIndex(), CPoint(0, 0, 0));
+		mStates.assign(vertices.getCurrentIndex(), Absent);
+		mOrder.clear();
+		for (auto pV : vertices) {
+			mOrder.push_back((int)pV->index());
+			mPoints[pV->index()] = getPoint(pV);
+			mStates[pV->index()] = InTree;
+		}
+		_build();
+	}
+
+	inline void CKdTree::_build()
+	{
+		const int n = (int)mOrder.size();
+		mSize = n;
+		mPending.clear();
+		mNumRemoved = 0;
+
+		int numLevels = 1;
+		for (int size = n; size > LEAF_SIZE; size = (size + 1) / 2) ++numLevels;
+		mSplitAxes.assign((1 << numLevels) - 1, -1);
+		mSplitValues.assign(mSplitAxes.size(), 0.0);
+
+		struct Range { int node, begin, end; };
+		std::vector<Range> level(1, Range{ 0, 0, n }), next;
+		while (!level.empty()) {
+			next.assign(2 * level.size(), Range{ -1, 0, 0 });
+#pragma omp parallel for schedule(dynamic, 1)
+			for (int r = 0; r < (int)level.size(); ++r) {
+				const Range range = level[r];
+				if (range.end - range.begin <= LEAF_SIZE) continue;
+				/* split the widest axis at the median */
+				CPoint lo = mPoints[mOrder[range.begin]], hi = lo;
+				for (int k = range.begin + 1; k < range.end; ++k) {
+					const CPoint & p = mPoints[mOrder[k]];
+					for (int a = 0; a < 3; ++a) {
+						lo[a] = std::min(lo[a], p[a]);
+						hi[a] = std::max(hi[a], p[a]);
+					}
+				}
+				int axis = 0;
+				for (int a = 1; a < 3; ++a) {
+					if (hi[a] - lo[a] > hi[axis] - lo[axis]) axis = a;
+				}
+				const int mid = (range.begin + range.end) / 2;
+				std::nth_element(mOrder.begin() + range.begin, mOrder.begin() + mid, mOrder.begin() + range.end,
+					[&](int a, int b) { return mPoints[a][axis] < mPoints[b][axis]; });
+				mSplitAxes[range.node] = (signed char)axis;
+				mSplitValues[range.node] = mPoints[mOrder[mid]][axis];
+				next[2 * r] = Range{ 2 * range.node + 1, range.begin, mid };
+				next[2 * r + 1] = Range{ 2 * range.node + 2, mid, range.end };
+			}
+			level.clear();
+			for (const Range & range : next) {
+				if (range.node >= 0) level.push_back(range);
+			}
+		}
+
+		mOrderPoints.resize(n);
+#pragma omp parallel for
+		for (int k = 0; k < n; ++k) mOrderPoints[k] = mPoints[mOrder[k]];
+	}
+
+	inline void CKdTree::insert(int id, const CPoint & p)
+	{
+		if (id >= (int)mStates.size()) {
+			mStates.resize(id + 1, Absent);
+			mPoints.resize(id + 1);
+		}
+		if (mStates[id] == Pending) {
+			mPoints[id] = p;
+			return;
+		}
+		if (mStates[id] == InTree) {
+			++mNumRemoved;
+			--mSize;
+		}
+		mPoints[id] = p;
+		mStates[id] = Pending;
+		mPending.push_back(id);
+		++mSize;
+		_rebuildIfNeeded();
+	}
+
+	inline void CKdTree::remove(int id)
+	{
+		if (!contains(id)) return;
+		if (mStates[id] == Pending) {
+			mPending.erase(std::find(mPending.begin(), mPending.end(), id));
+		}
+		else {
+			++mNumRemoved;
+		}
+		mStates[id] = Absent;
+		--mSize;
+		_rebuildIfNeeded();
+	}
+
+	inline void CKdTree::_rebuildIfNeeded()
+	{
+		if (4 * (int)(mPending.size() + mNumRemoved) <= (int)mOrder.size() + 64) return;
+		std::vector<int> ids;
+		ids.reserve(mSize);
+		for (int id : mOrder) {
+			/* an id moved to the pending list is kept once, from there */
+			if (mStates[id] == InTree) ids.push_back(id);
+		}
+		for (int id : mPending) {
+			mStates[id] = InTree;
+			ids.push_back(id);
+		}
+		mOrder.swap(ids);
+		_build();
+	}
+
+	inline void CKdTree::_push(std::vector<std::pair<double, int>> & heap, int k, double d2, int id) const
+	{
+		if ((int)heap.size() < k) {
+			heap.push_back(std::make_pair(d2, id));
+			std::push_heap(heap.begin(), heap.end());
+		}
+		else if (d2 < heap.front().first) {
+			std::pop_heap(heap.begin(), heap.end());
+			heap.back() = std::make_pair(d2, id);
+			std::push_heap(heap.begin(), heap.end());
+		}
+	}
+
+	inline void CKdTree::knn(const CPoint & p, int k, std::vector<int> & ids, std::vector<double> * dist2) const
+	{
+		std::vector<std::pair<double, int>> heap;
+		heap.reserve(k + 1);
+		if (k > 0 && !mOrder.empty()) {
+			struct Item { int node, begin, end; double d2; };
+			Item stack[64];
+			int top = 0;
+			stack[top++] = Item{ 0, 0, (int)mOrder.size(), 0.0 };
+			while (top > 0) {
+				const Item item = stack[--top];
+				if ((int)heap.size() == k && item.d2 >= heap.front().first) continue;
+				const int axis = item.node < (int)mSplitAxes.size() ? mSplitAxes[item.node] : -1;
+				if (axis < 0) {
+					for (int j = item.begin; j < item.end; ++j) {
+						const int id = mOrder[j];
+						if (mStates[id] != InTree) continue;
+						_push(heap, k, (mOrderPoints[j] - p).normSquare(), id);
+					}
+					continue;
+				}
+				const int mid = (item.begin + item.end) / 2;
+				const double diff = p[axis] - mSplitValues[item.node];
+				const Item left = Item{ 2 * item.node + 1, item.begin, mid, diff > 0 ? diff * diff : item.d2 };
+				const Item right = Item{ 2 * item.node + 2, mid, item.end, diff < 0 ? diff * diff : item.d2 };
+				/* the near child is popped first */
+				if (diff < 0) {
+					stack[top++] = right;
+					stack[top++] = left;
+				}
+				else {
+					stack[top++] = left;
+					stack[top++] = right;
+				}
+			}
+			for (int id : mPending) {
+				_push(heap, k, (mPoints[id] - p).normSquare(), id);
+			}
+		}
+		std::sort_heap(heap.begin(), heap.end());
+		ids.resize(heap.size());
+		for (size_t j = 0; j < heap.size(); ++j) ids[j] = heap[j].second;
+		if (dist2 != NULL) {
+			dist2->resize(heap.size());
+			for (size_t j = 0; j < heap.size(); ++j) (*dist2)[j] = heap[j].first;
+		}
+	}
+
+	inline int CKdTree::nearest(const CPoint & p) const
+	{
+		std::vector<int> ids;
+		knn(p, 1, ids);
+		return ids.empty() ? -1 : ids[0];
+	}
+
+	inline void CKdTree::knn(const std::vector<CPoint> & queries, int k, std::vector<int> & ids) const
+	{
+		const int n = (int)queries.size();
+		ids.assign((size_t)n * k, -1);
+#pragma omp parallel
+		{
+			std::vector<int> row;
+#pragma omp for schedule(dynamic, 256)
+			for (int i = 0; i < n; ++i) {
+				knn(queries[i], k, row);
+				std::copy(row.begin(), row.end(), ids.begin() + (size_t)k * i);
+			}
+		}
+	}
+}
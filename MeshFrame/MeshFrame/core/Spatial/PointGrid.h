@@ -0,0 +1,211 @@
+/*!
+*      \file PointGrid.h
+*      \brief Uniform hash grid over points for radius queries, kept up to date by insert, remove and move
+*
+*		The points are identified by ints, e.g. the vertex indices of a mesh. The non empty cells are
+*		stored in a hash map from the cell key to the ids in the cell.
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <stdint.h>
+#include <math.h>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Memory/CSRArray.h"
+#include "../Parallel/ParallelAlgorithms.h"
+
+namespace MeshLib {
+
+	class CPointGrid
+	{
+	public:
+		/*!
+		Index points with the ids 0 ... n - 1, in parallel.
+		\param cellSize about the radius of the queries
+		*/
+		void build(const std::vector<CPoint> & points, double cellSize);
+		/*!
+		Index the live members of a vertex pool of a CBaseMesh or a CTMesh, the ids being the vertex indices.
+		\param getPoint getPoint(pV) returns the position of a vertex
+		*/
+		template<typename VertexPool, typename GetPoint>
+		void buildVertices(VertexPool & vertices, GetPoint getPoint, double cellSize);
+
+		/*! add a point, or move it if the id is already in the grid */
+		void insert(int id, const CPoint & p);
+		void remove(int id);
+		void move(int id, const CPoint & p) { insert(id, p); };
+		bool contains(int id) const { return id < (int)mSlots.size() && mSlots[id] >= 0; };
+		const CPoint & point(int id) const { return mPoints[id]; };
+		int size() const { return mSize; };
+		double cellSize() const { return mCellSize; };
+
+		/*! the ids within radius of p, in no particular order */
+		void radiusQuery(const CPoint & p, double radius, std::vector<int> & ids) const;
+		/*! the closest id within radius of p, -1 if none */
+		int closest(const CPoint & p, double radius) const;
+		/*! radius queries of a batch of points in parallel, row i of ids answers queries[i] */
+		void radiusQuery(const std::vector<CPoint> & queries, double radius, CCSRArray & ids) const;
+
+	private:
+		int _cell(double x) const { return (int)floor(x * mInvCellSize); };
+		/*! 21 bits per axis; cells further apart share a key, the distance test sorts them out */
+		static uint64_t _key(int cx, int cy, int cz)
+		{
+			const uint64_t mask = (1 << 21) - 1;
+			return (((uint64_t)cx & mask) << 42) | (((uint64_t)cy & mask) << 21) | ((uint64_t)cz & mask);
+		};
+		uint64_t _key(const CPoint & p) const { return _key(_cell(p[0]), _cell(p[1]), _cell(p[2])); };
+		/*! calls visit(id, squared distance) for the ids within radius of p */
+		template<typename Visit>
+		void _forEach(const CPoint & p, double radius, Visit visit) const;
+		/*! fill the cells from the ids in mPoints, the slots of ids not to be indexed being -1 */
+		void _fill(std::vector<int> & ids, double cellSize);
+
+		std::unordered_map<uint64_t, std::vector<int>> mCells;
+		/*! id -> position */
+		std::vector<CPoint> mPoints;
+		/*! id -> place in its cell, -1 if not in the grid */
+		std::vector<int>    mSlots;
+		double              mCellSize = 1;
+		double              mInvCellSize = 1;
+		int                 mSize = 0;
+	};
+
+	inline void CPointGrid::build(const std::vector<CPoint> & points, double cellSize)
+	{
+		const int n = (int)points.size();
+		mPoints = points;
+		std::vector<int> ids(n);
+#pragma omp parallel for
+		for (int i = 0; i < n; ++i) ids[i] = i;
+		_fill(ids, cellSize);
+	}
+
+	template<typename VertexPool, typename GetPoint>
+	inline void CPointGrid::buildVertices(VertexPool & vertices, GetPoint getPoint, double cellSize)
+	{
+		mPoints.assign(vertices.getCurrentIndex(), CPoint(0, 0, 0));
+		std::vector<int> ids;
+		ids.reserve(vertices.size());
+		for (auto pV : vertices) {
+			ids.push_back((int)pV->index());
+			mPoints[pV->index()] = getPoint(pV);
+		}
+		_fill(ids, cellSize);
+	}
+
+	inline void CPointGrid::_fill(std::vector<int> & ids, double cellSize)
+	{
+		mCellSize = cellSize;
+		mInvCellSize = 1.0 / cellSize;
+		mSize = (int)ids.size();
+		mCells.clear();
+		mSlots.assign(mPoints.size(), -1);
+
+		/* sort the ids by cell in parallel, then each cell is a range */
+		std::vector<uint64_t> keys(mPoints.size());
+#pragma omp parallel for
+		for (int i = 0; i < mSize; ++i) keys[ids[i]] = _key(mPoints[ids[i]]);
+		Parallel::sort(ids.begin(), ids.end(), [&](int a, int b) {
+			return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+		});
+		mCells.reserve(mSize / 4 + 1);
+		for (int begin = 0, end; begin < mSize; begin = end) {
+			const uint64_t key = keys[ids[begin]];
+			for (end = begin + 1; end < mSize && keys[ids[end]] == key; ++end);
+			std::vector<int> & cell = mCells[key];
+			cell.assign(ids.begin() + begin, ids.begin() + end);
+			for (int k = begin; k < end; ++k) mSlots[ids[k]] = k - begin;
+		}
+	}
+
+	inline void CPointGrid::insert(int id, const CPoint & p)
+	{
+		if (contains(id)) {
+			if (_key(mPoints[id]) == _key(p)) {
+				mPoints[id] = p;
+				return;
+			}
+			remove(id);
+		}
+		if (id >= (int)mSlots.size()) {
+			mSlots.resize(id + 1, -1);
+			mPoints.resize(id + 1);
+		}
+		mPoints[id] = p;
+		std::vector<int> & cell = mCells[_key(p)];
+		mSlots[id] = (int)cell.size();
+		cell.push_back(id);
+		++mSize;
+	}
+
+	inline void CPointGrid::remove(int id)
+	{
+		if (!contains(id)) return;
+		auto it = mCells.find(_key(mPoints[id]));
+		std::vector<int> & cell = it->second;
+		/* move the last id of the cell to the hole */
+		const int slot = mSlots[id];
+		cell[slot] = cell.back();
+		mSlots[cell[slot]] = slot;
+		cell.pop_back();
+		if (cell.empty()) mCells.erase(it);
+		mSlots[id] = -1;
+		--mSize;
+	}
+
+	template<typename Visit>
+	inline void CPointGrid::_forEach(const CPoint & p, double radius, Visit visit) const
+	{
+		int lo[3], hi[3];
+		for (int k = 0; k < 3; ++k) {
+			lo[k] = _cell(p[k] - radius);
+			hi[k] = _cell(p[k] + radius);
+		}
+		const double radius2 = radius * radius;
+		for (int x = lo[0]; x <= hi[0]; ++x) {
+			for (int y = lo[1]; y <= hi[1]; ++y) {
+				for (int z = lo[2]; z <= hi[2]; ++z) {
+					auto it = mCells.find(_key(x, y, z));
+					if (it == mCells.end()) continue;
+					for (int id : it->second) {
+						const double d2 = (mPoints[id] - p).normSquare();
+						if (d2 <= radius2) visit(id, d2);
+					}
+				}
+			}
+		}
+	}
+
+	inline void CPointGrid::radiusQuery(const CPoint & p, double radius, std::vector<int> & ids) const
+	{
+		ids.clear();
+		_forEach(p, radius, [&](int id, double) { ids.push_back(id); });
+	}
+
+	inline int CPointGrid::closest(const CPoint & p, double radius) const
+	{
+		int best = -1;
+		double bestD2 = radius * radius;
+		_forEach(p, radius, [&](int id, double d2) {
+			if (d2 < bestD2 || (d2 == bestD2 && (best < 0 || id < best))) {
+				best = id;
+				bestD2 = d2;
+			}
+		});
+		return best;
+	}
+
+	inline void CPointGrid::radiusQuery(const std::vector<CPoint> & queries, double radius, CCSRArray & ids) const
+	{
+		ids.build((int)queries.size(), [&](int i, std::vector<int> & row) {
+			_forEach(queries[i], radius, [&](int id, double) { row.push_back(id); });
+		});
+	}
+}
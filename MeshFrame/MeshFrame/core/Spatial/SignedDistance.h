@@ -0,0 +1,143 @@
+/*!
+*      \file SignedDistance.h
+*      \brief Signed distance to a closed triangle mesh
+*
+*		The sign is taken from the angle weighted pseudonormal of the closest feature (face, edge or vertex),
+*		Baerentzen and Aanaes, Signed distance computation using the angle weighted pseudonormal, 2005.
+*/
+
+#pragma once
+
+#include <vector>
+#include <math.h>
+
+#include "FaceBVH.h"
+
+namespace MeshLib {
+
+	template<typename MeshType>
+	class CSignedDistance
+	{
+	public:
+		typedef typename MeshType::VPtr VPtr;
+		typedef typename MeshType::EPtr EPtr;
+		typedef typename MeshType::FPtr FPtr;
+		typedef typename MeshType::HEPtr HEPtr;
+		typedef typename CFaceBVH<MeshType>::Hit Hit;
+
+		/*!
+		Build the face hierarchy and the pseudonormals. The mesh should be closed and consistently oriented,
+		near the boundary of an open mesh the sign is meaningless.
+		*/
+		void build(MeshType * pMesh, int maxLeafSize = 4);
+		/*!
+		Update after the vertices moved, the connectivity must not have changed.
+		*/
+		void refit();
+
+		/*!
+		Signed distance from p to the mesh, positive on the side the face normals point to.
+		\param hit if not NULL, receives the closest face and barycentric coordinates
+		\param closest if not NULL, receives the closest point
+		*/
+		double signedDistance(const CPoint & p, Hit * hit = NULL, CPoint * closest = NULL) const;
+		/*!
+		Signed distances of a batch of query points, in parallel.
+		*/
+		void signedDistances(const std::vector<CPoint> & points, std::vector<double> & distances) const;
+
+		const CFaceBVH<MeshType> & bvh() const { return mBVH; };
+
+	private:
+		void _computePseudonormals();
+
+		MeshType *         mpMesh = NULL;
+		CFaceBVH<MeshType> mBVH;
+		/*! indexed by vertex and edge index() */
+		std::vector<CPoint> mVNormals;
+		std::vector<CPoint> mENormals;
+	};
+
+	template<typename MeshType>
+	inline void CSignedDistance<MeshType>::build(MeshType * pMesh, int maxLeafSize)
+	{
+		mpMesh = pMesh;
+		mBVH.build(pMesh, maxLeafSize);
+		_computePseudonormals();
+	}
+
+	template<typename MeshType>
+	inline void CSignedDistance<MeshType>::refit()
+	{
+		mBVH.refit();
+		_computePseudonormals();
+	}
+
+	template<typename MeshType>
+	inline void CSignedDistance<MeshType>::_computePseudonormals()
+	{
+		mVNormals.assign(mpMesh->vertices().getCurrentIndex(), CPoint(0, 0, 0));
+		mENormals.assign(mpMesh->edges().getCurrentIndex(), CPoint(0, 0, 0));
+
+		/* sums over the faces around: the face normal weighted by the corner angle for the vertices, unweighted for the edges */
+		for (FPtr pF : mpMesh->faces()) {
+			CPoint n = MeshType::faceNormal(pF);
+			HEPtr pH = MeshType::faceHalfedge(pF);
+			for (int k = 0; k < 3; ++k) {
+				HEPtr pHNext = MeshType::halfedgeNext(pH);
+				VPtr pV = MeshType::halfedgeTarget(pH);
+				CPoint a = MeshType::halfedgeSource(pH)->point() - pV->point();
+				CPoint b = MeshType::halfedgeTarget(pHNext)->point() - pV->point();
+				double c = (a * b) / (a.norm() * b.norm());
+				c = c > 1 ? 1 : (c < -1 ? -1 : c);
+				mVNormals[pV->index()] += n * acos(c);
+				mENormals[MeshType::halfedgeEdge(pH)->index()] += n;
+				pH = pHNext;
+			}
+		}
+	}
+
+	template<typename MeshType>
+	inline double CSignedDistance<MeshType>::signedDistance(const CPoint & p, Hit * hit, CPoint * closest) const
+	{
+		Hit h;
+		CPoint c;
+		if (!mBVH.closestPoint(p, h, c)) {
+			return std::numeric_limits<double>::infinity();
+		}
+		if (hit != NULL) *hit = h;
+		if (closest != NULL) *closest = c;
+
+		/* the closest feature from the exact zeros of the barycentric coordinates */
+		int numZeros = (h.u == 0) + (h.v == 0) + (h.u + h.v >= 1);
+		HEPtr pHs[3];
+		pHs[0] = MeshType::faceHalfedge(h.pF);
+		pHs[1] = MeshType::halfedgeNext(pHs[0]);
+		pHs[2] = MeshType::halfedgeNext(pHs[1]);
+
+		CPoint n;
+		if (numZeros >= 2) {
+			int k = (h.u == 1) ? 1 : ((h.v == 1) ? 2 : 0);
+			n = mVNormals[MeshType::halfedgeTarget(pHs[k])->index()];
+		}
+		else if (numZeros == 1) {
+			/* the edge opposite to corner k is the edge of pHs[k + 2], from corner k + 1 to corner k + 2 */
+			int k = (h.u == 0) ? 1 : ((h.v == 0) ? 2 : 0);
+			n = mENormals[MeshType::halfedgeEdge(pHs[(k + 2) % 3])->index()];
+		}
+		else {
+			n = MeshType::faceNormal(h.pF);
+		}
+		return ((p - c) * n) >= 0 ? h.t : -h.t;
+	}
+
+	template<typename MeshType>
+	inline void CSignedDistance<MeshType>::signedDistances(const std::vector<CPoint> & points, std::vector<double> & distances) const
+	{
+		distances.resize(points.size());
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < (int)points.size(); ++i) {
+			distances[i] = signedDistance(points[i]);
+		}
+	}
+}
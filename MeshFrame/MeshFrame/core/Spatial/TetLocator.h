@@ -0,0 +1,299 @@
+/*!
+*      \file TetLocator.h
+*      \brief Point location in tetrahedral meshes and interpolation of vertex fields
+*
+*		Cold queries go through a CAABBTree over the tets, coherent queries walk from the previous
+*		tet through the dual half faces and only fall back to the tree when the walk leaves the mesh.
+*/
+
+#pragma once
+
+#include <vector>
+#include <math.h>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Geometry/Point4.h"
+#include "../TetMesh/TProps.h"
+#include "AABBTree.h"
+
+namespace MeshLib
+{
+	namespace TMeshLib
+	{
+		template<typename TMeshType>
+		class CTetLocator
+		{
+		public:
+			typedef typename TMeshType::TPtr TPtr;
+			typedef typename TMeshType::VPtr VPtr;
+			typedef typename TMeshType::HFPtr HFPtr;
+
+			/*!
+			Build the tree over the tets of the mesh and the per tet barycentric frames.
+			*/
+			void build(TMeshType * pMesh, int maxLeafSize = 4);
+			/*!
+			Update after the vertices moved, the connectivity must not have changed.
+			*/
+			void refit();
+
+			/*!
+			Find the tet containing p through the tree.
+			\param bary barycentric coordinates of p, bary[i] being the weight of TetVertex(pT, i)
+			\return the tet, NULL if p is outside of the mesh
+			*/
+			TPtr locate(const CPoint & p, CPoint4 & bary) const;
+			/*!
+			Find the tet containing p by walking from pStart towards p, through the half face opposite to the
+			most negative barycentric coordinate. Cheap when p is close to pStart, e.g. along a particle path.
+			Falls back to locate() when the walk reaches the boundary, the domain may not be convex.
+			*/
+			TPtr walk(const CPoint & p, CPoint4 & bary, TPtr pStart) const;
+			/*!
+			Locate a batch of points in parallel.
+			\param coherent whether consecutive points are close to each other, each thread then walks from the
+			tet of its previous point
+			*/
+			void locate(const std::vector<CPoint> & points, std::vector<TPtr> & tets, std::vector<CPoint4> & barys, bool coherent = true) const;
+
+			/*!
+			Linear interpolation of a vertex property inside a tet.
+			*/
+			template<typename T>
+			T interpolate(VPropHandle<T> & prop, TPtr pT, const CPoint4 & bary) const;
+			/*!
+			Linear interpolation of a vertex property at p.
+			\param pHint in: the tet to walk from, NULL for a cold query; out: the tet containing p
+			\return false if p is outside of the mesh
+			*/
+			template<typename T>
+			bool interpolate(VPropHandle<T> & prop, const CPoint & p, T & value, TPtr * pHint = NULL) const;
+
+			/*!
+			Copy a query result into a CBaryCoordinates4D (Geometry/BaryCoordinates4D.h, or the one CTetFL derives
+			from): coordinate i, the vertex it weights and the half face opposite to that vertex.
+			*/
+			template<typename BaryCoordinates>
+			static void toBaryCoordinates(TPtr pT, const CPoint4 & bary, BaryCoordinates & coords);
+
+		private:
+			/*! p = v0 + M (b1, b2, b3), with M = [v1 - v0, v2 - v0, v3 - v0], stores M^-1 */
+			struct Frame
+			{
+				CPoint v0;
+				double inv[9];
+			};
+
+			void _setFrame(TPtr pT);
+			bool _bary(TPtr pT, const CPoint & p, CPoint4 & bary) const;
+
+			TMeshType *       mpMesh = NULL;
+			CAABBTree         mTree;
+			/*! tets in leaf order */
+			std::vector<TPtr> mTets;
+			/*! indexed by tet index() */
+			std::vector<Frame> mFrames;
+			int               mMaxWalk = 0;
+		};
+
+		/*! barycentric coordinates down to -INSIDE_TOLERANCE count as inside, for the points on the faces */
+		const double TET_LOCATOR_INSIDE_TOLERANCE = 1e-10;
+
+		template<typename TMeshType>
+		inline void CTetLocator<TMeshType>::build(TMeshType * pMesh, int maxLeafSize)
+		{
+			mpMesh = pMesh;
+			mTets.clear();
+			mTets.reserve(pMesh->numTets());
+			for (TPtr pT : pMesh->tets()) {
+				mTets.push_back(pT);
+			}
+			const int numTets = (int)mTets.size();
+			mFrames.resize(pMesh->tets().getCurrentIndex());
+			/* a walk through more tets than the width of the mesh in tets went wrong */
+			mMaxWalk = 64 + 4 * (int)cbrt((double)numTets);
+
+			std::vector<CAABBTree::PrimBounds> primBounds(numTets);
+#pragma omp parallel for
+			for (int i = 0; i < numTets; ++i) {
+				TPtr pT = mTets[i];
+				_setFrame(pT);
+				CAABBTree::PrimBounds & b = primBounds[i];
+				for (int k = 0; k < 3; ++k) {
+					b[k] = std::numeric_limits<double>::infinity();
+					b[3 + k] = -std::numeric_limits<double>::infinity();
+					b[6 + k] = 0;
+				}
+				for (int j = 0; j < 4; ++j) {
+					const CPoint & v = TMeshType::TetVertex(pT, j)->position();
+					for (int k = 0; k < 3; ++k) {
+						b[k] = std::min(b[k], v(k));
+						b[3 + k] = std::max(b[3 + k], v(k));
+						b[6 + k] += 0.25 * v(k);
+					}
+				}
+			}
+			mTree.build(primBounds, maxLeafSize);
+
+			const std::vector<int> & order = mTree.order();
+			std::vector<TPtr> tets(numTets);
+			for (int i = 0; i < numTets; ++i) {
+				tets[i] = mTets[order[i]];
+			}
+			mTets.swap(tets);
+		}
+
+		template<typename TMeshType>
+		inline void CTetLocator<TMeshType>::refit()
+		{
+			if (mTree.empty()) return;
+#pragma omp parallel for
+			for (int i = 0; i < (int)mTets.size(); ++i) {
+				_setFrame(mTets[i]);
+			}
+			mTree.refit([this](int i, double bmin[3], double bmax[3]) {
+				for (int j = 0; j < 4; ++j) {
+					const CPoint & v = TMeshType::TetVertex(mTets[i], j)->position();
+					for (int k = 0; k < 3; ++k) {
+						bmin[k] = std::min(bmin[k], v(k));
+						bmax[k] = std::max(bmax[k], v(k));
+					}
+				}
+			});
+		}
+
+		template<typename TMeshType>
+		inline void CTetLocator<TMeshType>::_setFrame(TPtr pT)
+		{
+			Frame & f = mFrames[pT->index()];
+			f.v0 = TMeshType::TetVertex(pT, 0)->position();
+			CPoint a = TMeshType::TetVertex(pT, 1)->position() - f.v0;
+			CPoint b = TMeshType::TetVertex(pT, 2)->position() - f.v0;
+			CPoint c = TMeshType::TetVertex(pT, 3)->position() - f.v0;
+			/* rows of M^-1 are the cross products of the columns of M over its determinant */
+			double det = a * (b ^ c);
+			double invDet = det != 0 ? 1.0 / det : std::numeric_limits<double>::quiet_NaN();
+			CPoint r0 = (b ^ c) * invDet, r1 = (c ^ a) * invDet, r2 = (a ^ b) * invDet;
+			for (int k = 0; k < 3; ++k) {
+				f.inv[k] = r0(k);
+				f.inv[3 + k] = r1(k);
+				f.inv[6 + k] = r2(k);
+			}
+		}
+
+		/*! barycentric coordinates of p in pT, returns whether p is inside; always false for a flat tet */
+		template<typename TMeshType>
+		inline bool CTetLocator<TMeshType>::_bary(TPtr pT, const CPoint & p, CPoint4 & bary) const
+		{
+			const Frame & f = mFrames[pT->index()];
+			double d[3] = { p(0) - f.v0(0), p(1) - f.v0(1), p(2) - f.v0(2) };
+			bary[1] = f.inv[0] * d[0] + f.inv[1] * d[1] + f.inv[2] * d[2];
+			bary[2] = f.inv[3] * d[0] + f.inv[4] * d[1] + f.inv[5] * d[2];
+			bary[3] = f.inv[6] * d[0] + f.inv[7] * d[1] + f.inv[8] * d[2];
+			bary[0] = 1.0 - bary[1] - bary[2] - bary[3];
+			const double tol = -TET_LOCATOR_INSIDE_TOLERANCE;
+			return bary[0] >= tol && bary[1] >= tol && bary[2] >= tol && bary[3] >= tol;
+		}
+
+		template<typename TMeshType>
+		inline typename CTetLocator<TMeshType>::TPtr CTetLocator<TMeshType>::locate(const CPoint & p, CPoint4 & bary) const
+		{
+			if (mTree.empty()) return NULL;
+			const std::vector<CAABBTree::Node> & nodes = mTree.nodes();
+			const double q[3] = { p(0), p(1), p(2) };
+
+			int stack[CAABBTree::MAX_STACK];
+			int top = 0;
+			stack[top++] = 0;
+			while (top > 0) {
+				const CAABBTree::Node & node = nodes[stack[--top]];
+				if (!CAABBTree::containsPoint(node, q)) continue;
+				if (node.count > 0) {
+					for (int i = node.first; i < node.first + node.count; ++i) {
+						if (_bary(mTets[i], p, bary)) return mTets[i];
+					}
+					continue;
+				}
+				stack[top++] = node.first + 1;
+				stack[top++] = node.first;
+			}
+			return NULL;
+		}
+
+		template<typename TMeshType>
+		inline typename CTetLocator<TMeshType>::TPtr CTetLocator<TMeshType>::walk(const CPoint & p, CPoint4 & bary, TPtr pStart) const
+		{
+			TPtr pT = pStart;
+			for (int step = 0; pT != NULL && step < mMaxWalk; ++step) {
+				if (_bary(pT, p, bary)) return pT;
+				/* half face i is opposite to vertex i */
+				int exit = 0;
+				for (int i = 1; i < 4; ++i) {
+					if (bary[i] < bary[exit]) exit = i;
+				}
+				if (!(bary[exit] < 0)) break;
+				HFPtr pHF = TMeshType::HalfFaceDual(TMeshType::TetHalfFace(pT, exit));
+				pT = pHF != NULL ? TMeshType::HalfFaceTet(pHF) : NULL;
+			}
+			return locate(p, bary);
+		}
+
+		template<typename TMeshType>
+		inline void CTetLocator<TMeshType>::locate(const std::vector<CPoint> & points, std::vector<TPtr> & tets,
+			std::vector<CPoint4> & barys, bool coherent) const
+		{
+			tets.resize(points.size());
+			barys.resize(points.size());
+#pragma omp parallel
+			{
+				TPtr pHint = NULL;
+#pragma omp for schedule(static)
+				for (int i = 0; i < (int)points.size(); ++i) {
+					if (coherent && pHint != NULL) {
+						tets[i] = walk(points[i], barys[i], pHint);
+					}
+					else {
+						tets[i] = locate(points[i], barys[i]);
+					}
+					if (tets[i] != NULL) pHint = tets[i];
+				}
+			}
+		}
+
+		template<typename TMeshType>
+		template<typename BaryCoordinates>
+		inline void CTetLocator<TMeshType>::toBaryCoordinates(TPtr pT, const CPoint4 & bary, BaryCoordinates & coords)
+		{
+			for (int i = 0; i < 4; ++i) {
+				/* not setCoordinate(CPoint4), which checks a sum of the first two coordinates only */
+				coords.setCoordinate(bary(i), i);
+				coords.setVpVertice(TMeshType::TetVertex(pT, i), i);
+				coords.setVpHalfface(TMeshType::TetHalfFace(pT, i), i);
+			}
+		}
+
+		template<typename TMeshType>
+		template<typename T>
+		inline T CTetLocator<TMeshType>::interpolate(VPropHandle<T> & prop, TPtr pT, const CPoint4 & bary) const
+		{
+			T value = mpMesh->gVP(prop, TMeshType::TetVertex(pT, 0)) * bary(0);
+			for (int i = 1; i < 4; ++i) {
+				value += mpMesh->gVP(prop, TMeshType::TetVertex(pT, i)) * bary(i);
+			}
+			return value;
+		}
+
+		template<typename TMeshType>
+		template<typename T>
+		inline bool CTetLocator<TMeshType>::interpolate(VPropHandle<T> & prop, const CPoint & p, T & value, TPtr * pHint) const
+		{
+			CPoint4 bary;
+			TPtr pT = (pHint != NULL && *pHint != NULL) ? walk(p, bary, *pHint) : locate(p, bary);
+			if (pHint != NULL) *pHint = pT;
+			if (pT == NULL) return false;
+			value = interpolate(prop, pT, bary);
+			return true;
+		}
+	}
+}
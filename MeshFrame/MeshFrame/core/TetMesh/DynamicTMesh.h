@@ -0,0 +1,819 @@
+/*!
+*      \file DynamicTMesh.h
+*      \brief Local topological operators on tet meshes: 2-3 and 3-2 flips, edge removal, multi-face removal,
+*		edge split and edge collapse
+*
+*		Every operator replaces the tets of a cavity by new ones with the same boundary: the old tets are unlinked
+*		from the faces and the edges they share with the rest of the mesh, then the new tets are linked to the
+*		faces and the edges already there, or to new ones, so that the half faces, the tedges, the edges, the
+*		vertex lists and the boundary flags stay consistent. A new tet gets the props of the old tet it comes
+*		from, the other new elements are initialized, except where an element is cut in two and both halves get
+*		its props.
+*
+*		The tets are expected to be positively oriented, TetOrientedVolume > 0, as _load_t with checkOrientation
+*		and _load_vtBuffer of oriented input give them, and the operators keep them so. An operator given a
+*		quality measure only goes ahead if the least quality of the new tets is above that of the old ones,
+*		without one if all the new tets are positively oriented; otherwise it leaves the mesh as it is.
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <functional>
+#include <float.h>
+
+#include "basetmesh.h"
+
+namespace MeshLib
+{
+	namespace TMeshLib
+	{
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		class CDynamicTMesh : public CTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>
+		{
+		public:
+			typedef CTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType> Base;
+			/*! quality of the tet (a, b, c, d), higher is better, not positive for the tets turned inside out */
+			typedef std::function<double(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d)> TetQuality;
+			typedef std::array<VertexType*, 4> TetVertices;
+
+			/*! the largest ring of tets around an edge that removeEdge triangulates */
+			static const int MAX_RING = 16;
+
+			/*!
+			2-3 flip: replace the two tets of the interior face pF by three tets around the edge joining their
+			opposite vertices, which must not be an edge yet.
+			\param pCreated if not NULL, receives the new tets
+			*/
+			bool flip23(FaceType* pF, const TetQuality & quality = TetQuality(), std::vector<TetType*>* pCreated = NULL);
+			/*! 3-2 flip: replace the three tets of the interior edge pE by two tets sharing the face across it */
+			bool flip32(EdgeType* pE, const TetQuality & quality = TetQuality(), std::vector<TetType*>* pCreated = NULL);
+			/*!
+			Edge removal: replace the n tets of the interior edge pE, n up to MAX_RING, by the 2 (n - 2) tets joining
+			the ends of the edge to a triangulation of the ring of vertices around it. The triangulation is the one
+			maximizing the least quality of the new tets, by dynamic programming over the ring.
+			*/
+			bool removeEdge(EdgeType* pE, const TetQuality & quality = TetQuality(), std::vector<TetType*>* pCreated = NULL);
+			/*!
+			Multi-face removal, the inverse of edge removal: the faces between pA and pB, that is the faces whose two
+			tets have pA and pB as their opposite vertices, must form a disc whose vertices are all on its boundary.
+			Its 2 m tets are replaced by the m + 2 tets around the new edge pA pB.
+			*/
+			bool removeMultiFace(VertexType* pA, VertexType* pB, const TetQuality & quality = TetQuality(), std::vector<TetType*>* pCreated = NULL);
+			/*!
+			Split the edge at p, every tet around it being cut in two.
+			\return the new vertex, NULL if a new tet would not be positively oriented
+			*/
+			VertexType* splitEdge(EdgeType* pE, const CPoint & p, std::vector<TetType*>* pCreated = NULL);
+			/*! whether collapsing pE by merging pRemoved into the other end keeps the mesh a manifold with the same boundary */
+			bool isCollapseOk(EdgeType* pE, VertexType* pRemoved);
+			/*!
+			Collapse pE: the tets around it go and pRemoved is merged into the other end of pE, moved to p.
+			\return the vertex kept, NULL if the collapse is not allowed or is rejected
+			*/
+			VertexType* collapseEdge(EdgeType* pE, VertexType* pRemoved, const CPoint & p, const TetQuality & quality = TetQuality(),
+				std::vector<TetType*>* pCreated = NULL);
+
+			/*!
+			The tets around pE and the vertices around it, tet i lying between ring[i] and ring[i + 1] so that
+			(vertex1, vertex2, ring[i], ring[i + 1]) is ordered like the tet.
+			\return false if the tets do not form a single fan; the ring is closed if it has as many vertices as tets
+			*/
+			bool edgeRing(EdgeType* pE, std::vector<TetType*> & tets, std::vector<VertexType*> & ring);
+			/*! the face with these vertices, NULL if there is none */
+			FaceType* findFace(VertexType* pV0, VertexType* pV1, VertexType* pV2);
+
+		protected:
+			/*! replace the tets removed by tets with the vertices added, new tet i getting the props of parents[i] */
+			void _replace(const std::vector<TetType*> & removed, const std::vector<TetVertices> & added, const std::vector<TetType*> & parents,
+				std::vector<TetType*>* pCreated);
+			TetType* _addTet(const TetVertices & vertices);
+			void _removeTet(TetType* pT);
+			VertexType* _addVertex(const CPoint & p);
+			/*! delete a vertex without tets */
+			void _removeVertex(VertexType* pV);
+			/*! the half face of another tet with the same vertices as pHF, NULL if there is none */
+			HalfFaceType* _matchHalfFace(HalfFaceType* pHF);
+			/*! recompute the boundary flags of the vertices and of their edges from the faces */
+			void _updateBoundary(std::vector<VertexType*> & vertices);
+			/*! remove the tets on both sides of the half faces, which have pA as their opposite vertex, see removeMultiFace */
+			bool _removeFaces(VertexType* pA, VertexType* pB, const std::vector<HalfFaceType*> & halfFaces, const TetQuality & quality,
+				std::vector<TetType*>* pCreated);
+
+			/*! a new member with its props initialized, whichever slot it takes */
+			template<typename T>
+			T* _newMember(MemoryPool<T> & pool, Props & props);
+			template<typename T>
+			T* _newMember(MemoryPool<T> & pool);
+			/*! the pools do not reuse the deleted members during an operator, so that the props of the old elements can be copied */
+			void _reuseDeleted(bool reuse);
+			static void _copyProps(Props & props, size_t from, size_t to)
+			{
+				for (BasicPropHandle * pProp : props) pProp->movePropMember(from, to);
+			};
+
+			/*! the other two vertices of pT, ordered so that (pA, pB, pX, pY) is ordered like the tet */
+			static void _others(TetType* pT, VertexType* pA, VertexType* pB, VertexType*& pX, VertexType*& pY);
+			/*! the vertex index of pV in pT, -1 if it is not one of its vertices */
+			static int _vertexIndex(TetType* pT, VertexType* pV)
+			{
+				for (int k = 0; k < 4; ++k) if (Base::TetVertex(pT, k) == pV) return k;
+				return -1;
+			};
+			static double _quality(const TetQuality & quality, const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d)
+			{
+				return quality ? quality(a, b, c, d) : (b - a) * ((c - a) ^ (d - a));
+			};
+			static double _quality(const TetQuality & quality, const TetVertices & v)
+			{
+				return _quality(quality, v[0]->position(), v[1]->position(), v[2]->position(), v[3]->position());
+			};
+			static TetVertices _vertices(TetType* pT)
+			{
+				return TetVertices{ Base::TetVertex(pT, 0), Base::TetVertex(pT, 1), Base::TetVertex(pT, 2), Base::TetVertex(pT, 3) };
+			};
+		};
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline bool CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::flip23(FaceType* pF,
+			const TetQuality & quality, std::vector<TetType*>* pCreated)
+		{
+			HalfFaceType* pHF = Base::FaceLeftHalfFace(pF);
+			HalfFaceType* pDual = Base::FaceRightHalfFace(pF);
+			if (pDual == NULL) return false;
+			VertexType* pA = Base::TVertexVertex(Base::HalfFaceOppositeTVertex(pHF));
+			VertexType* pB = Base::TVertexVertex(Base::HalfFaceOppositeTVertex(pDual));
+			if (findEdge(pA, pB) != NULL) return false;
+			return _removeFaces(pA, pB, std::vector<HalfFaceType*>{ pHF }, quality, pCreated);
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline bool CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::flip32(EdgeType* pE,
+			const TetQuality & quality, std::vector<TetType*>* pCreated)
+		{
+			if (Base::EdgeTEdgeList(pE)->size() != 3) return false;
+			return removeEdge(pE, quality, pCreated);
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline bool CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::removeEdge(EdgeType* pE,
+			const TetQuality & quality, std::vector<TetType*>* pCreated)
+		{
+			if (pE->boundary()) return false;
+			std::vector<TetType*> tets;
+			std::vector<VertexType*> ring;
+			if (!edgeRing(pE, tets, ring) || ring.size() != tets.size()) return false;
+			const int n = (int)ring.size();
+			if (n < 3 || n > MAX_RING) return false;
+			/* the face of a 3-2 flip may be there already, on the other side of the ring */
+			if (n == 3 && findFace(ring[0], ring[1], ring[2]) != NULL) return false;
+
+			VertexType* pA = Base::EdgeVertex1(pE);
+			VertexType* pB = Base::EdgeVertex2(pE);
+			double oldQuality = DBL_MAX;
+			for (TetType* pT : tets) oldQuality = std::min(oldQuality, _quality(quality, _vertices(pT)));
+			const double threshold = quality ? oldQuality : 0;
+
+			/* best[i][j]: the best least quality of the tets over a triangulation of the ring from i to j, split[i][j]
+			its apex; the diagonals that are edges already cannot be used */
+			double best[MAX_RING][MAX_RING];
+			int split[MAX_RING][MAX_RING];
+			for (int i = 0; i + 1 < n; ++i) best[i][i + 1] = DBL_MAX;
+			for (int length = 2; length < n; ++length)
+			{
+				for (int i = 0; i + length < n; ++i)
+				{
+					const int j = i + length;
+					best[i][j] = -DBL_MAX;
+					split[i][j] = -1;
+					if (!(i == 0 && j == n - 1) && findEdge(ring[i], ring[j]) != NULL) continue;
+					for (int k = i + 1; k < j; ++k)
+					{
+						const CPoint & pi = ring[i]->position();
+						const CPoint & pk = ring[k]->position();
+						const CPoint & pj = ring[j]->position();
+						double q = std::min(best[i][k], best[k][j]);
+						if (q <= best[i][j]) continue;
+						q = std::min(q, _quality(quality, pA->position(), pi, pk, pj));
+						q = std::min(q, _quality(quality, pB->position(), pi, pj, pk));
+						if (q > best[i][j])
+						{
+							best[i][j] = q;
+							split[i][j] = k;
+						}
+					}
+				}
+			}
+			if (best[0][n - 1] <= threshold) return false;
+
+			std::vector<TetVertices> added;
+			std::vector<TetType*> parents;
+			std::vector<std::pair<int, int>> stack{ { 0, n - 1 } };
+			while (!stack.empty())
+			{
+				const int i = stack.back().first, j = stack.back().second;
+				stack.pop_back();
+				if (j - i < 2) continue;
+				const int k = split[i][j];
+				added.push_back(TetVertices{ pA, ring[i], ring[k], ring[j] });
+				added.push_back(TetVertices{ pB, ring[i], ring[j], ring[k] });
+				parents.push_back(tets[i]);
+				parents.push_back(tets[i]);
+				stack.push_back({ i, k });
+				stack.push_back({ k, j });
+			}
+			_replace(tets, added, parents, pCreated);
+			return true;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline bool CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::removeMultiFace(VertexType* pA,
+			VertexType* pB, const TetQuality & quality, std::vector<TetType*>* pCreated)
+		{
+			if (pA == pB || findEdge(pA, pB) != NULL) return false;
+			std::vector<HalfFaceType*> halfFaces;
+			for (TVertexType* pTV : *Base::VertexTVertexList(pA))
+			{
+				TetType* pT = Base::TVertexTet(pTV);
+				HalfFaceType* pHF = Base::TetHalfFace(pT, _vertexIndex(pT, pA));
+				HalfFaceType* pDual = Base::HalfFaceDual(pHF);
+				if (pDual != NULL && Base::TVertexVertex(Base::HalfFaceOppositeTVertex(pDual)) == pB) halfFaces.push_back(pHF);
+			}
+			if (halfFaces.empty()) return false;
+			return _removeFaces(pA, pB, halfFaces, quality, pCreated);
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline bool CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_removeFaces(VertexType* pA,
+			VertexType* pB, const std::vector<HalfFaceType*> & halfFaces, const TetQuality & quality, std::vector<TetType*>* pCreated)
+		{
+			/* the edges of the faces oriented as seen from pA, the boundary of the disc being those without their reverse */
+			struct Side
+			{
+				VertexType* pFrom;
+				VertexType* pTo;
+				TetType* pT;
+			};
+			std::vector<Side> sides;
+			std::vector<VertexType*> vertices;
+			std::vector<TetType*> removed;
+			for (HalfFaceType* pHF : halfFaces)
+			{
+				TetType* pT = Base::HalfFaceTet(pHF);
+				removed.push_back(pT);
+				removed.push_back(Base::HalfFaceTet(Base::HalfFaceDual(pHF)));
+				const int a = _vertexIndex(pT, pA);
+				VertexType* pVs[3];
+				_others(pT, pA, Base::TetVertex(pT, (a + 1) % 4), pVs[1], pVs[2]);
+				pVs[0] = Base::TetVertex(pT, (a + 1) % 4);
+				for (int k = 0; k < 3; ++k)
+				{
+					sides.push_back(Side{ pVs[k], pVs[(k + 1) % 3], pT });
+					vertices.push_back(pVs[k]);
+				}
+			}
+			std::sort(vertices.begin(), vertices.end());
+			vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+
+			std::vector<Side> boundary;
+			for (const Side & side : sides)
+			{
+				bool inner = false;
+				for (const Side & other : sides) inner = inner || (other.pFrom == side.pTo && other.pTo == side.pFrom);
+				if (!inner) boundary.push_back(side);
+			}
+			/* a disc without inner vertices: its boundary is one loop through all its vertices, and it has n - 2 faces */
+			const int n = (int)boundary.size();
+			if (n != (int)vertices.size() || (int)halfFaces.size() != n - 2) return false;
+			std::vector<Side> loop{ boundary[0] };
+			while ((int)loop.size() < n)
+			{
+				const Side * pNext = NULL;
+				for (const Side & side : boundary) if (side.pFrom == loop.back().pTo) pNext = &side;
+				if (pNext == NULL || pNext->pFrom == loop[0].pFrom) return false;
+				loop.push_back(*pNext);
+			}
+			if (loop.back().pTo != loop[0].pFrom) return false;
+
+			double oldQuality = DBL_MAX;
+			for (TetType* pT : removed) oldQuality = std::min(oldQuality, _quality(quality, _vertices(pT)));
+			const double threshold = quality ? oldQuality : 0;
+			std::vector<TetVertices> added;
+			std::vector<TetType*> parents;
+			for (const Side & side : loop)
+			{
+				added.push_back(TetVertices{ pA, pB, side.pFrom, side.pTo });
+				parents.push_back(side.pT);
+				if (_quality(quality, added.back()) <= threshold) return false;
+			}
+			_replace(removed, added, parents, pCreated);
+			return true;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline VertexType* CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::splitEdge(EdgeType* pE,
+			const CPoint & p, std::vector<TetType*>* pCreated)
+		{
+			VertexType* pA = Base::EdgeVertex1(pE);
+			VertexType* pB = Base::EdgeVertex2(pE);
+			std::vector<TetType*> removed;
+			for (TEdgeType* pTE : *Base::EdgeTEdgeList(pE)) removed.push_back(Base::TEdgeTet(pTE));
+			for (TetType* pT : removed)
+			{
+				for (VertexType* pV : { pA, pB })
+				{
+					CPoint points[4];
+					for (int k = 0; k < 4; ++k) points[k] = Base::TetVertex(pT, k) == pV ? p : Base::TetVertex(pT, k)->position();
+					if (_quality(TetQuality(), points[0], points[1], points[2], points[3]) <= 0) return NULL;
+				}
+			}
+			/* the faces around the edge, cut in two */
+			std::vector<std::pair<VertexType*, FaceType*>> faces;
+			for (TetType* pT : removed)
+			{
+				VertexType* pX;
+				VertexType* pY;
+				_others(pT, pA, pB, pX, pY);
+				faces.push_back({ pX, findFace(pA, pB, pX) });
+			}
+			std::sort(faces.begin(), faces.end());
+			faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+
+			VertexType* pM = _addVertex(p);
+			_copyProps(mVProps, ((pA->position() - p).norm() <= (pB->position() - p).norm() ? pA : pB)->index(), pM->index());
+			std::vector<TetVertices> added;
+			std::vector<TetType*> parents;
+			for (TetType* pT : removed)
+			{
+				for (VertexType* pV : { pA, pB })
+				{
+					TetVertices vertices = _vertices(pT);
+					vertices[_vertexIndex(pT, pV)] = pM;
+					added.push_back(vertices);
+					parents.push_back(pT);
+				}
+			}
+			_replace(removed, added, parents, pCreated);
+			/* the old edge and faces are deleted but their slots are not reused yet */
+			for (VertexType* pV : { pA, pB })
+			{
+				_copyProps(mEProps, pE->index(), findEdge(pV, pM)->index());
+				for (auto & face : faces) _copyProps(mFProps, face.second->index(), findFace(pV, pM, face.first)->index());
+			}
+			return pM;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline bool CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::isCollapseOk(EdgeType* pE,
+			VertexType* pRemoved)
+		{
+			VertexType* pKept = Base::EdgeVertex1(pE) == pRemoved ? Base::EdgeVertex2(pE) : Base::EdgeVertex1(pE);
+			/* a boundary vertex only slides along the boundary */
+			if (pRemoved->boundary() && !pE->boundary()) return false;
+
+			std::vector<TetType*> tets;
+			std::vector<VertexType*> ring;
+			if (!edgeRing(pE, tets, ring)) return false;
+			auto inRing = [&](VertexType* pV) { return std::find(ring.begin(), ring.end(), pV) != ring.end(); };
+			auto neighbors = [](VertexType* pV, std::vector<VertexType*> & out) {
+				for (EdgeType* pEdge : *Base::VertexEdgeList(pV)) out.push_back(Base::EdgeVertex1(pEdge) == pV ? Base::EdgeVertex2(pEdge) : Base::EdgeVertex1(pEdge));
+				std::sort(out.begin(), out.end());
+			};
+			/* the links of the two ends meet in the link of the edge only: first the vertices */
+			std::vector<VertexType*> removedNeighbors, keptNeighbors, common;
+			neighbors(pRemoved, removedNeighbors);
+			neighbors(pKept, keptNeighbors);
+			std::set_intersection(removedNeighbors.begin(), removedNeighbors.end(), keptNeighbors.begin(), keptNeighbors.end(), std::back_inserter(common));
+			for (VertexType* pV : common) if (!inRing(pV)) return false;
+
+			/* then the edges: an edge x y forming faces with both ends is opposite the edge in one of its tets */
+			auto linkEdges = [](VertexType* pV, std::vector<std::pair<VertexType*, VertexType*>> & out) {
+				for (TVertexType* pTV : *Base::VertexTVertexList(pV))
+				{
+					TetType* pT = Base::TVertexTet(pTV);
+					VertexType* pOthers[3];
+					int n = 0;
+					for (int k = 0; k < 4; ++k) if (Base::TetVertex(pT, k) != pV) pOthers[n++] = Base::TetVertex(pT, k);
+					for (int i = 0; i < 3; ++i)
+					{
+						VertexType* pX = pOthers[i];
+						VertexType* pY = pOthers[(i + 1) % 3];
+						out.push_back(pX < pY ? std::make_pair(pX, pY) : std::make_pair(pY, pX));
+					}
+				}
+				std::sort(out.begin(), out.end());
+				out.erase(std::unique(out.begin(), out.end()), out.end());
+			};
+			std::vector<std::pair<VertexType*, VertexType*>> removedEdges, keptEdges, commonEdges;
+			linkEdges(pRemoved, removedEdges);
+			linkEdges(pKept, keptEdges);
+			std::set_intersection(removedEdges.begin(), removedEdges.end(), keptEdges.begin(), keptEdges.end(), std::back_inserter(commonEdges));
+			for (auto & edge : commonEdges)
+			{
+				bool inTet = false;
+				for (TetType* pT : tets) inTet = inTet || (_vertexIndex(pT, edge.first) >= 0 && _vertexIndex(pT, edge.second) >= 0);
+				if (!inTet) return false;
+			}
+
+			/* the boundary seen as coned to a vertex at infinity: two boundary edges x a and x b make a boundary face a b x */
+			if (pE->boundary())
+			{
+				for (VertexType* pV : common)
+				{
+					EdgeType* pE0 = findEdge(pRemoved, pV);
+					EdgeType* pE1 = findEdge(pKept, pV);
+					if (!pE0->boundary() || !pE1->boundary()) continue;
+					FaceType* pF = findFace(pRemoved, pKept, pV);
+					if (pF == NULL || !pF->boundary()) return false;
+				}
+			}
+			return true;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline VertexType* CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::collapseEdge(EdgeType* pE,
+			VertexType* pRemoved, const CPoint & p, const TetQuality & quality, std::vector<TetType*>* pCreated)
+		{
+			if (!isCollapseOk(pE, pRemoved)) return NULL;
+			VertexType* pKept = Base::EdgeVertex1(pE) == pRemoved ? Base::EdgeVertex2(pE) : Base::EdgeVertex1(pE);
+
+			/* the tets of the removed vertex move to the kept one, the others of the kept one only see it move */
+			std::vector<TetType*> removed;
+			std::vector<TetVertices> added;
+			std::vector<TetType*> parents;
+			double oldQuality = DBL_MAX, newQuality = DBL_MAX;
+			auto moved = [&](const TetVertices & v) {
+				CPoint points[4];
+				for (int k = 0; k < 4; ++k) points[k] = v[k] == pKept ? p : v[k]->position();
+				return _quality(quality, points[0], points[1], points[2], points[3]);
+			};
+			for (TVertexType* pTV : *Base::VertexTVertexList(pRemoved))
+			{
+				TetType* pT = Base::TVertexTet(pTV);
+				removed.push_back(pT);
+				oldQuality = std::min(oldQuality, _quality(quality, _vertices(pT)));
+				if (_vertexIndex(pT, pKept) >= 0) continue;
+				TetVertices vertices = _vertices(pT);
+				vertices[_vertexIndex(pT, pRemoved)] = pKept;
+				added.push_back(vertices);
+				parents.push_back(pT);
+				newQuality = std::min(newQuality, moved(vertices));
+			}
+			for (TVertexType* pTV : *Base::VertexTVertexList(pKept))
+			{
+				TetType* pT = Base::TVertexTet(pTV);
+				if (_vertexIndex(pT, pRemoved) >= 0) continue;
+				oldQuality = std::min(oldQuality, _quality(quality, _vertices(pT)));
+				newQuality = std::min(newQuality, moved(_vertices(pT)));
+			}
+			if (newQuality <= (quality ? oldQuality : 0)) return NULL;
+
+			pKept->position() = p;
+			_replace(removed, added, parents, pCreated);
+			_removeVertex(pRemoved);
+			return pKept;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline bool CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::edgeRing(EdgeType* pE,
+			std::vector<TetType*> & tets, std::vector<VertexType*> & ring)
+		{
+			VertexType* pA = Base::EdgeVertex1(pE);
+			VertexType* pB = Base::EdgeVertex2(pE);
+			struct Wedge
+			{
+				VertexType* pX;
+				VertexType* pY;
+				TetType* pT;
+			};
+			std::vector<Wedge> wedges;
+			for (TEdgeType* pTE : *Base::EdgeTEdgeList(pE))
+			{
+				Wedge wedge;
+				wedge.pT = Base::TEdgeTet(pTE);
+				_others(wedge.pT, pA, pB, wedge.pX, wedge.pY);
+				wedges.push_back(wedge);
+			}
+			const int n = (int)wedges.size();
+			tets.clear();
+			ring.clear();
+			if (n == 0) return false;
+
+			/* an open fan starts at the vertex that does not follow any other */
+			int first = 0;
+			for (int i = 0; i < n; ++i)
+			{
+				bool follows = false;
+				for (const Wedge & other : wedges) follows = follows || other.pY == wedges[i].pX;
+				if (!follows)
+				{
+					first = i;
+					break;
+				}
+			}
+			ring.push_back(wedges[first].pX);
+			for (int i = first; (int)tets.size() < n; )
+			{
+				tets.push_back(wedges[i].pT);
+				VertexType* pNext = wedges[i].pY;
+				if ((int)tets.size() == n)
+				{
+					if (pNext != ring[0]) ring.push_back(pNext);
+					break;
+				}
+				ring.push_back(pNext);
+				i = -1;
+				for (int j = 0; j < n; ++j) if (wedges[j].pX == pNext) i = j;
+				if (i < 0) return false;
+			}
+			/* every vertex once */
+			std::vector<VertexType*> sorted(ring);
+			std::sort(sorted.begin(), sorted.end());
+			return std::unique(sorted.begin(), sorted.end()) == sorted.end() && (ring.size() == tets.size() || ring.size() == tets.size() + 1);
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline FaceType* CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::findFace(VertexType* pV0,
+			VertexType* pV1, VertexType* pV2)
+		{
+			for (TVertexType* pTV : *Base::VertexTVertexList(pV0))
+			{
+				TetType* pT = Base::TVertexTet(pTV);
+				const int i1 = _vertexIndex(pT, pV1), i2 = _vertexIndex(pT, pV2);
+				if (i1 < 0 || i2 < 0) continue;
+				/* the face opposite the fourth vertex */
+				const int i3 = 6 - i1 - i2 - _vertexIndex(pT, pV0);
+				return Base::HalfFaceFace(Base::TetHalfFace(pT, i3));
+			}
+			return NULL;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline void CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_replace(const std::vector<TetType*> & removed,
+			const std::vector<TetVertices> & added, const std::vector<TetType*> & parents, std::vector<TetType*>* pCreated)
+		{
+			std::vector<VertexType*> vertices;
+			for (TetType* pT : removed)
+			{
+				for (int k = 0; k < 4; ++k) vertices.push_back(Base::TetVertex(pT, k));
+			}
+			_reuseDeleted(false);
+			for (TetType* pT : removed) _removeTet(pT);
+			for (size_t i = 0; i < added.size(); ++i)
+			{
+				TetType* pT = _addTet(added[i]);
+				_copyProps(mTProps, parents[i]->index(), pT->index());
+				if (pCreated) pCreated->push_back(pT);
+				for (int k = 0; k < 4; ++k) vertices.push_back(added[i][k]);
+			}
+			_reuseDeleted(true);
+			std::sort(vertices.begin(), vertices.end());
+			vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+			_updateBoundary(vertices);
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline TetType* CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_addTet(const TetVertices & vertices)
+		{
+			TetType* pT = _newMember(mTContainer, mTProps);
+			pT->id() = m_map_Tets.empty() ? 0 : m_map_Tets.rbegin()->first + 1;
+			m_map_Tets.insert(typename Base::TMapPair(pT->id(), pT));
+			++m_nTets;
+
+			VertexType* pVs[4] = { vertices[0], vertices[1], vertices[2], vertices[3] };
+			TVertexType* pTVs[4];
+			HalfFaceType* pHFs[4];
+			HalfEdgeType* pHEs[12];
+			TEdgeType* pTEs[6];
+			for (int k = 0; k < 4; ++k)
+			{
+				pTVs[k] = _newMember(mTVContainer);
+				pHFs[k] = _newMember(mHFContainer, mHFProps);
+			}
+			for (int k = 0; k < 12; ++k) pHEs[k] = _newMember(mHEContainer, mHEProps);
+			for (int j = 0; j < 6; ++j) pTEs[j] = _newMember(mTEContainer);
+			Base::_link_tet(pT, pVs, pTVs, pHFs, pHEs, pTEs);
+			for (int k = 0; k < 4; ++k) Base::VertexTVertexList(pVs[k])->push_back(pTVs[k]);
+
+			/* the faces shared with the tets there already */
+			for (int i = 0; i < 4; ++i)
+			{
+				HalfFaceType* pHF = pHFs[i];
+				HalfFaceType* pDual = _matchHalfFace(pHF);
+				if (pDual != NULL)
+				{
+					assert(Base::HalfFaceDual(pDual) == NULL);
+					FaceType* pF = Base::HalfFaceFace(pDual);
+					pF->SetRight(pHF);
+					pF->boundary() = false;
+					pHF->SetFace(pF);
+					pHF->SetDual(pDual);
+					pDual->SetDual(pHF);
+				}
+				else
+				{
+					FaceType* pF = _newMember(mFContainer, mFProps);
+					pF->SetLeft(pHF);
+					pF->boundary() = true;
+					pHF->SetFace(pF);
+				}
+			}
+
+			/* the edges, the first end having the smaller id as in the loaders */
+			for (int j = 0; j < 6; ++j)
+			{
+				TEdgeType* pTE = pTEs[j];
+				VertexType* pV1 = Base::HalfEdgeSource(Base::TEdgeLeftHalfEdge(pTE));
+				VertexType* pV2 = Base::HalfEdgeTarget(Base::TEdgeLeftHalfEdge(pTE));
+				EdgeType* pE = findEdge(pV1, pV2);
+				if (pE == NULL)
+				{
+					pE = _newMember(mEContainer, mEProps);
+					pE->SetVertex1(pV1);
+					pE->SetVertex2(pV2);
+					Base::VertexEdgeList(pV1)->push_back(pE);
+					Base::VertexEdgeList(pV2)->push_back(pE);
+					++m_nEdges;
+					if (mEIndexValid) mEIndex.insert(std::min(pV1->index(), pV2->index()), std::max(pV1->index(), pV2->index()), pE);
+				}
+				Base::EdgeTEdgeList(pE)->push_back(pTE);
+				pTE->SetEdge(pE);
+			}
+			return pT;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline void CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_removeTet(TetType* pT)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				HalfFaceType* pHF = Base::TetHalfFace(pT, i);
+				FaceType* pF = Base::HalfFaceFace(pHF);
+				HalfFaceType* pDual = Base::HalfFaceDual(pHF);
+				if (pDual != NULL)
+				{
+					pDual->SetDual(NULL);
+					pF->SetLeft(pDual);
+					pF->SetRight(NULL);
+					pF->boundary() = true;
+				}
+				else
+				{
+					mFContainer.deleteMember(pF->index());
+				}
+
+				HalfEdgeType* pH = Base::HalfFaceHalfEdge(pHF);
+				for (int k = 0; k < 3; ++k, pH = Base::HalfEdgeNext(pH))
+				{
+					TEdgeType* pTE = Base::HalfEdgeTEdge(pH);
+					mHEContainer.deleteMember(pH->index());
+					if (Base::TEdgeLeftHalfEdge(pTE) != pH) continue;
+					EdgeType* pE = Base::TEdgeEdge(pTE);
+					std::vector<TEdgeType*> & tedges = *Base::EdgeTEdgeList(pE);
+					tedges.erase(std::find(tedges.begin(), tedges.end(), pTE));
+					mTEContainer.deleteMember(pTE->index());
+					if (!tedges.empty()) continue;
+					for (VertexType* pV : { Base::EdgeVertex1(pE), Base::EdgeVertex2(pE) })
+					{
+						std::vector<EdgeType*> & edges = *Base::VertexEdgeList(pV);
+						edges.erase(std::find(edges.begin(), edges.end(), pE));
+					}
+					if (mEIndexValid) mEIndex.erase(std::min(Base::EdgeVertex1(pE)->index(), Base::EdgeVertex2(pE)->index()),
+						std::max(Base::EdgeVertex1(pE)->index(), Base::EdgeVertex2(pE)->index()), pE);
+					mEContainer.deleteMember(pE->index());
+					--m_nEdges;
+				}
+				mHFContainer.deleteMember(pHF->index());
+			}
+			for (int k = 0; k < 4; ++k)
+			{
+				TVertexType* pTV = Base::TetTVertex(pT, k);
+				std::vector<TVertexType*> & tvertices = *Base::VertexTVertexList(Base::TVertexVertex(pTV));
+				tvertices.erase(std::find(tvertices.begin(), tvertices.end(), pTV));
+				mTVContainer.deleteMember(pTV->index());
+			}
+			m_map_Tets.erase(pT->id());
+			mTContainer.deleteMember(pT->index());
+			--m_nTets;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline VertexType* CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_addVertex(const CPoint & p)
+		{
+			VertexType* pV = _newMember(mVContainer, mVProps);
+			pV->id() = m_map_Vertices.empty() ? 0 : m_map_Vertices.rbegin()->first + 1;
+			pV->position() = p;
+			m_map_Vertices.insert(typename Base::VMapPair(pV->id(), pV));
+			m_maxVertexId = std::max(m_maxVertexId, pV->id());
+			++m_nVertices;
+			return pV;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline void CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_removeVertex(VertexType* pV)
+		{
+			assert(Base::VertexTVertexList(pV)->empty() && Base::VertexEdgeList(pV)->empty());
+			m_map_Vertices.erase(pV->id());
+			mVContainer.deleteMember(pV->index());
+			--m_nVertices;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline HalfFaceType* CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_matchHalfFace(HalfFaceType* pHF)
+		{
+			TetType* pT = Base::HalfFaceTet(pHF);
+			VertexType* pV = Base::HalfEdgeSource(Base::HalfFaceHalfEdge(pHF));
+			for (TVertexType* pTV : *Base::VertexTVertexList(pV))
+			{
+				TetType* pOther = Base::TVertexTet(pTV);
+				if (pOther == pT) continue;
+				for (int i = 0; i < 4; ++i)
+				{
+					HalfFaceType* pCandidate = Base::TetHalfFace(pOther, i);
+					if (*pCandidate == *pHF) return pCandidate;
+				}
+			}
+			return NULL;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline void CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_updateBoundary(std::vector<VertexType*> & vertices)
+		{
+			for (VertexType* pV : vertices)
+			{
+				bool boundary = false;
+				for (EdgeType* pE : *Base::VertexEdgeList(pV))
+				{
+					bool edgeBoundary = false;
+					for (TEdgeType* pTE : *Base::EdgeTEdgeList(pE))
+					{
+						for (HalfEdgeType* pH : { Base::TEdgeLeftHalfEdge(pTE), Base::TEdgeRightHalfEdge(pTE) })
+						{
+							edgeBoundary = edgeBoundary || Base::HalfFaceFace(Base::HalfEdgeHalfFace(pH))->boundary();
+						}
+					}
+					pE->boundary() = edgeBoundary;
+					boundary = boundary || edgeBoundary;
+				}
+				pV->boundary() = boundary;
+			}
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		template<typename T>
+		inline T* CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_newMember(MemoryPool<T> & pool, Props & props)
+		{
+			T* pT = _newMember(pool);
+			for (BasicPropHandle * pProp : props) pProp->initializePropMember(pT->index());
+			return pT;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		template<typename T>
+		inline T* CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_newMember(MemoryPool<T> & pool)
+		{
+			size_t index;
+			T* pT = pool.newMember(index);
+			assert(pT != NULL);
+			/* a reused slot still holds the links and the lists of the member deleted there */
+			*pT = T();
+			pT->index() = index;
+			return pT;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline void CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_reuseDeleted(bool reuse)
+		{
+			mVContainer.setReuseDeleted(reuse);
+			mTVContainer.setReuseDeleted(reuse);
+			mHEContainer.setReuseDeleted(reuse);
+			mTEContainer.setReuseDeleted(reuse);
+			mEContainer.setReuseDeleted(reuse);
+			mHFContainer.setReuseDeleted(reuse);
+			mFContainer.setReuseDeleted(reuse);
+			mTContainer.setReuseDeleted(reuse);
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline void CDynamicTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_others(TetType* pT, VertexType* pA,
+			VertexType* pB, VertexType*& pX, VertexType*& pY)
+		{
+			int order[4];
+			order[0] = _vertexIndex(pT, pA);
+			order[1] = _vertexIndex(pT, pB);
+			int n = 2;
+			for (int k = 0; k < 4; ++k) if (k != order[0] && k != order[1]) order[n++] = k;
+			/* an odd permutation of the vertices of the tet turns it inside out */
+			int inversions = 0;
+			for (int i = 0; i < 4; ++i)
+			{
+				for (int j = i + 1; j < 4; ++j) inversions += order[i] > order[j];
+			}
+			if (inversions % 2) std::swap(order[2], order[3]);
+			pX = Base::TetVertex(pT, order[2]);
+			pY = Base::TetVertex(pT, order[3]);
+		}
+	}
+}
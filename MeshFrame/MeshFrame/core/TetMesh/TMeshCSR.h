@@ -0,0 +1,46 @@
+/*!
+*      \file TMeshCSR.h
+*      \brief Read only adjacency snapshot of a tet mesh in compressed sparse rows
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "../Memory/CSRArray.h"
+
+namespace MeshLib
+{
+	namespace TMeshLib
+	{
+		/*!
+		* \brief Vertex-vertex, vertex-tet and tet-tet adjacency of a CTMesh over dense 32 bits ids,
+		*  made by CTMesh::buildCSR.
+		*
+		*  The dense ids number the live elements in pool order. The snapshot is not updated by the mesh,
+		*  rebuild it after a topological change.
+		*/
+		template<typename VertexType, typename TetType>
+		struct CTMeshCSR
+		{
+			/*! dense id -> element */
+			std::vector<VertexType *> vertices;
+			std::vector<TetType *>    tets;
+			/*! pool index -> dense id, -1 for the deleted slots */
+			std::vector<int>          vertexIds;
+			std::vector<int>          tetIds;
+
+			/*! the vertices sharing an edge with a vertex, sorted */
+			CCSRArray vv;
+			/*! the tets around a vertex, sorted */
+			CCSRArray vt;
+			/*! the tets sharing a face with a tet, in the order of the half faces, the boundary faces are skipped */
+			CCSRArray tt;
+
+			int numVertices() const { return (int)vertices.size(); };
+			int numTets() const { return (int)tets.size(); };
+			int vertexId(VertexType * pV) const { return vertexIds[pV->index()]; };
+			int tetId(TetType * pT) const { return tetIds[pT->index()]; };
+		};
+	}
+}
@@ -0,0 +1,154 @@
+/*!
+*      \file TMeshComponents.h
+*      \brief Connected components of a tet mesh and splitting into one mesh per component
+*
+*		Same as MeshComponents.h for surfaces: a parallel union-find over the tet-tet adjacency of the
+*		CSR snapshot, two tets being connected through a face.
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Parallel/UnionFind.h"
+#include "TProps.h"
+#include "TMeshCSR.h"
+
+namespace MeshLib
+{
+	namespace TMeshLib
+	{
+		template<typename TMeshType>
+		class CTMeshComponents
+		{
+		public:
+			typedef typename TMeshType::TPtr TPtr;
+			typedef typename TMeshType::VPtr VPtr;
+
+			/*!
+			Label the tets, two tets being connected if they share a face.
+			\param label receives the component of each tet, from 0 to numComponents() - 1 by smallest tet index;
+			added to the mesh if it was not yet
+			\return the number of components
+			*/
+			int labelTets(TMeshType * pMesh, TPropHandle<int> & label);
+
+			int numComponents() const { return (int)mBoxMin.size(); };
+			/*! number of tets in each component */
+			int size(int c) const { return mMembers.degree(c); };
+			const CPoint & boxMin(int c) const { return mBoxMin[c]; };
+			const CPoint & boxMax(int c) const { return mBoxMax[c]; };
+
+			/*!
+			Copy each component with at least minTets tets to a new mesh, in parallel, keeping the vertex order
+			of the tets. Only the positions are copied. The caller deletes the parts.
+			*/
+			void extractComponents(std::vector<TMeshType *> & parts, int minTets = 0) const;
+
+		private:
+			TMeshType *          mpMesh = NULL;
+			CTMeshCSR<typename TMeshType::VType, typename TMeshType::TType> mCSR;
+			/*! dense tet id -> component */
+			std::vector<int>     mLabels;
+			/*! component -> dense tet ids */
+			CCSRArray            mMembers;
+			std::vector<CPoint>  mBoxMin;
+			std::vector<CPoint>  mBoxMax;
+		};
+
+		template<typename TMeshType>
+		inline int CTMeshComponents<TMeshType>::labelTets(TMeshType * pMesh, TPropHandle<int> & label)
+		{
+			mpMesh = pMesh;
+			pMesh->buildCSR(mCSR);
+			const int numTets = mCSR.numTets();
+
+			CUnionFind sets(numTets);
+#pragma omp parallel for schedule(dynamic, 1024)
+			for (int i = 0; i < numTets; ++i) {
+				for (const int * j = mCSR.tt.begin(i); j != mCSR.tt.end(i); ++j) {
+					if (*j > i) sets.unite(i, *j);
+				}
+			}
+			const int numComponents = sets.labels(mLabels);
+
+			/* counting sort, stable so the members stay in dense id order */
+			mMembers.offsets.assign(numComponents + 1, 0);
+			for (int i = 0; i < numTets; ++i) ++mMembers.offsets[mLabels[i]];
+			mMembers.indices.resize(Parallel::exclusiveScan(mMembers.offsets));
+			std::vector<int> fill(mMembers.offsets.begin(), mMembers.offsets.end() - 1);
+			for (int i = 0; i < numTets; ++i) mMembers.indices[fill[mLabels[i]]++] = i;
+
+			mBoxMin.resize(numComponents);
+			mBoxMax.resize(numComponents);
+#pragma omp parallel for schedule(dynamic, 64)
+			for (int c = 0; c < numComponents; ++c) {
+				CPoint lo(1e300, 1e300, 1e300), hi(-1e300, -1e300, -1e300);
+				for (const int * i = mMembers.begin(c); i != mMembers.end(c); ++i) {
+					for (int j = 0; j < 4; ++j) {
+						const CPoint & p = TMeshType::TetVertex(mCSR.tets[*i], j)->position();
+						for (int k = 0; k < 3; ++k) {
+							lo[k] = std::min(lo[k], p[k]);
+							hi[k] = std::max(hi[k], p[k]);
+						}
+					}
+				}
+				mBoxMin[c] = lo;
+				mBoxMax[c] = hi;
+			}
+
+			if (label.pPropPool == NULL) pMesh->addTProp(label);
+#pragma omp parallel for
+			for (int i = 0; i < numTets; ++i) {
+				pMesh->gTP(label, mCSR.tets[i]) = mLabels[i];
+			}
+			return numComponents;
+		}
+
+		template<typename TMeshType>
+		inline void CTMeshComponents<TMeshType>::extractComponents(std::vector<TMeshType *> & parts, int minTets) const
+		{
+			std::vector<int> kept;
+			for (int c = 0; c < numComponents(); ++c) {
+				if (size(c) >= minTets) kept.push_back(c);
+			}
+			parts.assign(kept.size(), NULL);
+
+#pragma omp parallel for schedule(dynamic, 1)
+			for (int k = 0; k < (int)kept.size(); ++k) {
+				const int c = kept[k];
+				const int numTets = size(c);
+				std::vector<int> vIds;
+				vIds.reserve(4 * numTets);
+				for (const int * i = mMembers.begin(c); i != mMembers.end(c); ++i) {
+					for (int j = 0; j < 4; ++j) {
+						vIds.push_back(mCSR.vertexId(TMeshType::TetVertex(mCSR.tets[*i], j)));
+					}
+				}
+				std::vector<std::array<int, 4>> tets(numTets);
+				for (int t = 0; t < numTets; ++t) {
+					for (int j = 0; j < 4; ++j) tets[t][j] = vIds[4 * t + j];
+				}
+				std::sort(vIds.begin(), vIds.end());
+				vIds.erase(std::unique(vIds.begin(), vIds.end()), vIds.end());
+
+				std::vector<std::array<double, 3>> verts(vIds.size());
+				for (size_t v = 0; v < vIds.size(); ++v) {
+					const CPoint & p = mCSR.vertices[vIds[v]]->position();
+					verts[v] = { p[0], p[1], p[2] };
+				}
+				for (std::array<int, 4> & tet : tets) {
+					for (int j = 0; j < 4; ++j) {
+						tet[j] = (int)(std::lower_bound(vIds.begin(), vIds.end(), tet[j]) - vIds.begin());
+					}
+				}
+				parts[k] = new TMeshType;
+				parts[k]->_load_vtArray(verts, tets);
+			}
+		}
+	}
+}
@@ -0,0 +1,442 @@
+/*!
+*      \file TMeshImprover.h
+*      \brief Quality improvement of a CDynamicTMesh by topological operators and optimization-based smoothing
+*
+*		A pass first takes the tets below the target quality worst first from an indexed heap, and tries on each
+*		the removal of its edges, the removal of the faces between the vertices on both sides of its faces, then
+*		the collapse of its shortest edges; an operator is applied only if it raises the least quality around it,
+*		and the new tets below the target join the heap. Then the interior vertices of the tets still below the
+*		target are smoothed: each one is moved along the steepest ascent of the quality of its worst tets, with a
+*		line search, while the least quality around it increases. The vertices are smoothed by rounds of
+*		independent ones, no two of them sharing a tet, in parallel. The qualities are computed in parallel too;
+*		the topological operators edit the mesh one at a time.
+*
+*		Both measures are 1 for the regular tet and not positive for the tets turned inside out.
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <float.h>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Memory/IndexedHeap.h"
+#include "DynamicTMesh.h"
+
+namespace MeshLib
+{
+	namespace TMeshLib
+	{
+		template<typename TMeshType>
+		class CTMeshImprover
+		{
+		public:
+			typedef typename TMeshType::VPtr VPtr;
+			typedef typename TMeshType::EPtr EPtr;
+			typedef typename TMeshType::TPtr TPtr;
+			typedef typename TMeshType::HFPtr HFPtr;
+			typedef typename TMeshType::TetQuality TetQuality;
+
+			enum Measure
+			{
+				/*! the least sine of the dihedral angles, against both flat and sharp angles */
+				MinSine,
+				/*! 3 times the inradius over the circumradius */
+				RadiusRatio
+			};
+			Measure measure = MinSine;
+			/*! the tets below this quality are improved */
+			double targetQuality = 0.4;
+			int maxPasses = 4;
+			bool useTopological = true;
+			bool useCollapses = true;
+			bool useSmoothing = true;
+			/*! line searches per vertex and pass */
+			int smoothingSteps = 8;
+
+			/*!
+			Improve pMesh in place; the boundary vertices stay where they are.
+			\return the least quality at the end
+			*/
+			double improve(TMeshType * pMesh);
+
+			double quality(TPtr pT) const;
+			double quality(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d) const
+			{
+				return measure == MinSine ? minSine(a, b, c, d) : radiusRatio(a, b, c, d);
+			};
+			static double minSine(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d);
+			static double radiusRatio(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d);
+
+			int numTopological() const { return mNumTopological; };
+			int numSmoothed() const { return mNumSmoothed; };
+
+		private:
+			/*! \return the number of operators applied */
+			int _topologicalPass();
+			/*! \return the number of vertices moved */
+			int _smoothingPass();
+			bool _improveTet(TPtr pT, std::vector<TPtr> & created);
+			bool _smoothVertex(VPtr pV);
+			/*! the least quality of the tets of pV with pV at p, and the two worst of them */
+			double _vertexQuality(VPtr pV, const CPoint & p, TPtr * pWorst = NULL) const;
+			/*! the gradient in p of the quality of pT, pV being at p */
+			CPoint _gradient(TPtr pT, VPtr pV, const CPoint & p, double h) const;
+			/*! the qualities of the live tets by index, DBL_MAX for the deleted ones */
+			void _computeQualities(std::vector<double> & qualities) const;
+
+			static unsigned int _hash(unsigned int a, unsigned int b)
+			{
+				unsigned int h = a * 0x9E3779B1u ^ (b + 0x7F4A7C15u);
+				h ^= h >> 15;
+				h *= 0x2C1B3C6Du;
+				h ^= h >> 12;
+				return h;
+			};
+
+			TMeshType *      mpMesh = NULL;
+			TetQuality       mQuality;
+			CIndexedHeap<4>  mHeap;
+			int              mNumTopological = 0;
+			int              mNumSmoothed = 0;
+		};
+
+		template<typename TMeshType>
+		inline double CTMeshImprover<TMeshType>::improve(TMeshType * pMesh)
+		{
+			mpMesh = pMesh;
+			mQuality = [this](const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d) { return quality(a, b, c, d); };
+			mNumTopological = mNumSmoothed = 0;
+			for (int pass = 0; pass < maxPasses; ++pass)
+			{
+				const int numTopological = useTopological ? _topologicalPass() : 0;
+				const int numSmoothed = useSmoothing ? _smoothingPass() : 0;
+				mNumTopological += numTopological;
+				mNumSmoothed += numSmoothed;
+				if (numTopological == 0 && numSmoothed == 0) break;
+			}
+			std::vector<double> qualities;
+			_computeQualities(qualities);
+			return qualities.empty() ? DBL_MAX : *std::min_element(qualities.begin(), qualities.end());
+		}
+
+		template<typename TMeshType>
+		inline double CTMeshImprover<TMeshType>::quality(TPtr pT) const
+		{
+			return quality(TMeshType::TetVertex(pT, 0)->position(), TMeshType::TetVertex(pT, 1)->position(),
+				TMeshType::TetVertex(pT, 2)->position(), TMeshType::TetVertex(pT, 3)->position());
+		}
+
+		template<typename TMeshType>
+		inline double CTMeshImprover<TMeshType>::minSine(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d)
+		{
+			/* the dihedral angle at edge i j lies between the faces opposite the other two vertices k and l:
+			sin = 6 V l_ij / (4 A_k A_l), written with the cross products n = 2 A */
+			const CPoint p[4] = { a, b, c, d };
+			const double volume6 = (b - a) * ((c - a) ^ (d - a));
+			double n[4];
+			for (int k = 0; k < 4; ++k)
+			{
+				const CPoint & u = p[(k + 1) % 4];
+				n[k] = ((p[(k + 2) % 4] - u) ^ (p[(k + 3) % 4] - u)).norm();
+				if (n[k] == 0) return 0;
+			}
+			static const int ends[6][2] = { { 0, 1 }, { 0, 2 }, { 0, 3 }, { 1, 2 }, { 1, 3 }, { 2, 3 } };
+			double least = DBL_MAX;
+			for (int j = 0; j < 6; ++j)
+			{
+				const int i0 = ends[j][0], i1 = ends[j][1];
+				const int k = ends[5 - j][0], l = ends[5 - j][1];
+				least = std::min(least, volume6 * (p[i1] - p[i0]).norm() / (n[k] * n[l]));
+			}
+			/* the regular tet has sin = 2 sqrt(2) / 3 */
+			return least * 3.0 / (2.0 * sqrt(2.0));
+		}
+
+		template<typename TMeshType>
+		inline double CTMeshImprover<TMeshType>::radiusRatio(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d)
+		{
+			const CPoint u = b - a, v = c - a, w = d - a;
+			const double volume6 = u * (v ^ w);
+			const double area2 = (v ^ w).norm() + (w ^ u).norm() + (u ^ v).norm() + ((c - b) ^ (d - b)).norm();
+			const double circumradius = ((v ^ w) * (u * u) + (w ^ u) * (v * v) + (u ^ v) * (w * w)).norm() / (2 * fabs(volume6));
+			if (area2 == 0 || !(circumradius < DBL_MAX)) return 0;
+			/* the inradius is 3 V / A = volume6 / area2 */
+			return 3 * volume6 / area2 / circumradius;
+		}
+
+		template<typename TMeshType>
+		inline void CTMeshImprover<TMeshType>::_computeQualities(std::vector<double> & qualities) const
+		{
+			auto & tets = mpMesh->tets();
+			const int numT = (int)tets.getCurrentIndex();
+			qualities.assign(numT, DBL_MAX);
+#pragma omp parallel for schedule(dynamic, 1024)
+			for (int i = 0; i < numT; ++i)
+			{
+				if (!tets.hasBeenDeleted(i)) qualities[i] = quality(tets.getPointer(i));
+			}
+		}
+
+		template<typename TMeshType>
+		inline int CTMeshImprover<TMeshType>::_topologicalPass()
+		{
+			auto & tets = mpMesh->tets();
+			std::vector<double> qualities;
+			_computeQualities(qualities);
+			std::vector<int> ids;
+			std::vector<double> keys;
+			for (int i = 0; i < (int)qualities.size(); ++i)
+			{
+				if (qualities[i] >= targetQuality) continue;
+				ids.push_back(i);
+				keys.push_back(qualities[i]);
+			}
+			mHeap.reset((int)qualities.size());
+			mHeap.build(ids, keys);
+
+			int numApplied = 0;
+			std::vector<TPtr> created;
+			while (!mHeap.empty())
+			{
+				const double key = mHeap.topKey();
+				const int id = mHeap.pop();
+				/* the slots of the tets removed are taken by new tets: their keys are checked when they come out */
+				if (tets.hasBeenDeleted(id)) continue;
+				TPtr pT = tets.getPointer(id);
+				const double q = quality(pT);
+				if (q >= targetQuality) continue;
+				if (q > key)
+				{
+					mHeap.push(id, q);
+					continue;
+				}
+				created.clear();
+				if (!_improveTet(pT, created)) continue;
+				++numApplied;
+				for (TPtr pNew : created)
+				{
+					if (tets.hasBeenDeleted(pNew->index())) continue;
+					const double qNew = quality(pNew);
+					if (qNew < targetQuality) mHeap.push((int)pNew->index(), qNew);
+				}
+			}
+			return numApplied;
+		}
+
+		template<typename TMeshType>
+		inline bool CTMeshImprover<TMeshType>::_improveTet(TPtr pT, std::vector<TPtr> & created)
+		{
+			VPtr pVs[4];
+			for (int k = 0; k < 4; ++k) pVs[k] = TMeshType::TetVertex(pT, k);
+			EPtr pEs[6];
+			for (int i = 0, j = 0; i < 4; ++i)
+			{
+				for (int k = i + 1; k < 4; ++k) pEs[j++] = mpMesh->findEdge(pVs[i], pVs[k]);
+			}
+
+			/* the edge removals, including the 3-2 flips */
+			for (EPtr pE : pEs)
+			{
+				if (mpMesh->removeEdge(pE, mQuality, &created)) return true;
+			}
+			/* the multi-face removals across the faces, including the 2-3 flips */
+			for (int k = 0; k < 4; ++k)
+			{
+				HFPtr pDual = TMeshType::HalfFaceDual(TMeshType::TetHalfFace(pT, k));
+				if (pDual == NULL) continue;
+				VPtr pB = TMeshType::TVertexVertex(TMeshType::HalfFaceOppositeTVertex(pDual));
+				if (mpMesh->removeMultiFace(pVs[k], pB, mQuality, &created)) return true;
+			}
+			if (!useCollapses) return false;
+			/* the collapses of the shortest edges, an interior end going into the other */
+			std::sort(pEs, pEs + 6, [](EPtr a, EPtr b) { return TMeshType::EdgeLengthSquare(a) < TMeshType::EdgeLengthSquare(b); });
+			for (EPtr pE : pEs)
+			{
+				for (VPtr pRemoved : { TMeshType::EdgeVertex1(pE), TMeshType::EdgeVertex2(pE) })
+				{
+					if (pRemoved->boundary()) continue;
+					VPtr pKept = TMeshType::EdgeVertex1(pE) == pRemoved ? TMeshType::EdgeVertex2(pE) : TMeshType::EdgeVertex1(pE);
+					if (mpMesh->collapseEdge(pE, pRemoved, pKept->position(), mQuality, &created) != NULL) return true;
+				}
+			}
+			return false;
+		}
+
+		template<typename TMeshType>
+		inline int CTMeshImprover<TMeshType>::_smoothingPass()
+		{
+			auto & vertices = mpMesh->vertices();
+			auto & tets = mpMesh->tets();
+			std::vector<double> qualities;
+			_computeQualities(qualities);
+			const int numV = (int)vertices.getCurrentIndex();
+			std::vector<char> pending(numV, 0);
+			for (int i = 0; i < (int)qualities.size(); ++i)
+			{
+				if (qualities[i] >= targetQuality) continue;
+				TPtr pT = tets.getPointer(i);
+				for (int k = 0; k < 4; ++k)
+				{
+					VPtr pV = TMeshType::TetVertex(pT, k);
+					if (!pV->boundary()) pending[pV->index()] = 1;
+				}
+			}
+			std::vector<int> candidates;
+			for (int i = 0; i < numV; ++i) if (pending[i]) candidates.push_back(i);
+
+			/* rounds of the pending vertices whose hash is the largest among their pending neighbours */
+			int numMoved = 0;
+			std::vector<char> selected(numV, 0);
+			for (unsigned int round = 0; !candidates.empty(); ++round)
+			{
+				const int numCandidates = (int)candidates.size();
+#pragma omp parallel for schedule(dynamic, 256)
+				for (int j = 0; j < numCandidates; ++j)
+				{
+					VPtr pV = vertices.getPointer(candidates[j]);
+					const unsigned int h = _hash((unsigned int)pV->index(), round);
+					bool best = true;
+					for (EPtr pE : *TMeshType::VertexEdgeList(pV))
+					{
+						VPtr pW = TMeshType::EdgeVertex1(pE) == pV ? TMeshType::EdgeVertex2(pE) : TMeshType::EdgeVertex1(pE);
+						if (!pending[pW->index()]) continue;
+						const unsigned int hW = _hash((unsigned int)pW->index(), round);
+						if (hW > h || (hW == h && pW->index() > pV->index())) best = false;
+					}
+					selected[candidates[j]] = best;
+				}
+				int numRoundMoved = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:numRoundMoved)
+				for (int j = 0; j < numCandidates; ++j)
+				{
+					if (selected[candidates[j]] && _smoothVertex(vertices.getPointer(candidates[j]))) ++numRoundMoved;
+				}
+				numMoved += numRoundMoved;
+				int numLeft = 0;
+				for (int j = 0; j < numCandidates; ++j)
+				{
+					if (selected[candidates[j]])
+					{
+						pending[candidates[j]] = 0;
+						selected[candidates[j]] = 0;
+					}
+					else
+					{
+						candidates[numLeft++] = candidates[j];
+					}
+				}
+				candidates.resize(numLeft);
+			}
+			return numMoved;
+		}
+
+		template<typename TMeshType>
+		inline double CTMeshImprover<TMeshType>::_vertexQuality(VPtr pV, const CPoint & p, TPtr * pWorst) const
+		{
+			double least = DBL_MAX, second = DBL_MAX;
+			if (pWorst) pWorst[0] = pWorst[1] = NULL;
+			for (typename TMeshType::TVPtr pTV : *TMeshType::VertexTVertexList(pV))
+			{
+				TPtr pT = TMeshType::TVertexTet(pTV);
+				CPoint points[4];
+				for (int k = 0; k < 4; ++k) points[k] = TMeshType::TetVertex(pT, k) == pV ? p : TMeshType::TetVertex(pT, k)->position();
+				const double q = quality(points[0], points[1], points[2], points[3]);
+				if (q < least)
+				{
+					second = least;
+					least = q;
+					if (pWorst)
+					{
+						pWorst[1] = pWorst[0];
+						pWorst[0] = pT;
+					}
+				}
+				else if (q < second)
+				{
+					second = q;
+					if (pWorst) pWorst[1] = pT;
+				}
+			}
+			return least;
+		}
+
+		template<typename TMeshType>
+		inline CPoint CTMeshImprover<TMeshType>::_gradient(TPtr pT, VPtr pV, const CPoint & p, double h) const
+		{
+			CPoint points[4];
+			int i = 0;
+			for (int k = 0; k < 4; ++k)
+			{
+				points[k] = TMeshType::TetVertex(pT, k)->position();
+				if (TMeshType::TetVertex(pT, k) == pV) i = k;
+			}
+			CPoint g;
+			for (int c = 0; c < 3; ++c)
+			{
+				points[i] = p;
+				points[i][c] += h;
+				const double qPlus = quality(points[0], points[1], points[2], points[3]);
+				points[i][c] -= 2 * h;
+				const double qMinus = quality(points[0], points[1], points[2], points[3]);
+				g[c] = (qPlus - qMinus) / (2 * h);
+			}
+			return g;
+		}
+
+		template<typename TMeshType>
+		inline bool CTMeshImprover<TMeshType>::_smoothVertex(VPtr pV)
+		{
+			double length = 0;
+			for (EPtr pE : *TMeshType::VertexEdgeList(pV)) length += TMeshType::EdgeLength(pE);
+			if (TMeshType::VertexEdgeList(pV)->empty()) return false;
+			length /= TMeshType::VertexEdgeList(pV)->size();
+
+			CPoint p = pV->position();
+			TPtr pWorst[2];
+			double least = _vertexQuality(pV, p, pWorst);
+			bool moved = false;
+			for (int step = 0; step < smoothingSteps; ++step)
+			{
+				/* the ascent direction of the worst tet, or the point of least norm between the gradients of the two
+				worst when they are about as bad, so that raising one does not lower the other */
+				CPoint g = _gradient(pWorst[0], pV, p, 1e-6 * length);
+				if (pWorst[1] != NULL && quality(pWorst[1]) - least < 1e-3)
+				{
+					const CPoint g1 = _gradient(pWorst[1], pV, p, 1e-6 * length);
+					const CPoint d = g1 - g;
+					const double dd = d * d;
+					if (dd > 0) g = g + d * std::min(1.0, std::max(0.0, -(g * d) / dd));
+				}
+				const double norm = g.norm();
+				if (norm == 0) break;
+				g /= norm;
+
+				bool improved = false;
+				for (double s = 0.1 * length; s > 1e-4 * length; s /= 2)
+				{
+					const CPoint candidate = p + g * s;
+					TPtr pCandidateWorst[2];
+					const double q = _vertexQuality(pV, candidate, pCandidateWorst);
+					if (q > least)
+					{
+						p = candidate;
+						least = q;
+						pWorst[0] = pCandidateWorst[0];
+						pWorst[1] = pCandidateWorst[1];
+						improved = true;
+						break;
+					}
+				}
+				if (!improved) break;
+				/* no other vertex of the round shares a tet with pV, nothing read around pV moves meanwhile */
+				pV->position() = p;
+				moved = true;
+			}
+			return moved;
+		}
+	}
+}
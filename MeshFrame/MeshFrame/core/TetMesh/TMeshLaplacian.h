@@ -0,0 +1,215 @@
+/*!
+*      \file TMeshLaplacian.h
+*      \brief Assembly of the cotangent Laplacian and mass matrices of a tet mesh
+*
+*		Same scheme as MeshLaplacian.h for surfaces: the pattern and the positions of the entries of every
+*		tet corner are computed once, then a parallel pass over the tets computes their edge weights and a
+*		parallel pass over the rows gathers them.
+*/
+
+#pragma once
+
+#include <vector>
+#include <math.h>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Memory/CSRMatrix.h"
+#include "TMeshCSR.h"
+
+namespace MeshLib
+{
+	namespace TMeshLib
+	{
+		template<typename TMeshType>
+		class CTMeshLaplacian
+		{
+		public:
+			typedef typename TMeshType::TPtr TPtr;
+			typedef typename TMeshType::VPtr VPtr;
+
+			/*!
+			Build the sparsity pattern over the vertices and assemble the matrices.
+			\param consistentMass also assemble the consistent mass matrix, the lumped masses are always assembled
+			*/
+			void build(TMeshType * pMesh, bool consistentMass = false);
+			/*!
+			Assemble the values again after the vertices moved, the connectivity must not have changed.
+			*/
+			void update();
+
+			/*!
+			L_ij = -w_ij, L_ii = sum of the w_ij, with w_ij the sum over the tets around the edge ij of
+			|e_kl| cot(theta_kl) / 6, e_kl being the opposite edge in the tet and theta_kl its dihedral angle.
+			Positive semi-definite, the rows sum to 0. The rows and columns are the dense vertex ids.
+			*/
+			const CCSRMatrix & laplacian() const { return mL; };
+			/*! consistent mass matrix, M_ii = sum of V / 10 and M_ij = sum of V / 20 over the tets around; empty if not asked */
+			const CCSRMatrix & mass() const { return mM; };
+			/*! a quarter of the volume of the tets around each vertex */
+			const std::vector<double> & lumpedMass() const { return mLumpedMass; };
+
+			int numVertices() const { return mCSR.numVertices(); };
+			VPtr vertex(int i) const { return mCSR.vertices[i]; };
+			int vertexId(VPtr pV) const { return mCSR.vertexId(pV); };
+
+		private:
+			void _computeTets();
+			void _assembleRow(int i);
+
+			/*! local edge of the tet joining its vertices a and b */
+			static int _edge(int a, int b)
+			{
+				static const int edges[4][4] = { { -1, 0, 1, 2 }, { 0, -1, 3, 4 }, { 1, 3, -1, 5 }, { 2, 4, 5, -1 } };
+				return edges[a][b];
+			};
+
+			TMeshType *          mpMesh = NULL;
+			bool                 mConsistentMass = false;
+			CTMeshCSR<typename TMeshType::VType, typename TMeshType::TType> mCSR;
+
+			/*! dense vertex id of corner 4 * t + a */
+			std::vector<int>     mCornerVertices;
+			/*! vertex -> its corners */
+			CCSRArray            mVCorners;
+			/*! positions in the values of the entries (i, j) of corner c of vertex i, for the 3 other vertices
+			j of the tet in local order */
+			std::vector<int>     mCornerSlots;
+
+			/*! per tet: the weights of its 6 edges (0 1) (0 2) (0 3) (1 2) (1 3) (2 3) */
+			std::vector<double>  mEdgeWeights;
+			std::vector<double>  mVolumes;
+
+			CCSRMatrix           mL;
+			CCSRMatrix           mM;
+			std::vector<double>  mLumpedMass;
+		};
+
+		template<typename TMeshType>
+		inline void CTMeshLaplacian<TMeshType>::build(TMeshType * pMesh, bool consistentMass)
+		{
+			mpMesh = pMesh;
+			mConsistentMass = consistentMass;
+			pMesh->buildCSR(mCSR);
+			const int numV = mCSR.numVertices(), numT = mCSR.numTets();
+
+			mCornerVertices.resize(4 * numT);
+#pragma omp parallel for
+			for (int t = 0; t < numT; ++t) {
+				for (int a = 0; a < 4; ++a) {
+					mCornerVertices[4 * t + a] = mCSR.vertexId(TMeshType::TetVertex(mCSR.tets[t], a));
+				}
+			}
+			mVCorners.build(numV, [&](int i, std::vector<int> & row) {
+				for (const int * t = mCSR.vt.begin(i); t != mCSR.vt.end(i); ++t) {
+					for (int a = 0; a < 4; ++a) {
+						if (mCornerVertices[4 * *t + a] == i) row.push_back(4 * *t + a);
+					}
+				}
+			});
+
+			/* the pattern is the vertex-vertex adjacency plus the diagonal */
+			CCSRArray pattern;
+			pattern.build(numV, [&](int i, std::vector<int> & row) {
+				const int * j = mCSR.vv.begin(i);
+				for (; j != mCSR.vv.end(i) && *j < i; ++j) row.push_back(*j);
+				row.push_back(i);
+				for (; j != mCSR.vv.end(i); ++j) row.push_back(*j);
+			});
+			mL.setPattern(pattern);
+			if (consistentMass) {
+				mM.setPattern(pattern);
+			}
+			else {
+				mM.clear();
+			}
+
+			mCornerSlots.resize(12 * numT);
+#pragma omp parallel for
+			for (int t = 0; t < numT; ++t) {
+				for (int a = 0; a < 4; ++a) {
+					int * slots = &mCornerSlots[3 * (4 * t + a)];
+					for (int b = 0; b < 4; ++b) {
+						if (b == a) continue;
+						*slots++ = mL.find(mCornerVertices[4 * t + a], mCornerVertices[4 * t + b]);
+					}
+				}
+			}
+			mEdgeWeights.resize(6 * numT);
+			mVolumes.resize(numT);
+			mLumpedMass.resize(numV);
+			update();
+		}
+
+		template<typename TMeshType>
+		inline void CTMeshLaplacian<TMeshType>::update()
+		{
+			_computeTets();
+#pragma omp parallel for schedule(dynamic, 1024)
+			for (int i = 0; i < mCSR.numVertices(); ++i) {
+				_assembleRow(i);
+			}
+		}
+
+		template<typename TMeshType>
+		inline void CTMeshLaplacian<TMeshType>::_computeTets()
+		{
+			const int numT = mCSR.numTets();
+#pragma omp parallel for
+			for (int t = 0; t < numT; ++t) {
+				CPoint p[4];
+				for (int a = 0; a < 4; ++a) p[a] = mCSR.vertices[mCornerVertices[4 * t + a]]->position();
+				mVolumes[t] = fabs(((p[1] - p[0]) ^ (p[2] - p[0])) * (p[3] - p[0])) / 6.0;
+
+				/* normal of the face opposite to each vertex, pointing to it; their length does not matter */
+				CPoint n[4];
+				for (int a = 0; a < 4; ++a) {
+					const CPoint & q0 = p[(a + 1) % 4];
+					n[a] = (p[(a + 2) % 4] - q0) ^ (p[(a + 3) % 4] - q0);
+					if (n[a] * (p[a] - q0) < 0) n[a] = -n[a];
+				}
+				for (int a = 0; a < 4; ++a) {
+					for (int b = a + 1; b < 4; ++b) {
+						/* c and d are the two other vertices, the faces opposite to a and b meet at the edge cd */
+						int c = 0;
+						while (c == a || c == b) ++c;
+						int d = 6 - a - b - c;
+						const double sinTheta = (n[a] ^ n[b]).norm();
+						const double cosTheta = -(n[a] * n[b]);
+						mEdgeWeights[6 * t + _edge(a, b)] =
+							sinTheta > 0 ? (p[c] - p[d]).norm() * cosTheta / (6.0 * sinTheta) : 0.0;
+					}
+				}
+			}
+		}
+
+		template<typename TMeshType>
+		inline void CTMeshLaplacian<TMeshType>::_assembleRow(int i)
+		{
+			double * L = mL.values.data();
+			const int rowBegin = mL.pattern.offsets[i], rowEnd = mL.pattern.offsets[i + 1];
+			double mass = 0;
+			for (int k = rowBegin; k < rowEnd; ++k) L[k] = 0.0;
+			if (mConsistentMass) {
+				for (int k = rowBegin; k < rowEnd; ++k) mM.values[k] = 0.0;
+			}
+
+			for (const int * c = mVCorners.begin(i); c != mVCorners.end(i); ++c) {
+				const int t = *c / 4, a = *c % 4;
+				const int * slots = &mCornerSlots[3 * *c];
+				const double volume = mVolumes[t];
+				for (int b = 0; b < 4; ++b) {
+					if (b == a) continue;
+					const double w = mEdgeWeights[6 * t + _edge(a, b)];
+					L[*slots] -= w;
+					L[mL.diagonal[i]] += w;
+					if (mConsistentMass) mM.values[*slots] += volume / 20.0;
+					++slots;
+				}
+				mass += volume / 4.0;
+				if (mConsistentMass) mM.values[mM.diagonal[i]] += volume / 10.0;
+			}
+			mLumpedMass[i] = mass;
+		}
+	}
+}
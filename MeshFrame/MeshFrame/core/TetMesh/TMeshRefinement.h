@@ -0,0 +1,451 @@
+/*!
+*      \file TMeshRefinement.h
+*      \brief Refinement of tet meshes into a new mesh: centroid star, 1:8 red refinement and adaptive red-green
+*
+*		The refined vertices and tets are computed into arrays in parallel over the tets, each new vertex
+*		being a weighted sum of input vertices, then the output mesh is built at once by _load_vtBuffer.
+*		The input mesh is not changed. The props of the output are set through the interpolators, which get
+*		the parents of every output vertex and tet in the input mesh.
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <functional>
+#include "../Parallel/OpenMP.h"
+
+#include "../Geometry/Point.h"
+#include "../Parallel/ParallelAlgorithms.h"
+
+namespace MeshLib
+{
+	namespace TMeshLib
+	{
+		template<typename TMeshType>
+		class CTMeshRefinement
+		{
+		public:
+			typedef typename TMeshType::VPtr VPtr;
+			typedef typename TMeshType::EPtr EPtr;
+			typedef typename TMeshType::TPtr TPtr;
+			typedef typename TMeshType::HEPtr HEPtr;
+
+			/*! pV of the output is weights[0] pParents[0] + ... + weights[n - 1] pParents[n - 1], n = 1 for the copies of the input vertices */
+			typedef std::function<void(VPtr pV, VPtr const * pParents, const double * weights, int n)> VertexInterpolator;
+			/*! pT of the output lies in pParent of the input */
+			typedef std::function<void(TPtr pT, TPtr pParent)> TetInterpolator;
+
+			/*! called in parallel once the output is built, with the position already set; empty to skip */
+			VertexInterpolator vertexInterpolator;
+			TetInterpolator    tetInterpolator;
+
+			/*! split every tet into 4 around its centroid */
+			void centroidStar(TMeshType * pIn, TMeshType * pOut);
+			/*! split every tet into 8 at the midpoints of its edges, the inner octahedron along its shortest diagonal */
+			void red(TMeshType * pIn, TMeshType * pOut);
+			/*!
+			Red refinement of the marked tets, closed by green tets so that the output is conforming: a tet with
+			one split edge is bisected, a tet with two split edges of one face is cut into 3 and one with the three
+			edges of a face into 4 under that face, any other tet with split edges is refined red and the closure
+			goes on. A face with two split edges is cut from the midpoint of the longer one, so that both its tets
+			agree. The green tets are worse shaped than their parents, refine the parents rather than them again.
+			\param marked tets of pIn
+			*/
+			void redGreen(TMeshType * pIn, TMeshType * pOut, const std::vector<TPtr> & marked);
+
+		private:
+			/*! at most 4 input vertices and their weights */
+			struct Parents
+			{
+				int n;
+				int ids[4];
+				double weights[4];
+			};
+
+			/*! dense ids of the input vertices, tets and edges */
+			void _numberInput(TMeshType * pIn);
+			/*! the dense ids of the 6 edges of each tet, in the order of _edge */
+			void _tetEdges(TMeshType * pIn);
+			/*! red-green refinement with the edges that are split */
+			void _refine(TMeshType * pIn, TMeshType * pOut, std::vector<char> & split);
+			/*! compute the positions, orient the children like their parents, build pOut and interpolate */
+			void _finish(TMeshType * pOut, std::vector<std::array<int, 4>> & tets);
+
+			/*! local edge of the tet joining its vertices a and b */
+			static int _edge(int a, int b)
+			{
+				static const int edges[4][4] = { { -1, 0, 1, 2 }, { 0, -1, 3, 4 }, { 1, 3, -1, 5 }, { 2, 4, 5, -1 } };
+				return edges[a][b];
+			};
+			static double _volume(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d)
+			{
+				return (b - a) * ((c - a) ^ (d - a));
+			};
+
+			std::vector<VPtr>    mVertices;
+			std::vector<TPtr>    mTets;
+			std::vector<EPtr>    mEdges;
+			std::vector<int>     mVertexIds;
+			std::vector<int>     mTetIds;
+			std::vector<int>     mEdgeIds;
+			/*! 6 edges per tet */
+			std::vector<int>     mTetEdgeIds;
+
+			/*! output vertex -> input vertices, the first mVertices.size() are the copies */
+			std::vector<Parents> mVertexParents;
+			/*! output tet -> input tet */
+			std::vector<int>     mTetParents;
+			std::vector<CPoint>  mPoints;
+		};
+
+		template<typename TMeshType>
+		inline void CTMeshRefinement<TMeshType>::centroidStar(TMeshType * pIn, TMeshType * pOut)
+		{
+			_numberInput(pIn);
+			const int numV = (int)mVertices.size();
+			const int numT = (int)mTets.size();
+
+			mVertexParents.resize(numV + numT);
+			mTetParents.resize(4 * numT);
+			std::vector<std::array<int, 4>> tets(4 * numT);
+#pragma omp parallel for
+			for (int t = 0; t < numT; ++t)
+			{
+				Parents & parents = mVertexParents[numV + t];
+				parents.n = 4;
+				for (int k = 0; k < 4; ++k)
+				{
+					parents.ids[k] = mVertexIds[TMeshType::TetVertex(mTets[t], k)->index()];
+					parents.weights[k] = 0.25;
+				}
+				/* child k is the tet with vertex k moved to the centroid: the face opposite k coned to it */
+				for (int k = 0; k < 4; ++k)
+				{
+					std::array<int, 4> & child = tets[4 * t + k];
+					for (int j = 0; j < 4; ++j) child[j] = parents.ids[j];
+					child[k] = numV + t;
+					mTetParents[4 * t + k] = t;
+				}
+			}
+			_finish(pOut, tets);
+		}
+
+		template<typename TMeshType>
+		inline void CTMeshRefinement<TMeshType>::red(TMeshType * pIn, TMeshType * pOut)
+		{
+			_numberInput(pIn);
+			std::vector<char> split(mEdges.size(), 1);
+			_refine(pIn, pOut, split);
+		}
+
+		template<typename TMeshType>
+		inline void CTMeshRefinement<TMeshType>::redGreen(TMeshType * pIn, TMeshType * pOut, const std::vector<TPtr> & marked)
+		{
+			_numberInput(pIn);
+			_tetEdges(pIn);
+			std::vector<char> split(mEdges.size(), 0);
+			for (TPtr pT : marked)
+			{
+				const int t = mTetIds[pT->index()];
+				for (int j = 0; j < 6; ++j) split[mTetEdgeIds[6 * t + j]] = 1;
+			}
+			_refine(pIn, pOut, split);
+		}
+
+		template<typename TMeshType>
+		inline void CTMeshRefinement<TMeshType>::_numberInput(TMeshType * pIn)
+		{
+			mVertices.clear();
+			mTets.clear();
+			mEdges.clear();
+			mTetEdgeIds.clear();
+			mVertexIds.assign(pIn->vertices().getCurrentIndex(), -1);
+			mTetIds.assign(pIn->tets().getCurrentIndex(), -1);
+			mEdgeIds.assign(pIn->edges().getCurrentIndex(), -1);
+			for (VPtr pV : pIn->vertices())
+			{
+				mVertexIds[pV->index()] = (int)mVertices.size();
+				mVertices.push_back(pV);
+			}
+			for (TPtr pT : pIn->tets())
+			{
+				mTetIds[pT->index()] = (int)mTets.size();
+				mTets.push_back(pT);
+			}
+			for (EPtr pE : pIn->edges())
+			{
+				mEdgeIds[pE->index()] = (int)mEdges.size();
+				mEdges.push_back(pE);
+			}
+
+			const int numV = (int)mVertices.size();
+			mVertexParents.resize(numV);
+#pragma omp parallel for
+			for (int i = 0; i < numV; ++i)
+			{
+				mVertexParents[i].n = 1;
+				mVertexParents[i].ids[0] = i;
+				mVertexParents[i].weights[0] = 1.0;
+			}
+		}
+
+		template<typename TMeshType>
+		inline void CTMeshRefinement<TMeshType>::_tetEdges(TMeshType * pIn)
+		{
+			if (!mTetEdgeIds.empty()) return;
+			const int numT = (int)mTets.size();
+			mTetEdgeIds.resize(6 * numT);
+#pragma omp parallel for
+			for (int t = 0; t < numT; ++t)
+			{
+				TPtr pT = mTets[t];
+				VPtr pVs[4];
+				for (int k = 0; k < 4; ++k) pVs[k] = TMeshType::TetVertex(pT, k);
+				/* the halfedges of the four half faces go around every edge of the tet */
+				for (int i = 0; i < 4; ++i)
+				{
+					HEPtr pH = TMeshType::HalfFaceHalfEdge(TMeshType::TetHalfFace(pT, i));
+					for (int k = 0; k < 3; ++k, pH = TMeshType::HalfEdgeNext(pH))
+					{
+						VPtr pS = TMeshType::HalfEdgeSource(pH);
+						VPtr pD = TMeshType::HalfEdgeTarget(pH);
+						int a = 0, b = 0;
+						while (pVs[a] != pS) ++a;
+						while (pVs[b] != pD) ++b;
+						mTetEdgeIds[6 * t + _edge(a, b)] = mEdgeIds[TMeshType::HalfEdgeEdge(pH)->index()];
+					}
+				}
+			}
+		}
+
+		template<typename TMeshType>
+		inline void CTMeshRefinement<TMeshType>::_refine(TMeshType * pIn, TMeshType * pOut, std::vector<char> & split)
+		{
+			_tetEdges(pIn);
+			const int numV = (int)mVertices.size();
+			const int numT = (int)mTets.size();
+			const int numE = (int)mEdges.size();
+
+			/* the split edges of a tet as bits in the order of _edge: the allowed patterns are none, one edge,
+			two edges of a face, i.e. not opposite, the 3 edges of the face opposite a vertex, and all */
+			static const int faceMasks[4] = { 56, 38, 21, 11 };
+			static const int oppositeMasks[3] = { 33, 18, 12 };
+			auto pattern = [&](int t) {
+				int mask = 0;
+				for (int j = 0; j < 6; ++j) if (split[mTetEdgeIds[6 * t + j]]) mask |= 1 << j;
+				return mask;
+			};
+			auto allowed = [&](int mask) {
+				const int rest = mask & (mask - 1);
+				if (mask == 0 || mask == 63 || rest == 0) return true;
+				if ((rest & (rest - 1)) == 0) return mask != oppositeMasks[0] && mask != oppositeMasks[1] && mask != oppositeMasks[2];
+				return mask == faceMasks[0] || mask == faceMasks[1] || mask == faceMasks[2] || mask == faceMasks[3];
+			};
+			auto numChildren = [](int mask) {
+				int n = 0;
+				for (int j = 0; j < 6; ++j) n += (mask >> j) & 1;
+				static const int counts[7] = { 1, 2, 3, 4, 0, 0, 8 };
+				return counts[n];
+			};
+			/* the longer of two edges, by dense id on ties, so that the tets of a face agree */
+			auto longer = [&](int e0, int e1) {
+				const double l0 = (TMeshType::EdgeVertex1(mEdges[e0])->position() - TMeshType::EdgeVertex2(mEdges[e0])->position()).normSquare();
+				const double l1 = (TMeshType::EdgeVertex1(mEdges[e1])->position() - TMeshType::EdgeVertex2(mEdges[e1])->position()).normSquare();
+				return l0 > l1 || (l0 == l1 && e0 > e1);
+			};
+			std::vector<char> upgrade(numT);
+			for (;;)
+			{
+				int numUpgrades = 0;
+#pragma omp parallel for reduction(+:numUpgrades)
+				for (int t = 0; t < numT; ++t)
+				{
+					upgrade[t] = allowed(pattern(t)) ? 0 : 1;
+					numUpgrades += upgrade[t];
+				}
+				if (numUpgrades == 0) break;
+				for (int t = 0; t < numT; ++t)
+				{
+					if (!upgrade[t]) continue;
+					for (int j = 0; j < 6; ++j) split[mTetEdgeIds[6 * t + j]] = 1;
+				}
+			}
+
+			/* a midpoint per split edge */
+			std::vector<int> midIds(numE);
+#pragma omp parallel for
+			for (int e = 0; e < numE; ++e) midIds[e] = split[e];
+			const int numMids = Parallel::exclusiveScan(midIds);
+			mVertexParents.resize(numV + numMids);
+#pragma omp parallel for
+			for (int e = 0; e < numE; ++e)
+			{
+				if (!split[e]) continue;
+				Parents & parents = mVertexParents[numV + midIds[e]];
+				parents.n = 2;
+				parents.ids[0] = mVertexIds[TMeshType::EdgeVertex1(mEdges[e])->index()];
+				parents.ids[1] = mVertexIds[TMeshType::EdgeVertex2(mEdges[e])->index()];
+				parents.weights[0] = parents.weights[1] = 0.5;
+			}
+
+			std::vector<int> offsets(numT);
+#pragma omp parallel for
+			for (int t = 0; t < numT; ++t)
+			{
+				offsets[t] = numChildren(pattern(t));
+			}
+			const int numOut = Parallel::exclusiveScan(offsets);
+			mTetParents.resize(numOut);
+			std::vector<std::array<int, 4>> tets(numOut);
+
+			static const int ends[6][2] = { { 0, 1 }, { 0, 2 }, { 0, 3 }, { 1, 2 }, { 1, 3 }, { 2, 3 } };
+			/* the three pairs of opposite edges, and for each the cycle of the 4 other edges around the octahedron */
+			static const int diagonals[3][2] = { { 0, 5 }, { 1, 4 }, { 2, 3 } };
+			static const int equators[3][4] = { { 1, 2, 4, 3 }, { 0, 2, 5, 3 }, { 0, 1, 5, 4 } };
+#pragma omp parallel for
+			for (int t = 0; t < numT; ++t)
+			{
+				TPtr pT = mTets[t];
+				int v[4], m[6];
+				for (int k = 0; k < 4; ++k) v[k] = mVertexIds[TMeshType::TetVertex(pT, k)->index()];
+				for (int j = 0; j < 6; ++j)
+				{
+					const int e = mTetEdgeIds[6 * t + j];
+					m[j] = split[e] ? numV + midIds[e] : -1;
+				}
+				const int mask = pattern(t);
+				std::array<int, 4> * children = &tets[offsets[t]];
+				const int count = numChildren(mask);
+				for (int c = 0; c < count; ++c) mTetParents[offsets[t] + c] = t;
+
+				if (mask == 0)
+				{
+					children[0] = { v[0], v[1], v[2], v[3] };
+				}
+				else if (count == 2)
+				{
+					/* bisection: each end of the edge in turn moved to the midpoint */
+					int j = 0;
+					while (!(mask & (1 << j))) ++j;
+					for (int c = 0; c < 2; ++c)
+					{
+						children[c] = { v[0], v[1], v[2], v[3] };
+						children[c][ends[j][c]] = m[j];
+					}
+				}
+				else if (count == 3)
+				{
+					/* edges a b and a c split: the corner at a, and the quad b c m_ac m_ab cut from the midpoint of the longer edge */
+					int j0 = 0;
+					while (!(mask & (1 << j0))) ++j0;
+					int j1 = j0 + 1;
+					while (!(mask & (1 << j1))) ++j1;
+					const int a = ends[j0][0] == ends[j1][0] || ends[j0][0] == ends[j1][1] ? ends[j0][0] : ends[j0][1];
+					int b = ends[j0][0] == a ? ends[j0][1] : ends[j0][0];
+					int c = ends[j1][0] == a ? ends[j1][1] : ends[j1][0];
+					if (!longer(mTetEdgeIds[6 * t + _edge(a, b)], mTetEdgeIds[6 * t + _edge(a, c)])) std::swap(b, c);
+					const int d = 6 - a - b - c;
+					const int mb = m[_edge(a, b)], mc = m[_edge(a, c)];
+					children[0] = { v[a], mb, mc, v[d] };
+					children[1] = { mb, v[b], v[c], v[d] };
+					children[2] = { mb, v[c], mc, v[d] };
+				}
+				else if (count == 4)
+				{
+					/* the face opposite d cut into 4 and coned to d */
+					int d = 0;
+					while (mask != faceMasks[d]) ++d;
+					int f[3], n = 0;
+					for (int k = 0; k < 4; ++k) if (k != d) f[n++] = k;
+					const int m01 = m[_edge(f[0], f[1])], m12 = m[_edge(f[1], f[2])], m02 = m[_edge(f[0], f[2])];
+					children[0] = { v[f[0]], m01, m02, v[d] };
+					children[1] = { m01, v[f[1]], m12, v[d] };
+					children[2] = { m02, m12, v[f[2]], v[d] };
+					children[3] = { m01, m12, m02, v[d] };
+				}
+				else
+				{
+					/* the corners */
+					for (int k = 0; k < 4; ++k)
+					{
+						for (int j = 0; j < 4; ++j) children[k][j] = j == k ? v[k] : m[_edge(j, k)];
+					}
+					/* the octahedron around its shortest diagonal */
+					int best = 0;
+					double bestLength = -1;
+					for (int i = 0; i < 3; ++i)
+					{
+						const CPoint a = (mVertices[v[ends[diagonals[i][0]][0]]]->position() + mVertices[v[ends[diagonals[i][0]][1]]]->position()) / 2;
+						const CPoint b = (mVertices[v[ends[diagonals[i][1]][0]]]->position() + mVertices[v[ends[diagonals[i][1]][1]]]->position()) / 2;
+						const double length = (b - a).normSquare();
+						if (bestLength < 0 || length < bestLength)
+						{
+							best = i;
+							bestLength = length;
+						}
+					}
+					for (int k = 0; k < 4; ++k)
+					{
+						children[4 + k] = { m[diagonals[best][0]], m[diagonals[best][1]],
+							m[equators[best][k]], m[equators[best][(k + 1) % 4]] };
+					}
+				}
+			}
+			_finish(pOut, tets);
+		}
+
+		template<typename TMeshType>
+		inline void CTMeshRefinement<TMeshType>::_finish(TMeshType * pOut, std::vector<std::array<int, 4>> & tets)
+		{
+			const int numV = (int)mVertexParents.size();
+			const int numT = (int)tets.size();
+			mPoints.resize(numV);
+#pragma omp parallel for
+			for (int i = 0; i < numV; ++i)
+			{
+				const Parents & parents = mVertexParents[i];
+				CPoint p(0, 0, 0);
+				for (int k = 0; k < parents.n; ++k) p += mVertices[parents.ids[k]]->position() * parents.weights[k];
+				mPoints[i] = p;
+			}
+
+			/* swap two vertices of the children whose orientation differs from their parent's */
+#pragma omp parallel for
+			for (int c = 0; c < numT; ++c)
+			{
+				TPtr pT = mTets[mTetParents[c]];
+				const double parentVolume = _volume(TMeshType::TetVertex(pT, 0)->position(), TMeshType::TetVertex(pT, 1)->position(),
+					TMeshType::TetVertex(pT, 2)->position(), TMeshType::TetVertex(pT, 3)->position());
+				std::array<int, 4> & child = tets[c];
+				const double volume = _volume(mPoints[child[0]], mPoints[child[1]], mPoints[child[2]], mPoints[child[3]]);
+				if ((volume < 0) != (parentVolume < 0)) std::swap(child[2], child[3]);
+			}
+
+			pOut->_load_vtBuffer(mPoints, tets);
+
+			if (vertexInterpolator)
+			{
+#pragma omp parallel
+				{
+					VPtr pParents[4];
+#pragma omp for
+					for (int i = 0; i < numV; ++i)
+					{
+						const Parents & parents = mVertexParents[i];
+						for (int k = 0; k < parents.n; ++k) pParents[k] = mVertices[parents.ids[k]];
+						vertexInterpolator(pOut->vertices().getPointer(i), pParents, parents.weights, parents.n);
+					}
+				}
+			}
+			if (tetInterpolator)
+			{
+#pragma omp parallel for
+				for (int c = 0; c < numT; ++c)
+				{
+					tetInterpolator(pOut->tets().getPointer(c), mTets[mTetParents[c]]);
+				}
+			}
+		}
+	}
+}
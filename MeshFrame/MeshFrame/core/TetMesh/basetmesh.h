@@ -24,6 +24,7 @@
 #include <string>
 #include <iomanip>
 #include <iterator>
+#include <algorithm>
 
 #include "../Geometry/Point.h"
 #include "../Geometry/Point2.h"
@@ -31,8 +32,11 @@
 #include "../Parser/IOFuncDef.h"
 #include "../Memory/MemoryPool.h"
 #include "../Memory/Array.h"
+#include "../Memory/VertexPairIndex.h"
+#include "../Parallel/ParallelAlgorithms.h"
 
 #include "TProps.h"
+#include "TMeshCSR.h"
 
 #ifndef MAX_LINE 
 #define MAX_LINE 2048
@@ -124,6 +128,15 @@ namespace MeshLib
 			*/
 			void _load_vtArray(const std::vector<std::array<double, 3>>& verts, const std::vector<std::array<int, 4>>& tetVIds, bool checkOrientation = false);
 
+			/*!
+			Build the mesh from vertex positions and tets like _load_vtArray, for generated meshes: all the members
+			are allocated up front and linked in parallel, the faces and the edges are matched by a parallel sort
+			instead of the vertex lists. The mesh must be empty, vertex i gets index() and id() i, tet j index() j.
+			\param verts the vertex positions
+			\param tetVIds the 0-based vertex indices of the tets, taken as they are oriented
+			*/
+			void _load_vtBuffer(const std::vector<CPoint>& verts, const std::vector<std::array<int, 4>>& tetVIds);
+
 			/*!
 				Write tet mesh to a file
 				*/
@@ -184,6 +197,12 @@ namespace MeshLib
 			TContainer& tets() { return mTContainer; };
 			const TContainer & tets() const { return mTContainer; };
 
+			/*!
+			Snapshot the vertex-vertex, vertex-tet and tet-tet adjacency in compressed sparse rows, in parallel.
+			\param csr the output snapshot
+			*/
+			void buildCSR(CTMeshCSR<VertexType, TetType> & csr);
+
 			/*! access the vertex with ID */
 			VertexType * idVertex(int id) { return m_map_Vertices[id]; };
 
@@ -203,6 +222,15 @@ namespace MeshLib
 
 			/*! Vertex->Edge */
 			static EdgeType* VertexEdge(VertexType* v1, VertexType* v2);
+			/*!
+			Make findEdge use a hash index from vertex pairs to edges instead of walking the edge list of the
+			vertex. The index is built at the first lookup, the first lookup is not thread safe.
+			*/
+			void useVertexPairIndex(bool use = true);
+			/*! Drop the index after the edges were changed, it is rebuilt at the next lookup */
+			void invalidateVertexPairIndex();
+			/*! Same as VertexEdge(v1, v2), through the vertex pair index if it is used */
+			EdgeType* findEdge(VertexType* v1, VertexType* v2);
 
 			//Access TVertex data memebers
 			static VertexType* TVertexVertex(TVertexType* pTVertex);
@@ -365,6 +393,11 @@ namespace MeshLib
 
 			void  _construct_tet(TetType* pT, int tID, int * v);
 			void  _construct_tet_orientation(TetType* pT, int tId, int  v[4]);
+			/*!
+			link the members of a tet as _construct_tet does, pVs being its vertices in order; the faces, the edges
+			and the lists of the vertices are left to the caller
+			*/
+			static void _link_tet(TetType* pT, VertexType** pVs, TVertexType** pTVs, HalfFaceType** pHFs, HalfEdgeType** pHEs, TEdgeType** pTEs);
 			/*! construct faces */
 			void  _construct_faces();
 			/*! construct edges */
@@ -448,6 +481,10 @@ namespace MeshLib
 			VPropHandle<HFArray> mVHFArrayHandle;
 			VPropHandle<TEArray> mVTEArrayHandle;
 
+			/*! (smaller vertex index, larger vertex index) -> edge, see useVertexPairIndex */
+			CVertexPairIndex<EdgeType*> mEIndex;
+			bool mUseVertexPairIndex = false;
+			bool mEIndexValid = false;
 		};
 
 		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
@@ -753,6 +790,10 @@ namespace MeshLib
 			_construct_faces();
 			_construct_edges();
 
+			/* the Edge lines go through the vertex pair index */
+			const bool usedVertexPairIndex = mUseVertexPairIndex;
+			invalidateVertexPairIndex();
+			mUseVertexPairIndex = true;
 			for (int id = 0; id < m_nEdges && is.getline(buffer, MAX_LINE); id++)
 			{
 				std::string line(buffer);
@@ -779,7 +820,7 @@ namespace MeshLib
 				VertexType * pV1 = idVertex(id1);
 				VertexType * pV2 = idVertex(id2);
 
-				EdgeType * pE = VertexEdge(pV1, pV2);
+				EdgeType * pE = findEdge(pV1, pV2);
 
 				if (!stokenizer.nextToken("\t\r\n"))
 				{
@@ -796,6 +837,7 @@ namespace MeshLib
 				//	pE->string() = token.substr(sp + 1, ep - sp - 1);
 				//}
 			}
+			if (!usedVertexPairIndex) useVertexPairIndex(false);
 
 			m_nEdges = (int)mEContainer.size();
 
@@ -963,6 +1005,237 @@ namespace MeshLib
 			removeVProp(mVTEArrayHandle);
 		}
 
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		void CTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_load_vtBuffer(
+			const std::vector<CPoint>& verts, const std::vector<std::array<int, 4>>& tetVIds)
+		{
+			const int numV = (int)verts.size();
+			const int numT = (int)tetVIds.size();
+
+			/* the pools hand out the indices in order: tet t owns the tvertices 4 t + k, the half faces 4 t + i,
+			the halfedges 12 t + 3 i + k and the tedges 6 t + j */
+			mVContainer.reserve(numV);
+			mTContainer.reserve(numT);
+			mTVContainer.reserve(4 * numT);
+			mHFContainer.reserve(4 * numT);
+			mHEContainer.reserve(12 * numT);
+			mTEContainer.reserve(6 * numT);
+			for (int i = 0; i < numV; ++i) createVertexWithIndex();
+			for (int t = 0; t < numT; ++t) createTetWithIndex();
+			for (int i = 0; i < 4 * numT; ++i) createTVertex();
+			for (int i = 0; i < 4 * numT; ++i) createHalfFaceWithIndex();
+			for (int i = 0; i < 12 * numT; ++i) createHalfEdgeWithIndex();
+			for (int i = 0; i < 6 * numT; ++i) createTEdgeWithIndex();
+
+#pragma omp parallel for
+			for (int i = 0; i < numV; ++i)
+			{
+				mVContainer.getPointer(i)->position() = verts[i];
+			}
+
+			/* the links of _construct_tet, tet by tet */
+#pragma omp parallel for
+			for (int t = 0; t < numT; ++t)
+			{
+				TetType* pT = mTContainer.getPointer(t);
+				pT->id() = t;
+				VertexType* pVs[4];
+				TVertexType* pTVs[4];
+				HalfFaceType* pHFs[4];
+				HalfEdgeType* pHEs[12];
+				TEdgeType* pTEs[6];
+				for (int k = 0; k < 4; k++)
+				{
+					pVs[k] = mVContainer.getPointer(tetVIds[t][k]);
+					pTVs[k] = mTVContainer.getPointer(4 * t + k);
+					pHFs[k] = mHFContainer.getPointer(4 * t + k);
+				}
+				for (int k = 0; k < 12; k++) pHEs[k] = mHEContainer.getPointer(12 * t + k);
+				for (int j = 0; j < 6; j++) pTEs[j] = mTEContainer.getPointer(6 * t + j);
+				_link_tet(pT, pVs, pTVs, pHFs, pHEs, pTEs);
+			}
+
+			/* faces: the half faces with the same keys are next to each other once sorted, the first one is the left */
+			const int numHF = 4 * numT;
+			std::vector<std::array<int, 4>> hfKeys(numHF);
+#pragma omp parallel for
+			for (int h = 0; h < numHF; ++h)
+			{
+				HalfFaceType* pHF = mHFContainer.getPointer(h);
+				hfKeys[h] = { pHF->key(0), pHF->key(1), pHF->key(2), h };
+			}
+			Parallel::sort(hfKeys.begin(), hfKeys.end());
+			std::vector<int> faceIds(numHF);
+#pragma omp parallel for
+			for (int i = 0; i < numHF; ++i)
+			{
+				const bool sameAsPrev = i > 0 && std::equal(hfKeys[i].begin(), hfKeys[i].begin() + 3, hfKeys[i - 1].begin());
+				faceIds[i] = sameAsPrev ? 0 : 1;
+			}
+			const int numF = Parallel::exclusiveScan(faceIds);
+			mFContainer.reserve(numF);
+			for (int i = 0; i < numF; ++i) createFace();
+#pragma omp parallel for
+			for (int i = 0; i < numHF; ++i)
+			{
+				const bool sameAsPrev = i > 0 && std::equal(hfKeys[i].begin(), hfKeys[i].begin() + 3, hfKeys[i - 1].begin());
+				if (sameAsPrev) continue;
+				HalfFaceType* pHF = mHFContainer.getPointer(hfKeys[i][3]);
+				FaceType* f = mFContainer.getPointer(faceIds[i]);
+				f->SetLeft(pHF);
+				pHF->SetFace(f);
+				if (i + 1 < numHF && std::equal(hfKeys[i].begin(), hfKeys[i].begin() + 3, hfKeys[i + 1].begin()))
+				{
+					HalfFaceType* pH = mHFContainer.getPointer(hfKeys[i + 1][3]);
+					pH->SetDual(pHF);
+					pHF->SetDual(pH);
+					f->SetRight(pH);
+					pH->SetFace(f);
+				}
+			}
+
+			/* edges: the runs of tedges with the same keys */
+			const int numTE = 6 * numT;
+			std::vector<std::array<int, 3>> teKeys(numTE);
+#pragma omp parallel for
+			for (int j = 0; j < numTE; ++j)
+			{
+				TEdgeType* pTE = mTEContainer.getPointer(j);
+				teKeys[j] = { pTE->key(0), pTE->key(1), j };
+			}
+			Parallel::sort(teKeys.begin(), teKeys.end());
+			std::vector<int> edgeIds(numTE);
+#pragma omp parallel for
+			for (int i = 0; i < numTE; ++i)
+			{
+				edgeIds[i] = i == 0 || teKeys[i][0] != teKeys[i - 1][0] || teKeys[i][1] != teKeys[i - 1][1] ? 1 : 0;
+			}
+			const int numE = Parallel::exclusiveScan(edgeIds);
+			mEContainer.reserve(numE);
+			for (int i = 0; i < numE; ++i) createEdgeWithIndex();
+#pragma omp parallel for
+			for (int i = 0; i < numTE; ++i)
+			{
+				if (i > 0 && teKeys[i][0] == teKeys[i - 1][0] && teKeys[i][1] == teKeys[i - 1][1]) continue;
+				EdgeType* e = mEContainer.getPointer(edgeIds[i]);
+				e->SetVertex1(mVContainer.getPointer(teKeys[i][0]));
+				e->SetVertex2(mVContainer.getPointer(teKeys[i][1]));
+				for (int j = i; j < numTE && teKeys[j][0] == teKeys[i][0] && teKeys[j][1] == teKeys[i][1]; ++j)
+				{
+					TEdgeType* pTE = mTEContainer.getPointer(teKeys[j][2]);
+					e->edges()->push_back(pTE);
+					pTE->SetEdge(e);
+				}
+			}
+
+			/* the vertex lists, in the order of the serial loaders */
+			for (int i = 0; i < 4 * numT; ++i)
+			{
+				TVertexType* pTV = mTVContainer.getPointer(i);
+				TVertexVertex(pTV)->tvertices()->push_back(pTV);
+			}
+			for (int i = 0; i < numE; ++i)
+			{
+				EdgeType* pE = mEContainer.getPointer(i);
+				EdgeVertex1(pE)->edges()->push_back(pE);
+				EdgeVertex2(pE)->edges()->push_back(pE);
+			}
+
+			m_nVertices = numV;
+			m_nTets = numT;
+			m_nEdges = numE;
+			m_maxVertexId = numV - 1;
+
+			// label the boundary for faces and vertices
+			for (int i = 0; i < numF; ++i)
+			{
+				FaceType* pF = mFContainer.getPointer(i);
+				if (FaceRightHalfFace(pF) != NULL) continue;
+				pF->boundary() = true;
+				HalfEdgeType* pHE = HalfFaceHalfEdge(FaceLeftHalfFace(pF));
+				for (int k = 0; k < 3; ++k)
+				{
+					HalfEdgeSource(pHE)->boundary() = true;
+					HalfEdgeEdge(pHE)->boundary() = true;
+					pHE = HalfEdgeNext(pHE);
+				}
+			}
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		void CTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_link_tet(TetType* pT, VertexType** pVs,
+			TVertexType** pTVs, HalfFaceType** pHFs, HalfEdgeType** pHEs, TEdgeType** pTEs)
+		{
+			for (int k = 0; k < 4; k++)
+			{
+				TVertexType* pTV = pTVs[k];
+				pT->setTVertex(pTV, k);
+				pTV->id() = k;
+				pTV->set_vert(pVs[k]);
+				pTV->set_tet(pT);
+			}
+
+			int order[4][3] = { { 1, 2, 3 },{ 2, 0, 3 },{ 0, 1, 3 },{ 1, 0, 2 } };
+			HalfFaceType** pHF = pHFs;
+			for (int i = 0; i < 4; i++)
+			{
+				HalfEdgeType** pH = pHEs + 3 * i;
+				for (int k = 0; k < 3; k++)
+				{
+					TVertexType* pTV = TetTVertex(pT, order[i][k]);
+					pH[k]->SetHalfFace(pHF[i]);
+					pH[k]->SetTarget(TetTVertex(pT, order[i][(k + 1) % 3]));
+					pTV->set_halfedge(pH[k]);
+					pHF[i]->key(k) = pVs[order[i][k]]->id();
+				}
+				for (int k = 0; k < 3; k++)
+				{
+					pH[k]->SetNext(pH[(k + 1) % 3]);
+					pH[k]->SetPrev(pH[(k + 2) % 3]);
+				}
+				pHF[i]->SetHalfEdge(pH[0]);
+				std::sort(&pHF[i]->key(0), &pHF[i]->key(0) + 3);
+				pT->setHalfFace(pHF[i], i);
+				pHF[i]->SetTet(pT);
+			}
+
+			for (int j = 0; j < 6; j++)
+			{
+				HalfEdgeType* pH0;
+				HalfEdgeType* pH1;
+				if (j < 3)
+				{
+					pH0 = HalfEdgeNext(HalfFaceHalfEdge(pHF[j]));
+					pH1 = HalfEdgePrev(HalfFaceHalfEdge(pHF[(j + 1) % 3]));
+				}
+				else
+				{
+					pH0 = HalfFaceHalfEdge(pHF[3]);
+					for (int i = 3; i < j; i++) pH0 = HalfEdgeNext(pH0);
+					pH1 = HalfFaceHalfEdge(pHF[5 - j]);
+				}
+				pH0->SetDual(pH1);
+				pH1->SetDual(pH0);
+
+				TEdgeType* pTE = pTEs[j];
+				pTE->SetTet(pT);
+				pH0->SetTEdge(pTE);
+				pH1->SetTEdge(pTE);
+				if (pH0->source()->id() < pH0->target()->id())
+				{
+					pTE->SetLeft(pH0);
+					pTE->SetRight(pH1);
+				}
+				else
+				{
+					pTE->SetLeft(pH1);
+					pTE->SetRight(pH0);
+				}
+				pTE->key(0) = pTE->left()->source()->id();
+				pTE->key(1) = pTE->left()->target()->id();
+			}
+		}
+
 		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
 
 		HalfFaceType* CTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::_construct_half_face(TVertexType ** pTV)
@@ -1733,6 +2006,85 @@ namespace MeshLib
 			}
 			return NULL;
 		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline void CTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::buildCSR(CTMeshCSR<VertexType, TetType> & csr)
+		{
+			csr.vertices.clear();
+			csr.tets.clear();
+			csr.vertexIds.assign(mVContainer.getCurrentIndex(), -1);
+			csr.tetIds.assign(mTContainer.getCurrentIndex(), -1);
+			csr.vertices.reserve(mVContainer.size());
+			csr.tets.reserve(mTContainer.size());
+			for (VertexType* pV : mVContainer)
+			{
+				csr.vertexIds[pV->index()] = (int)csr.vertices.size();
+				csr.vertices.push_back(pV);
+			}
+			for (TetType* pT : mTContainer)
+			{
+				csr.tetIds[pT->index()] = (int)csr.tets.size();
+				csr.tets.push_back(pT);
+			}
+			const std::vector<int> & vIds = csr.vertexIds;
+			const std::vector<int> & tIds = csr.tetIds;
+
+			csr.vv.build(csr.numVertices(), [&](int i, std::vector<int> & row) {
+				VertexType* pV = csr.vertices[i];
+				for (EdgeType* pE : *VertexEdgeList(pV))
+				{
+					VertexType* pW = EdgeVertex1(pE) == pV ? EdgeVertex2(pE) : EdgeVertex1(pE);
+					row.push_back(vIds[pW->index()]);
+				}
+				std::sort(row.begin(), row.end());
+			});
+			csr.vt.build(csr.numVertices(), [&](int i, std::vector<int> & row) {
+				for (TVertexType* pTV : *VertexTVertexList(csr.vertices[i]))
+				{
+					row.push_back(tIds[TVertexTet(pTV)->index()]);
+				}
+				std::sort(row.begin(), row.end());
+			});
+			csr.tt.build(csr.numTets(), [&](int i, std::vector<int> & row) {
+				for (int j = 0; j < 4; ++j)
+				{
+					HalfFaceType* pHF = HalfFaceDual(TetHalfFace(csr.tets[i], j));
+					if (pHF != NULL) row.push_back(tIds[HalfFaceTet(pHF)->index()]);
+				}
+			});
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline void CTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::useVertexPairIndex(bool use)
+		{
+			mUseVertexPairIndex = use;
+			if (!use) invalidateVertexPairIndex();
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline void CTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::invalidateVertexPairIndex()
+		{
+			mEIndex.clear();
+			mEIndexValid = false;
+		}
+
+		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
+		inline EdgeType* CTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::findEdge(VertexType* v1, VertexType* v2)
+		{
+			if (!mUseVertexPairIndex) return VertexEdge(v1, v2);
+			if (!mEIndexValid)
+			{
+				mEIndex.reserve(mEContainer.size());
+				for (EdgeType* pE : mEContainer)
+				{
+					size_t i1 = EdgeVertex1(pE)->index(), i2 = EdgeVertex2(pE)->index();
+					mEIndex.insert(std::min(i1, i2), std::max(i1, i2), pE);
+				}
+				mEIndexValid = true;
+			}
+			size_t i1 = v1->index(), i2 = v2->index();
+			return mEIndex.find(std::min(i1, i2), std::max(i1, i2));
+		}
 		/*------------------------------------------------------------------------------------------------
 		Access TVertex data members
 		--------------------------------------------------------------------------------------------------*/
@@ -1899,7 +2251,7 @@ namespace MeshLib
 		template <typename TVertexType, typename VertexType, typename HalfEdgeType, typename TEdgeType, typename EdgeType, typename HalfFaceType, typename FaceType, typename TetType>
 		inline double CTMesh<TVertexType, VertexType, HalfEdgeType, TEdgeType, EdgeType, HalfFaceType, FaceType, TetType>::EdgeLengthSquare(EdgeType* pEdge)
 		{
-			return (EdgeVertex1(pEdge)->position() - EdgeVertex2(pEdge)->position()).norm2();
+			return (EdgeVertex1(pEdge)->position() - EdgeVertex2(pEdge)->position()).normSquare();
 		}
 
 		/*------------------------------------------------------------------------------------------------
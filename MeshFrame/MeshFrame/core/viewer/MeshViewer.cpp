@@ -7,6 +7,8 @@
 #include <MeshFrame\core\Mesh\MeshCoreHeaders.h>
 
 #include <MeshFrame\core\viewer\Arcball.h>
+#include <MeshFrame\core\Spatial\FaceBVH.h>
+#include <MeshFrame\core\Mesh\MeshNormals.h>
 
 #define MAX(a,b) ((a)>(b) ? (a) : (b))
 #define MIN(a,b) ((a)<(b) ? (a) : (b))
@@ -29,6 +31,15 @@ VPropHandle<CPoint2> vUVHdl;
 FPropHandle<CPointF> fColorHdl, fNormalHdl;
 EPropHandle<CPointF> eColorHdl;
 
+/* faces hierarchy for picking, built at the first pick after the mesh was set */
+CFaceBVH<CMeshGL> faceBVH;
+bool faceBVHOutdated = true;
+bool faceBVHToRefit = false;
+
+/* normals of the whole mesh, rebuilt when the mesh was set, recomputed in place when it moved */
+CMeshNormals<CMeshGL> meshNormals;
+bool meshNormalsOutdated = true;
+
 /* window width and height */
 int win_width, win_height;
 int gButton;
@@ -261,6 +272,7 @@ void help()
 	printf("W  -  Wireframe Display\n");
 	printf("F  -  Flat Shading \n");
 	printf("S  -  Smooth Shading\n");
+	printf("P  -  Pick a face with the next left click\n");
 	printf("?  -  Help Information\n");
 	printf("esc - quit\n");
 	printf("We suggest you to define your own controlling keys with lower case charactors.");
@@ -290,6 +302,9 @@ void keyBoard(unsigned char key, int x, int y)
 	case '?':
 		help();
 		break;
+	case 'P':
+		selectionMode = true;
+		break;
 	case 'T':
 		textureFlag = (textureFlag + 1) % 3;
 		switch (textureFlag)
@@ -368,6 +383,7 @@ void initialize_bmp_texture()
 	glEnable(GL_TEXTURE_2D);
 }
 
+/*! ray from the near plane through the cursor, in the object coordinate system */
 void projectRay(int x_cursor, int y_cursor, CPoint &org, CPoint &drt) {
 
 	GLfloat winX, winY;
@@ -381,9 +397,9 @@ void projectRay(int x_cursor, int y_cursor, CPoint &org, CPoint &drt) {
 
 	// obtain the world coordinates
 	bool bResult = gluUnProject(winX, winY, 0.0, modelview, projection, viewport, &posX, &posY, &posZ);
-	drt[0] = posX; drt[1] = posY; drt[2] = posZ;
-	bResult = gluUnProject(winX, winY, 1.0, modelview, projection, viewport, &posX, &posY, &posZ);
 	org[0] = posX; org[1] = posY; org[2] = posZ;
+	bResult = gluUnProject(winX, winY, 1.0, modelview, projection, viewport, &posX, &posY, &posZ);
+	drt[0] = posX; drt[1] = posY; drt[2] = posZ;
 
 	drt = drt - org;
 }
@@ -459,33 +475,27 @@ void  mouseClick(int button, int state, int x, int y) {
 	if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN && selectionMode) {
 		CPoint drt, org;
 		// build ray
-		projectRay(x, y, drt, org);
-
-
-		int viewport[4];
-		// get matrixs and viewport:
-
-
-		//for (CMeshGL::FPtr pF : pMesh->faces())
-		//{
-		//	float insertX, insertY, insertZ;
-		//
-		//	CMeshGL::VPtr pVs[3];
-		//	int i = 0;
-		//	for (CMeshGL::VPtr pV : ITGL::FVIterator(pF))
-		//	{
-		//		pVs[i] = pV;
-		//		++i;
-		//	}
-		//	if (intersectTriangle(org, drt, pVs[0]->point(), pVs[1]->point(), pVs[2]->point(), &insertX, &insertY, &insertZ)) {
-		//		pF->color().r = 255;
-		//		pF->color().g = 0;
-		//		pF->color().b = 0;
-		//
-		//		printf("Insert with face: %d\n", pF->id());
-		//	}
-		//}
+		projectRay(x, y, org, drt);
+
+		if (faceBVHOutdated) {
+			faceBVH.build(pMesh);
+			faceBVHOutdated = false;
+			faceBVHToRefit = false;
+		}
+		else if (faceBVHToRefit) {
+			faceBVH.refit();
+			faceBVHToRefit = false;
+		}
 
+		CFaceBVH<CMeshGL>::Hit hit;
+		if (faceBVH.intersect(org, drt, hit)) {
+			CPointF & color = pMesh->gFP(fColorHdl, hit.pF);
+			color[0] = 1.0;
+			color[1] = 0.0;
+			color[2] = 0.0;
+			printf("Picked face: %d, barycentric coordinates: (%f, %f, %f)\n", hit.pF->id(), 1.0 - hit.u - hit.v, hit.u, hit.v);
+		}
+		glutPostRedisplay();
 
 		selectionMode = false;
 	}
@@ -603,6 +613,8 @@ void MeshLib::CMeshViewer::setMeshPointer(void * pNewM, bool toComputeN, bool to
 {
 	m_pM = pNewM;
 	pMesh = (CMeshGL::Ptr)pNewM;
+	faceBVHOutdated = true;
+	meshNormalsOutdated = true;
 	//VPropHandle<CPointF>
 	//VPropHandle<CPoint2>
 	//FPropHandle<CPointF>
@@ -665,12 +677,34 @@ void MeshLib::CMeshViewer::setMeshPointer(void * pNewM, bool toComputeN, bool to
 		normalizeMesh();
 }
 
+void MeshLib::CMeshViewer::updateMeshGeometry(bool toComputeN)
+{
+	faceBVHToRefit = true;
+	if (toComputeN || !pMesh->vertices().front().hasNormal()) {
+		computeFNormal();
+		computeVNormal();
+	}
+	else
+	{
+		copyFNormal();
+		copyVNormal();
+	}
+}
+
 void MeshLib::CMeshViewer::computeFNormal()
 {
-	for (auto pF : ITGL::MFIterator(pMesh))
+	if (meshNormalsOutdated) {
+		meshNormals.build(pMesh);
+		meshNormalsOutdated = false;
+	}
+	else {
+		meshNormals.update();
+	}
+#pragma omp parallel for
+	for (int i = 0; i < meshNormals.numFaces(); ++i)
 	{
-		CPointF & fNProp = pMesh->gFP(fNormalHdl, pF);
-		CPoint fN = CMeshGL::faceNormal(pF);
+		CPointF & fNProp = pMesh->gFP(fNormalHdl, meshNormals.face(i));
+		CPoint fN = meshNormals.faceNormal(i);
 		fNProp[0] = (float)fN[0];
 		fNProp[1] = (float)fN[1];
 		fNProp[2] = (float)fN[2];
@@ -679,13 +713,19 @@ void MeshLib::CMeshViewer::computeFNormal()
 
 void MeshLib::CMeshViewer::computeVNormal()
 {
-	for (auto pV : ITGL::MVIterator(pMesh))
+	/* the face normals are computed with the vertex normals, by computeFNormal */
+	if (meshNormalsOutdated) {
+		meshNormals.build(pMesh);
+		meshNormalsOutdated = false;
+	}
+#pragma omp parallel for
+	for (int i = 0; i < meshNormals.numVertices(); ++i)
 	{
-		CPointF vN(0, 0, 0);
-		for (auto pF : ITGL::VFIterator(pV)) {
-			vN += pMesh->gFP(fNormalHdl, pF) * CMeshGL::faceArea(pF);
-		}
-		pMesh->gVP(vNormalHdl, pV) = vN / vN.norm();
+		CPointF & vNProp = pMesh->gVP(vNormalHdl, meshNormals.vertex(i));
+		const CPoint & vN = meshNormals.vertexNormal(i);
+		vNProp[0] = (float)vN[0];
+		vNProp[1] = (float)vN[1];
+		vNProp[2] = (float)vN[2];
 	}
 }
 
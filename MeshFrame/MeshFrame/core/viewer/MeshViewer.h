@@ -64,6 +64,12 @@ namespace MeshLib {
 		CMeshViewer();
 		CMeshViewer(void * pM, bool toComputeN = true, bool toNormalize = false, bool copyFields = true);
 		void setMeshPointer(void * pM, bool toComputeN = true, bool toNormalize = false, bool copyFields = true);
+		/*
+		* Refresh the rendering buffers after the vertex positions of the current mesh were changed in place,
+		* e.g. by CBaseMesh::updatePositionsFromBuffer. Unlike setMeshPointer, no property is reallocated.
+		* \param toComputeN   : whether to compute normal for vertices and faces again
+		*/
+		void updateMeshGeometry(bool toComputeN = true);
 
 		/*
 		* You can set your key responding function own here.